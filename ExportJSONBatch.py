@@ -0,0 +1,43 @@
+import os
+import sys
+import time
+import bpy
+
+current_dir = os.path.dirname(__file__)
+module_path = os.path.join(current_dir,'third-party','io_scene_json')
+module_path = os.path.abspath(module_path)
+sys.path.append(module_path)
+
+import export_json
+
+
+argv = sys.argv
+argv = argv[argv.index("--") + 1:] # get all args after "--"
+
+if len(argv) % 2 != 0:
+    sys.stderr.write('Expected pairs of input and output files.\n')
+    sys.exit(1)
+
+# stdout carries Blender's log, so the timings go to stderr.
+failed = 0
+total_start = time.time()
+for i in range(0, len(argv), 2):
+    blend_file = argv[i]
+    out = argv[i+1]
+    start = time.time()
+    try:
+        bpy.ops.wm.open_mainfile(filepath=blend_file)
+        export_json.save(
+            bpy.data.scenes[0],
+            filepath=out,
+            triangulate=True,
+            y_is_up=True)
+    except Exception as error:
+        sys.stderr.write('%s: %s\n' % (blend_file, error))
+        failed += 1
+        continue
+    sys.stderr.write('%s: %.2f s\n' % (out, time.time() - start))
+
+sys.stderr.write('%d files in %.2f s\n' % (len(argv)//2 - failed, time.time() - total_start))
+if failed:
+    sys.exit(1)
@@ -0,0 +1,307 @@
+#if !defined(_WIN32)
+#define _GNU_SOURCE // posix_memalign, madvise
+#endif
+#include <assert.h>
+#include <stdlib.h> // malloc, free, posix_memalign
+#include <string.h> // memset
+#include <stdint.h> // uintptr_t
+#if defined(_WIN32)
+#include <malloc.h> // _aligned_malloc, _aligned_free
+#include <windows.h> // SRWLOCK
+#else
+#include <pthread.h>
+#include <sys/mman.h> // madvise
+#endif
+#include "allocator.h"
+
+
+enum
+{
+    HugePageSize      = 2*1024*1024,
+    HugePageThreshold = 4*HugePageSize,
+    PoolSlotCount     = 32,
+    PoolMinimumSize   = 64*1024 // Smaller buffers are cheap to allocate.
+};
+
+static bool HugePagesEnabled = true;
+
+
+static void * AllocateWithAlignment( size_t size, size_t alignment )
+{
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    void * memory = NULL;
+    if(posix_memalign(&memory, alignment, size) != 0)
+        return NULL;
+    return memory;
+#endif
+}
+
+void * AllocateAligned( size_t size )
+{
+    if(size == 0)
+        size = 1;
+
+    if(HugePagesEnabled && size >= HugePageThreshold)
+    {
+        void * memory = AllocateWithAlignment(size, HugePageSize);
+#if defined(MADV_HUGEPAGE)
+        if(memory)
+            madvise(memory, size - size % HugePageSize, MADV_HUGEPAGE);
+#endif
+        return memory;
+    }
+
+    return AllocateWithAlignment(size, MemoryAlignment);
+}
+
+void FreeAligned( void * memory )
+{
+#if defined(_WIN32)
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+void SetHugePagesEnabled( bool enabled )
+{
+    HugePagesEnabled = enabled;
+}
+
+
+// --- Buffer pool ---
+
+typedef struct
+{
+    void * memory;
+    size_t size;
+} PoolSlot;
+
+static PoolSlot PoolSlots[PoolSlotCount];
+static size_t PoolSize = 0;
+static size_t PoolLimit = (size_t)1024*1024*1024;
+static size_t BufferUsage = 0;
+static size_t PeakBufferUsage = 0;
+
+#if defined(_WIN32)
+static SRWLOCK PoolLock = SRWLOCK_INIT;
+static void LockPool()   { AcquireSRWLockExclusive(&PoolLock); }
+static void UnlockPool() { ReleaseSRWLockExclusive(&PoolLock); }
+#else
+static pthread_mutex_t PoolLock = PTHREAD_MUTEX_INITIALIZER;
+static void LockPool()   { pthread_mutex_lock(&PoolLock); }
+static void UnlockPool() { pthread_mutex_unlock(&PoolLock); }
+#endif
+
+static void AddBufferUsage( size_t size )
+{
+    LockPool();
+    BufferUsage += size;
+    if(BufferUsage > PeakBufferUsage)
+        PeakBufferUsage = BufferUsage;
+    UnlockPool();
+}
+
+static void RemoveBufferUsage( size_t size )
+{
+    LockPool();
+    BufferUsage -= size;
+    UnlockPool();
+}
+
+void * AcquireBuffer( size_t size )
+{
+    AddBufferUsage(size);
+
+    if(size >= PoolMinimumSize)
+    {
+        LockPool();
+
+        // Pick the smallest pooled buffer which is large enough, but don't
+        // waste more than half of it:
+        int best = -1;
+        for(int i = 0; i < PoolSlotCount; i++)
+        {
+            const PoolSlot * slot = &PoolSlots[i];
+            if(slot->memory &&
+               slot->size >= size &&
+               slot->size/2 <= size &&
+               (best == -1 || slot->size < PoolSlots[best].size))
+                best = i;
+        }
+
+        if(best != -1)
+        {
+            void * memory = PoolSlots[best].memory;
+            PoolSize -= PoolSlots[best].size;
+            memset(&PoolSlots[best], 0, sizeof(PoolSlot));
+            UnlockPool();
+            return memory;
+        }
+
+        UnlockPool();
+    }
+
+    return AllocateAligned(size);
+}
+
+void ReleaseBuffer( void * memory, size_t size )
+{
+    if(!memory)
+        return;
+    RemoveBufferUsage(size);
+
+    if(size >= PoolMinimumSize)
+    {
+        LockPool();
+        if(PoolSize + size <= PoolLimit)
+        {
+            for(int i = 0; i < PoolSlotCount; i++)
+            {
+                PoolSlot * slot = &PoolSlots[i];
+                if(!slot->memory)
+                {
+                    slot->memory = memory;
+                    slot->size = size;
+                    PoolSize += size;
+                    UnlockPool();
+                    return;
+                }
+            }
+        }
+        UnlockPool();
+    }
+
+    FreeAligned(memory);
+}
+
+void ClearBufferPool()
+{
+    LockPool();
+    for(int i = 0; i < PoolSlotCount; i++)
+    {
+        PoolSlot * slot = &PoolSlots[i];
+        if(slot->memory)
+            FreeAligned(slot->memory);
+        memset(slot, 0, sizeof(PoolSlot));
+    }
+    PoolSize = 0;
+    UnlockPool();
+}
+
+void SetBufferPoolLimit( size_t bytes )
+{
+    LockPool();
+    PoolLimit = bytes;
+    UnlockPool();
+}
+
+size_t GetPeakBufferUsage()
+{
+    LockPool();
+    const size_t peak = PeakBufferUsage;
+    UnlockPool();
+    return peak;
+}
+
+
+// --- Arena ---
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock * previous;
+    unsigned char * memory;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+struct Arena
+{
+    ArenaBlock * block; // Most recent block
+    size_t initialSize;
+};
+
+static size_t AlignSize( size_t size )
+{
+    return (size + MemoryAlignment-1) & ~(size_t)(MemoryAlignment-1);
+}
+
+static ArenaBlock * CreateArenaBlock( size_t size, ArenaBlock * previous )
+{
+    ArenaBlock * block = (ArenaBlock *)malloc(sizeof(ArenaBlock));
+    block->previous = previous;
+    block->memory   = (unsigned char *)AcquireBuffer(size);
+    block->size     = size;
+    block->used     = 0;
+    return block;
+}
+
+static void FreeArenaBlocks( ArenaBlock * block )
+{
+    while(block)
+    {
+        ArenaBlock * previous = block->previous;
+        ReleaseBuffer(block->memory, block->size);
+        free(block);
+        block = previous;
+    }
+}
+
+Arena * CreateArena( size_t initialSize )
+{
+    Arena * arena = (Arena *)malloc(sizeof(Arena));
+    arena->block = NULL;
+    arena->initialSize = AlignSize(initialSize > 0 ? initialSize : PoolMinimumSize);
+    return arena;
+}
+
+void FreeArena( Arena * arena )
+{
+    FreeArenaBlocks(arena->block);
+    memset(arena, 0, sizeof(Arena));
+    free(arena);
+}
+
+void * ArenaAllocate( Arena * arena, size_t size )
+{
+    size = AlignSize(size > 0 ? size : 1);
+
+    ArenaBlock * block = arena->block;
+    if(!block || block->used + size > block->size)
+    {
+        size_t blockSize = block ? block->size*2 : arena->initialSize;
+        if(blockSize < size)
+            blockSize = size;
+        block = CreateArenaBlock(blockSize, block);
+        arena->block = block;
+    }
+
+    void * memory = block->memory + block->used;
+    block->used += size;
+    assert(((uintptr_t)memory % MemoryAlignment) == 0);
+    return memory;
+}
+
+void ResetArena( Arena * arena )
+{
+    ArenaBlock * block = arena->block;
+    if(!block)
+        return;
+
+    if(block->previous)
+    {
+        // Replace the chain with a single block which fits everything,
+        // so the next run doesn't need to grow the arena again.
+        size_t totalSize = 0;
+        for(ArenaBlock * b = block; b; b = b->previous)
+            totalSize += b->size;
+        FreeArenaBlocks(block);
+        arena->block = CreateArenaBlock(totalSize, NULL);
+    }
+    else
+    {
+        block->used = 0;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef __ALLOCATOR_H__
+#define __ALLOCATOR_H__
+
+#include <stdbool.h>
+#include <stddef.h> // size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum
+{
+    /**
+     * Alignment of all buffers returned by this module.
+     * Suits cache lines and every SIMD register size up to AVX-512.
+     */
+    MemoryAlignment = 64
+};
+
+/**
+ * Allocates a buffer which is aligned to #MemoryAlignment.
+ *
+ * Large buffers are backed by huge pages if the system supports it,
+ * which greatly reduces page faults and TLB misses for gigapixel images.
+ */
+void * AllocateAligned( size_t size );
+void FreeAligned( void * memory );
+
+void SetHugePagesEnabled( bool enabled );
+
+
+/**
+ * Returns an aligned buffer, reusing a previously released one if possible.
+ *
+ * Batch runs process many similar sized images.  Reusing their buffers
+ * avoids faulting in fresh pages for every image.  Thread safe.
+ */
+void * AcquireBuffer( size_t size );
+
+/**
+ * Hands a buffer back to the pool.
+ *
+ * @param size
+ * Must be the size which was passed to #AcquireBuffer.
+ */
+void ReleaseBuffer( void * memory, size_t size );
+
+/**
+ * Frees all pooled buffers.
+ */
+void ClearBufferPool();
+
+/**
+ * Upper bound for the memory which is kept in the pool.
+ */
+void SetBufferPoolLimit( size_t bytes );
+
+/**
+ * Most memory which was acquired and not yet released at the same time.
+ */
+size_t GetPeakBufferUsage();
+
+
+/**
+ * Bump allocator for scratch memory which is only needed during a single run.
+ *
+ * Allocations are released all at once by #ResetArena, which keeps the
+ * memory for the next run.  An arena must only be used by one thread.
+ */
+typedef struct Arena Arena;
+
+Arena * CreateArena( size_t initialSize );
+void FreeArena( Arena * arena );
+void * ArenaAllocate( Arena * arena, size_t size );
+void ResetArena( Arena * arena );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
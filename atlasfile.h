@@ -0,0 +1,75 @@
+#ifndef __ATLASFILE_H__
+#define __ATLASFILE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Texture atlas lookup tables, as written by `gen-atlas`.
+ *
+ * Everything is little endian and every section starts at a multiple of
+ * #AtlasFileAlignment, so a mapped file can be used in place:
+ *
+ * - #AtlasFileHeader
+ * - #AtlasFilePage array
+ * - #AtlasFileEntry array, sorted by name for binary search
+ * - strings, zero terminated UTF-8
+ *
+ * Offsets are counted from the start of the file.
+ */
+
+enum
+{
+    AtlasFileVersion = 1,
+    AtlasFileAlignment = 16
+};
+
+#define ATLAS_FILE_MAGIC "KATL"
+
+typedef struct
+{
+    char magic[4]; // ATLAS_FILE_MAGIC
+    uint32_t version;
+    uint32_t fileSize;
+    uint32_t padding; // Pixels around each entry
+
+    uint32_t pageCount;
+    uint32_t pageOffset;
+    uint32_t entryCount;
+    uint32_t entryOffset;
+    uint32_t stringSize;
+    uint32_t stringOffset;
+} AtlasFileHeader;
+
+typedef struct
+{
+    uint32_t fileName; // Offset into the strings
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+} AtlasFilePage;
+
+/**
+ * Texture coordinates span the pixels of the entry without its padding:
+ * `uvMin = position/pageSize` and `uvMax = (position + size)/pageSize`
+ */
+typedef struct
+{
+    uint32_t name; // Offset into the strings, the input file name
+    uint32_t page;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    float uvMin[2];
+    float uvMax[2];
+} AtlasFileEntry;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,320 @@
+#include <assert.h>
+#include <stdio.h> // fopen, fread, fprintf, printf
+#include <stdlib.h> // malloc, realloc, free, strtol, atol
+#include <string.h> // memset, strlen, strchr, strcmp, memcpy
+#include <ctype.h> // isspace
+#include "batch.h"
+
+
+static char * CopyString( const char * begin, size_t length )
+{
+    char * copy = (char *)malloc(length+1);
+    memcpy(copy, begin, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static void AddArgument( ManifestEntry * entry, char * argument )
+{
+    entry->argv = (char * *)realloc(entry->argv, sizeof(char *)*(entry->argc+2));
+    entry->argv[entry->argc] = argument;
+    entry->argc++;
+    entry->argv[entry->argc] = NULL;
+}
+
+/**
+ * Splits a line into arguments.  Modifies the line.
+ */
+static bool ParseManifestLine( char * line, ManifestEntry * entry )
+{
+    char * c = line;
+    for(;;)
+    {
+        while(*c && isspace((unsigned char)*c))
+            c++;
+        if(*c == '\0' || *c == '#')
+            return true;
+
+        // Quoted parts may appear anywhere in an argument:
+        char * argument = c;
+        char * end = c;
+        while(*c && !isspace((unsigned char)*c))
+        {
+            if(*c == '"' || *c == '\'')
+            {
+                const char quote = *c++;
+                while(*c && *c != quote)
+                    *end++ = *c++;
+                if(*c != quote)
+                    return false;
+                c++;
+            }
+            else
+            {
+                *end++ = *c++;
+            }
+        }
+        const bool lineEnd = (*c == '\0');
+        AddArgument(entry, CopyString(argument, end-argument));
+        if(lineEnd)
+            return true;
+        c++;
+    }
+}
+
+bool ParseManifestEntry( char * line,
+                         const char * programName,
+                         ManifestEntry * entry )
+{
+    memset(entry, 0, sizeof(ManifestEntry));
+    AddArgument(entry, CopyString(programName, strlen(programName)));
+
+    if(!ParseManifestLine(line, entry))
+    {
+        FreeManifestEntry(entry);
+        return false;
+    }
+    return true;
+}
+
+void FreeManifestEntry( ManifestEntry * entry )
+{
+    for(int i = 0; i < entry->argc; i++)
+        free(entry->argv[i]);
+    free(entry->argv);
+    memset(entry, 0, sizeof(ManifestEntry));
+}
+
+static char * ReadTextFile( const char * fileName )
+{
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+        return NULL;
+
+    size_t size = 0;
+    size_t capacity = 4096;
+    char * text = (char *)malloc(capacity);
+    for(;;)
+    {
+        size += fread(&text[size], 1, capacity-size-1, file);
+        if(size < capacity-1)
+            break;
+        capacity *= 2;
+        text = (char *)realloc(text, capacity);
+    }
+    text[size] = '\0';
+    fclose(file);
+    return text;
+}
+
+Manifest * ReadManifest( const char * fileName, const char * programName )
+{
+    char * text = ReadTextFile(fileName);
+    if(!text)
+    {
+        fprintf(stderr, "Could not open manifest '%s'.\n", fileName);
+        return NULL;
+    }
+
+    Manifest * manifest = (Manifest *)malloc(sizeof(Manifest));
+    memset(manifest, 0, sizeof(Manifest));
+
+    int lineNumber = 1;
+    for(char * line = text; line; lineNumber++)
+    {
+        char * lineEnd = strchr(line, '\n');
+        if(lineEnd)
+            *lineEnd = '\0';
+
+        ManifestEntry entry;
+        if(!ParseManifestEntry(line, programName, &entry))
+        {
+            fprintf(stderr, "%s:%d: Unterminated quote.\n", fileName, lineNumber);
+            FreeManifest(manifest);
+            free(text);
+            return NULL;
+        }
+        entry.line = lineNumber;
+
+        if(entry.argc > 1)
+        {
+            manifest->entries =
+                (ManifestEntry *)realloc(manifest->entries,
+                                         sizeof(ManifestEntry)*(manifest->entryCount+1));
+            manifest->entries[manifest->entryCount] = entry;
+            manifest->entryCount++;
+        }
+        else
+        {
+            FreeManifestEntry(&entry);
+        }
+
+        line = lineEnd ? lineEnd+1 : NULL;
+    }
+
+    free(text);
+    return manifest;
+}
+
+void FreeManifest( Manifest * manifest )
+{
+    for(int i = 0; i < manifest->entryCount; i++)
+        FreeManifestEntry(&manifest->entries[i]);
+    free(manifest->entries);
+    memset(manifest, 0, sizeof(Manifest));
+    free(manifest);
+}
+
+void InitBatchOptions( BatchOptions * options )
+{
+    options->manifestFileName = NULL;
+    InitPipelineOptions(&options->pipeline);
+    options->serverSocketName = NULL;
+    options->inputCacheSize = 512;
+    options->watch = false;
+}
+
+static bool ParseThreadCounts( const char * value, PipelineOptions * options )
+{
+    // <compute>[:<decode>[:<encode>]]
+    static const PipelineStage order[PipelineStageCount] =
+    {
+        ComputeStage,
+        DecodeStage,
+        EncodeStage
+    };
+
+    const char * c = value;
+    for(int i = 0; i < PipelineStageCount; i++)
+    {
+        char * end;
+        const long threads = strtol(c, &end, 10);
+        if(end == c || threads < 0)
+            return false;
+        options->threads[order[i]] = (int)threads;
+
+        if(*end == '\0')
+            return true;
+        if(*end != ':')
+            return false;
+        c = end+1;
+    }
+    return false;
+}
+
+int ParseBatchOption( int argc, char * * argv, int * i, BatchOptions * options )
+{
+    const char * name = argv[*i];
+    if(strcmp(name, "-W") == 0)
+    {
+        options->watch = true;
+        return 1;
+    }
+
+    if(strcmp(name, "-b") != 0 &&
+       strcmp(name, "-j") != 0 &&
+       strcmp(name, "-m") != 0 &&
+       strcmp(name, "-s") != 0 &&
+       strcmp(name, "-i") != 0)
+        return 0;
+
+    if(*i+1 >= argc)
+    {
+        printf("Option needs a value.\n");
+        return -1;
+    }
+    (*i)++;
+    const char * value = argv[*i];
+
+    if(strcmp(name, "-b") == 0)
+    {
+        options->manifestFileName = value;
+    }
+    else if(strcmp(name, "-j") == 0)
+    {
+        if(!ParseThreadCounts(value, &options->pipeline))
+        {
+            printf("Invalid thread counts '%s'.\n", value);
+            return -1;
+        }
+    }
+    else if(strcmp(name, "-m") == 0)
+    {
+        options->pipeline.memoryLimit = (size_t)atol(value)*1024*1024;
+    }
+    else if(strcmp(name, "-s") == 0)
+    {
+        options->serverSocketName = value;
+    }
+    else
+    {
+        options->inputCacheSize = atoi(value);
+    }
+    return 1;
+}
+
+void PrintBatchHelp()
+{
+    printf("\t-b <manifest> (process '[options] <input> <output>' per line)\n");
+    printf("\t-j <compute>[:<decode>[:<encode>]] (batch threads per stage)\n");
+    printf("\t-m <megabytes> (limits memory of images in flight)\n");
+    printf("\t-W (keep watching and redo the jobs of changed inputs)\n");
+    printf("\t-s <socket> (serve jobs on a Unix socket)\n");
+    printf("\t-i <megabytes> (decoded inputs kept by the server, defaults to 512)\n");
+}
+
+bool RunBatch( const BatchOptions * options,
+               const char * programName,
+               const BatchStages * stages,
+               void * context )
+{
+    Manifest * manifest = ReadManifest(options->manifestFileName, programName);
+    if(!manifest)
+        return false;
+
+    const int itemCount = manifest->entryCount;
+    void * * items = (void * *)malloc(sizeof(void *)*(itemCount+1));
+    bool * results = (bool *)malloc(sizeof(bool)*(itemCount+1));
+
+    // Invalid entries are reported before anything is processed:
+    bool success = true;
+    for(int i = 0; i < itemCount; i++)
+    {
+        const ManifestEntry * entry = &manifest->entries[i];
+        items[i] = stages->createItem(entry->argc, entry->argv, context);
+        if(!items[i])
+        {
+            fprintf(stderr,
+                    "%s:%d: Invalid job.\n",
+                    options->manifestFileName,
+                    entry->line);
+            success = false;
+        }
+    }
+
+    if(success)
+    {
+        success = RunPipeline(items,
+                              itemCount,
+                              &stages->stages,
+                              context,
+                              &options->pipeline,
+                              results);
+
+        for(int i = 0; i < itemCount; i++)
+            if(!results[i])
+                fprintf(stderr,
+                        "%s:%d: Job failed.\n",
+                        options->manifestFileName,
+                        manifest->entries[i].line);
+    }
+
+    for(int i = 0; i < itemCount; i++)
+        if(items[i])
+            stages->freeItem(items[i], context);
+
+    free(results);
+    free(items);
+    FreeManifest(manifest);
+    return success;
+}
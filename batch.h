@@ -0,0 +1,117 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <stdbool.h>
+#include "pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A manifest lists one job per line, written like the command line arguments
+ * of the tool: `[options] <input> <output>`.
+ *
+ * Arguments are separated by whitespace and may be quoted with `"` or `'`.
+ * Empty lines and everything after a `#` are ignored.
+ */
+typedef struct
+{
+    int argc;
+    char * * argv; // argv[0] is the program name.
+    int line;
+} ManifestEntry;
+
+typedef struct
+{
+    ManifestEntry * entries;
+    int entryCount;
+} Manifest;
+
+Manifest * ReadManifest( const char * fileName, const char * programName );
+void FreeManifest( Manifest * manifest );
+
+/**
+ * Splits a single line into the arguments of an entry.  Modifies the line.
+ *
+ * @return
+ * `false` if a quote is unterminated.
+ */
+bool ParseManifestEntry( char * line,
+                         const char * programName,
+                         ManifestEntry * entry );
+void FreeManifestEntry( ManifestEntry * entry );
+
+typedef struct
+{
+    const char * manifestFileName;
+    PipelineOptions pipeline;
+
+    /**
+     * Serve jobs on this socket instead of reading a manifest.
+     * See #RunServer.
+     */
+    const char * serverSocketName;
+
+    /**
+     * Memory in megabytes for decoded inputs which the server keeps around.
+     */
+    int inputCacheSize;
+
+    /**
+     * Keep running after the manifest has been processed and redo jobs
+     * whose input changes.  See #RunWatch.
+     */
+    bool watch;
+} BatchOptions;
+
+void InitBatchOptions( BatchOptions * options );
+
+/**
+ * Parses the batch option at `argv[*i]`, if it is one.
+ *
+ * @return
+ * 1 if the option was consumed (`*i` then points to its last argument),
+ * 0 if it isn't a batch option and -1 if it is malformed.
+ */
+int ParseBatchOption( int argc, char * * argv, int * i, BatchOptions * options );
+
+void PrintBatchHelp();
+
+typedef struct
+{
+    /**
+     * Creates the item state from a manifest entry.
+     * Returns `NULL` if the entry is invalid.
+     */
+    void * (*createItem)( int argc, char * * argv, void * context );
+
+    /**
+     * Called for every created item, regardless of whether it succeeded.
+     */
+    void (*freeItem)( void * item, void * context );
+
+    /**
+     * Input file which the item is generated from.
+     */
+    const char * (*getInputFileName)( const void * item );
+
+    PipelineStages stages;
+} BatchStages;
+
+/**
+ * Runs all jobs of a manifest through a decode/compute/encode pipeline.
+ *
+ * @return
+ * Whether all jobs succeeded.
+ */
+bool RunBatch( const BatchOptions * options,
+               const char * programName,
+               const BatchStages * stages,
+               void * context );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,585 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime, getrusage, mkdtemp
+#include <stdio.h> // printf, fprintf, fopen, snprintf
+#include <stdlib.h> // malloc, free, atoi, atof, getenv
+#include <string.h> // strcmp, memset
+#include <stdint.h> // uint32_t
+#include <time.h> // clock_gettime
+#include <unistd.h> // unlink, rmdir
+#include <sys/resource.h> // getrusage
+#include "image.h"
+#include "threadpool.h"
+#include "normalmap.h"
+#include "distancefield.h"
+
+static const int DefaultMinSize = 512;
+static const int DefaultMaxSize = 2048;
+static const double DefaultMinTime = 0.5; // Seconds per measurement
+static const float MaxDistance = 16;
+static const int ScalingTileSize = 256;
+
+typedef struct
+{
+    int minSize;
+    int maxSize;
+    double minTime;
+    int maxThreads;
+    const char * directory; // For codec files
+    FILE * output;
+    int resultCount;
+} Bench;
+
+typedef void (*BenchFunction)( void * data );
+
+static void PrintHelp( const char * programName )
+{
+    printf("%s [options]\n", programName);
+
+    printf("\t-s <min size>:<max size> (square inputs, defaults to %d:%d)\n",
+           DefaultMinSize, DefaultMaxSize);
+    printf("\t-t <seconds> (minimum time per measurement, defaults to %g)\n",
+           DefaultMinTime);
+    printf("\t-j <threads> (maximum for thread scaling, defaults to all processors)\n");
+    printf("\t-d <directory> (for codec files, defaults to $TMPDIR or /tmp)\n");
+    printf("\t-o <file> (JSON results, defaults to stdout)\n");
+}
+
+static double GetTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec*1e-9;
+}
+
+static long GetPeakResidentSize()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // Kibibytes on Linux
+}
+
+
+// --- Synthetic inputs ---
+
+static uint32_t Hash( uint32_t x )
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static float HashToFloat( uint32_t x, uint32_t y, uint32_t seed )
+{
+    return (float)(Hash(x ^ Hash(y ^ Hash(seed))) & 0xffffff) / (float)0xffffff;
+}
+
+static float ValueNoise( float x, float y, uint32_t seed )
+{
+    const int cellX = (int)x;
+    const int cellY = (int)y;
+    float fx = x - cellX;
+    float fy = y - cellY;
+    fx = fx*fx*(3-2*fx);
+    fy = fy*fy*(3-2*fy);
+
+    const float a = HashToFloat(cellX,   cellY,   seed);
+    const float b = HashToFloat(cellX+1, cellY,   seed);
+    const float c = HashToFloat(cellX,   cellY+1, seed);
+    const float d = HashToFloat(cellX+1, cellY+1, seed);
+    return (a + (b-a)*fx) + ((c + (d-c)*fx) - (a + (b-a)*fx))*fy;
+}
+
+/**
+ * Several octaves of value noise.  Features have a fixed size in pixels, so
+ * larger images don't just look blurrier.
+ */
+static Image * CreateNoiseHeightMap( int size )
+{
+    Image * image = CreateImage(size, size, 1);
+    for(int y = 0; y < size; y++)
+    for(int x = 0; x < size; x++)
+    {
+        float height = 0;
+        float amplitude = 0.5f;
+        for(int octave = 0; octave < 4; octave++)
+        {
+            const float cellSize = (float)(256 >> (octave*2)); // 256 to 4
+            height += ValueNoise(x/cellSize, y/cellSize, octave) * amplitude;
+            amplitude *= 0.5f;
+        }
+        image->data[y*size + x] = height;
+    }
+    return image;
+}
+
+/**
+ * Glyph like shapes (discs, rings, bars and crosses) of varying size on a
+ * grid, which resemble the masks of decals and font atlases.
+ */
+static Image * CreateGlyphMask( int size )
+{
+    static const int CellSize = 128;
+    Image * image = CreateImage(size, size, 1);
+    for(int y = 0; y < size; y++)
+    for(int x = 0; x < size; x++)
+    {
+        const int cellX = x / CellSize;
+        const int cellY = y / CellSize;
+        const uint32_t cellHash = Hash(cellX*7919 + cellY*104729);
+        const float radius = CellSize*(0.15f + 0.3f*(cellHash & 0xff)/255.0f);
+        const float dx = (float)(x % CellSize) - CellSize*0.5f;
+        const float dy = (float)(y % CellSize) - CellSize*0.5f;
+        const float width = radius*0.3f;
+
+        bool inside;
+        switch((cellHash >> 8) % 4)
+        {
+            case 0: // Disc
+                inside = dx*dx + dy*dy < radius*radius;
+                break;
+            case 1: // Ring
+                inside = dx*dx + dy*dy < radius*radius &&
+                         dx*dx + dy*dy > (radius-width)*(radius-width);
+                break;
+            case 2: // Bar
+                inside = dx > -radius && dx < radius && dy > -width && dy < width;
+                break;
+            default: // Cross
+                inside = (dx > -radius && dx < radius && dy > -width && dy < width) ||
+                         (dy > -radius && dy < radius && dx > -width && dx < width);
+        }
+        image->data[y*size + x] = inside ? 1.0f : 0.0f;
+    }
+    return image;
+}
+
+
+// --- Measurement ---
+
+/**
+ * Runs the function until `minTime` passed.
+ *
+ * @return
+ * Seconds taken by all iterations.
+ */
+static double Measure( const Bench * bench,
+                       BenchFunction function,
+                       void * data,
+                       int * iterations )
+{
+    *iterations = 0;
+    const double start = GetTime();
+    double elapsed;
+    do
+    {
+        function(data);
+        (*iterations)++;
+        elapsed = GetTime() - start;
+    } while(elapsed < bench->minTime);
+    return elapsed;
+}
+
+static void WriteResult( Bench * bench,
+                         const char * benchmark,
+                         const char * variant,
+                         int size,
+                         int threads,
+                         int iterations,
+                         double seconds )
+{
+    const double pixels = (double)size*size*iterations;
+    fprintf(bench->output,
+            "%s\n    {\"benchmark\": \"%s\", \"variant\": \"%s\", "
+            "\"width\": %d, \"height\": %d, \"threads\": %d, "
+            "\"iterations\": %d, \"seconds\": %.6f, "
+            "\"mpixPerSecond\": %.3f, \"peakRssKiB\": %ld}",
+            bench->resultCount > 0 ? "," : "",
+            benchmark, variant,
+            size, size, threads,
+            iterations, seconds,
+            pixels / seconds * 1e-6,
+            GetPeakResidentSize());
+    fflush(bench->output);
+    bench->resultCount++;
+}
+
+
+// --- Normal maps ---
+
+typedef struct
+{
+    const Image * heightMap;
+    Image * normalMap;
+    NormalMapFilter filter;
+    bool wrap;
+} NormalMapRun;
+
+static void RunNormalMap( void * data )
+{
+    NormalMapRun * run = (NormalMapRun *)data;
+    GenerateNormalMap(run->heightMap->width,
+                      run->heightMap->height,
+                      run->heightMap->data,
+                      run->normalMap->data,
+                      run->filter,
+                      run->wrap,
+                      false);
+}
+
+static void BenchNormalMaps( Bench * bench, const Image * heightMap )
+{
+    NormalMapRun run;
+    run.heightMap = heightMap;
+    run.normalMap = CreateImage(heightMap->width, heightMap->height, 3);
+
+    for(int filter = 0; filter < NormalMapFilterCount; filter++)
+    for(int wrap = 0; wrap < 2; wrap++)
+    {
+        run.filter = (NormalMapFilter)filter;
+        run.wrap = wrap;
+
+        char variant[64];
+        snprintf(variant, sizeof(variant), "%s%s",
+                 NormalMapFilterToString(run.filter),
+                 wrap ? " wrap" : "");
+
+        int iterations;
+        const double seconds = Measure(bench, RunNormalMap, &run, &iterations);
+        WriteResult(bench, "normalmap", variant, heightMap->width, 1,
+                    iterations, seconds);
+    }
+
+    FreeImage(run.normalMap);
+}
+
+
+// --- Distance fields ---
+
+typedef struct
+{
+    const Image * mask;
+    Image * distanceField;
+    void * scratch;
+} DistanceFieldRun;
+
+static void RunDistanceField( void * data )
+{
+    DistanceFieldRun * run = (DistanceFieldRun *)data;
+    GenerateDistanceField(run->mask->width,
+                          run->mask->height,
+                          run->mask->data,
+                          run->distanceField->data,
+                          MaxDistance,
+                          run->scratch);
+}
+
+static void BenchDistanceField( Bench * bench, const Image * mask )
+{
+    DistanceFieldRun run;
+    run.mask = mask;
+    run.distanceField = CreateImage(mask->width, mask->height, 1);
+    run.scratch = malloc(GetDistanceFieldScratchSize(mask->width, mask->height));
+
+    int iterations;
+    const double seconds = Measure(bench, RunDistanceField, &run, &iterations);
+    WriteResult(bench, "distancefield", "full", mask->width, 1,
+                iterations, seconds);
+
+    free(run.scratch);
+    FreeImage(run.distanceField);
+}
+
+
+// --- Codecs ---
+
+typedef struct
+{
+    Image * image;
+    const char * fileName;
+} CodecRun;
+
+static void RunWrite( void * data )
+{
+    CodecRun * run = (CodecRun *)data;
+    WriteImage(run->image, run->fileName);
+}
+
+static void RunRead( void * data )
+{
+    CodecRun * run = (CodecRun *)data;
+    Image * image = ReadImage(run->fileName);
+    if(image)
+        FreeImage(image);
+}
+
+static void BenchCodecs( Bench * bench, const Image * heightMap )
+{
+    static const char * Formats[] = {"png", "pfm", "qoi"};
+
+    // Normal maps are the most common output:
+    Image * normalMap = CreateImage(heightMap->width, heightMap->height, 3);
+    GenerateNormalMap(heightMap->width,
+                      heightMap->height,
+                      heightMap->data,
+                      normalMap->data,
+                      Sobel3x3,
+                      false,
+                      false);
+
+    for(int i = 0; i < (int)(sizeof(Formats)/sizeof(Formats[0])); i++)
+    {
+        char fileName[1024];
+        snprintf(fileName, sizeof(fileName), "%s/bench.%s",
+                 bench->directory, Formats[i]);
+
+        CodecRun run;
+        run.image = normalMap;
+        run.fileName = fileName;
+
+        char variant[64];
+        int iterations;
+        double seconds = Measure(bench, RunWrite, &run, &iterations);
+        snprintf(variant, sizeof(variant), "%s write", Formats[i]);
+        WriteResult(bench, "codec", variant, heightMap->width, 1,
+                    iterations, seconds);
+
+        seconds = Measure(bench, RunRead, &run, &iterations);
+        snprintf(variant, sizeof(variant), "%s read", Formats[i]);
+        WriteResult(bench, "codec", variant, heightMap->width, 1,
+                    iterations, seconds);
+
+        unlink(fileName);
+    }
+
+    FreeImage(normalMap);
+}
+
+
+// --- Thread scaling ---
+
+typedef struct
+{
+    ThreadPool * pool;
+    TaskFunction function; // Processes one tile
+    const Image * input;
+    Image * output;
+    void * * scratch; // One per worker
+} ScalingRun;
+
+typedef struct
+{
+    ScalingRun * run;
+    int x, y, width, height;
+} ScalingTask;
+
+static void RunNormalMapTile( void * data, int workerIndex )
+{
+    const ScalingTask * task = (const ScalingTask *)data;
+    const Image * heightMap = task->run->input;
+    GenerateNormalMapRegion(heightMap->width,
+                            heightMap->height,
+                            heightMap->data,
+                            task->run->output->data,
+                            Sobel3x3,
+                            false,
+                            false,
+                            task->x, task->y, task->width, task->height);
+}
+
+static void RunDistanceFieldTile( void * data, int workerIndex )
+{
+    const ScalingTask * task = (const ScalingTask *)data;
+    const Image * mask = task->run->input;
+    GenerateDistanceFieldRegion(mask->width,
+                                mask->height,
+                                mask->data,
+                                task->run->output->data,
+                                MaxDistance,
+                                task->x, task->y, task->width, task->height,
+                                task->run->scratch[workerIndex]);
+}
+
+/**
+ * Splits the image into tiles, which are processed by the pool.
+ */
+static void RunTiles( void * data )
+{
+    ScalingRun * run = (ScalingRun *)data;
+    const int size = run->input->width;
+    const int tilesPerRow = (size + ScalingTileSize-1) / ScalingTileSize;
+    const int tileCount = tilesPerRow*tilesPerRow;
+
+    ScalingTask * tasks = (ScalingTask *)malloc(sizeof(ScalingTask)*tileCount);
+    for(int i = 0; i < tileCount; i++)
+    {
+        ScalingTask * task = &tasks[i];
+        task->run = run;
+        task->x = (i % tilesPerRow) * ScalingTileSize;
+        task->y = (i / tilesPerRow) * ScalingTileSize;
+        task->width  = (task->x + ScalingTileSize > size) ? size - task->x : ScalingTileSize;
+        task->height = (task->y + ScalingTileSize > size) ? size - task->y : ScalingTileSize;
+        SubmitTask(run->pool, run->function, task);
+    }
+    WaitForTasks(run->pool);
+    free(tasks);
+}
+
+static void BenchScaling( Bench * bench,
+                          const char * benchmark,
+                          TaskFunction function,
+                          const Image * input,
+                          int outputChannels,
+                          size_t scratchSize )
+{
+    ScalingRun run;
+    run.function = function;
+    run.input = input;
+    run.output = CreateImage(input->width, input->height, outputChannels);
+
+    for(int threads = 1;; threads *= 2)
+    {
+        if(threads > bench->maxThreads)
+            threads = bench->maxThreads;
+
+        run.pool = CreateThreadPool(threads);
+        run.scratch = (void * *)malloc(sizeof(void *)*threads);
+        for(int i = 0; i < threads; i++)
+            run.scratch[i] = scratchSize ? malloc(scratchSize) : NULL;
+
+        int iterations;
+        const double seconds = Measure(bench, RunTiles, &run, &iterations);
+        WriteResult(bench, benchmark, "tiles", input->width, threads,
+                    iterations, seconds);
+
+        for(int i = 0; i < threads; i++)
+            free(run.scratch[i]);
+        free(run.scratch);
+        FreeThreadPool(run.pool);
+
+        if(threads == bench->maxThreads)
+            break;
+    }
+
+    FreeImage(run.output);
+}
+
+
+static bool ParseSizes( const char * value, int * minSize, int * maxSize )
+{
+    return sscanf(value, "%d:%d", minSize, maxSize) == 2 &&
+           *minSize > 0 && *maxSize >= *minSize;
+}
+
+int main( int argc, char * * argv )
+{
+    Bench bench;
+    memset(&bench, 0, sizeof(Bench));
+    bench.minSize = DefaultMinSize;
+    bench.maxSize = DefaultMaxSize;
+    bench.minTime = DefaultMinTime;
+    bench.maxThreads = GetProcessorCount();
+    const char * outputFileName = NULL;
+    const char * directory = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-h") == 0)
+        {
+            PrintHelp(argv[0]);
+            return 0;
+        }
+        else if(strcmp(argv[i], "-s") == 0 ||
+                strcmp(argv[i], "-t") == 0 ||
+                strcmp(argv[i], "-j") == 0 ||
+                strcmp(argv[i], "-d") == 0 ||
+                strcmp(argv[i], "-o") == 0)
+        {
+            if(i+1 >= argc)
+            {
+                printf("Option needs a value.\n");
+                return 1;
+            }
+            const char option = argv[i][1];
+            i++;
+            switch(option)
+            {
+                case 's':
+                    if(!ParseSizes(argv[i], &bench.minSize, &bench.maxSize))
+                    {
+                        printf("Invalid sizes '%s'.\n", argv[i]);
+                        return 1;
+                    }
+                    break;
+                case 't': bench.minTime = atof(argv[i]); break;
+                case 'j': bench.maxThreads = atoi(argv[i]); break;
+                case 'd': directory = argv[i]; break;
+                default:  outputFileName = argv[i];
+            }
+        }
+        else
+        {
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if(bench.maxThreads < 1)
+        bench.maxThreads = 1;
+
+    char directoryName[1024];
+    snprintf(directoryName, sizeof(directoryName), "%s/konstrukt-bench-XXXXXX", directory);
+    bench.directory = mkdtemp(directoryName);
+    if(!bench.directory)
+    {
+        fprintf(stderr, "Could not create a directory in '%s'.\n", directory);
+        return 1;
+    }
+
+    bench.output = outputFileName ? fopen(outputFileName, "w") : stdout;
+    if(!bench.output)
+    {
+        fprintf(stderr, "Could not open '%s' for writing.\n", outputFileName);
+        rmdir(bench.directory);
+        return 1;
+    }
+
+    fprintf(bench.output,
+            "{\n  \"processors\": %d,\n  \"minTime\": %g,\n  \"results\": [",
+            GetProcessorCount(), bench.minTime);
+
+    for(int size = bench.minSize; size <= bench.maxSize; size *= 2)
+    {
+        fprintf(stderr, "%dx%d\n", size, size);
+        Image * heightMap = CreateNoiseHeightMap(size);
+        Image * mask = CreateGlyphMask(size);
+
+        BenchNormalMaps(&bench, heightMap);
+        BenchDistanceField(&bench, mask);
+        BenchCodecs(&bench, heightMap);
+
+        FreeImage(mask);
+        FreeImage(heightMap);
+    }
+
+    // Thread scaling is measured on the largest input:
+    fprintf(stderr, "Thread scaling\n");
+    Image * heightMap = CreateNoiseHeightMap(bench.maxSize);
+    BenchScaling(&bench, "normalmap", RunNormalMapTile, heightMap, 3, 0);
+    FreeImage(heightMap);
+
+    Image * mask = CreateGlyphMask(bench.maxSize);
+    BenchScaling(&bench, "distancefield", RunDistanceFieldTile, mask, 1,
+                 GetDistanceFieldRegionScratchSize(mask->width,
+                                                   mask->height,
+                                                   ScalingTileSize,
+                                                   ScalingTileSize,
+                                                   MaxDistance));
+    FreeImage(mask);
+
+    fprintf(bench.output, "\n  ],\n  \"peakRssKiB\": %ld\n}\n", GetPeakResidentSize());
+    if(bench.output != stdout)
+        fclose(bench.output);
+    rmdir(bench.directory);
+    return 0;
+}
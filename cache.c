@@ -0,0 +1,462 @@
+#define _POSIX_C_SOURCE 200809L // mkstemp, fdopen
+#include <stdio.h> // fopen, fread, fwrite, fprintf, printf, rename
+#include <stdlib.h> // malloc, realloc, free, getenv, atol, qsort
+#include <string.h> // memcpy, memcmp, memset, strlen, strcmp, strrchr
+#include <errno.h>
+#include <dirent.h> // opendir, readdir
+#include <sys/stat.h> // stat, mkdir, fchmod
+#include <unistd.h> // unlink, close
+#include <utime.h> // utime
+#include "cache.h"
+#include "stats.h"
+
+static const size_t DefaultCacheSize = 1024; // In megabytes
+
+// Changing the way keys are built must invalidate all existing entries:
+static const int CacheFormatVersion = 1;
+
+
+// --- Hashing ---
+
+static const uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+static uint64_t Rotate( uint64_t value, int bits )
+{
+    return (value << bits) | (value >> (64-bits));
+}
+
+static uint64_t Mix( uint64_t value )
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+/**
+ * Reads a little endian word, so keys don't depend on the host.
+ */
+static uint64_t ReadWord( const unsigned char * bytes )
+{
+    uint64_t word = 0;
+    for(int i = 7; i >= 0; i--)
+        word = (word << 8) | bytes[i];
+    return word;
+}
+
+static void HashWord( CacheHasher * hasher, uint64_t word )
+{
+    uint64_t * lanes = hasher->lanes;
+    lanes[0] = Rotate(lanes[0] ^ (word * Prime2), 31) * Prime1;
+    lanes[1] = Rotate(lanes[1] + (word * Prime1), 27) * Prime2 + lanes[0];
+}
+
+void InitCacheHasher( CacheHasher * hasher )
+{
+    memset(hasher, 0, sizeof(CacheHasher));
+    hasher->lanes[0] = Prime1;
+    hasher->lanes[1] = Prime2;
+    HashInt(hasher, CacheFormatVersion);
+}
+
+void HashBytes( CacheHasher * hasher, const void * data, size_t size )
+{
+    const unsigned char * bytes = (const unsigned char *)data;
+    hasher->length += size;
+
+    if(hasher->tailSize > 0)
+    {
+        while(size > 0 && hasher->tailSize < 8)
+        {
+            hasher->tail[hasher->tailSize++] = *bytes++;
+            size--;
+        }
+        if(hasher->tailSize < 8)
+            return;
+        HashWord(hasher, ReadWord(hasher->tail));
+        hasher->tailSize = 0;
+    }
+
+    for(; size >= 8; bytes += 8, size -= 8)
+        HashWord(hasher, ReadWord(bytes));
+
+    memcpy(hasher->tail, bytes, size);
+    hasher->tailSize = (int)size;
+}
+
+void HashString( CacheHasher * hasher, const char * string )
+{
+    HashBytes(hasher, string, strlen(string)+1);
+}
+
+void HashInt( CacheHasher * hasher, int value )
+{
+    const uint32_t bits = (uint32_t)value;
+    const unsigned char bytes[4] =
+    {
+        (unsigned char)(bits),
+        (unsigned char)(bits >> 8),
+        (unsigned char)(bits >> 16),
+        (unsigned char)(bits >> 24)
+    };
+    HashBytes(hasher, bytes, 4);
+}
+
+void HashFloat( CacheHasher * hasher, float value )
+{
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    HashInt(hasher, (int)bits);
+}
+
+void HashFileExtension( CacheHasher * hasher, const char * fileName )
+{
+    const char * dot = strrchr(fileName, '.');
+    const char * slash = strrchr(fileName, '/');
+    if(dot && (!slash || dot > slash))
+        HashString(hasher, dot+1);
+    else
+        HashString(hasher, "");
+}
+
+bool HashFile( CacheHasher * hasher, const char * fileName )
+{
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for reading.\n", fileName);
+        return false;
+    }
+
+    unsigned char buffer[64*1024];
+    size_t size;
+    while((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        HashBytes(hasher, buffer, size);
+
+    const bool success = !ferror(file);
+    fclose(file);
+    return success;
+}
+
+void FinishCacheKey( CacheHasher * hasher, char * key )
+{
+    unsigned char tail[8];
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, hasher->tail, hasher->tailSize);
+    HashWord(hasher, ReadWord(tail));
+    HashWord(hasher, hasher->length);
+
+    const uint64_t a = Mix(hasher->lanes[0] + hasher->lanes[1]);
+    const uint64_t b = Mix(hasher->lanes[1] ^ a);
+
+    static const char digits[] = "0123456789abcdef";
+    for(int i = 0; i < 16; i++)
+    {
+        key[i]    = digits[(a >> (60 - i*4)) & 0xF];
+        key[16+i] = digits[(b >> (60 - i*4)) & 0xF];
+    }
+    key[CacheKeyLength] = '\0';
+}
+
+
+// --- Options ---
+
+void InitCacheOptions( CacheOptions * options )
+{
+    options->directory = getenv("KONSTRUKT_CACHE_DIR");
+    if(options->directory && options->directory[0] == '\0')
+        options->directory = NULL;
+
+    const char * size = getenv("KONSTRUKT_CACHE_SIZE");
+    const long megabytes = size ? atol(size) : 0;
+    options->maxSize = ((megabytes > 0) ? (size_t)megabytes : DefaultCacheSize)
+                       *1024*1024;
+}
+
+int ParseCacheOption( int argc, char * * argv, int * i, CacheOptions * options )
+{
+    if(strcmp(argv[*i], "-C") != 0)
+        return 0;
+
+    if(*i+1 >= argc)
+    {
+        printf("Option needs a value.\n");
+        return -1;
+    }
+    (*i)++;
+    options->directory = argv[*i];
+    return 1;
+}
+
+void PrintCacheHelp()
+{
+    printf("\t-C <directory> (cache for generated files, defaults to $KONSTRUKT_CACHE_DIR)\n");
+}
+
+
+// --- Entries ---
+
+static char * GetEntryPath( const char * directory, const char * name )
+{
+    const size_t directoryLength = strlen(directory);
+    const size_t nameLength = strlen(name);
+    char * path = (char *)malloc(directoryLength + 1 + nameLength + 1);
+    memcpy(path, directory, directoryLength);
+    path[directoryLength] = '/';
+    memcpy(&path[directoryLength+1], name, nameLength+1);
+    return path;
+}
+
+static bool CopyFileContent( FILE * source, FILE * destination )
+{
+    unsigned char buffer[64*1024];
+    size_t size;
+    while((size = fread(buffer, 1, sizeof(buffer), source)) > 0)
+        if(fwrite(buffer, 1, size, destination) != size)
+            return false;
+    return !ferror(source);
+}
+
+/**
+ * Appends the mkstemp pattern to a file name, so the temporary file lies in
+ * the same directory and can be renamed to it.
+ */
+static char * GetTemporaryPath( const char * fileName )
+{
+    static const char Suffix[] = ".tmp-XXXXXX";
+    const size_t length = strlen(fileName);
+    char * path = (char *)malloc(length + sizeof(Suffix));
+    memcpy(path, fileName, length);
+    memcpy(&path[length], Suffix, sizeof(Suffix));
+    return path;
+}
+
+/**
+ * Files are written under a temporary name and renamed afterwards, so
+ * concurrent runs never see partial files and an interrupted copy doesn't
+ * leave a truncated file that looks up to date.
+ *
+ * @param temporaryPath
+ * Pattern for mkstemp, which replaces its trailing `XXXXXX`.
+ */
+static bool CopyFileAtomically( FILE * source, char * temporaryPath, const char * path )
+{
+    const int descriptor = mkstemp(temporaryPath);
+    if(descriptor < 0)
+        return false;
+    fchmod(descriptor, 0644); // mkstemp only grants access to the owner
+
+    bool success = false;
+    FILE * destination = fdopen(descriptor, "wb");
+    if(destination)
+    {
+        success = CopyFileContent(source, destination);
+        success = (fclose(destination) == 0) && success;
+    }
+    else
+    {
+        close(descriptor);
+    }
+
+    success = success && (rename(temporaryPath, path) == 0);
+    if(!success)
+        unlink(temporaryPath);
+    return success;
+}
+
+bool RestoreCachedFile( const CacheOptions * options,
+                        const char * key,
+                        const char * fileName )
+{
+    if(!options->directory)
+        return false;
+
+    char * path = GetEntryPath(options->directory, key);
+    FILE * source = fopen(path, "rb");
+    if(!source)
+    {
+        AddStatsCount("cache misses", 1);
+        free(path);
+        return false;
+    }
+    AddStatsCount("cache hits", 1);
+
+    char * temporaryPath = GetTemporaryPath(fileName);
+    const bool success = CopyFileAtomically(source, temporaryPath, fileName);
+    free(temporaryPath);
+    fclose(source);
+
+    if(success)
+        utime(path, NULL); // Marks the entry as recently used
+    else
+        fprintf(stderr, "Could not restore '%s' from the cache.\n", fileName);
+
+    free(path);
+    return success;
+}
+
+void StoreCachedFile( const CacheOptions * options,
+                      const char * key,
+                      const char * fileName )
+{
+    if(!options->directory)
+        return;
+
+    if(mkdir(options->directory, 0777) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Could not create cache directory '%s'.\n",
+                options->directory);
+        return;
+    }
+
+    FILE * source = fopen(fileName, "rb");
+    if(!source)
+    {
+        fprintf(stderr, "Could not open '%s' for reading.\n", fileName);
+        return;
+    }
+
+    char * temporaryPath = GetEntryPath(options->directory, ".tmp-XXXXXX");
+    char * path = GetEntryPath(options->directory, key);
+    if(!CopyFileAtomically(source, temporaryPath, path))
+        fprintf(stderr, "Could not store '%s' in the cache.\n", fileName);
+    free(path);
+    free(temporaryPath);
+    fclose(source);
+}
+
+typedef struct
+{
+    char * path;
+    size_t size;
+    time_t lastUse;
+} CacheEntry;
+
+static int CompareEntryUse( const void * a, const void * b )
+{
+    const CacheEntry * entryA = (const CacheEntry *)a;
+    const CacheEntry * entryB = (const CacheEntry *)b;
+    if(entryA->lastUse < entryB->lastUse)
+        return -1;
+    if(entryA->lastUse > entryB->lastUse)
+        return 1;
+    return 0;
+}
+
+void TrimCache( const CacheOptions * options )
+{
+    if(!options->directory)
+        return;
+
+    DIR * directory = opendir(options->directory);
+    if(!directory)
+        return;
+
+    CacheEntry * entries = NULL;
+    int entryCount = 0;
+    size_t totalSize = 0;
+
+    const struct dirent * dirEntry;
+    while((dirEntry = readdir(directory)) != NULL)
+    {
+        // Skips '.', '..' and temporary files:
+        if(dirEntry->d_name[0] == '.')
+            continue;
+
+        char * path = GetEntryPath(options->directory, dirEntry->d_name);
+        struct stat status;
+        if(stat(path, &status) != 0 || !S_ISREG(status.st_mode))
+        {
+            free(path);
+            continue;
+        }
+
+        entries = (CacheEntry *)realloc(entries, sizeof(CacheEntry)*(entryCount+1));
+        entries[entryCount].path = path;
+        entries[entryCount].size = (size_t)status.st_size;
+        entries[entryCount].lastUse = status.st_mtime;
+        entryCount++;
+        totalSize += (size_t)status.st_size;
+    }
+    closedir(directory);
+
+    if(totalSize > options->maxSize)
+    {
+        qsort(entries, entryCount, sizeof(CacheEntry), CompareEntryUse);
+        for(int i = 0; i < entryCount && totalSize > options->maxSize; i++)
+            if(unlink(entries[i].path) == 0)
+                totalSize -= entries[i].size;
+    }
+
+    for(int i = 0; i < entryCount; i++)
+        free(entries[i].path);
+    free(entries);
+}
+
+bool FileExists( const char * fileName )
+{
+    struct stat status;
+    return stat(fileName, &status) == 0;
+}
+
+bool DuplicateFile( const char * fileName, const char * copyFileName )
+{
+    FILE * source = fopen(fileName, "rb");
+    if(!source)
+    {
+        fprintf(stderr, "Could not open '%s' for reading.\n", fileName);
+        return false;
+    }
+
+    char * temporaryPath = GetTemporaryPath(copyFileName);
+    const bool success = CopyFileAtomically(source, temporaryPath, copyFileName);
+    free(temporaryPath);
+    fclose(source);
+
+    if(!success)
+        fprintf(stderr, "Could not copy '%s' to '%s'.\n", fileName, copyFileName);
+    return success;
+}
+
+static char * GetOptionsFileName( const char * previousInputFileName )
+{
+    static const char Suffix[] = ".options";
+    const size_t length = strlen(previousInputFileName);
+    char * fileName = (char *)malloc(length + sizeof(Suffix));
+    memcpy(fileName, previousInputFileName, length);
+    memcpy(&fileName[length], Suffix, sizeof(Suffix));
+    return fileName;
+}
+
+bool WritePreviousOptions( const char * previousInputFileName, const char * key )
+{
+    char * fileName = GetOptionsFileName(previousInputFileName);
+    bool success = false;
+    FILE * file = fopen(fileName, "wb");
+    if(file)
+    {
+        success = fwrite(key, 1, CacheKeyLength, file) == CacheKeyLength;
+        success = (fclose(file) == 0) && success;
+    }
+    if(!success)
+        fprintf(stderr, "Could not write '%s'.\n", fileName);
+    free(fileName);
+    return success;
+}
+
+bool MatchPreviousOptions( const char * previousInputFileName, const char * key )
+{
+    char * fileName = GetOptionsFileName(previousInputFileName);
+    FILE * file = fopen(fileName, "rb");
+    free(fileName);
+    if(!file)
+        return false;
+
+    char storedKey[CacheKeyLength+1];
+    const size_t size = fread(storedKey, 1, sizeof(storedKey), file);
+    fclose(file);
+    return size == CacheKeyLength && memcmp(storedKey, key, CacheKeyLength) == 0;
+}
@@ -0,0 +1,136 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdbool.h>
+#include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Generated files are stored in a directory, named after a hash of
+ * everything which affects their content: the input bytes, the tool and
+ * its version and the options.  A later run with the same key copies the
+ * stored file instead of regenerating it.
+ *
+ * Entries are evicted by their modification time, which is updated on
+ * every hit, so the least recently used ones go first.
+ */
+
+enum
+{
+    CacheKeyLength = 32 // Hexadecimal digits
+};
+
+typedef struct
+{
+    uint64_t lanes[2];
+    uint64_t length;
+    unsigned char tail[8];
+    int tailSize;
+} CacheHasher;
+
+void InitCacheHasher( CacheHasher * hasher );
+void HashBytes( CacheHasher * hasher, const void * data, size_t size );
+
+/**
+ * Hashes the string including its terminator, so consecutive strings
+ * can't be confused.
+ */
+void HashString( CacheHasher * hasher, const char * string );
+void HashInt( CacheHasher * hasher, int value );
+void HashFloat( CacheHasher * hasher, float value );
+
+/**
+ * Hashes the extension of a file name, which selects the output format.
+ */
+void HashFileExtension( CacheHasher * hasher, const char * fileName );
+
+/**
+ * Hashes the file content.
+ */
+bool HashFile( CacheHasher * hasher, const char * fileName );
+
+/**
+ * @param key
+ * Receives #CacheKeyLength digits and a terminator.
+ */
+void FinishCacheKey( CacheHasher * hasher, char * key );
+
+
+typedef struct
+{
+    /**
+     * `NULL` disables the cache.  Defaults to `KONSTRUKT_CACHE_DIR`.
+     */
+    const char * directory;
+
+    /**
+     * Defaults to `KONSTRUKT_CACHE_SIZE` megabytes or 1 GB.
+     */
+    size_t maxSize;
+} CacheOptions;
+
+void InitCacheOptions( CacheOptions * options );
+
+/**
+ * Parses the cache option at `argv[*i]`, if it is one.
+ *
+ * @return
+ * 1 if the option was consumed (`*i` then points to its last argument),
+ * 0 if it isn't a cache option and -1 if it is malformed.
+ */
+int ParseCacheOption( int argc, char * * argv, int * i, CacheOptions * options );
+
+void PrintCacheHelp();
+
+/**
+ * Copies a cached file to `fileName`.
+ *
+ * @return
+ * `false` if there is no entry for the key.
+ */
+bool RestoreCachedFile( const CacheOptions * options,
+                        const char * key,
+                        const char * fileName );
+
+/**
+ * Copies `fileName` into the cache.  Failures are reported, but don't
+ * affect the caller, since the file exists anyway.
+ */
+void StoreCachedFile( const CacheOptions * options,
+                      const char * key,
+                      const char * fileName );
+
+/**
+ * Removes the least recently used entries until the cache fits its size.
+ */
+void TrimCache( const CacheOptions * options );
+
+bool FileExists( const char * fileName );
+
+/**
+ * Copies the content of `fileName` to `copyFileName`.
+ */
+bool DuplicateFile( const char * fileName, const char * copyFileName );
+
+/**
+ * Records the key of the options which the copy of a previous input was
+ * processed with, in `<previousInputFileName>.options`.  Incremental
+ * updates are only valid with the same options.
+ */
+bool WritePreviousOptions( const char * previousInputFileName, const char * key );
+
+/**
+ * @return
+ * `false` if no key was recorded or it differs.
+ */
+bool MatchPreviousOptions( const char * previousInputFileName, const char * key );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
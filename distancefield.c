@@ -0,0 +1,156 @@
+#include <math.h> // ceilf
+#include <string.h> // memcpy
+#include "distancefield.h"
+#include "stats.h"
+#include "third-party/edtaa3/edtaa3.h"
+
+
+size_t GetDistanceFieldScratchSize( int width, int height )
+{
+    const size_t pixels = (size_t)width * height;
+    // Inverted mask, outside and inside distances:
+    return pixels*3*sizeof(float) + edtaa3_scratch_size(width, height);
+}
+
+void GenerateDistanceField( int width,
+                            int height,
+                            const float * mask,
+                            float * distanceField,
+                            float maxDistance,
+                            void * scratch )
+{
+    const int pixels = width * height;
+
+    StatsScope scope;
+    BeginStatsScope(&scope, "distance field", NULL);
+
+    float * inverted = (float *)scratch;
+    float * outside  = inverted + pixels;
+    float * inside   = outside + pixels;
+    void * edtaa3Scratch = inside + pixels;
+
+    int sweeps = edtaa3_scratch(width, height, mask, outside, edtaa3Scratch);
+
+    for(int i = 0; i < pixels; i++)
+        inverted[i] = 1.0f - mask[i];
+
+    sweeps += edtaa3_scratch(width, height, inverted, inside, edtaa3Scratch);
+    AddStatsCount("edtaa3 sweeps", sweeps);
+
+    // Merge inside and outside:
+    for(int i = 0; i < pixels; i++)
+    {
+        float d = -(outside[i] - inside[i]);
+
+        d = (d / maxDistance) * 0.5f + 0.5;
+
+        // Clamp to 0-1:
+        if(d > 1.0f)
+            d = 1.0f;
+        else if(d < 0.0f)
+            d = 0.0f;
+
+        distanceField[i] = d;
+    }
+
+    EndStatsScope(&scope);
+}
+
+int GetDistanceFieldRegionMargin( float maxDistance )
+{
+    // The gradient estimation of edtaa3 looks at direct neighbours, hence
+    // the extra pixels:
+    return (int)ceilf(maxDistance) + 2;
+}
+
+static void GetRegionWindow( int width,
+                             int height,
+                             int regionX,
+                             int regionY,
+                             int regionWidth,
+                             int regionHeight,
+                             float maxDistance,
+                             int * x,
+                             int * y,
+                             int * windowWidth,
+                             int * windowHeight )
+{
+    const int margin = GetDistanceFieldRegionMargin(maxDistance);
+    int left   = regionX - margin;
+    int top    = regionY - margin;
+    int right  = regionX + regionWidth  + margin;
+    int bottom = regionY + regionHeight + margin;
+    if(left < 0)
+        left = 0;
+    if(top < 0)
+        top = 0;
+    if(right > width)
+        right = width;
+    if(bottom > height)
+        bottom = height;
+
+    *x = left;
+    *y = top;
+    *windowWidth  = right - left;
+    *windowHeight = bottom - top;
+}
+
+size_t GetDistanceFieldRegionScratchSize( int width,
+                                          int height,
+                                          int regionWidth,
+                                          int regionHeight,
+                                          float maxDistance )
+{
+    // The window is largest if the region doesn't touch the image edges:
+    const int margin = GetDistanceFieldRegionMargin(maxDistance);
+    int windowWidth  = regionWidth  + margin*2;
+    int windowHeight = regionHeight + margin*2;
+    if(windowWidth > width)
+        windowWidth = width;
+    if(windowHeight > height)
+        windowHeight = height;
+
+    const size_t pixels = (size_t)windowWidth * windowHeight;
+    // Window mask and distances:
+    return pixels*2*sizeof(float) +
+           GetDistanceFieldScratchSize(windowWidth, windowHeight);
+}
+
+void GenerateDistanceFieldRegion( int width,
+                                  int height,
+                                  const float * mask,
+                                  float * distanceField,
+                                  float maxDistance,
+                                  int regionX,
+                                  int regionY,
+                                  int regionWidth,
+                                  int regionHeight,
+                                  void * scratch )
+{
+    int windowX, windowY, windowWidth, windowHeight;
+    GetRegionWindow(width, height,
+                    regionX, regionY, regionWidth, regionHeight,
+                    maxDistance,
+                    &windowX, &windowY, &windowWidth, &windowHeight);
+
+    const int windowPixels = windowWidth * windowHeight;
+    float * windowMask = (float *)scratch;
+    float * windowDistances = windowMask + windowPixels;
+
+    for(int y = 0; y < windowHeight; y++)
+        memcpy(&windowMask[y*windowWidth],
+               &mask[(windowY+y)*width + windowX],
+               sizeof(float)*windowWidth);
+
+    GenerateDistanceField(windowWidth,
+                          windowHeight,
+                          windowMask,
+                          windowDistances,
+                          maxDistance,
+                          windowDistances + windowPixels);
+
+    for(int y = 0; y < regionHeight; y++)
+        memcpy(&distanceField[(regionY+y)*width + regionX],
+               &windowDistances[(regionY-windowY+y)*windowWidth + (regionX-windowX)],
+               sizeof(float)*regionWidth);
+}
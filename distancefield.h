@@ -0,0 +1,74 @@
+#ifndef __DISTANCEFIELD_H__
+#define __DISTANCEFIELD_H__
+
+#include <stddef.h> // size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Size of the scratch memory which #GenerateDistanceField needs.
+ */
+size_t GetDistanceFieldScratchSize( int width, int height );
+
+/**
+ * Calculate a signed distance field from a mask.
+ *
+ * @param mask
+ * Is expected being an array with width*height elements.  Values above 0.5
+ * are inside.  It is not modified.
+ *
+ * @param distanceField
+ * Is expected being an array with width*height elements.  Receives the
+ * distance mapped from [-maxDistance, maxDistance] to [0, 1], where 0.5 lies
+ * on the edge.
+ *
+ * @param scratch
+ * Must be aligned for float access and at least
+ * #GetDistanceFieldScratchSize bytes large.
+ */
+void GenerateDistanceField( int width,
+                            int height,
+                            const float * mask,
+                            float * distanceField,
+                            float maxDistance,
+                            void * scratch );
+
+/**
+ * Pixels around a region which are needed to compute it.
+ */
+int GetDistanceFieldRegionMargin( float maxDistance );
+
+/**
+ * Size of the scratch memory which #GenerateDistanceFieldRegion needs.
+ */
+size_t GetDistanceFieldRegionScratchSize( int width,
+                                          int height,
+                                          int regionWidth,
+                                          int regionHeight,
+                                          float maxDistance );
+
+/**
+ * Like #GenerateDistanceField, but only writes the distances of a region.
+ *
+ * Only the mask around the region is processed.  Edges further than
+ * `maxDistance` can't affect the clamped result, so the region gets the
+ * same values as a complete run.
+ */
+void GenerateDistanceFieldRegion( int width,
+                                  int height,
+                                  const float * mask,
+                                  float * distanceField,
+                                  float maxDistance,
+                                  int regionX,
+                                  int regionY,
+                                  int regionWidth,
+                                  int regionHeight,
+                                  void * scratch );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,800 @@
+#include <stdint.h> // uint32_t, uint64_t
+#include <stdio.h> // printf, fprintf, snprintf, fopen, fwrite
+#include <string.h> // strcmp, strstr, strlen, memcpy, memset
+#include <stdlib.h> // atof, atoi, malloc, realloc, free, qsort
+#include "image.h"
+#include "threadpool.h"
+#include "stats.h"
+#include "atlasfile.h"
+
+static const int DefaultPageSize = 2048;
+static const int DefaultPadding = 2;
+
+typedef enum
+{
+    DilatePadding, // Repeats the edge pixels
+    DistanceFieldPadding // Continues the fields as if the shapes ended at the edge
+} PaddingMode;
+
+typedef struct
+{
+    int maxPageSize;
+    int padding;
+    PaddingMode paddingMode;
+    float maxDistance; // Of the distance fields
+    int threads;
+    const char * pageFileName; // May contain %d for the page number
+    const char * tableFileName;
+    char * * inputFileNames;
+    int inputCount;
+} Options;
+
+typedef struct
+{
+    const char * fileName;
+    int width;
+    int height;
+    int channels;
+
+    // Position of the image, without padding:
+    int page;
+    int x;
+    int y;
+} Entry;
+
+typedef struct
+{
+    char * fileName;
+    Image * image;
+} Page;
+
+static void PrintHelp( const char * programName )
+{
+    printf("%s [options] <page output> <table output> <input>...\n", programName);
+
+    printf("\t-s <size> (largest page size, a power of two, defaults to %d)\n",
+           DefaultPageSize);
+    printf("\t-p <padding> (pixels around each entry, defaults to %d)\n",
+           DefaultPadding);
+    printf("\t-d <max distance> (inputs are distance fields made with this distance,\n"
+           "\t    their padding continues the field instead of repeating the edge)\n");
+    printf("\t-j <threads> (defaults to one per processor)\n");
+    printf("\tThe page output may contain %%d, which is replaced by the page number.\n");
+    PrintStatsHelp();
+}
+
+static bool IsPowerOfTwo( int value )
+{
+    return value > 0 && (value & (value-1)) == 0;
+}
+
+static int NextPowerOfTwo( int value )
+{
+    int result = 1;
+    while(result < value)
+        result *= 2;
+    return result;
+}
+
+static bool ParseArguments( int argc,
+                            char * * argv,
+                            Options * options,
+                            StatsOptions * statsOptions )
+{
+    int fileCount = 0;
+    for(int i = 1; i < argc; i++)
+    {
+        if(argv[i][0] == '-')
+        {
+            const int statsOption = ParseStatsOption(argc, argv, &i, statsOptions);
+            if(statsOption < 0)
+                return false;
+            else if(statsOption > 0)
+                continue;
+
+            if(strcmp(argv[i], "-s") == 0 ||
+               strcmp(argv[i], "-p") == 0 ||
+               strcmp(argv[i], "-d") == 0 ||
+               strcmp(argv[i], "-j") == 0)
+            {
+                if(i+1 >= argc)
+                {
+                    printf("Option needs a value.\n");
+                    return false;
+                }
+                const char option = argv[i][1];
+                i++;
+                if(option == 's')
+                    options->maxPageSize = atoi(argv[i]);
+                else if(option == 'p')
+                    options->padding = atoi(argv[i]);
+                else if(option == 'd')
+                {
+                    options->paddingMode = DistanceFieldPadding;
+                    options->maxDistance = atof(argv[i]);
+                }
+                else
+                    options->threads = atoi(argv[i]);
+            }
+            else
+            {
+                printf("Unknown option %s\n", argv[i]);
+                return false;
+            }
+        }
+        else
+        {
+            if(fileCount == 0)
+                options->pageFileName = argv[i];
+            else if(fileCount == 1)
+                options->tableFileName = argv[i];
+            else
+                options->inputFileNames[options->inputCount++] = argv[i];
+            fileCount++;
+        }
+    }
+
+    if(options->inputCount == 0)
+    {
+        printf("File parameter(s) are missing.\n");
+        return false;
+    }
+
+    if(!IsPowerOfTwo(options->maxPageSize))
+    {
+        printf("Page size must be a power of two.\n");
+        return false;
+    }
+
+    if(options->padding < 0 || options->maxDistance <= 0)
+    {
+        printf("Padding and distance must be positive.\n");
+        return false;
+    }
+
+    return true;
+}
+
+
+// --- Packing ---
+
+typedef struct
+{
+    int x;
+    int y; // Top of the occupied area below
+    int width;
+} SkylineNode;
+
+/**
+ * Tracks the upper outline of the packed rectangles.  New rectangles are
+ * put where their top ends up lowest, which leaves little unusable space
+ * below them and is fast enough for thousands of entries.
+ */
+typedef struct
+{
+    int size;
+    SkylineNode * nodes;
+    int nodeCount;
+} Skyline;
+
+static void InitSkyline( Skyline * skyline, int size, int capacity )
+{
+    skyline->size = size;
+    skyline->nodes = (SkylineNode *)malloc(sizeof(SkylineNode)*capacity);
+    skyline->nodes[0].x = 0;
+    skyline->nodes[0].y = 0;
+    skyline->nodes[0].width = size;
+    skyline->nodeCount = 1;
+}
+
+static void FreeSkyline( Skyline * skyline )
+{
+    free(skyline->nodes);
+}
+
+/**
+ * @return
+ * Y coordinate for a rectangle whose left edge is at node `index`, or -1
+ * if it doesn't fit there.
+ */
+static int FitSkyline( const Skyline * skyline, int index, int width, int height )
+{
+    const SkylineNode * nodes = skyline->nodes;
+    if(nodes[index].x + width > skyline->size)
+        return -1;
+
+    int y = 0;
+    int remaining = width;
+    for(int i = index; remaining > 0; i++)
+    {
+        if(nodes[i].y > y)
+            y = nodes[i].y;
+        if(y + height > skyline->size)
+            return -1;
+        remaining -= nodes[i].width;
+    }
+    return y;
+}
+
+static void AddSkylineRect( Skyline * skyline, int index, int x, int y, int width, int height )
+{
+    SkylineNode * nodes = skyline->nodes;
+    memmove(&nodes[index+1], &nodes[index], sizeof(SkylineNode)*(skyline->nodeCount - index));
+    skyline->nodeCount++;
+    nodes[index].x = x;
+    nodes[index].y = y + height;
+    nodes[index].width = width;
+
+    // Cut the nodes which are now below the rectangle:
+    const int right = x + width;
+    while(index+1 < skyline->nodeCount && nodes[index+1].x < right)
+    {
+        SkylineNode * node = &nodes[index+1];
+        const int end = node->x + node->width;
+        if(end <= right)
+        {
+            memmove(node, node+1, sizeof(SkylineNode)*(skyline->nodeCount - index - 2));
+            skyline->nodeCount--;
+        }
+        else
+        {
+            node->width = end - right;
+            node->x = right;
+        }
+    }
+
+    // Merge neighbours of equal height:
+    for(int i = 0; i+1 < skyline->nodeCount;)
+    {
+        if(nodes[i].y == nodes[i+1].y)
+        {
+            nodes[i].width += nodes[i+1].width;
+            memmove(&nodes[i+1], &nodes[i+2], sizeof(SkylineNode)*(skyline->nodeCount - i - 2));
+            skyline->nodeCount--;
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+static bool InsertSkylineRect( Skyline * skyline, int width, int height, int * x, int * y )
+{
+    int bestIndex = -1;
+    int bestTop = 0;
+    int bestX = 0;
+    for(int i = 0; i < skyline->nodeCount; i++)
+    {
+        const int top = FitSkyline(skyline, i, width, height);
+        if(top < 0)
+            continue;
+        if(bestIndex < 0 || top + height < bestTop)
+        {
+            bestIndex = i;
+            bestTop = top + height;
+            bestX = skyline->nodes[i].x;
+        }
+    }
+    if(bestIndex < 0)
+        return false;
+
+    *x = bestX;
+    *y = bestTop - height;
+    AddSkylineRect(skyline, bestIndex, *x, *y, width, height);
+    return true;
+}
+
+static int CompareEntrySizes( const void * a, const void * b )
+{
+    const Entry * entryA = *(const Entry * const *)a;
+    const Entry * entryB = *(const Entry * const *)b;
+    if(entryA->height != entryB->height)
+        return entryB->height - entryA->height;
+    if(entryA->width != entryB->width)
+        return entryB->width - entryA->width;
+    return strcmp(entryA->fileName, entryB->fileName);
+}
+
+/**
+ * Fills one page after the other with the largest entries first.  Pages are
+ * then shrunk to the power of two which covers their entries.
+ *
+ * @return
+ * Page count or -1 if an entry is larger than a page.
+ */
+static int PackEntries( Entry * entries,
+                        int entryCount,
+                        const Options * options,
+                        int * pageWidths,
+                        int * pageHeights )
+{
+    const int padding = options->padding;
+    const int size = options->maxPageSize;
+    for(int i = 0; i < entryCount; i++)
+    {
+        if(entries[i].width  + 2*padding > size ||
+           entries[i].height + 2*padding > size)
+        {
+            fprintf(stderr, "'%s' doesn't fit into a %dx%d page.\n",
+                    entries[i].fileName, size, size);
+            return -1;
+        }
+    }
+
+    Entry * * sorted = (Entry * *)malloc(sizeof(Entry *)*entryCount);
+    for(int i = 0; i < entryCount; i++)
+        sorted[i] = &entries[i];
+    qsort(sorted, entryCount, sizeof(Entry *), CompareEntrySizes);
+
+    int pageCount = 0;
+    int remaining = entryCount;
+    while(remaining > 0)
+    {
+        Skyline skyline;
+        InitSkyline(&skyline, size, remaining+2);
+        int usedWidth = 0;
+        int usedHeight = 0;
+        int unplaced = 0;
+        for(int i = 0; i < remaining; i++)
+        {
+            Entry * entry = sorted[i];
+            const int width  = entry->width  + 2*padding;
+            const int height = entry->height + 2*padding;
+            int x, y;
+            if(!InsertSkylineRect(&skyline, width, height, &x, &y))
+            {
+                sorted[unplaced++] = entry;
+                continue;
+            }
+            entry->page = pageCount;
+            entry->x = x + padding;
+            entry->y = y + padding;
+            if(x + width > usedWidth)
+                usedWidth = x + width;
+            if(y + height > usedHeight)
+                usedHeight = y + height;
+        }
+        FreeSkyline(&skyline);
+
+        pageWidths[pageCount] = NextPowerOfTwo(usedWidth);
+        pageHeights[pageCount] = NextPowerOfTwo(usedHeight);
+        pageCount++;
+        remaining = unplaced;
+    }
+
+    free(sorted);
+    return pageCount;
+}
+
+
+// --- Compositing ---
+
+/**
+ * Channels of a page which can hold all its entries: gray or RGB, with
+ * alpha if any entry has it.
+ */
+static int GetPageChannels( const Entry * entries, int entryCount, int page )
+{
+    bool color = false;
+    bool alpha = false;
+    for(int i = 0; i < entryCount; i++)
+    {
+        if(entries[i].page != page)
+            continue;
+        if(entries[i].channels >= 3)
+            color = true;
+        if(entries[i].channels == 2 || entries[i].channels == 4)
+            alpha = true;
+    }
+    return (color ? 3 : 1) + (alpha ? 1 : 0);
+}
+
+static void ConvertPixel( const float * in, int inChannels, float * out, int outChannels )
+{
+    const bool inAlpha = inChannels == 2 || inChannels == 4;
+    const bool outAlpha = outChannels == 2 || outChannels == 4;
+    const int outColors = outAlpha ? outChannels-1 : outChannels;
+    const int inColors = inAlpha ? inChannels-1 : inChannels;
+    for(int c = 0; c < outColors; c++)
+        out[c] = in[inColors == 1 ? 0 : c];
+    if(outAlpha)
+        out[outColors] = inAlpha ? in[inColors] : 1;
+}
+
+static int Clamp( int value, int min, int max )
+{
+    if(value < min)
+        return min;
+    if(value > max)
+        return max;
+    return value;
+}
+
+typedef struct
+{
+    const Options * options;
+    const Entry * entry;
+    Image * page;
+    bool success;
+} CompositeTask;
+
+/**
+ * Copies an entry into its page and fills its padding.  Entries don't
+ * overlap, including their padding, so they can be composited concurrently.
+ */
+static void CompositeEntry( void * data, int workerIndex )
+{
+    CompositeTask * task = (CompositeTask *)data;
+    const Entry * entry = task->entry;
+    Image * page = task->page;
+    const int channels = page->channels;
+    const int padding = task->options->padding;
+    const float step = 0.5f / task->options->maxDistance;
+
+    Image * image = ReadImage(entry->fileName);
+    if(!image)
+        return;
+    if(image->width != entry->width || image->height != entry->height)
+    {
+        fprintf(stderr, "'%s' changed while packing.\n", entry->fileName);
+        FreeImage(image);
+        return;
+    }
+
+    StatsScope scope;
+    BeginStatsScope(&scope, "composite", entry->fileName);
+    for(int y = -padding; y < entry->height + padding; y++)
+    for(int x = -padding; x < entry->width + padding; x++)
+    {
+        const int sourceX = Clamp(x, 0, entry->width-1);
+        const int sourceY = Clamp(y, 0, entry->height-1);
+        const float * in =
+            &image->data[(sourceY*image->width + sourceX)*image->channels];
+        float * out = &page->data[((size_t)(entry->y + y)*page->width +
+                                   entry->x + x)*channels];
+        ConvertPixel(in, image->channels, out, channels);
+
+        const int dx = x < 0 ? -x : x - sourceX;
+        const int dy = y < 0 ? -y : y - sourceY;
+        const int distance = dx > dy ? dx : dy;
+        if(distance > 0 && task->options->paddingMode == DistanceFieldPadding)
+        {
+            // Filtering across the edge must not create a shape there, so
+            // the field falls off as if everything outside was empty:
+            for(int c = 0; c < channels; c++)
+            {
+                const float value = (out[c] < 0.5f ? out[c] : 0.5f) - distance*step;
+                out[c] = value > 0 ? value : 0;
+            }
+        }
+    }
+    EndStatsScope(&scope);
+
+    FreeImage(image);
+    task->success = true;
+}
+
+typedef struct
+{
+    const Page * page;
+    bool success;
+} WriteTask;
+
+static void WritePage( void * data, int workerIndex )
+{
+    WriteTask * task = (WriteTask *)data;
+    task->success = WriteImage(task->page->image, task->page->fileName);
+}
+
+static char * GetPageFileName( const char * pattern, int page )
+{
+    const char * placeholder = strstr(pattern, "%d");
+    const size_t length = strlen(pattern) + 16;
+    char * fileName = (char *)malloc(length);
+    if(placeholder)
+        snprintf(fileName, length, "%.*s%d%s",
+                 (int)(placeholder - pattern), pattern, page, placeholder+2);
+    else
+        snprintf(fileName, length, "%s", pattern);
+    return fileName;
+}
+
+
+// --- Lookup table ---
+
+static uint64_t Align( uint64_t offset )
+{
+    return (offset + AtlasFileAlignment-1) / AtlasFileAlignment * AtlasFileAlignment;
+}
+
+static void PutU32( unsigned char * out, uint32_t value )
+{
+    out[0] = (unsigned char)(value & 0xff);
+    out[1] = (unsigned char)((value >> 8) & 0xff);
+    out[2] = (unsigned char)((value >> 16) & 0xff);
+    out[3] = (unsigned char)((value >> 24) & 0xff);
+}
+
+static void PutF32( unsigned char * out, float value )
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutU32(out, bits);
+}
+
+static void WritePadding( FILE * file, uint64_t * position, uint64_t target )
+{
+    static const unsigned char Zeros[AtlasFileAlignment] = {0};
+    fwrite(Zeros, 1, (size_t)(target - *position), file);
+    *position = target;
+}
+
+static int CompareEntryNames( const void * a, const void * b )
+{
+    return strcmp((*(const Entry * const *)a)->fileName,
+                  (*(const Entry * const *)b)->fileName);
+}
+
+static bool WriteTable( const char * fileName,
+                        const Entry * entries,
+                        int entryCount,
+                        const Page * pages,
+                        int pageCount,
+                        int padding )
+{
+    const Entry * * sorted = (const Entry * *)malloc(sizeof(Entry *)*entryCount);
+    for(int i = 0; i < entryCount; i++)
+        sorted[i] = &entries[i];
+    qsort(sorted, entryCount, sizeof(Entry *), CompareEntryNames);
+
+    for(int i = 1; i < entryCount; i++)
+    {
+        if(strcmp(sorted[i-1]->fileName, sorted[i]->fileName) == 0)
+        {
+            fprintf(stderr, "'%s' is given twice.\n", sorted[i]->fileName);
+            free(sorted);
+            return false;
+        }
+    }
+
+    uint64_t stringSize = 0;
+    for(int i = 0; i < pageCount; i++)
+        stringSize += strlen(pages[i].fileName)+1;
+    for(int i = 0; i < entryCount; i++)
+        stringSize += strlen(entries[i].fileName)+1;
+
+    const uint64_t pageOffset = Align(sizeof(AtlasFileHeader));
+    const uint64_t entryOffset = Align(pageOffset +
+                                       sizeof(AtlasFilePage)*(uint64_t)pageCount);
+    const uint64_t stringOffset = Align(entryOffset +
+                                        sizeof(AtlasFileEntry)*(uint64_t)entryCount);
+    const uint64_t fileSize = stringOffset + stringSize;
+
+    FILE * file = fopen(fileName, "wb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for writing.\n", fileName);
+        free(sorted);
+        return false;
+    }
+
+    unsigned char buffer[sizeof(AtlasFileEntry)];
+    uint64_t position = 0;
+    uint32_t string = 0;
+
+    // Header:
+    {
+        unsigned char out[sizeof(AtlasFileHeader)];
+        const uint32_t fields[] =
+        {
+            AtlasFileVersion,
+            (uint32_t)fileSize,
+            (uint32_t)padding,
+            (uint32_t)pageCount,
+            (uint32_t)pageOffset,
+            (uint32_t)entryCount,
+            (uint32_t)entryOffset,
+            (uint32_t)stringSize,
+            (uint32_t)stringOffset
+        };
+        memcpy(out, ATLAS_FILE_MAGIC, 4);
+        for(size_t i = 0; i < sizeof(fields)/sizeof(fields[0]); i++)
+            PutU32(&out[4 + i*4], fields[i]);
+        fwrite(out, 1, sizeof(out), file);
+        position += sizeof(out);
+    }
+
+    // Pages:
+    WritePadding(file, &position, pageOffset);
+    for(int i = 0; i < pageCount; i++)
+    {
+        const Image * image = pages[i].image;
+        PutU32(&buffer[0], string);
+        PutU32(&buffer[4], (uint32_t)image->width);
+        PutU32(&buffer[8], (uint32_t)image->height);
+        PutU32(&buffer[12], (uint32_t)image->channels);
+        fwrite(buffer, 1, sizeof(AtlasFilePage), file);
+        position += sizeof(AtlasFilePage);
+        string += (uint32_t)strlen(pages[i].fileName)+1;
+    }
+
+    // Entries:
+    WritePadding(file, &position, entryOffset);
+    for(int i = 0; i < entryCount; i++)
+    {
+        const Entry * entry = sorted[i];
+        const Image * page = pages[entry->page].image;
+        PutU32(&buffer[0], string);
+        PutU32(&buffer[4], (uint32_t)entry->page);
+        PutU32(&buffer[8], (uint32_t)entry->x);
+        PutU32(&buffer[12], (uint32_t)entry->y);
+        PutU32(&buffer[16], (uint32_t)entry->width);
+        PutU32(&buffer[20], (uint32_t)entry->height);
+        PutF32(&buffer[24], (float)entry->x / page->width);
+        PutF32(&buffer[28], (float)entry->y / page->height);
+        PutF32(&buffer[32], (float)(entry->x + entry->width) / page->width);
+        PutF32(&buffer[36], (float)(entry->y + entry->height) / page->height);
+        fwrite(buffer, 1, sizeof(AtlasFileEntry), file);
+        position += sizeof(AtlasFileEntry);
+        string += (uint32_t)strlen(entry->fileName)+1;
+    }
+
+    // Strings, in the order they were referenced:
+    WritePadding(file, &position, stringOffset);
+    for(int i = 0; i < pageCount; i++)
+        fwrite(pages[i].fileName, 1, strlen(pages[i].fileName)+1, file);
+    for(int i = 0; i < entryCount; i++)
+        fwrite(sorted[i]->fileName, 1, strlen(sorted[i]->fileName)+1, file);
+    free(sorted);
+
+    if(ferror(file) | fclose(file))
+    {
+        fprintf(stderr, "Could not write '%s'.\n", fileName);
+        return false;
+    }
+    return true;
+}
+
+
+static bool GenAtlas( const Options * options )
+{
+    const int entryCount = options->inputCount;
+    Entry * entries = (Entry *)malloc(sizeof(Entry)*entryCount);
+    memset(entries, 0, sizeof(Entry)*entryCount);
+    for(int i = 0; i < entryCount; i++)
+    {
+        Entry * entry = &entries[i];
+        entry->fileName = options->inputFileNames[i];
+        ImageInfo info;
+        if(!ReadImageInfo(entry->fileName, &info))
+        {
+            free(entries);
+            return false;
+        }
+        entry->width = info.width;
+        entry->height = info.height;
+        entry->channels = info.channels;
+    }
+
+    // At most one page per entry:
+    int * pageWidths = (int *)malloc(sizeof(int)*entryCount);
+    int * pageHeights = (int *)malloc(sizeof(int)*entryCount);
+    StatsScope scope;
+    BeginStatsScope(&scope, "pack", NULL);
+    const int pageCount = PackEntries(entries, entryCount, options, pageWidths, pageHeights);
+    EndStatsScope(&scope);
+    if(pageCount < 0)
+    {
+        free(pageWidths);
+        free(pageHeights);
+        free(entries);
+        return false;
+    }
+
+    if(pageCount > 1 && !strstr(options->pageFileName, "%d"))
+    {
+        fprintf(stderr, "Entries need %d pages, but '%s' has no %%d for the page number.\n",
+                pageCount, options->pageFileName);
+        free(pageWidths);
+        free(pageHeights);
+        free(entries);
+        return false;
+    }
+
+    Page * pages = (Page *)malloc(sizeof(Page)*pageCount);
+    for(int i = 0; i < pageCount; i++)
+    {
+        pages[i].fileName = GetPageFileName(options->pageFileName, i);
+        pages[i].image = CreateImage(pageWidths[i],
+                                     pageHeights[i],
+                                     GetPageChannels(entries, entryCount, i));
+        memset(pages[i].image->data, 0, sizeof(float)*pageWidths[i]*pageHeights[i]*
+                                        pages[i].image->channels);
+    }
+    free(pageWidths);
+    free(pageHeights);
+
+    ThreadPool * pool = CreateThreadPool(options->threads);
+    bool success = true;
+
+    CompositeTask * compositeTasks = (CompositeTask *)malloc(sizeof(CompositeTask)*entryCount);
+    for(int i = 0; i < entryCount; i++)
+    {
+        CompositeTask * task = &compositeTasks[i];
+        task->options = options;
+        task->entry = &entries[i];
+        task->page = pages[entries[i].page].image;
+        task->success = false;
+        SubmitTask(pool, CompositeEntry, task);
+    }
+    WaitForTasks(pool);
+    for(int i = 0; i < entryCount; i++)
+        success = success && compositeTasks[i].success;
+    free(compositeTasks);
+
+    if(success)
+    {
+        WriteTask * writeTasks = (WriteTask *)malloc(sizeof(WriteTask)*pageCount);
+        for(int i = 0; i < pageCount; i++)
+        {
+            writeTasks[i].page = &pages[i];
+            writeTasks[i].success = false;
+            SubmitTask(pool, WritePage, &writeTasks[i]);
+        }
+        WaitForTasks(pool);
+        for(int i = 0; i < pageCount; i++)
+            success = success && writeTasks[i].success;
+        free(writeTasks);
+    }
+    FreeThreadPool(pool);
+
+    success = success && WriteTable(options->tableFileName,
+                                    entries,
+                                    entryCount,
+                                    pages,
+                                    pageCount,
+                                    options->padding);
+
+    for(int i = 0; i < pageCount; i++)
+    {
+        free(pages[i].fileName);
+        FreeImage(pages[i].image);
+    }
+    free(pages);
+    free(entries);
+    return success;
+}
+
+int main( int argc, char * * argv )
+{
+    if(argc == 1)
+    {
+        PrintHelp(argv[0]);
+        return 0;
+    }
+
+    Options options;
+    options.maxPageSize = DefaultPageSize;
+    options.padding = DefaultPadding;
+    options.paddingMode = DilatePadding;
+    options.maxDistance = 1;
+    options.threads = 0;
+    options.pageFileName = NULL;
+    options.tableFileName = NULL;
+    options.inputFileNames = (char * *)malloc(sizeof(char *)*argc);
+    options.inputCount = 0;
+
+    StatsOptions statsOptions;
+    InitStatsOptions(&statsOptions);
+
+    bool success = ParseArguments(argc, argv, &options, &statsOptions);
+    if(success)
+    {
+        StartStats(&statsOptions);
+        success = GenAtlas(&options);
+        success = FinishStats() && success;
+    }
+    free(options.inputFileNames);
+    return success ? 0 : 1;
+}
@@ -1,130 +1,137 @@
+#include <math.h> // ceilf
 #include <stdio.h> // printf
 #include <string.h> // strcmp
-#include <stdlib.h> // atof
+#include <stdlib.h> // atof, atoi
 #include "image.h"
-#include "third-party/edtaa3/edtaa3.h"
+#include "imagetool.h"
+#include "distancefield.h"
 
 static const float DefaultMaxDistance = 16;
 
-static void PrintHelp( const char * programName )
+typedef struct
 {
-    printf("%s [options] <input> <output>\n", programName);
+    float maxDistance;
+    int channel; // Negative selects alpha if present, otherwise the first channel.
+} Options;
 
+static void PrintOptionsHelp()
+{
     printf("\t-d <max distance>\n");
+    printf("\t-c <channel> (defaults to alpha if present, otherwise the first channel)\n");
 }
 
-static bool ParseArguments( int argc,
-                            char * * argv,
-                            float * maxDistance,
-                            const char * * inputFileName,
-                            const char * * outputFileName )
+static int ParseOption( int argc, char * * argv, int * i, void * data )
 {
-    for(int i = 1; i < argc; i++)
+    Options * options = (Options *)data;
+    if(strcmp(argv[*i], "-d") == 0 ||
+       strcmp(argv[*i], "-c") == 0)
     {
-        if(argv[i][0] == '-')
-        {
-            if(strcmp(argv[i], "-d") == 0)
-            {
-                if(i+1 < argc)
-                {
-                    i++;
-                    *maxDistance = atof(argv[i]);
-                }
-                else
-                {
-                    printf("Option needs a value.\n");
-                    return false;
-                }
-            }
-            else
-            {
-                printf("Unknown option %s\n", argv[i]);
-                return false;
-            }
-        }
-        else if(*inputFileName == NULL)
-        {
-            *inputFileName = argv[i];
-        }
-        else if(*outputFileName == NULL)
+        if(*i+1 >= argc)
         {
-            *outputFileName = argv[i];
+            printf("Option needs a value.\n");
+            return -1;
         }
+        const char option = argv[*i][1];
+        (*i)++;
+        if(option == 'd')
+            options->maxDistance = atof(argv[*i]);
         else
-        {
-            printf("Too many arguments.\n");
-            return false;
-        }
-    }
-
-    if(*inputFileName  == NULL ||
-       *outputFileName == NULL)
-    {
-        printf("File parameter(s) are missing.\n");
-        return false;
+            options->channel = atoi(argv[*i]);
+        return 1;
     }
-
-    return true;
+    return 0;
 }
 
-static void GenDistanceField( const char * inputFileName,
-                              const char * outputFileName,
-                              float maxDistance )
+static void HashOptions( CacheHasher * hasher, const void * data )
 {
-    Image * input   = ReadImage(inputFileName);
-    Image * outside = CreateImage(input->width, input->height, 1);
-    Image * inside  = CreateImage(input->width, input->height, 1);
-    Image * output  = CreateImage(input->width, input->height, 1);
-
-    const int pixels = input->width * input->height;
-
-    edtaa3(input->width, input->height, input->data, outside->data);
-
-    // Invert input image:
-    for(int i = 0; i < pixels; i++)
-        input->data[i] = 1.0f - input->data[i];
-
-    edtaa3(input->width, input->height, input->data, inside->data);
+    const Options * options = (const Options *)data;
+    HashFloat(hasher, options->maxDistance);
+    HashInt(hasher, options->channel);
+}
 
-    // Merge inside and outside:
-    for(int i = 0; i < pixels; i++)
+static Image * ReadMask( const char * fileName, const void * data )
+{
+    int channel = ((const Options *)data)->channel;
+    if(channel < 0)
     {
-        float d = -(outside->data[i] - inside->data[i]);
-
-        d = (d / maxDistance) * 0.5f + 0.5;
+        ImageInfo info;
+        if(!ReadImageInfo(fileName, &info))
+            return NULL;
+        channel = (info.channels == 2 || info.channels == 4) ? info.channels-1 : 0;
+    }
+    return ReadImageChannel(fileName, channel);
+}
 
-        // Clamp to 0-1:
-        if(d > 1.0f)
-            d = 1.0f;
-        else if(d < 0.0f)
-            d = 0.0f;
+static void Generate( const Image * mask,
+                      Image * distanceField,
+                      const void * data,
+                      Arena * scratchArena )
+{
+    const Options * options = (const Options *)data;
+    void * scratch = ArenaAllocate(scratchArena,
+        GetDistanceFieldScratchSize(mask->width, mask->height));
+    GenerateDistanceField(mask->width,
+                          mask->height,
+                          mask->data,
+                          distanceField->data,
+                          options->maxDistance,
+                          scratch);
+}
 
-        output->data[i] = d;
-    }
+static int GetReach( const void * data, bool * wrap )
+{
+    // A changed edge affects distances up to maxDistance away, and the
+    // gradient estimation looks at direct neighbours:
+    *wrap = false;
+    return (int)ceilf(((const Options *)data)->maxDistance) + 2;
+}
 
-    WriteImage(output, outputFileName);
+static void GenerateRegion( const Image * mask,
+                            Image * distanceField,
+                            const void * data,
+                            int x,
+                            int y,
+                            int width,
+                            int height,
+                            void * scratch )
+{
+    GenerateDistanceFieldRegion(mask->width,
+                                mask->height,
+                                mask->data,
+                                distanceField->data,
+                                ((const Options *)data)->maxDistance,
+                                x, y, width, height,
+                                scratch);
+}
 
-    FreeImage(input);
-    FreeImage(outside);
-    FreeImage(inside);
-    FreeImage(output);
+static size_t GetRegionScratchSize( const Image * mask, int tileSize, const void * data )
+{
+    return GetDistanceFieldRegionScratchSize(mask->width,
+                                             mask->height,
+                                             tileSize,
+                                             tileSize,
+                                             ((const Options *)data)->maxDistance);
 }
 
-int main( int argc, char * * argv )
+static const ImageTool DistanceFieldTool =
 {
-    if(argc == 1)
-    {
-        PrintHelp(argv[0]);
-    }
-    else
-    {
-        float maxDistance = DefaultMaxDistance;
-        const char * inputFileName = NULL;
-        const char * outputFileName = NULL;
-        if(!ParseArguments(argc, argv, &maxDistance, &inputFileName, &outputFileName))
-            return 1;
+    "gen-distancefield 1", // Must change whenever the output for the same input and options changes
+    sizeof(Options),
+    1,
+    PrintOptionsHelp,
+    ParseOption,
+    HashOptions,
+    ReadMask,
+    Generate,
+    GetReach,
+    GenerateRegion,
+    GetRegionScratchSize
+};
 
-        GenDistanceField(inputFileName, outputFileName, maxDistance);
-    }
-    return 0;
+int main( int argc, char * * argv )
+{
+    Options defaults;
+    defaults.maxDistance = DefaultMaxDistance;
+    defaults.channel = -1;
+    return RunImageTool(&DistanceFieldTool, &defaults, argc, argv);
 }
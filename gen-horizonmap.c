@@ -0,0 +1,273 @@
+#include <stdio.h> // printf, snprintf
+#include <string.h> // strcmp, strstr, strlen, strcpy
+#include <stdlib.h> // atof, atoi, malloc, free
+#include "image.h"
+#include "pixelformat.h"
+#include "threadpool.h"
+#include "stats.h"
+#include "horizonmap.h"
+
+static const int DefaultDirectionCount = 8;
+
+// Heights as steep as gen-normalmap's default Sobel3x3 filter assumes them:
+static const float DefaultHeightScale = 8;
+
+typedef struct
+{
+    int directionCount;
+    float heightScale;
+    bool wrap;
+    int threads;
+    const char * inputFileName;
+    const char * horizonFileName; // May contain %d for the direction group
+    const char * occlusionFileName; // Optional
+} Options;
+
+static void PrintHelp( const char * programName )
+{
+    printf("%s [options] <height map> <horizon output>\n", programName);
+
+    printf("\t-n <directions> (defaults to %d)\n", DefaultDirectionCount);
+    printf("\t-s <height scale> (pixels per unit of height, defaults to %g)\n",
+           DefaultHeightScale);
+    printf("\t-w (enable wrapping)\n");
+    printf("\t-a <occlusion output> (also write the ambient occlusion)\n");
+    printf("\t-j <threads> (defaults to one per processor)\n");
+    printf("\tThe horizon output stores the sine of the horizon angle of four\n"
+           "\tdirections per image.  With more directions it must contain %%d,\n"
+           "\twhich is replaced by the index of each group of four.\n");
+    PrintStatsHelp();
+}
+
+static bool ParseArguments( int argc,
+                            char * * argv,
+                            Options * options,
+                            StatsOptions * statsOptions )
+{
+    int fileCount = 0;
+    for(int i = 1; i < argc; i++)
+    {
+        if(argv[i][0] == '-')
+        {
+            const int statsOption = ParseStatsOption(argc, argv, &i, statsOptions);
+            if(statsOption < 0)
+                return false;
+            else if(statsOption > 0)
+                continue;
+
+            if(strcmp(argv[i], "-w") == 0)
+            {
+                options->wrap = true;
+            }
+            else if(strcmp(argv[i], "-n") == 0 ||
+                    strcmp(argv[i], "-s") == 0 ||
+                    strcmp(argv[i], "-a") == 0 ||
+                    strcmp(argv[i], "-j") == 0)
+            {
+                if(i+1 >= argc)
+                {
+                    printf("Option needs a value.\n");
+                    return false;
+                }
+                const char option = argv[i][1];
+                i++;
+                if(option == 'n')
+                    options->directionCount = atoi(argv[i]);
+                else if(option == 's')
+                    options->heightScale = atof(argv[i]);
+                else if(option == 'a')
+                    options->occlusionFileName = argv[i];
+                else
+                    options->threads = atoi(argv[i]);
+            }
+            else
+            {
+                printf("Unknown option %s\n", argv[i]);
+                return false;
+            }
+        }
+        else
+        {
+            if(fileCount == 0)
+                options->inputFileName = argv[i];
+            else if(fileCount == 1)
+                options->horizonFileName = argv[i];
+            else
+            {
+                printf("Too many parameters.\n");
+                return false;
+            }
+            fileCount++;
+        }
+    }
+
+    if(fileCount < 2)
+    {
+        printf("File parameter(s) are missing.\n");
+        return false;
+    }
+
+    if(options->directionCount <= 0)
+    {
+        printf("Direction count must be positive.\n");
+        return false;
+    }
+
+    if(options->directionCount > 4 && !strstr(options->horizonFileName, "%d"))
+    {
+        printf("More than four directions need %%d in the horizon output.\n");
+        return false;
+    }
+
+    return true;
+}
+
+static char * GetGroupFileName( const char * pattern, int group )
+{
+    const char * placeholder = strstr(pattern, "%d");
+    const size_t length = strlen(pattern) + 16;
+    char * fileName = (char *)malloc(length);
+    if(placeholder)
+        snprintf(fileName, length, "%.*s%d%s",
+                 (int)(placeholder - pattern), pattern, group, placeholder+2);
+    else
+        snprintf(fileName, length, "%s", pattern);
+    return fileName;
+}
+
+typedef struct
+{
+    Image * image;
+    char * fileName;
+    bool success;
+} WriteTask;
+
+static void WriteOutput( void * data, int workerIndex )
+{
+    WriteTask * task = (WriteTask *)data;
+    task->success = WriteImage(task->image, task->fileName);
+}
+
+/**
+ * Puts up to four horizon planes into each image, plus the occlusion map.
+ *
+ * @return
+ * Number of tasks.
+ */
+static int CreateWriteTasks( const Options * options,
+                             int width,
+                             int height,
+                             const float * horizonMap,
+                             WriteTask * tasks )
+{
+    const size_t pixelCount = (size_t)width*height;
+    int taskCount = 0;
+    for(int first = 0; first < options->directionCount; first += 4)
+    {
+        const int remaining = options->directionCount - first;
+        const int channels = (remaining < 4) ? remaining : 4;
+        WriteTask * task = &tasks[taskCount++];
+        task->image = CreateImage(width, height, channels);
+        for(int c = 0; c < channels; c++)
+            InsertChannel(&horizonMap[(first+c)*pixelCount], task->image->data,
+                          channels, c, pixelCount);
+        task->fileName = GetGroupFileName(options->horizonFileName, first/4);
+        task->success = false;
+    }
+
+    if(options->occlusionFileName)
+    {
+        WriteTask * task = &tasks[taskCount++];
+        task->image = CreateImage(width, height, 1);
+        GenerateAmbientOcclusionMap(width,
+                                    height,
+                                    options->directionCount,
+                                    horizonMap,
+                                    task->image->data);
+        task->fileName = (char *)malloc(strlen(options->occlusionFileName)+1);
+        strcpy(task->fileName, options->occlusionFileName);
+        task->success = false;
+    }
+    return taskCount;
+}
+
+static bool GenHorizonMap( const Options * options )
+{
+    Image * heightMap = ReadImage(options->inputFileName);
+    if(!heightMap)
+        return false;
+
+    // The height is taken from the first channel:
+    if(heightMap->channels > 1)
+    {
+        Image * firstChannel = CopyImageChannel(heightMap, 0);
+        FreeImage(heightMap);
+        heightMap = firstChannel;
+    }
+
+    const int width = heightMap->width;
+    const int height = heightMap->height;
+    float * horizonMap =
+        (float *)malloc(sizeof(float)*options->directionCount*width*height);
+
+    ThreadPool * pool = CreateThreadPool(options->threads);
+    GenerateHorizonMap(width,
+                       height,
+                       heightMap->data,
+                       options->heightScale,
+                       options->directionCount,
+                       options->wrap,
+                       horizonMap,
+                       pool);
+    FreeImage(heightMap);
+
+    // Outputs are encoded concurrently:
+    WriteTask * tasks = (WriteTask *)malloc(sizeof(WriteTask)*
+                                            (options->directionCount/4 + 2));
+    const int taskCount = CreateWriteTasks(options, width, height, horizonMap, tasks);
+    free(horizonMap);
+    for(int i = 0; i < taskCount; i++)
+        SubmitTask(pool, WriteOutput, &tasks[i]);
+    WaitForTasks(pool);
+    FreeThreadPool(pool);
+
+    bool success = true;
+    for(int i = 0; i < taskCount; i++)
+    {
+        success = success && tasks[i].success;
+        free(tasks[i].fileName);
+        FreeImage(tasks[i].image);
+    }
+    free(tasks);
+    return success;
+}
+
+int main( int argc, char * * argv )
+{
+    if(argc == 1)
+    {
+        PrintHelp(argv[0]);
+        return 0;
+    }
+
+    Options options;
+    options.directionCount = DefaultDirectionCount;
+    options.heightScale = DefaultHeightScale;
+    options.wrap = false;
+    options.threads = 0;
+    options.inputFileName = NULL;
+    options.horizonFileName = NULL;
+    options.occlusionFileName = NULL;
+
+    StatsOptions statsOptions;
+    InitStatsOptions(&statsOptions);
+
+    bool success = ParseArguments(argc, argv, &options, &statsOptions);
+    if(success)
+    {
+        StartStats(&statsOptions);
+        success = GenHorizonMap(&options);
+        success = FinishStats() && success;
+    }
+    return success ? 0 : 1;
+}
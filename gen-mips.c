@@ -0,0 +1,444 @@
+#include <stdint.h> // uint8_t, uint16_t, uint32_t
+#include <stdio.h> // printf, fprintf, fopen, fwrite
+#include <string.h> // strcmp, memcpy, memset
+#include <stdlib.h> // atof, atoi, malloc, free
+#include "image.h"
+#include "pixelformat.h"
+#include "threadpool.h"
+#include "stats.h"
+#include "mipmap.h"
+
+// DDS header values, see the DirectX documentation of DDS_HEADER and
+// DDS_HEADER_DXT10:
+enum
+{
+    DdsHeaderSize = 124,
+    DdsPixelFormatSize = 32,
+    DdsFlags = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x20000, // Caps, height, width, pitch, pixel format, mip count
+    DdsPixelFormatFourCC = 0x4,
+    DdsCaps = 0x8 | 0x1000 | 0x400000, // Complex, texture, mipmap
+    DdsDimensionTexture2D = 3
+};
+
+// DXGI_FORMAT values:
+enum
+{
+    DxgiR32G32B32A32Float = 2,
+    DxgiR32G32B32Float = 6,
+    DxgiR16G16B16A16Unorm = 11,
+    DxgiR32G32Float = 16,
+    DxgiR8G8B8A8Unorm = 28,
+    DxgiR8G8B8A8UnormSrgb = 29,
+    DxgiR16G16Unorm = 35,
+    DxgiR32Float = 41,
+    DxgiR8G8Unorm = 49,
+    DxgiR16Unorm = 56,
+    DxgiR8Unorm = 61
+};
+
+typedef struct
+{
+    MipOptions mip;
+    bool filterSet;
+    int bits;
+    int threads;
+    const char * inputFileName;
+    const char * outputFileName;
+} Options;
+
+/**
+ * How levels are stored in the file.
+ */
+typedef struct
+{
+    uint32_t dxgiFormat;
+    int channels;
+    int bytesPerChannel;
+    bool linearColor; // Colors are stored without sRGB encoding
+} OutputFormat;
+
+static void PrintHelp( const char * programName )
+{
+    printf("%s [options] <input> <output.dds>\n", programName);
+
+    printf("\t-t <content> (color, data, normal or sdf, defaults to color)\n");
+    printf("\t-f <filter> (kaiser, lanczos or box, defaults to kaiser; sdf always uses box)\n");
+    printf("\t-w (tiling texture, filter across the edges)\n");
+    printf("\t-a <reference> (keep the alpha test coverage for this reference value)\n");
+    printf("\t-b <bits> (per channel: 8, 16 or 32 for floats, defaults to 8)\n");
+    printf("\t-j <threads> (defaults to one per processor)\n");
+    printf("\tWrites all levels into one DDS file.  Colors are filtered in linear\n"
+           "\tlight; 8 bit color is stored as sRGB, wider formats as linear.\n");
+    PrintStatsHelp();
+}
+
+static bool ParseContent( const char * name, MipContent * content )
+{
+    if(strcmp(name, "color") == 0)
+        *content = MipColor;
+    else if(strcmp(name, "data") == 0)
+        *content = MipData;
+    else if(strcmp(name, "normal") == 0)
+        *content = MipNormalMap;
+    else if(strcmp(name, "sdf") == 0)
+        *content = MipDistanceField;
+    else
+        return false;
+    return true;
+}
+
+static bool ParseFilter( const char * name, MipFilter * filter )
+{
+    if(strcmp(name, "kaiser") == 0)
+        *filter = MipKaiser;
+    else if(strcmp(name, "lanczos") == 0)
+        *filter = MipLanczos;
+    else if(strcmp(name, "box") == 0)
+        *filter = MipBox;
+    else
+        return false;
+    return true;
+}
+
+static bool ParseArguments( int argc,
+                            char * * argv,
+                            Options * options,
+                            StatsOptions * statsOptions )
+{
+    int fileCount = 0;
+    for(int i = 1; i < argc; i++)
+    {
+        if(argv[i][0] == '-')
+        {
+            const int statsOption = ParseStatsOption(argc, argv, &i, statsOptions);
+            if(statsOption < 0)
+                return false;
+            else if(statsOption > 0)
+                continue;
+
+            if(strcmp(argv[i], "-w") == 0)
+            {
+                options->mip.wrap = true;
+            }
+            else if(strcmp(argv[i], "-t") == 0 ||
+                    strcmp(argv[i], "-f") == 0 ||
+                    strcmp(argv[i], "-a") == 0 ||
+                    strcmp(argv[i], "-b") == 0 ||
+                    strcmp(argv[i], "-j") == 0)
+            {
+                if(i+1 >= argc)
+                {
+                    printf("Option needs a value.\n");
+                    return false;
+                }
+                const char option = argv[i][1];
+                i++;
+                if(option == 't')
+                {
+                    if(!ParseContent(argv[i], &options->mip.content))
+                    {
+                        printf("Unknown content %s\n", argv[i]);
+                        return false;
+                    }
+                }
+                else if(option == 'f')
+                {
+                    if(!ParseFilter(argv[i], &options->mip.filter))
+                    {
+                        printf("Unknown filter %s\n", argv[i]);
+                        return false;
+                    }
+                    options->filterSet = true;
+                }
+                else if(option == 'a')
+                    options->mip.alphaReference = atof(argv[i]);
+                else if(option == 'b')
+                    options->bits = atoi(argv[i]);
+                else
+                    options->threads = atoi(argv[i]);
+            }
+            else
+            {
+                printf("Unknown option %s\n", argv[i]);
+                return false;
+            }
+        }
+        else
+        {
+            if(fileCount == 0)
+                options->inputFileName = argv[i];
+            else if(fileCount == 1)
+                options->outputFileName = argv[i];
+            else
+            {
+                printf("Too many parameters.\n");
+                return false;
+            }
+            fileCount++;
+        }
+    }
+
+    if(fileCount < 2)
+    {
+        printf("File parameter(s) are missing.\n");
+        return false;
+    }
+
+    if(options->bits != 8 && options->bits != 16 && options->bits != 32)
+    {
+        printf("Bits must be 8, 16 or 32.\n");
+        return false;
+    }
+
+    if(options->mip.content == MipDistanceField && options->filterSet &&
+       options->mip.filter != MipBox)
+        printf("Distance fields are always filtered with a box filter.\n");
+
+    return true;
+}
+
+/**
+ * DXGI has no three channel formats below 32 bits and no sRGB formats with
+ * less than four channels, so those get padded with an opaque alpha.
+ */
+static OutputFormat GetOutputFormat( int channels, int bits, MipContent content )
+{
+    OutputFormat format;
+    format.bytesPerChannel = bits/8;
+    format.linearColor = bits != 8;
+    format.channels = channels;
+    if(bits == 8)
+    {
+        if(content == MipColor || channels >= 3)
+            format.channels = 4;
+        if(format.channels == 1)
+            format.dxgiFormat = DxgiR8Unorm;
+        else if(format.channels == 2)
+            format.dxgiFormat = DxgiR8G8Unorm;
+        else
+            format.dxgiFormat = (content == MipColor) ? DxgiR8G8B8A8UnormSrgb :
+                                                        DxgiR8G8B8A8Unorm;
+    }
+    else if(bits == 16)
+    {
+        if(channels == 3)
+            format.channels = 4;
+        const uint32_t formats[4] = { DxgiR16Unorm,
+                                      DxgiR16G16Unorm,
+                                      DxgiR16G16B16A16Unorm,
+                                      DxgiR16G16B16A16Unorm };
+        format.dxgiFormat = formats[channels-1];
+    }
+    else
+    {
+        const uint32_t formats[4] = { DxgiR32Float,
+                                      DxgiR32G32Float,
+                                      DxgiR32G32B32Float,
+                                      DxgiR32G32B32A32Float };
+        format.dxgiFormat = formats[channels-1];
+    }
+    return format;
+}
+
+/**
+ * Source channel of every output channel, for #SwizzleChannels.
+ */
+static void GetChannelMapping( int channels, const OutputFormat * format, int * mapping )
+{
+    for(int c = 0; c < format->channels; c++)
+        mapping[c] = (c < channels) ? c : SwizzleOne;
+    if(format->channels == 4 && channels == 1)
+    {
+        // Gray:
+        mapping[1] = 0;
+        mapping[2] = 0;
+    }
+    else if(format->channels == 4 && channels == 2)
+    {
+        // Gray and alpha:
+        mapping[1] = 0;
+        mapping[2] = 0;
+        mapping[3] = 1;
+    }
+}
+
+static void PutU32( unsigned char * out, uint32_t value )
+{
+    out[0] = (unsigned char)(value & 0xff);
+    out[1] = (unsigned char)((value >> 8) & 0xff);
+    out[2] = (unsigned char)((value >> 16) & 0xff);
+    out[3] = (unsigned char)((value >> 24) & 0xff);
+}
+
+static void WriteLevel( FILE * file,
+                        const MipLevel * level,
+                        int channels,
+                        const OutputFormat * format )
+{
+    const size_t pixelCount = (size_t)level->width*level->height;
+    const size_t count = pixelCount*format->channels;
+    const float * values = level->data;
+    float * swizzled = NULL;
+    if(format->channels != channels)
+    {
+        int mapping[4];
+        GetChannelMapping(channels, format, mapping);
+        swizzled = (float *)malloc(sizeof(float)*count);
+        SwizzleChannels(level->data, channels, swizzled, format->channels, mapping, pixelCount);
+        values = swizzled;
+    }
+
+    if(format->bytesPerChannel == 1)
+    {
+        uint8_t * out = (uint8_t *)malloc(count);
+        ConvertFloatToU8(values, out, count);
+        fwrite(out, 1, count, file);
+        free(out);
+    }
+    else if(format->bytesPerChannel == 2)
+    {
+        uint16_t * out = (uint16_t *)malloc(sizeof(uint16_t)*count);
+        ConvertFloatToU16(values, out, count);
+        unsigned char * bytes = (unsigned char *)out;
+        for(size_t i = 0; i < count; i++)
+        {
+            const uint16_t value = out[i];
+            bytes[i*2] = (unsigned char)(value & 0xff);
+            bytes[i*2+1] = (unsigned char)(value >> 8);
+        }
+        fwrite(out, 2, count, file);
+        free(out);
+    }
+    else
+    {
+        unsigned char * out = (unsigned char *)malloc(4*count);
+        for(size_t i = 0; i < count; i++)
+        {
+            uint32_t bits;
+            memcpy(&bits, &values[i], sizeof(bits));
+            PutU32(&out[i*4], bits);
+        }
+        fwrite(out, 4, count, file);
+        free(out);
+    }
+    free(swizzled);
+}
+
+/**
+ * Writes a DDS file with the DX10 header extension, followed by the levels
+ * from largest to smallest without any padding.
+ */
+static bool WriteDds( const char * fileName,
+                      const MipLevel * levels,
+                      int levelCount,
+                      int channels,
+                      const OutputFormat * format )
+{
+    FILE * file = fopen(fileName, "wb");
+    if(!file)
+    {
+        fprintf(stderr, "Can't open '%s' for writing.\n", fileName);
+        return false;
+    }
+
+    const uint32_t pixelSize = (uint32_t)(format->channels*format->bytesPerChannel);
+    uint32_t header[DdsHeaderSize/4 + 5];
+    memset(header, 0, sizeof(header));
+    header[0] = DdsHeaderSize;
+    header[1] = DdsFlags;
+    header[2] = (uint32_t)levels[0].height;
+    header[3] = (uint32_t)levels[0].width;
+    header[4] = (uint32_t)levels[0].width*pixelSize; // Pitch
+    header[6] = (uint32_t)levelCount;
+    header[18] = DdsPixelFormatSize;
+    header[19] = DdsPixelFormatFourCC;
+    header[20] = (uint32_t)'D' | (uint32_t)'X' << 8 | (uint32_t)'1' << 16 | (uint32_t)'0' << 24;
+    header[26] = DdsCaps;
+    header[31] = format->dxgiFormat;
+    header[32] = DdsDimensionTexture2D;
+    header[34] = 1; // Array size
+
+    unsigned char out[4 + sizeof(header)];
+    memcpy(out, "DDS ", 4);
+    for(size_t i = 0; i < sizeof(header)/sizeof(header[0]); i++)
+        PutU32(&out[4 + i*4], header[i]);
+    fwrite(out, 1, sizeof(out), file);
+
+    for(int i = 0; i < levelCount; i++)
+        WriteLevel(file, &levels[i], channels, format);
+
+    if(ferror(file) | fclose(file))
+    {
+        fprintf(stderr, "Could not write '%s'.\n", fileName);
+        return false;
+    }
+    return true;
+}
+
+static bool GenMips( const Options * options )
+{
+    Image * image = ReadImage(options->inputFileName);
+    if(!image)
+        return false;
+
+    const int channels = image->channels;
+    if(options->mip.content == MipNormalMap && channels < 3)
+    {
+        fprintf(stderr, "Normal maps need three channels.\n");
+        FreeImage(image);
+        return false;
+    }
+
+    const OutputFormat format = GetOutputFormat(channels, options->bits, options->mip.content);
+    ThreadPool * pool = CreateThreadPool(options->threads);
+    const int levelCount = GetMipLevelCount(image->width, image->height);
+    MipLevel * levels = GenerateMipChain(image->width,
+                                         image->height,
+                                         channels,
+                                         image->data,
+                                         &options->mip,
+                                         format.linearColor,
+                                         pool);
+    FreeThreadPool(pool);
+    FreeImage(image);
+
+    StatsScope scope;
+    BeginStatsScope(&scope, "write", options->outputFileName);
+    const bool success = WriteDds(options->outputFileName, levels, levelCount, channels, &format);
+    EndStatsScope(&scope);
+
+    FreeMipChain(levels, levelCount);
+    return success;
+}
+
+int main( int argc, char * * argv )
+{
+    if(argc == 1)
+    {
+        PrintHelp(argv[0]);
+        return 0;
+    }
+
+    Options options;
+    options.mip.content = MipColor;
+    options.mip.filter = MipKaiser;
+    options.mip.wrap = false;
+    options.mip.alphaReference = -1;
+    options.filterSet = false;
+    options.bits = 8;
+    options.threads = 0;
+    options.inputFileName = NULL;
+    options.outputFileName = NULL;
+
+    StatsOptions statsOptions;
+    InitStatsOptions(&statsOptions);
+
+    bool success = ParseArguments(argc, argv, &options, &statsOptions);
+    if(success)
+    {
+        StartStats(&statsOptions);
+        success = GenMips(&options);
+        success = FinishStats() && success;
+    }
+    return success ? 0 : 1;
+}
@@ -2,13 +2,19 @@
 #include <string.h> // strcmp
 #include "image.h"
 #include "normalmap.h"
+#include "imagetool.h"
 
 static const NormalMapFilter DefaultFilter = Sobel3x3;
 
-static void PrintHelp( const char * programName )
+typedef struct
 {
-    printf("%s [options] <input> <output>\n", programName);
+    NormalMapFilter filter;
+    bool wrap;
+    bool invertY;
+} Options;
 
+static void PrintOptionsHelp()
+{
     printf("\t-f <filter> (");
     for(int i = 0; i < NormalMapFilterCount; i++)
     {
@@ -33,107 +39,113 @@ static NormalMapFilter GetFilterByName( const char * name )
     return DefaultFilter;
 }
 
-static bool ParseArguments( int argc,
-                            char * * argv,
-                            NormalMapFilter * filter,
-                            bool * wrap,
-                            bool * invertY,
-                            const char * * inputFileName,
-                            const char * * outputFileName )
+static int ParseOption( int argc, char * * argv, int * i, void * data )
 {
-    for(int i = 1; i < argc; i++)
+    Options * options = (Options *)data;
+    if(strcmp(argv[*i], "-f") == 0)
     {
-        if(argv[i][0] == '-')
-        {
-            if(strcmp(argv[i], "-f") == 0)
-            {
-                if(i+1 < argc)
-                {
-                    i++;
-                    *filter = GetFilterByName(argv[i]);
-                }
-                else
-                {
-                    printf("Option needs a value.\n");
-                    return false;
-                }
-            }
-            else if(strcmp(argv[i], "-w") == 0)
-            {
-                *wrap = true;
-            }
-            else if(strcmp(argv[i], "-y") == 0)
-            {
-                *invertY = true;
-            }
-            else
-            {
-                printf("Unknown option %s\n", argv[i]);
-                return false;
-            }
-        }
-        else if(*inputFileName == NULL)
-        {
-            *inputFileName = argv[i];
-        }
-        else if(*outputFileName == NULL)
+        if(*i+1 < argc)
         {
-            *outputFileName = argv[i];
+            (*i)++;
+            options->filter = GetFilterByName(argv[*i]);
         }
         else
         {
-            printf("Too many arguments.\n");
-            return false;
+            printf("Option needs a value.\n");
+            return -1;
         }
     }
-
-    if(*inputFileName  == NULL ||
-       *outputFileName == NULL)
+    else if(strcmp(argv[*i], "-w") == 0)
     {
-        printf("File parameter(s) are missing.\n");
-        return false;
+        options->wrap = true;
     }
-
-    return true;
-}
-
-int main( int argc, char * * argv )
-{
-    if(argc == 1)
+    else if(strcmp(argv[*i], "-y") == 0)
     {
-        PrintHelp(argv[0]);
+        options->invertY = true;
     }
     else
     {
-        NormalMapFilter filter = DefaultFilter;
-        bool wrap = false;
-        bool invertY = false;
-        const char * inputFileName = NULL;
-        const char * outputFileName = NULL;
-        if(!ParseArguments(argc,
-                           argv,
-                           &filter,
-                           &wrap,
-                           &invertY,
-                           &inputFileName,
-                           &outputFileName))
-            return 1;
+        return 0;
+    }
+    return 1;
+}
+
+static void HashOptions( CacheHasher * hasher, const void * data )
+{
+    const Options * options = (const Options *)data;
+    HashString(hasher, NormalMapFilterToString(options->filter));
+    HashInt(hasher, options->wrap);
+    HashInt(hasher, options->invertY);
+}
 
-        Image * input = ReadImage(inputFileName);
-        Image * output = CreateImage(input->width, input->height, 3);
+static Image * ReadHeightMap( const char * fileName, const void * options )
+{
+    // The height is taken from the first channel:
+    return ReadImageChannel(fileName, 0);
+}
 
-        GenerateNormalMap(input->width,
-                          input->height,
-                          input->data,
-                          output->data,
-                          filter,
-                          wrap,
-                          invertY);
+static void Generate( const Image * heightMap,
+                      Image * normalMap,
+                      const void * data,
+                      Arena * scratchArena )
+{
+    const Options * options = (const Options *)data;
+    GenerateNormalMap(heightMap->width,
+                      heightMap->height,
+                      heightMap->data,
+                      normalMap->data,
+                      options->filter,
+                      options->wrap,
+                      options->invertY);
+}
 
-        WriteImage(output, outputFileName);
+static int GetReach( const void * data, bool * wrap )
+{
+    const Options * options = (const Options *)data;
+    *wrap = options->wrap;
+    return GetNormalMapFilterRadius(options->filter);
+}
 
-        FreeImage(input);
-        FreeImage(output);
-    }
-    return 0;
+static void GenerateRegion( const Image * heightMap,
+                            Image * normalMap,
+                            const void * data,
+                            int x,
+                            int y,
+                            int width,
+                            int height,
+                            void * scratch )
+{
+    const Options * options = (const Options *)data;
+    GenerateNormalMapRegion(heightMap->width,
+                            heightMap->height,
+                            heightMap->data,
+                            normalMap->data,
+                            options->filter,
+                            options->wrap,
+                            options->invertY,
+                            x, y, width, height);
+}
+
+static const ImageTool NormalMapTool =
+{
+    "gen-normalmap 1", // Must change whenever the output for the same input and options changes
+    sizeof(Options),
+    3,
+    PrintOptionsHelp,
+    ParseOption,
+    HashOptions,
+    ReadHeightMap,
+    Generate,
+    GetReach,
+    GenerateRegion,
+    NULL // No scratch memory
+};
+
+int main( int argc, char * * argv )
+{
+    Options defaults;
+    defaults.filter = DefaultFilter;
+    defaults.wrap = false;
+    defaults.invertY = false;
+    return RunImageTool(&NormalMapTool, &defaults, argc, argv);
 }
@@ -0,0 +1,481 @@
+#include <stdint.h> // uint32_t, uint64_t
+#include <stdio.h> // printf, fprintf, fopen, fread, fwrite
+#include <string.h> // strcmp, strlen, strchr, strncmp, memcpy, memset
+#include <stdlib.h> // atoi, malloc, realloc, free, qsort
+#include <sys/stat.h> // stat
+#include "threadpool.h"
+#include "stats.h"
+#include "lz4block.h"
+#include "packfile.h"
+#include "pack.h"
+
+enum
+{
+    DefaultAlignment = 4096,
+    MinCompressedSize = 64, // Smaller entries are always stored raw
+    CopyChunkSize = 1024*1024
+};
+
+typedef struct
+{
+    int alignment;
+    int threads;
+    const char * rawSuffixes; // Colon separated, like zip --suffixes
+    const char * outputFileName;
+    char * * inputFileNames;
+    int inputCount;
+} Options;
+
+typedef struct
+{
+    const char * name;
+    const Options * options;
+    uint64_t size;
+    unsigned char * compressed; // `NULL` if stored raw
+    size_t compressedSize;
+    uint64_t offset;
+    bool success;
+} Entry;
+
+static void PrintHelp( const char * programName )
+{
+    printf("%s [options] <output> <input>...\n", programName);
+
+    printf("\t-r <suffixes> (store files with these colon separated suffixes\n"
+           "\t    uncompressed, e.g. '.png:.ogg')\n");
+    printf("\t-a <alignment> (of uncompressed entries, defaults to %d)\n",
+           DefaultAlignment);
+    printf("\t-j <threads> (defaults to one per processor)\n");
+    PrintStatsHelp();
+}
+
+static bool ParseArguments( int argc,
+                            char * * argv,
+                            Options * options,
+                            StatsOptions * statsOptions )
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(argv[i][0] == '-')
+        {
+            const int statsOption = ParseStatsOption(argc, argv, &i, statsOptions);
+            if(statsOption < 0)
+                return false;
+            else if(statsOption > 0)
+                continue;
+
+            if(strcmp(argv[i], "-r") == 0 ||
+               strcmp(argv[i], "-a") == 0 ||
+               strcmp(argv[i], "-j") == 0)
+            {
+                if(i+1 >= argc)
+                {
+                    printf("Option needs a value.\n");
+                    return false;
+                }
+                const char option = argv[i][1];
+                i++;
+                if(option == 'r')
+                    options->rawSuffixes = argv[i];
+                else if(option == 'a')
+                    options->alignment = atoi(argv[i]);
+                else
+                    options->threads = atoi(argv[i]);
+            }
+            else
+            {
+                printf("Unknown option %s\n", argv[i]);
+                return false;
+            }
+        }
+        else if(!options->outputFileName)
+        {
+            options->outputFileName = argv[i];
+        }
+        else
+        {
+            options->inputFileNames[options->inputCount++] = argv[i];
+        }
+    }
+
+    if(options->inputCount == 0)
+    {
+        printf("File parameter(s) are missing.\n");
+        return false;
+    }
+
+    const int alignment = options->alignment;
+    if(alignment < PackFileIndexAlignment || (alignment & (alignment-1)) != 0)
+    {
+        printf("Alignment must be a power of two of at least %d.\n",
+               PackFileIndexAlignment);
+        return false;
+    }
+
+    return true;
+}
+
+static bool HasSuffix( const char * name, const char * suffixes )
+{
+    if(!suffixes)
+        return false;
+
+    const size_t nameLength = strlen(name);
+    for(const char * suffix = suffixes; *suffix;)
+    {
+        const char * end = strchr(suffix, ':');
+        const size_t length = end ? (size_t)(end - suffix) : strlen(suffix);
+        if(length > 0 && length <= nameLength &&
+           strncmp(&name[nameLength - length], suffix, length) == 0)
+            return true;
+        if(!end)
+            break;
+        suffix = end+1;
+    }
+    return false;
+}
+
+static unsigned char * ReadFile( const char * fileName, uint64_t size )
+{
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+    {
+        fprintf(stderr, "Can't open '%s'.\n", fileName);
+        return NULL;
+    }
+    unsigned char * data = (unsigned char *)malloc(size ? (size_t)size : 1);
+    const bool success = fread(data, 1, (size_t)size, file) == size;
+    fclose(file);
+    if(!success)
+    {
+        fprintf(stderr, "Can't read '%s'.\n", fileName);
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+/**
+ * Compresses an entry, unless its suffix says it's compressed already.
+ * The result is only kept if it saves at least an eighth, otherwise
+ * mapping the raw data is worth more.
+ */
+static void PrepareEntry( void * data, int workerIndex )
+{
+    Entry * entry = (Entry *)data;
+    struct stat status;
+    if(stat(entry->name, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        fprintf(stderr, "Can't open '%s'.\n", entry->name);
+        return;
+    }
+    entry->size = (uint64_t)status.st_size;
+
+    if(HasSuffix(entry->name, entry->options->rawSuffixes) ||
+       entry->size < MinCompressedSize ||
+       entry->size > LZ4_BLOCK_MAX_INPUT_SIZE)
+    {
+        entry->success = true;
+        return;
+    }
+
+    unsigned char * input = ReadFile(entry->name, entry->size);
+    if(!input)
+        return;
+
+    StatsScope scope;
+    BeginStatsScope(&scope, "compress", entry->name);
+    const size_t capacity = (size_t)(entry->size - entry->size/8);
+    unsigned char * output = (unsigned char *)malloc(capacity);
+    const size_t compressedSize = CompressLz4Block(input, (size_t)entry->size, output, capacity);
+    EndStatsScope(&scope);
+    free(input);
+
+    if(compressedSize > 0)
+    {
+        entry->compressed = (unsigned char *)realloc(output, compressedSize);
+        entry->compressedSize = compressedSize;
+    }
+    else
+    {
+        free(output);
+    }
+    entry->success = true;
+}
+
+static int CompareEntries( const void * a, const void * b )
+{
+    return strcmp(((const Entry *)a)->name, ((const Entry *)b)->name);
+}
+
+static uint64_t Align( uint64_t offset, uint64_t alignment )
+{
+    return (offset + alignment-1) / alignment * alignment;
+}
+
+static void PutU32( unsigned char * out, uint32_t value )
+{
+    out[0] = (unsigned char)(value & 0xff);
+    out[1] = (unsigned char)((value >> 8) & 0xff);
+    out[2] = (unsigned char)((value >> 16) & 0xff);
+    out[3] = (unsigned char)((value >> 24) & 0xff);
+}
+
+static void PutU64( unsigned char * out, uint64_t value )
+{
+    PutU32(out, (uint32_t)value);
+    PutU32(out+4, (uint32_t)(value >> 32));
+}
+
+static void WritePadding( FILE * file, uint64_t * position, uint64_t target )
+{
+    static const unsigned char Zeros[1024] = {0};
+    while(*position < target)
+    {
+        uint64_t length = target - *position;
+        if(length > sizeof(Zeros))
+            length = sizeof(Zeros);
+        fwrite(Zeros, 1, (size_t)length, file);
+        *position += length;
+    }
+}
+
+static bool CopyEntryData( FILE * file, const Entry * entry, unsigned char * buffer )
+{
+    FILE * input = fopen(entry->name, "rb");
+    if(!input)
+    {
+        fprintf(stderr, "Can't open '%s'.\n", entry->name);
+        return false;
+    }
+    uint64_t remaining = entry->size;
+    while(remaining > 0)
+    {
+        const size_t length = remaining > CopyChunkSize ? CopyChunkSize : (size_t)remaining;
+        if(fread(buffer, 1, length, input) != length)
+            break;
+        fwrite(buffer, 1, length, file);
+        remaining -= length;
+    }
+    fclose(input);
+    if(remaining > 0)
+    {
+        fprintf(stderr, "'%s' changed while packing.\n", entry->name);
+        return false;
+    }
+    return true;
+}
+
+static bool WritePack( const Options * options, Entry * entries, int entryCount )
+{
+    uint32_t slotCount = 1;
+    while(slotCount < (uint32_t)entryCount*2 || slotCount <= (uint32_t)entryCount)
+        slotCount *= 2;
+
+    uint64_t stringSize = 0;
+    for(int i = 0; i < entryCount; i++)
+        stringSize += strlen(entries[i].name)+1;
+
+    const uint64_t entryOffset = Align(sizeof(PackFileHeader), PackFileIndexAlignment);
+    const uint64_t slotOffset = Align(entryOffset + sizeof(PackFileEntry)*(uint64_t)entryCount,
+                                      PackFileIndexAlignment);
+    const uint64_t stringOffset = Align(slotOffset + sizeof(uint32_t)*(uint64_t)slotCount,
+                                        PackFileIndexAlignment);
+
+    // Uncompressed entries start on a page, so they can be used in place:
+    uint64_t fileSize = stringOffset + stringSize;
+    for(int i = 0; i < entryCount; i++)
+    {
+        Entry * entry = &entries[i];
+        if(entry->compressed)
+        {
+            entry->offset = Align(fileSize, PackFileIndexAlignment);
+            fileSize = entry->offset + entry->compressedSize;
+        }
+        else
+        {
+            entry->offset = Align(fileSize, options->alignment);
+            fileSize = entry->offset + entry->size;
+        }
+    }
+
+    uint32_t * slots = (uint32_t *)malloc(sizeof(uint32_t)*slotCount);
+    memset(slots, 0, sizeof(uint32_t)*slotCount);
+    for(int i = 0; i < entryCount; i++)
+    {
+        const uint64_t hash = HashPackName(entries[i].name);
+        uint32_t slot = (uint32_t)hash & (slotCount-1);
+        while(slots[slot])
+            slot = (slot+1) & (slotCount-1);
+        slots[slot] = (uint32_t)i+1;
+    }
+
+    FILE * file = fopen(options->outputFileName, "wb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for writing.\n", options->outputFileName);
+        free(slots);
+        return false;
+    }
+
+    unsigned char buffer[sizeof(PackFileEntry)];
+    uint64_t position = 0;
+
+    // Header:
+    {
+        unsigned char out[sizeof(PackFileHeader)];
+        memcpy(out, PACK_FILE_MAGIC, 4);
+        PutU32(&out[4], PackFileVersion);
+        PutU32(&out[8], (uint32_t)entryCount);
+        PutU32(&out[12], slotCount);
+        PutU32(&out[16], (uint32_t)options->alignment);
+        PutU32(&out[20], 0);
+        PutU64(&out[24], fileSize);
+        PutU64(&out[32], entryOffset);
+        PutU64(&out[40], slotOffset);
+        PutU64(&out[48], stringOffset);
+        PutU64(&out[56], stringSize);
+        fwrite(out, 1, sizeof(out), file);
+        position += sizeof(out);
+    }
+
+    // Entries:
+    WritePadding(file, &position, entryOffset);
+    uint32_t string = 0;
+    for(int i = 0; i < entryCount; i++)
+    {
+        const Entry * entry = &entries[i];
+        PutU64(&buffer[0], HashPackName(entry->name));
+        PutU64(&buffer[8], entry->offset);
+        PutU64(&buffer[16], entry->compressed ? entry->compressedSize : entry->size);
+        PutU64(&buffer[24], entry->size);
+        PutU32(&buffer[32], string);
+        PutU32(&buffer[36], entry->compressed ? PackLz4 : PackRaw);
+        fwrite(buffer, 1, sizeof(PackFileEntry), file);
+        position += sizeof(PackFileEntry);
+        string += (uint32_t)strlen(entry->name)+1;
+    }
+
+    // Hash table:
+    WritePadding(file, &position, slotOffset);
+    for(uint32_t i = 0; i < slotCount; i++)
+    {
+        PutU32(buffer, slots[i]);
+        fwrite(buffer, 1, sizeof(uint32_t), file);
+    }
+    position += sizeof(uint32_t)*(uint64_t)slotCount;
+    free(slots);
+
+    // Names:
+    WritePadding(file, &position, stringOffset);
+    for(int i = 0; i < entryCount; i++)
+        fwrite(entries[i].name, 1, strlen(entries[i].name)+1, file);
+    position += stringSize;
+
+    // Data:
+    StatsScope scope;
+    BeginStatsScope(&scope, "write", options->outputFileName);
+    unsigned char * copyBuffer = (unsigned char *)malloc(CopyChunkSize);
+    bool success = true;
+    for(int i = 0; i < entryCount && success; i++)
+    {
+        const Entry * entry = &entries[i];
+        WritePadding(file, &position, entry->offset);
+        if(entry->compressed)
+        {
+            fwrite(entry->compressed, 1, entry->compressedSize, file);
+            position += entry->compressedSize;
+        }
+        else
+        {
+            success = CopyEntryData(file, entry, copyBuffer);
+            position += entry->size;
+        }
+    }
+    free(copyBuffer);
+    EndStatsScope(&scope);
+
+    if((ferror(file) | fclose(file)) && success)
+    {
+        fprintf(stderr, "Could not write '%s'.\n", options->outputFileName);
+        success = false;
+    }
+    return success;
+}
+
+static bool GenPack( const Options * options )
+{
+    const int entryCount = options->inputCount;
+    Entry * entries = (Entry *)malloc(sizeof(Entry)*entryCount);
+    memset(entries, 0, sizeof(Entry)*entryCount);
+    for(int i = 0; i < entryCount; i++)
+    {
+        entries[i].name = options->inputFileNames[i];
+        entries[i].options = options;
+    }
+
+    qsort(entries, entryCount, sizeof(Entry), CompareEntries);
+    bool success = true;
+    for(int i = 1; i < entryCount; i++)
+    {
+        if(strcmp(entries[i-1].name, entries[i].name) == 0)
+        {
+            fprintf(stderr, "'%s' is given twice.\n", entries[i].name);
+            success = false;
+        }
+    }
+
+    if(success)
+    {
+        ThreadPool * pool = CreateThreadPool(options->threads);
+        for(int i = 0; i < entryCount; i++)
+            SubmitTask(pool, PrepareEntry, &entries[i]);
+        FreeThreadPool(pool);
+
+        for(int i = 0; i < entryCount; i++)
+        {
+            success = success && entries[i].success;
+            AddStatsCount("bytes packed", (double)entries[i].size);
+            AddStatsCount("bytes stored", entries[i].compressed ?
+                                          (double)entries[i].compressedSize :
+                                          (double)entries[i].size);
+        }
+    }
+
+    success = success && WritePack(options, entries, entryCount);
+
+    for(int i = 0; i < entryCount; i++)
+        free(entries[i].compressed);
+    free(entries);
+    return success;
+}
+
+int main( int argc, char * * argv )
+{
+    if(argc == 1)
+    {
+        PrintHelp(argv[0]);
+        return 0;
+    }
+
+    Options options;
+    options.alignment = DefaultAlignment;
+    options.threads = 0;
+    options.rawSuffixes = NULL;
+    options.outputFileName = NULL;
+    options.inputFileNames = (char * *)malloc(sizeof(char *)*argc);
+    options.inputCount = 0;
+
+    StatsOptions statsOptions;
+    InitStatsOptions(&statsOptions);
+
+    bool success = ParseArguments(argc, argv, &options, &statsOptions);
+    if(success)
+    {
+        StartStats(&statsOptions);
+        success = GenPack(&options);
+        success = FinishStats() && success;
+    }
+    free(options.inputFileNames);
+    return success ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+#include <assert.h>
+#include <math.h> // sqrtf, floorf, cos, sin
+#include <stdlib.h> // malloc, free
+#include "horizonmap.h"
+#include "stats.h"
+
+
+typedef struct
+{
+    int width;
+    int height;
+    const float * heightMap;
+    float heightScale;
+    bool wrap;
+    double angle;
+    float * horizonMap; // Plane of this direction
+} Sweep;
+
+static int Round( float value )
+{
+    return (int)floorf(value + 0.5f);
+}
+
+static int Wrap( int value, int size )
+{
+    value %= size;
+    return (value < 0) ? value + size : value;
+}
+
+static float Slope( float fromDistance, float fromHeight, float toDistance, float toHeight )
+{
+    return (toHeight - fromHeight) / (toDistance - fromDistance);
+}
+
+/**
+ * Walks every pixel along lines in the sweep direction, starting at the far
+ * end.  The stack holds the upper convex hull of the terrain passed so far,
+ * nearest point on top.  Points below the line to the next hull point can't
+ * be the horizon of this or any later pixel, so each is popped at most once
+ * and a line takes linear time.
+ *
+ * Lines advance one pixel along the major axis per step and are rounded to
+ * the nearest pixel on the minor axis.  Lines starting at every minor
+ * offset cover each pixel exactly once.
+ */
+static void SweepDirection( void * data, int workerIndex )
+{
+    const Sweep * sweep = (const Sweep *)data;
+    const float dx = (float)cos(sweep->angle);
+    const float dy = (float)-sin(sweep->angle); // Rows go down
+    const bool majorIsX = fabsf(dx) >= fabsf(dy);
+    const int majorSize = majorIsX ? sweep->width  : sweep->height;
+    const int minorSize = majorIsX ? sweep->height : sweep->width;
+    const float major = majorIsX ? dx : dy;
+    const float minor = majorIsX ? dy : dx;
+    const int majorStep = (major > 0) ? 1 : -1;
+    const int majorStart = (major > 0) ? 0 : majorSize-1;
+    const float minorStep = minor / fabsf(major);
+    const float stepLength = sqrtf(1.0f + minorStep*minorStep);
+
+    // With wrapping every line runs twice around the image, so the first
+    // round provides the terrain beyond the edge for the second:
+    const int stepCount = sweep->wrap ? majorSize*2 : majorSize;
+    int firstLine = 0;
+    int endLine = minorSize;
+    if(!sweep->wrap)
+    {
+        const int endOffset = Round((float)(majorSize-1)*minorStep);
+        firstLine = (endOffset > 0) ? -endOffset : 0;
+        endLine = (endOffset < 0) ? minorSize - endOffset : minorSize;
+    }
+
+    float * stackDistances = (float *)malloc(sizeof(float)*stepCount);
+    float * stackHeights = (float *)malloc(sizeof(float)*stepCount);
+
+    for(int line = firstLine; line < endLine; line++)
+    {
+        int top = 0;
+        for(int step = stepCount-1; step >= 0; step--)
+        {
+            int a = majorStart + step*majorStep;
+            int b = line + Round((float)step*minorStep);
+            if(sweep->wrap)
+            {
+                a = Wrap(a, majorSize);
+                b = Wrap(b, minorSize);
+            }
+            else if(b < 0 || b >= minorSize)
+            {
+                continue;
+            }
+
+            const int index = majorIsX ? b*sweep->width + a : a*sweep->width + b;
+            const float distance = (float)step*stepLength;
+            const float height = sweep->heightMap[index]*sweep->heightScale;
+
+            while(top >= 2 &&
+                  Slope(distance, height, stackDistances[top-1], stackHeights[top-1]) <=
+                  Slope(distance, height, stackDistances[top-2], stackHeights[top-2]))
+                top--;
+
+            if(step < majorSize)
+            {
+                float slope = 0;
+                if(top > 0)
+                    slope = Slope(distance, height, stackDistances[top-1], stackHeights[top-1]);
+                sweep->horizonMap[index] = (slope > 0) ? slope / sqrtf(1.0f + slope*slope) : 0;
+            }
+
+            stackDistances[top] = distance;
+            stackHeights[top] = height;
+            top++;
+        }
+    }
+
+    free(stackDistances);
+    free(stackHeights);
+}
+
+void GenerateHorizonMap( int width,
+                         int height,
+                         const float * heightMap,
+                         float heightScale,
+                         int directionCount,
+                         bool wrap,
+                         float * horizonMap,
+                         ThreadPool * pool )
+{
+    assert(directionCount > 0);
+
+    StatsScope scope;
+    BeginStatsScope(&scope, "horizon map", NULL);
+
+    Sweep * sweeps = (Sweep *)malloc(sizeof(Sweep)*directionCount);
+    for(int i = 0; i < directionCount; i++)
+    {
+        Sweep * sweep = &sweeps[i];
+        sweep->width = width;
+        sweep->height = height;
+        sweep->heightMap = heightMap;
+        sweep->heightScale = heightScale;
+        sweep->wrap = wrap;
+        sweep->angle = 2.0*3.14159265358979323846*i / directionCount;
+        sweep->horizonMap = &horizonMap[(size_t)i*width*height];
+        if(pool)
+            SubmitTask(pool, SweepDirection, sweep);
+        else
+            SweepDirection(sweep, 0);
+    }
+    if(pool)
+        WaitForTasks(pool);
+    free(sweeps);
+
+    EndStatsScope(&scope);
+}
+
+void GenerateAmbientOcclusionMap( int width,
+                                  int height,
+                                  int directionCount,
+                                  const float * horizonMap,
+                                  float * occlusionMap )
+{
+    const size_t pixelCount = (size_t)width*height;
+    for(size_t i = 0; i < pixelCount; i++)
+    {
+        float visible = 0;
+        for(int d = 0; d < directionCount; d++)
+        {
+            const float horizon = horizonMap[d*pixelCount + i];
+            visible += 1.0f - horizon*horizon;
+        }
+        occlusionMap[i] = visible / (float)directionCount;
+    }
+}
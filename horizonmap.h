@@ -0,0 +1,65 @@
+#ifndef __HORIZONMAP_H__
+#define __HORIZONMAP_H__
+
+#include <stdbool.h>
+#include "threadpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Calculate the horizon of every pixel of a height map in evenly spaced
+ * directions.
+ *
+ * Direction `i` points `i*360/directionCount` degrees counterclockwise from
+ * +X, with Y pointing up, i.e. towards the previous row.  The horizon is
+ * stored as the sine of its elevation angle, zero where the terrain ahead
+ * is nowhere higher than the pixel.
+ *
+ * @param heightMap
+ * Is expected being an array with width*height elements.
+ *
+ * @param heightScale
+ * Pixels which a height difference of 1 corresponds to.
+ *
+ * @param horizonMap
+ * Is expected being an array with directionCount*width*height elements.
+ * Receives one plane per direction.
+ *
+ * @param wrap
+ * Horizons continue across the edges - useful when the image will be tiled.
+ * They then consider terrain up to one image size away.  Otherwise there
+ * is no terrain beyond the edges.
+ *
+ * @param pool
+ * Directions are swept concurrently on its threads.  May be `NULL`.
+ */
+void GenerateHorizonMap( int width,
+                         int height,
+                         const float * heightMap,
+                         float heightScale,
+                         int directionCount,
+                         bool wrap,
+                         float * horizonMap,
+                         ThreadPool * pool );
+
+/**
+ * Ambient occlusion of a flat surface below the horizons of
+ * #GenerateHorizonMap: the cosine weighted fraction of the sky which is
+ * visible, i.e. 1 - sin²(horizon) averaged over all directions.
+ *
+ * @param occlusionMap
+ * Is expected being an array with width*height elements.  1 is unoccluded.
+ */
+void GenerateAmbientOcclusionMap( int width,
+                                  int height,
+                                  int directionCount,
+                                  const float * horizonMap,
+                                  float * occlusionMap );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
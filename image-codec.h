@@ -0,0 +1,74 @@
+#ifndef __IMAGE_CODEC_H__
+#define __IMAGE_CODEC_H__
+
+#include <stdbool.h>
+#include "image.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum
+{
+    ImageSignatureSize = 16
+};
+
+/**
+ * Describes an image file format implementation.
+ *
+ * `ReadImage` and `WriteImage` dispatch to the first codec which recognizes
+ * the file signature (when reading) or the file extension.  Codecs without
+ * signature and extension list act as fallback for everything else.
+ */
+typedef struct
+{
+    const char * name;
+
+    /**
+     * `NULL` terminated list of lower case file extensions without dot.
+     */
+    const char * const * extensions;
+
+    /**
+     * Tests whether the first bytes of a file belong to this format.
+     * May be `NULL` if the format has no reliable signature.
+     */
+    bool (*probe)( const unsigned char * header, int headerSize );
+
+    Image * (*read)( const char * fileName );
+
+    /**
+     * May be `NULL` for formats which are only read.
+     */
+    bool (*write)( const Image * image, const char * fileName );
+
+    /**
+     * Reads only the header.  May be `NULL`, in which case the complete
+     * image is read.
+     */
+    bool (*readInfo)( const char * fileName, ImageInfo * info );
+
+    /**
+     * Reads only a part of the image.  May be `NULL`, in which case the
+     * complete image is read and cropped.
+     */
+    Image * (*readRegion)( const char * fileName,
+                           int x,
+                           int y,
+                           int width,
+                           int height );
+} ImageCodec;
+
+extern const ImageCodec PngCodec;
+extern const ImageCodec PfmCodec;
+extern const ImageCodec QoiCodec;
+extern const ImageCodec XcfCodec;
+#if defined(USE_OIIO)
+extern const ImageCodec OiioCodec;
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
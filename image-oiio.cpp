@@ -1,15 +1,106 @@
 #include <stdio.h> // fprintf
+#include <algorithm> // min
+#include <map> // map
+#include <memory> // unique_ptr
+#include <string> // string
+#include <pthread.h> // pthread_once, pthread_mutex_lock
+#include <sys/stat.h> // stat
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/imagecache.h>
 #include "image.h"
+#include "image-codec.h"
 
 
 
 OIIO_NAMESPACE_USING
 
+// Scanlines which are decoded or encoded per call.  Keeps the temporary
+// buffers of the plugins small, while still allowing them to work in parallel.
+static const int ScanlineChunkSize = 64;
 
-Image * ReadImage( const char * fileName )
+#if OIIO_VERSION >= 20000
+typedef ImageInput::unique_ptr InputHandle;
+typedef ImageOutput::unique_ptr OutputHandle;
+#else
+struct InputDeleter
 {
-    ImageInput * input = ImageInput::open(fileName);
+    void operator()( ImageInput * input ) const { ImageInput::destroy(input); }
+};
+
+struct OutputDeleter
+{
+    void operator()( ImageOutput * output ) const { ImageOutput::destroy(output); }
+};
+
+typedef std::unique_ptr<ImageInput, InputDeleter> InputHandle;
+typedef std::unique_ptr<ImageOutput, OutputDeleter> OutputHandle;
+#endif
+
+
+static void ApplyThreadSettings()
+{
+    OIIO::attribute("threads", GetImageThreads());
+}
+
+// The shared cache lives until the process exits.  Decode threads may ask
+// for it concurrently, so it's created only once:
+static ImageCache * Cache = NULL;
+static pthread_once_t CacheCreated = PTHREAD_ONCE_INIT;
+
+static void CreateImageCache()
+{
+    Cache = ImageCache::create(true);
+    Cache->attribute("autotile", 64); // Random access to untiled files.
+    Cache->attribute("forcefloat", 1);
+}
+
+static ImageCache * GetImageCache()
+{
+    pthread_once(&CacheCreated, CreateImageCache);
+    Cache->attribute("max_memory_MB", (float)GetImageCacheSize()); // Thread safe
+    return Cache;
+}
+
+// Files may change while the process runs, e.g. in watch or server mode.
+// The version of each file which the cache has seen is remembered, so its
+// tiles can be dropped once it differs.
+static std::map<std::string, struct stat> CachedFileVersions;
+static pthread_mutex_t CachedFileVersionsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool IsSameFileVersion( const struct stat & a, const struct stat & b )
+{
+    return a.st_size == b.st_size &&
+           a.st_ino  == b.st_ino  &&
+           a.st_mtim.tv_sec  == b.st_mtim.tv_sec &&
+           a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+static void InvalidateChangedFile( ImageCache * cache, const char * fileName )
+{
+    struct stat status;
+    if(stat(fileName, &status) != 0)
+        return; // The cache reports the error
+
+    pthread_mutex_lock(&CachedFileVersionsMutex);
+    std::map<std::string, struct stat>::iterator entry =
+        CachedFileVersions.find(fileName);
+    if(entry == CachedFileVersions.end())
+    {
+        CachedFileVersions[fileName] = status;
+    }
+    else if(!IsSameFileVersion(entry->second, status))
+    {
+        cache->invalidate(ustring(fileName));
+        entry->second = status;
+    }
+    pthread_mutex_unlock(&CachedFileVersionsMutex);
+}
+
+static Image * ReadOiioImage( const char * fileName )
+{
+    ApplyThreadSettings();
+
+    InputHandle input(ImageInput::open(fileName));
     if(!input)
     {
         fprintf(stderr,
@@ -21,23 +112,117 @@ Image * ReadImage( const char * fileName )
 
     const ImageSpec & spec = input->spec();
     Image * image = CreateImage(spec.width, spec.height, spec.nchannels);
-    if(!input->read_image(image->data))
+
+    const size_t rowLength = (size_t)spec.width*spec.nchannels;
+    for(int row = 0; row < spec.height; row += ScanlineChunkSize)
+    {
+        const int rowEnd = std::min(row+ScanlineChunkSize, spec.height);
+        if(!input->read_scanlines(spec.y + row,
+                                  spec.y + rowEnd,
+                                  spec.z,
+                                  0,
+                                  spec.nchannels,
+                                  TypeDesc::FLOAT,
+                                  &image->data[row*rowLength]))
+        {
+            fprintf(stderr,
+                    "'%s': %s\n",
+                    fileName,
+                    input->geterror().c_str());
+            input->close();
+            FreeImage(image);
+            return NULL;
+        }
+    }
+
+    input->close();
+    return image;
+}
+
+static bool ReadOiioImageInfo( const char * fileName, ImageInfo * info )
+{
+    // Opening an input only parses the header:
+    InputHandle input(ImageInput::open(fileName));
+    if(!input)
     {
         fprintf(stderr,
-                "'%s': %s",
+                "Could not open '%s' for reading: %s\n",
                 fileName,
-                input->geterror().c_str());
-        return NULL;
+                OpenImageIO::geterror().c_str());
+        return false;
     }
 
+    const ImageSpec & spec = input->spec();
+    info->width    = spec.width;
+    info->height   = spec.height;
+    info->channels = spec.nchannels;
+    info->bitDepth = (int)spec.format.size()*8;
     input->close();
+    return true;
+}
+
+static Image * ReadOiioImageRegion( const char * fileName,
+                                    int x,
+                                    int y,
+                                    int width,
+                                    int height )
+{
+    ApplyThreadSettings();
+
+    ImageCache * cache = GetImageCache();
+    InvalidateChangedFile(cache, fileName);
+    const ustring name(fileName);
+
+    ImageSpec spec;
+    if(!cache->get_imagespec(name, spec))
+    {
+        fprintf(stderr,
+                "Could not open '%s' for reading: %s\n",
+                fileName,
+                cache->geterror().c_str());
+        return NULL;
+    }
+
+    if(x < 0 || y < 0 || width <= 0 || height <= 0 ||
+       x+width  > spec.width ||
+       y+height > spec.height)
+    {
+        fprintf(stderr, "Region is outside of '%s'.\n", fileName);
+        return NULL;
+    }
+
+    Image * image = CreateImage(width, height, spec.nchannels);
+
+    // Only the tiles overlapping the region are decoded and they stay in the
+    // cache, so neighbouring regions can be read cheaply.
+    if(!cache->get_pixels(name,
+                          0, // subimage
+                          0, // miplevel
+                          spec.x + x,
+                          spec.x + x + width,
+                          spec.y + y,
+                          spec.y + y + height,
+                          spec.z,
+                          spec.z + 1,
+                          TypeDesc::FLOAT,
+                          image->data))
+    {
+        fprintf(stderr,
+                "'%s': %s\n",
+                fileName,
+                cache->geterror().c_str());
+        FreeImage(image);
+        return NULL;
+    }
 
     return image;
 }
 
-bool WriteImage( const Image * image, const char * fileName )
+static bool WriteOiioImage( const Image * image, const char * fileName )
 {
-    ImageOutput * output = ImageOutput::create(fileName);
+    ApplyThreadSettings();
+
+    OutputHandle output(ImageOutput::create(fileName));
     if(!output)
     {
         fprintf(stderr,
@@ -54,19 +239,51 @@ bool WriteImage( const Image * image, const char * fileName )
                 "Could not open '%s' for writing: %s\n",
                 fileName,
                 output->geterror().c_str());
-        output->close();
         return false;
     }
 
-    if(!output->write_image(TypeDesc::FLOAT, image->data))
+    // The plugin may have picked a different pixel format:
+    const ImageSpec & outputSpec = output->spec();
+
+    const size_t rowLength = (size_t)image->width*image->channels;
+    for(int row = 0; row < image->height; row += ScanlineChunkSize)
+    {
+        const int rowEnd = std::min(row+ScanlineChunkSize, image->height);
+        if(!output->write_scanlines(outputSpec.y + row,
+                                    outputSpec.y + rowEnd,
+                                    outputSpec.z,
+                                    TypeDesc::FLOAT,
+                                    &image->data[row*rowLength]))
+        {
+            fprintf(stderr,
+                    "Can't write '%s': %s\n",
+                    fileName,
+                    output->geterror().c_str());
+            output->close();
+            return false;
+        }
+    }
+
+    if(!output->close())
     {
         fprintf(stderr,
-                "Can't write material map: %s\n",
+                "Can't finish '%s': %s\n",
+                fileName,
                 output->geterror().c_str());
         return false;
     }
 
-    output->close();
-
     return true;
 }
+
+// Handles every format supported by OpenImageIO, so it's used as fallback.
+const ImageCodec OiioCodec =
+{
+    "oiio",
+    NULL,
+    NULL,
+    ReadOiioImage,
+    WriteOiioImage,
+    ReadOiioImageInfo,
+    ReadOiioImageRegion
+};
@@ -0,0 +1,181 @@
+#include <assert.h>
+#include <stdio.h> // fopen, fscanf, fread, fwrite, fprintf
+#include <string.h> // memcpy
+#include <stdint.h> // uint32_t, SIZE_MAX
+#include "image.h"
+#include "image-codec.h"
+
+// Portable float map: A minimal uncompressed float format.
+// See http://www.pauldebevec.com/Research/HDR/PFM/
+
+
+static bool IsLittleEndianHost()
+{
+    const uint32_t value = 1;
+    unsigned char bytes[4];
+    memcpy(bytes, &value, 4);
+    return bytes[0] == 1;
+}
+
+static void SwapBytes( float * values, size_t count )
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        uint32_t v;
+        memcpy(&v, &values[i], 4);
+        v = (v >> 24) |
+            ((v >> 8) & 0x0000FF00u) |
+            ((v << 8) & 0x00FF0000u) |
+            (v << 24);
+        memcpy(&values[i], &v, 4);
+    }
+}
+
+static bool ReadPfmHeader( FILE * file,
+                           const char * fileName,
+                           int * width,
+                           int * height,
+                           int * channels,
+                           float * scale )
+{
+    char type[3] = {0};
+    if(fscanf(file, "%2s %d %d %f", type, width, height, scale) != 4 ||
+       type[0] != 'P' ||
+       (type[1] != 'F' && type[1] != 'f') ||
+       *width <= 0 ||
+       *height <= 0 ||
+       (size_t)*height > SIZE_MAX / (sizeof(float)*3) / (size_t)*width || // Overflows
+       fgetc(file) == EOF) // Single whitespace character before the data.
+    {
+        fprintf(stderr, "'%s' is not a valid PFM file.\n", fileName);
+        return false;
+    }
+    *channels = (type[1] == 'F') ? 3 : 1;
+    return true;
+}
+
+static Image * ReadPfmImage( const char * fileName )
+{
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for reading.\n", fileName);
+        return NULL;
+    }
+
+    int width;
+    int height;
+    int channels;
+    float scale;
+    if(!ReadPfmHeader(file, fileName, &width, &height, &channels, &scale))
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    Image * image = CreateImage(width, height, channels);
+
+    // Rows are stored from bottom to top:
+    const size_t rowLength = (size_t)width*channels;
+    for(int y = height-1; y >= 0; y--)
+    {
+        float * row = &image->data[y*rowLength];
+        if(fread(row, sizeof(float), rowLength, file) != rowLength)
+        {
+            fprintf(stderr, "'%s' is truncated.\n", fileName);
+            FreeImage(image);
+            fclose(file);
+            return NULL;
+        }
+    }
+    fclose(file);
+
+    const bool littleEndianFile = scale < 0;
+    if(littleEndianFile != IsLittleEndianHost())
+        SwapBytes(image->data, (size_t)width*height*channels);
+
+    return image;
+}
+
+static bool ReadPfmImageInfo( const char * fileName, ImageInfo * info )
+{
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for reading.\n", fileName);
+        return false;
+    }
+
+    float scale;
+    const bool success = ReadPfmHeader(file,
+                                       fileName,
+                                       &info->width,
+                                       &info->height,
+                                       &info->channels,
+                                       &scale);
+    info->bitDepth = 32;
+    fclose(file);
+    return success;
+}
+
+static bool WritePfmImage( const Image * image, const char * fileName )
+{
+    if(image->channels != 1 && image->channels != 3)
+    {
+        fprintf(stderr,
+                "Can't write %d channels to '%s': PFM supports 1 or 3 channels.\n",
+                image->channels,
+                fileName);
+        return false;
+    }
+
+    FILE * file = fopen(fileName, "wb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for writing.\n", fileName);
+        return false;
+    }
+
+    fprintf(file,
+            "%s\n%d %d\n%s\n",
+            (image->channels == 3) ? "PF" : "Pf",
+            image->width,
+            image->height,
+            IsLittleEndianHost() ? "-1.0" : "1.0");
+
+    const size_t rowLength = (size_t)image->width*image->channels;
+    for(int y = image->height-1; y >= 0; y--)
+    {
+        const float * row = &image->data[y*rowLength];
+        if(fwrite(row, sizeof(float), rowLength, file) != rowLength)
+        {
+            fprintf(stderr, "Could not write '%s'.\n", fileName);
+            fclose(file);
+            return false;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool ProbePfmImage( const unsigned char * header, int headerSize )
+{
+    return headerSize >= 3 &&
+           header[0] == 'P' &&
+           (header[1] == 'F' || header[1] == 'f') &&
+           (header[2] == '\n' || header[2] == '\r' || header[2] == ' ');
+}
+
+static const char * const PfmExtensions[] = { "pfm", NULL };
+
+const ImageCodec PfmCodec =
+{
+    "pfm",
+    PfmExtensions,
+    ProbePfmImage,
+    ReadPfmImage,
+    WritePfmImage,
+    ReadPfmImageInfo,
+    NULL
+};
@@ -1,13 +1,32 @@
 #include <assert.h>
 #include <stdio.h> // fprintf
 #include <setjmp.h> // setjmp
-#include <string.h> // memset
-#include <stdlib.h> // malloc, free, abort
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcmp
 #include <png.h>
 #include "image.h"
+#include "image-codec.h"
+#include "pixelformat.h"
 
 
-Image * ReadImage( const char * fileName )
+static bool IsLittleEndianHost()
+{
+    const uint16_t value = 1;
+    return *(const uint8_t *)&value == 1;
+}
+
+static void ConvertSamples( png_const_bytep source,
+                            int bitDepth,
+                            float * destination,
+                            size_t count )
+{
+    if(bitDepth == 16)
+        ConvertU16ToFloat((const uint16_t *)source, destination, count);
+    else
+        ConvertU8ToFloat(source, destination, count);
+}
+
+static Image * ReadPngImage( const char * fileName )
 {
     FILE * file = fopen(fileName, "rb");
     if(!file)
@@ -31,8 +50,23 @@ Image * ReadImage( const char * fileName )
     png_infop info = png_create_info_struct(png);
     assert(info);
 
+    // Released when libpng reports an error, which jumps back here.  They
+    // are volatile, since they change after setjmp.
+    Image * volatile image = NULL;
+    png_bytep volatile buffer = NULL;
+    png_bytep * volatile rowPointers = NULL;
+
     if(setjmp(png_jmpbuf(png)))
-        abort();
+    {
+        fprintf(stderr, "Could not decode '%s'.\n", fileName);
+        png_destroy_read_struct(&png, &info, NULL);
+        fclose(file);
+        free(rowPointers);
+        free(buffer);
+        if(image)
+            FreeImage(image);
+        return NULL;
+    }
 
     png_init_io(png, file);
 
@@ -50,96 +84,70 @@ Image * ReadImage( const char * fileName )
     if(colorType == PNG_COLOR_TYPE_PALETTE)
         png_set_palette_to_rgb(png);
 
-    // Ensure that the image has 8 bit:
-    if(bitDepth == 16)
-        png_set_strip_16(png);
+    // Ensure that the image has 8 or 16 bit:
     if(colorType == PNG_COLOR_TYPE_GRAY && bitDepth < 8)
         png_set_expand_gray_1_2_4_to_8(png);
 
+    // PNG stores 16 bit samples in big endian:
+    if(bitDepth == 16 && IsLittleEndianHost())
+        png_set_swap(png);
+
     if(png_get_valid(png, info, PNG_INFO_tRNS))
         png_set_tRNS_to_alpha(png);
 
-    png_read_update_info(png, info);
+    const int passes = png_set_interlace_handling(png);
 
-    png_bytep * rowPointers = (png_bytep *)malloc(sizeof(png_bytep) * height);
-    for(int y = 0; y < height; y++)
-        rowPointers[y] = (png_byte*)malloc(png_get_rowbytes(png, info));
+    png_read_update_info(png, info);
 
-    png_read_image(png, rowPointers);
+    const int channels = png_get_channels(png, info);
+    const int depth = png_get_bit_depth(png, info);
+    const size_t rowBytes = png_get_rowbytes(png, info);
+    const size_t rowSamples = (size_t)width*channels;
+    assert(rowBytes == rowSamples*(depth/8));
 
-    fclose(file);
+    image = CreateImage(width, height, channels);
 
-    // ---------------------------------------------------------------------
+    // Interlaced images need to be decoded completely before the rows are
+    // usable, others are converted row by row.
+    const int bufferRows = (passes > 1) ? height : 1;
+    buffer = (png_bytep)malloc(rowBytes*bufferRows);
 
-    Image * image = (Image *)malloc(sizeof(Image));
-    memset(image, 0, sizeof(Image));
-    image->width  = width;
-    image->height = height;
-    switch(colorType)
+    if(passes > 1)
     {
-        case PNG_COLOR_TYPE_GRAY:
-            image->channels = 1;
-            break;
-
-        case PNG_COLOR_TYPE_GRAY_ALPHA:
-            image->channels = 2;
-            break;
-
-        case PNG_COLOR_TYPE_RGB:
-            image->channels = 3;
-            break;
-
-        case PNG_COLOR_TYPE_RGB_ALPHA:
-            image->channels = 4;
-            break;
-
-        case PNG_COLOR_TYPE_PALETTE:
-            image->channels = 3;
-            int transparency = 0;
-            png_get_tRNS(png, info, NULL, &transparency, NULL);
-            if(transparency > 0)
-                image->channels++;
-            break;
-
-        default:
-            assert(!"Unknown color type.");
+        rowPointers = (png_bytep *)malloc(sizeof(png_bytep) * height);
+        for(int y = 0; y < height; y++)
+            rowPointers[y] = &buffer[y*rowBytes];
+        png_read_image(png, rowPointers);
+        free(rowPointers);
+        rowPointers = NULL;
+
+        ConvertSamples(buffer, depth, image->data, rowSamples*height);
     }
-
-    const int channels = image->channels;
-    assert(png_get_rowbytes(png, info) == width*channels);
-    image->data = (float *)malloc(sizeof(float)*width*height*channels);
-
-    for(int y = 0; y < height; y++)
+    else
     {
-        const png_bytep row = rowPointers[y];
-        for(int x = 0; x < width;  x++)
+        for(int y = 0; y < height; y++)
         {
-            float * dstPixel = &image->data[y*width*channels + x*channels];
-            const png_bytep srcPixel = &row[x*channels];
-            for(int i = 0; i < channels; i++)
-            {
-                dstPixel[i] = (float)srcPixel[i] / 255.f;
-            }
+            png_read_row(png, buffer, NULL);
+            ConvertSamples(buffer, depth, &image->data[y*rowSamples], rowSamples);
         }
     }
 
-    for(int y = 0; y < height; y++)
-        free(rowPointers[y]);
-    free(rowPointers);
+    png_read_end(png, NULL);
+    png_destroy_read_struct(&png, &info, NULL);
+    fclose(file);
+    free(buffer);
 
     return image;
 }
 
 
-bool WriteImage( const Image * image, const char * fileName )
+static bool WritePngImage( const Image * image, const char * fileName )
 {
-    int y;
-
     FILE * file = fopen(fileName, "wb");
     if(!file)
     {
         fprintf(stderr, "Could not open '%s' for writing.\n", fileName);
-        return NULL;
+        return false;
     }
 
     png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
@@ -148,8 +156,16 @@ bool WriteImage( const Image * image, const char * fileName )
     png_infop info = png_create_info_struct(png);
     assert(info);
 
+    png_bytep volatile row = NULL; // Changes after setjmp
+
     if(setjmp(png_jmpbuf(png)))
-        abort();
+    {
+        fprintf(stderr, "Could not encode '%s'.\n", fileName);
+        png_destroy_write_struct(&png, &info);
+        fclose(file);
+        free(row);
+        return false;
+    }
 
     png_init_io(png, file);
 
@@ -180,25 +196,6 @@ bool WriteImage( const Image * image, const char * fileName )
             assert(!"Unsupported channel count.");
     }
 
-    png_bytep * rowPointers = (png_bytep *)malloc(sizeof(png_bytep) * height);
-    for(int y = 0; y < height; y++)
-    {
-        rowPointers[y] = (png_bytep)malloc(sizeof(png_byte)*width*height*channels);
-        png_bytep row = rowPointers[y];
-        for(int x = 0; x < width; x++)
-        {
-            const png_bytep dstPixel = &row[x*channels];
-            const float * srcPixel = &image->data[y*width*channels + x*channels];
-            for(int i = 0; i < channels; i++)
-            {
-                int value = srcPixel[i] * 255.f;
-                if(value > 255)    value = 255;
-                else if(value < 0) value = 0;
-                dstPixel[i] = value;
-            }
-        }
-    }
-
     png_set_IHDR(png,
                  info,
                  width,
@@ -210,13 +207,109 @@ bool WriteImage( const Image * image, const char * fileName )
                  PNG_FILTER_TYPE_DEFAULT);
     png_write_info(png, info);
 
-    png_write_image(png, rowPointers);
+    const size_t rowSamples = (size_t)width*channels;
+    row = (png_bytep)malloc(sizeof(png_byte)*rowSamples);
+    for(int y = 0; y < height; y++)
+    {
+        ConvertFloatToU8(&image->data[y*rowSamples], row, rowSamples);
+        png_write_row(png, row);
+    }
+    free(row);
+    row = NULL;
+
     png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
 
-    for(int y = 0; y < height; y++)
-        free(rowPointers[y]);
-    free(rowPointers);
+    fclose(file);
+    return true;
+}
+
+static png_uint_32 ReadBigEndianU32( const png_byte * bytes )
+{
+    return ((png_uint_32)bytes[0] << 24) |
+           ((png_uint_32)bytes[1] << 16) |
+           ((png_uint_32)bytes[2] <<  8) |
+            (png_uint_32)bytes[3];
+}
+
+static bool ReadPngImageInfo( const char * fileName, ImageInfo * info )
+{
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for reading.\n", fileName);
+        return false;
+    }
 
+    // Signature, IHDR chunk length, type and data:
+    png_byte header[8 + 8 + 13];
+    if(fread(header, 1, sizeof(header), file) != sizeof(header) ||
+       png_sig_cmp(header, 0, 8) != 0 ||
+       memcmp(&header[12], "IHDR", 4) != 0)
+    {
+        fprintf(stderr, "'%s' is not a valid PNG file.\n", fileName);
+        fclose(file);
+        return false;
+    }
+
+    const int colorType = header[25];
+    int channels;
+    switch(colorType)
+    {
+        case PNG_COLOR_TYPE_GRAY:       channels = 1; break;
+        case PNG_COLOR_TYPE_GRAY_ALPHA: channels = 2; break;
+        case PNG_COLOR_TYPE_RGB:        channels = 3; break;
+        case PNG_COLOR_TYPE_RGB_ALPHA:  channels = 4; break;
+        case PNG_COLOR_TYPE_PALETTE:    channels = 3; break;
+        default:
+            fprintf(stderr, "'%s' has an unknown color type.\n", fileName);
+            fclose(file);
+            return false;
+    }
+
+    // A tRNS chunk adds an alpha channel.  It must appear before the image
+    // data, so only the chunk headers up to IDAT need to be visited.
+    if(!(colorType & PNG_COLOR_MASK_ALPHA) &&
+       fseek(file, 4, SEEK_CUR) == 0) // IHDR CRC
+    {
+        png_byte chunk[8];
+        while(fread(chunk, 1, sizeof(chunk), file) == sizeof(chunk))
+        {
+            if(memcmp(&chunk[4], "tRNS", 4) == 0)
+            {
+                channels++;
+                break;
+            }
+            if(memcmp(&chunk[4], "IDAT", 4) == 0 ||
+               memcmp(&chunk[4], "IEND", 4) == 0)
+                break;
+            if(fseek(file, (long)ReadBigEndianU32(chunk) + 4, SEEK_CUR) != 0)
+                break;
+        }
+    }
     fclose(file);
+
+    info->width    = (int)ReadBigEndianU32(&header[16]);
+    info->height   = (int)ReadBigEndianU32(&header[20]);
+    info->channels = channels;
+    info->bitDepth = header[24];
     return true;
 }
+
+static bool ProbePngImage( const unsigned char * header, int headerSize )
+{
+    return headerSize >= 8 && png_sig_cmp((png_const_bytep)header, 0, 8) == 0;
+}
+
+static const char * const PngExtensions[] = { "png", NULL };
+
+const ImageCodec PngCodec =
+{
+    "png",
+    PngExtensions,
+    ProbePngImage,
+    ReadPngImage,
+    WritePngImage,
+    ReadPngImageInfo,
+    NULL
+};
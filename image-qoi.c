@@ -0,0 +1,393 @@
+#include <assert.h>
+#include <stdio.h> // fopen, fread, fwrite, fprintf
+#include <string.h> // memset, memcmp
+#include <stdlib.h> // malloc, free
+#include <stdint.h> // SIZE_MAX
+#include "image.h"
+#include "image-codec.h"
+#include "pixelformat.h"
+
+// Quite OK Image format: Fast lossless RGB(A) compression.
+// See https://qoiformat.org/qoi-specification.pdf
+
+
+enum
+{
+    QoiHeaderSize = 14,
+    QoiPaddingSize = 8,
+
+    QoiOpIndex = 0x00,
+    QoiOpDiff  = 0x40,
+    QoiOpLuma  = 0x80,
+    QoiOpRun   = 0xc0,
+    QoiOpRgb   = 0xfe,
+    QoiOpRgba  = 0xff,
+    QoiMask2   = 0xc0
+};
+
+static const unsigned char QoiMagic[4] = { 'q', 'o', 'i', 'f' };
+static const unsigned char QoiPadding[QoiPaddingSize] = { 0,0,0,0,0,0,0,1 };
+
+typedef struct
+{
+    unsigned char r, g, b, a;
+} QoiPixel;
+
+static int QoiHash( QoiPixel p )
+{
+    return (p.r*3 + p.g*5 + p.b*7 + p.a*11) % 64;
+}
+
+static bool QoiPixelEquals( QoiPixel a, QoiPixel b )
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static unsigned int ReadU32( const unsigned char * bytes )
+{
+    return ((unsigned int)bytes[0] << 24) |
+           ((unsigned int)bytes[1] << 16) |
+           ((unsigned int)bytes[2] <<  8) |
+            (unsigned int)bytes[3];
+}
+
+static void WriteU32( unsigned char * bytes, unsigned int value )
+{
+    bytes[0] = (value >> 24) & 0xff;
+    bytes[1] = (value >> 16) & 0xff;
+    bytes[2] = (value >>  8) & 0xff;
+    bytes[3] =  value        & 0xff;
+}
+
+static bool ParseQoiHeader( const unsigned char * bytes,
+                            long size,
+                            const char * fileName,
+                            ImageInfo * info )
+{
+    if(size < QoiHeaderSize ||
+       memcmp(bytes, QoiMagic, 4) != 0 ||
+       (bytes[12] != 3 && bytes[12] != 4))
+    {
+        fprintf(stderr, "'%s' is not a valid QOI file.\n", fileName);
+        return false;
+    }
+
+    info->width    = (int)ReadU32(&bytes[4]);
+    info->height   = (int)ReadU32(&bytes[8]);
+    info->channels = bytes[12];
+    info->bitDepth = 8;
+    // The float image must be addressable:
+    if(info->width <= 0 ||
+       info->height <= 0 ||
+       (size_t)info->height > SIZE_MAX / sizeof(float) / info->channels / (size_t)info->width)
+    {
+        fprintf(stderr, "'%s' has invalid dimensions.\n", fileName);
+        return false;
+    }
+    return true;
+}
+
+static unsigned char * ReadWholeFile( const char * fileName, long * size )
+{
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char * buffer = (unsigned char *)malloc(*size > 0 ? *size : 1);
+    if(fread(buffer, 1, *size, file) != (size_t)*size)
+    {
+        free(buffer);
+        buffer = NULL;
+    }
+    fclose(file);
+    return buffer;
+}
+
+static Image * ReadQoiImage( const char * fileName )
+{
+    long size = 0;
+    unsigned char * bytes = ReadWholeFile(fileName, &size);
+    if(!bytes)
+    {
+        fprintf(stderr, "Could not open '%s' for reading.\n", fileName);
+        return NULL;
+    }
+
+    ImageInfo info;
+    if(!ParseQoiHeader(bytes, size - QoiPaddingSize, fileName, &info))
+    {
+        free(bytes);
+        return NULL;
+    }
+
+    const int width    = info.width;
+    const int height   = info.height;
+    const int channels = info.channels;
+
+    const size_t samples = (size_t)width*height*channels;
+    unsigned char * pixelBytes = (unsigned char *)malloc(samples);
+    if(!pixelBytes)
+    {
+        fprintf(stderr, "'%s' is too large.\n", fileName);
+        free(bytes);
+        return NULL;
+    }
+
+    QoiPixel index[64];
+    memset(index, 0, sizeof(index));
+    QoiPixel px = { 0, 0, 0, 255 };
+
+    const long chunksEnd = size - QoiPaddingSize;
+    long p = QoiHeaderSize;
+    int run = 0;
+    const size_t pixels = (size_t)width*height;
+    for(size_t i = 0; i < pixels; i++)
+    {
+        if(run > 0)
+        {
+            run--;
+        }
+        else if(p < chunksEnd)
+        {
+            const int b1 = bytes[p++];
+            if(b1 == QoiOpRgb)
+            {
+                px.r = bytes[p++];
+                px.g = bytes[p++];
+                px.b = bytes[p++];
+            }
+            else if(b1 == QoiOpRgba)
+            {
+                px.r = bytes[p++];
+                px.g = bytes[p++];
+                px.b = bytes[p++];
+                px.a = bytes[p++];
+            }
+            else if((b1 & QoiMask2) == QoiOpIndex)
+            {
+                px = index[b1];
+            }
+            else if((b1 & QoiMask2) == QoiOpDiff)
+            {
+                px.r += ((b1 >> 4) & 0x03) - 2;
+                px.g += ((b1 >> 2) & 0x03) - 2;
+                px.b += ( b1       & 0x03) - 2;
+            }
+            else if((b1 & QoiMask2) == QoiOpLuma)
+            {
+                const int b2 = bytes[p++];
+                const int vg = (b1 & 0x3f) - 32;
+                px.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                px.g += vg;
+                px.b += vg - 8 +  (b2       & 0x0f);
+            }
+            else // QoiOpRun
+            {
+                run = b1 & 0x3f;
+            }
+            index[QoiHash(px)] = px;
+        }
+
+        unsigned char * dst = &pixelBytes[i*channels];
+        dst[0] = px.r;
+        dst[1] = px.g;
+        dst[2] = px.b;
+        if(channels == 4)
+            dst[3] = px.a;
+    }
+    free(bytes);
+
+    Image * image = CreateImage(width, height, channels);
+    ConvertU8ToFloat(pixelBytes, image->data, samples);
+    free(pixelBytes);
+    return image;
+}
+
+static bool ReadQoiImageInfo( const char * fileName, ImageInfo * info )
+{
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for reading.\n", fileName);
+        return false;
+    }
+
+    unsigned char header[QoiHeaderSize];
+    const long size = (long)fread(header, 1, sizeof(header), file);
+    fclose(file);
+    return ParseQoiHeader(header, size, fileName, info);
+}
+
+static QoiPixel GetPixel( const unsigned char * pixelBytes, int channels, size_t i )
+{
+    const unsigned char * src = &pixelBytes[i*channels];
+    QoiPixel px;
+    switch(channels)
+    {
+        case 1:
+            px.r = px.g = px.b = src[0];
+            px.a = 255;
+            break;
+
+        case 2:
+            px.r = px.g = px.b = src[0];
+            px.a = src[1];
+            break;
+
+        case 3:
+            px.r = src[0];
+            px.g = src[1];
+            px.b = src[2];
+            px.a = 255;
+            break;
+
+        default:
+            px.r = src[0];
+            px.g = src[1];
+            px.b = src[2];
+            px.a = src[3];
+    }
+    return px;
+}
+
+static bool WriteQoiImage( const Image * image, const char * fileName )
+{
+    // Gray images are stored as RGB(A), as QOI has no gray formats.
+    const int channels = (image->channels == 2 || image->channels == 4) ? 4 : 3;
+    const size_t pixels = (size_t)image->width*image->height;
+    const size_t maxSize = QoiHeaderSize +
+                           pixels*(channels+1) +
+                           QoiPaddingSize;
+    unsigned char * bytes = (unsigned char *)malloc(maxSize);
+
+    const size_t samples = pixels*image->channels;
+    unsigned char * pixelBytes = (unsigned char *)malloc(samples);
+    ConvertFloatToU8(image->data, pixelBytes, samples);
+
+    memcpy(bytes, QoiMagic, 4);
+    WriteU32(&bytes[4], image->width);
+    WriteU32(&bytes[8], image->height);
+    bytes[12] = channels;
+    bytes[13] = 0; // sRGB with linear alpha
+
+    QoiPixel index[64];
+    memset(index, 0, sizeof(index));
+    QoiPixel prev = { 0, 0, 0, 255 };
+
+    size_t p = QoiHeaderSize;
+    int run = 0;
+    for(size_t i = 0; i < pixels; i++)
+    {
+        const QoiPixel px = GetPixel(pixelBytes, image->channels, i);
+
+        if(QoiPixelEquals(px, prev))
+        {
+            run++;
+            if(run == 62 || i == pixels-1)
+            {
+                bytes[p++] = QoiOpRun | (run-1);
+                run = 0;
+            }
+            continue;
+        }
+
+        if(run > 0)
+        {
+            bytes[p++] = QoiOpRun | (run-1);
+            run = 0;
+        }
+
+        const int hash = QoiHash(px);
+        if(QoiPixelEquals(index[hash], px))
+        {
+            bytes[p++] = QoiOpIndex | hash;
+        }
+        else
+        {
+            index[hash] = px;
+
+            if(px.a == prev.a)
+            {
+                const signed char vr = px.r - prev.r;
+                const signed char vg = px.g - prev.g;
+                const signed char vb = px.b - prev.b;
+                const signed char vgr = vr - vg;
+                const signed char vgb = vb - vg;
+
+                if(vr > -3 && vr < 2 &&
+                   vg > -3 && vg < 2 &&
+                   vb > -3 && vb < 2)
+                {
+                    bytes[p++] = QoiOpDiff | (vr+2) << 4 | (vg+2) << 2 | (vb+2);
+                }
+                else if(vgr > -9 && vgr < 8 &&
+                        vg > -33 && vg < 32 &&
+                        vgb > -9 && vgb < 8)
+                {
+                    bytes[p++] = QoiOpLuma | (vg+32);
+                    bytes[p++] = (vgr+8) << 4 | (vgb+8);
+                }
+                else
+                {
+                    bytes[p++] = QoiOpRgb;
+                    bytes[p++] = px.r;
+                    bytes[p++] = px.g;
+                    bytes[p++] = px.b;
+                }
+            }
+            else
+            {
+                bytes[p++] = QoiOpRgba;
+                bytes[p++] = px.r;
+                bytes[p++] = px.g;
+                bytes[p++] = px.b;
+                bytes[p++] = px.a;
+            }
+        }
+        prev = px;
+    }
+
+    free(pixelBytes);
+
+    memcpy(&bytes[p], QoiPadding, QoiPaddingSize);
+    p += QoiPaddingSize;
+    assert(p <= maxSize);
+
+    FILE * file = fopen(fileName, "wb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for writing.\n", fileName);
+        free(bytes);
+        return false;
+    }
+
+    const bool success = fwrite(bytes, 1, p, file) == p;
+    if(!success)
+        fprintf(stderr, "Could not write '%s'.\n", fileName);
+
+    fclose(file);
+    free(bytes);
+    return success;
+}
+
+static bool ProbeQoiImage( const unsigned char * header, int headerSize )
+{
+    return headerSize >= 4 && memcmp(header, QoiMagic, 4) == 0;
+}
+
+static const char * const QoiExtensions[] = { "qoi", NULL };
+
+const ImageCodec QoiCodec =
+{
+    "qoi",
+    QoiExtensions,
+    ProbeQoiImage,
+    ReadQoiImage,
+    WriteQoiImage,
+    ReadQoiImageInfo,
+    NULL
+};
@@ -0,0 +1,1109 @@
+#include <math.h> // fabsf, ldexpf
+#include <stdio.h> // fopen, fread, fprintf
+#include <string.h> // memset, memcpy, memcmp
+#include <stdlib.h> // malloc, calloc, free, atoi
+#include <stdint.h> // uint32_t, uint64_t
+#include <zlib.h> // inflate
+#include "image.h"
+#include "image-codec.h"
+#include "threadpool.h"
+
+// Native file format of GIMP.  Only reading is supported: the visible
+// layers are flattened like "Merge Visible Layers" would.
+// See https://testing.developer.gimp.org/core/standards/xcf/
+
+
+enum
+{
+    XcfTileSize = 64,
+    XcfBandHeight = 64, // Rows which are composited by one task
+
+    XcfRgb = 0,
+    XcfGray = 1,
+    XcfIndexed = 2,
+
+    XcfCompressionNone = 0,
+    XcfCompressionRle  = 1,
+    XcfCompressionZlib = 2,
+
+    XcfPropEnd          = 0,
+    XcfPropColormap     = 1,
+    XcfPropOpacity      = 6,
+    XcfPropMode         = 7,
+    XcfPropVisible      = 8,
+    XcfPropApplyMask    = 11,
+    XcfPropOffsets      = 15,
+    XcfPropCompression  = 17,
+    XcfPropGroupItem    = 29,
+    XcfPropItemPath     = 30,
+    XcfPropFloatOpacity = 33
+};
+
+typedef enum
+{
+    XcfU8,
+    XcfU16,
+    XcfU32,
+    XcfHalf,
+    XcfFloat,
+    XcfDouble
+} XcfComponentType;
+
+/**
+ * Values of GimpLayerMode.  Legacy and current modes share the same blend
+ * function here.
+ */
+typedef enum
+{
+    XcfNormal,
+    XcfMultiply,
+    XcfScreen,
+    XcfOverlay,
+    XcfDifference,
+    XcfAddition,
+    XcfSubtract,
+    XcfDarkenOnly,
+    XcfLightenOnly,
+    XcfDivide,
+    XcfDodge,
+    XcfBurn,
+    XcfHardLight,
+    XcfSoftLight,
+    XcfGrainExtract,
+    XcfGrainMerge,
+    XcfPassThrough // Groups only
+} XcfBlendMode;
+
+typedef struct
+{
+    int width;
+    int height;
+    int type; // RGB, RGBA, gray, gray alpha, indexed, indexed alpha
+    int x;
+    int y;
+    bool visible;
+    float opacity;
+    XcfBlendMode mode;
+    bool group;
+    int depth; // Nesting level within groups
+    bool applyMask;
+    uint64_t hierarchy;
+    uint64_t mask; // 0 if the layer has none
+
+    float * pixels; // RGBA, `NULL` for groups
+    float * maskPixels;
+    bool failed;
+} XcfLayer;
+
+typedef struct
+{
+    const unsigned char * data;
+    size_t size;
+    const char * fileName;
+
+    int version;
+    int width;
+    int height;
+    int baseType;
+    XcfComponentType componentType;
+    int componentSize;
+    int compression;
+    unsigned char colormap[256*3];
+
+    XcfLayer * layers; // From top to bottom
+    int layerCount;
+} XcfFile;
+
+typedef struct
+{
+    const XcfFile * file;
+    size_t position;
+    bool failed;
+} XcfReader;
+
+
+// --- Reading primitives ---
+
+static void InitReader( XcfReader * reader, const XcfFile * file, uint64_t position )
+{
+    reader->file = file;
+    reader->position = (size_t)position;
+    reader->failed = position > file->size;
+}
+
+static const unsigned char * ReadBytes( XcfReader * reader, size_t count )
+{
+    if(reader->failed || count > reader->file->size - reader->position)
+    {
+        reader->failed = true;
+        return NULL;
+    }
+    const unsigned char * bytes = &reader->file->data[reader->position];
+    reader->position += count;
+    return bytes;
+}
+
+static uint32_t ReadU32( XcfReader * reader )
+{
+    const unsigned char * b = ReadBytes(reader, 4);
+    if(!b)
+        return 0;
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+           ((uint32_t)b[2] <<  8) |  (uint32_t)b[3];
+}
+
+static float ReadFloat( XcfReader * reader )
+{
+    const uint32_t bits = ReadU32(reader);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * Offsets are 64 bit since version 11.
+ */
+static uint64_t ReadPointer( XcfReader * reader )
+{
+    if(reader->file->version < 11)
+        return ReadU32(reader);
+    const uint64_t high = ReadU32(reader);
+    return (high << 32) | ReadU32(reader);
+}
+
+static void SkipString( XcfReader * reader )
+{
+    ReadBytes(reader, ReadU32(reader));
+}
+
+
+// --- Structure ---
+
+static XcfBlendMode GetBlendMode( uint32_t mode )
+{
+    switch(mode)
+    {
+        case 3:  case 30: return XcfMultiply;
+        case 4:  case 31: return XcfScreen;
+        case 5:  case 23: return XcfOverlay;
+        case 6:  case 32: return XcfDifference;
+        case 7:  case 33: return XcfAddition;
+        case 8:  case 34: return XcfSubtract;
+        case 9:  case 35: return XcfDarkenOnly;
+        case 10: case 36: return XcfLightenOnly;
+        case 15: case 41: return XcfDivide;
+        case 16: case 42: return XcfDodge;
+        case 17: case 43: return XcfBurn;
+        case 18: case 44: return XcfHardLight;
+        case 19: case 45: return XcfSoftLight;
+        case 20: case 46: return XcfGrainExtract;
+        case 21: case 47: return XcfGrainMerge;
+        case 61:          return XcfPassThrough;
+        default: return XcfNormal; // Including dissolve
+    }
+}
+
+static bool ParseHeader( XcfFile * file )
+{
+    static const char Magic[] = "gimp xcf ";
+    if(file->size < 14 || memcmp(file->data, Magic, 9) != 0)
+    {
+        fprintf(stderr, "'%s' is not a valid XCF file.\n", file->fileName);
+        return false;
+    }
+
+    const char * version = (const char *)&file->data[9];
+    if(memcmp(version, "file", 4) == 0)
+        file->version = 0;
+    else if(version[0] == 'v')
+        file->version = atoi(&version[1]);
+    else
+        return false;
+
+    XcfReader reader;
+    InitReader(&reader, file, 14);
+    file->width    = (int)ReadU32(&reader);
+    file->height   = (int)ReadU32(&reader);
+    file->baseType = (int)ReadU32(&reader);
+
+    uint32_t precision = 150; // 8 bit gamma
+    if(file->version >= 4)
+        precision = ReadU32(&reader);
+    if(file->version >= 4 && file->version < 7)
+    {
+        static const uint32_t OldPrecisions[] = {150, 250, 350, 550, 650};
+        precision = (precision < 5) ? OldPrecisions[precision] : 0;
+    }
+
+    switch(precision / 100)
+    {
+        case 1: file->componentType = XcfU8;     file->componentSize = 1; break;
+        case 2: file->componentType = XcfU16;    file->componentSize = 2; break;
+        case 3: file->componentType = XcfU32;    file->componentSize = 4; break;
+        case 5: file->componentType = XcfHalf;   file->componentSize = 2; break;
+        case 6: file->componentType = XcfFloat;  file->componentSize = 4; break;
+        case 7: file->componentType = XcfDouble; file->componentSize = 8; break;
+        default:
+            fprintf(stderr, "'%s' has an unsupported precision.\n", file->fileName);
+            return false;
+    }
+
+    if(reader.failed || file->width <= 0 || file->height <= 0 ||
+       file->baseType < XcfRgb || file->baseType > XcfIndexed)
+    {
+        fprintf(stderr, "'%s' has an invalid header.\n", file->fileName);
+        return false;
+    }
+
+    // Image properties:
+    file->compression = XcfCompressionRle;
+    for(;;)
+    {
+        const uint32_t type = ReadU32(&reader);
+        const uint32_t length = ReadU32(&reader);
+        if(reader.failed || type == XcfPropEnd)
+            break;
+
+        const size_t end = reader.position + length;
+        if(type == XcfPropCompression)
+        {
+            const unsigned char * value = ReadBytes(&reader, 1);
+            file->compression = value ? value[0] : 0;
+        }
+        else if(type == XcfPropColormap)
+        {
+            // Old versions wrote a wrong length, so the count is trusted:
+            uint32_t colors = ReadU32(&reader);
+            if(colors > 256)
+                colors = 256;
+            const unsigned char * colormap = ReadBytes(&reader, colors*3);
+            if(colormap)
+                memcpy(file->colormap, colormap, colors*3);
+            continue;
+        }
+        reader.position = end;
+    }
+
+    if(file->compression > XcfCompressionZlib)
+    {
+        fprintf(stderr, "'%s' uses an unsupported compression.\n", file->fileName);
+        return false;
+    }
+
+    // Layers, from top to bottom:
+    for(;;)
+    {
+        const uint64_t offset = ReadPointer(&reader);
+        if(reader.failed || offset == 0)
+            break;
+
+        file->layers = (XcfLayer *)realloc(file->layers,
+                                           sizeof(XcfLayer)*(file->layerCount+1));
+        XcfLayer * layer = &file->layers[file->layerCount++];
+        memset(layer, 0, sizeof(XcfLayer));
+        layer->visible = true;
+        layer->opacity = 1;
+        layer->applyMask = true;
+
+        XcfReader layerReader;
+        InitReader(&layerReader, file, offset);
+        layer->width  = (int)ReadU32(&layerReader);
+        layer->height = (int)ReadU32(&layerReader);
+        layer->type   = (int)ReadU32(&layerReader);
+        SkipString(&layerReader);
+
+        for(;;)
+        {
+            const uint32_t type = ReadU32(&layerReader);
+            const uint32_t length = ReadU32(&layerReader);
+            if(layerReader.failed || type == XcfPropEnd)
+                break;
+
+            const size_t end = layerReader.position + length;
+            switch(type)
+            {
+                case XcfPropVisible:
+                    layer->visible = ReadU32(&layerReader) != 0;
+                    break;
+                case XcfPropOpacity:
+                    layer->opacity = ReadU32(&layerReader) / 255.0f;
+                    break;
+                case XcfPropFloatOpacity:
+                    layer->opacity = ReadFloat(&layerReader);
+                    break;
+                case XcfPropMode:
+                    layer->mode = GetBlendMode(ReadU32(&layerReader));
+                    break;
+                case XcfPropApplyMask:
+                    layer->applyMask = ReadU32(&layerReader) != 0;
+                    break;
+                case XcfPropOffsets:
+                    layer->x = (int32_t)ReadU32(&layerReader);
+                    layer->y = (int32_t)ReadU32(&layerReader);
+                    break;
+                case XcfPropGroupItem:
+                    layer->group = true;
+                    break;
+                case XcfPropItemPath:
+                    layer->depth = (int)(length/4) - 1;
+                    break;
+            }
+            layerReader.position = end;
+        }
+
+        layer->hierarchy = ReadPointer(&layerReader);
+        layer->mask = ReadPointer(&layerReader);
+
+        if(layerReader.failed || layer->width < 0 || layer->height < 0 ||
+           layer->type < 0 || layer->type > 5 || layer->depth < 0)
+        {
+            fprintf(stderr, "'%s' has an invalid layer.\n", file->fileName);
+            return false;
+        }
+    }
+
+    if(reader.failed)
+    {
+        fprintf(stderr, "'%s' is truncated.\n", file->fileName);
+        return false;
+    }
+    return true;
+}
+
+static int GetLayerComponents( int type )
+{
+    static const int Components[] = {3, 4, 1, 2, 1, 2};
+    return Components[type];
+}
+
+static bool HasAlpha( int type )
+{
+    return type % 2 == 1;
+}
+
+/**
+ * Whether the flattened image is opaque for sure, so the alpha channel can
+ * be left out.  That's the case if the bottom layer covers the whole image
+ * and has no transparency of its own.
+ */
+static bool IsOpaque( const XcfFile * file )
+{
+    for(int i = file->layerCount-1; i >= 0; i--)
+    {
+        const XcfLayer * layer = &file->layers[i];
+        if(layer->depth != 0 || !layer->visible)
+            continue;
+        return !layer->group &&
+               !HasAlpha(layer->type) &&
+               layer->opacity >= 1 &&
+               !(layer->mask && layer->applyMask) &&
+               layer->x <= 0 && layer->y <= 0 &&
+               layer->x + layer->width  >= file->width &&
+               layer->y + layer->height >= file->height;
+    }
+    return false;
+}
+
+
+// --- Pixel data ---
+
+static float HalfToFloat( uint16_t half )
+{
+    const int exponent = (half >> 10) & 0x1f;
+    const int mantissa = half & 0x3ff;
+    float value;
+    if(exponent == 0)
+        value = ldexpf((float)mantissa, -24);
+    else if(exponent == 31)
+        value = mantissa ? NAN : INFINITY;
+    else
+        value = ldexpf((float)(mantissa | 0x400), exponent-25);
+    return (half & 0x8000) ? -value : value;
+}
+
+/**
+ * Components are stored big endian.
+ */
+static float ReadComponent( const unsigned char * b, XcfComponentType type )
+{
+    switch(type)
+    {
+        case XcfU8:
+            return b[0] / 255.0f;
+        case XcfU16:
+            return ((b[0] << 8) | b[1]) / 65535.0f;
+        case XcfU32:
+            return (float)((((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+                            ((uint32_t)b[2] <<  8) |  (uint32_t)b[3]) / 4294967295.0);
+        case XcfHalf:
+            return HalfToFloat((uint16_t)((b[0] << 8) | b[1]));
+        case XcfFloat:
+        {
+            const uint32_t bits = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+                                  ((uint32_t)b[2] <<  8) |  (uint32_t)b[3];
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        default:
+        {
+            uint64_t bits = 0;
+            for(int i = 0; i < 8; i++)
+                bits = (bits << 8) | b[i];
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return (float)value;
+        }
+    }
+}
+
+static bool DecodeRleTile( XcfReader * reader,
+                           unsigned char * tile,
+                           int pixels,
+                           int bytesPerPixel )
+{
+    // Each byte of a pixel is compressed as separate plane:
+    for(int plane = 0; plane < bytesPerPixel; plane++)
+    {
+        int i = 0;
+        while(i < pixels)
+        {
+            const unsigned char * opcode = ReadBytes(reader, 1);
+            if(!opcode)
+                return false;
+
+            int length;
+            if(opcode[0] >= 128) // Literal bytes
+            {
+                length = 256 - opcode[0];
+                if(length == 128)
+                {
+                    const unsigned char * b = ReadBytes(reader, 2);
+                    if(!b)
+                        return false;
+                    length = (b[0] << 8) | b[1];
+                }
+                const unsigned char * bytes = ReadBytes(reader, length);
+                if(!bytes || i + length > pixels)
+                    return false;
+                for(int j = 0; j < length; j++, i++)
+                    tile[i*bytesPerPixel + plane] = bytes[j];
+            }
+            else // Repeated byte
+            {
+                length = opcode[0] + 1;
+                if(length == 128)
+                {
+                    const unsigned char * b = ReadBytes(reader, 2);
+                    if(!b)
+                        return false;
+                    length = (b[0] << 8) | b[1];
+                }
+                const unsigned char * value = ReadBytes(reader, 1);
+                if(!value || i + length > pixels)
+                    return false;
+                for(int j = 0; j < length; j++, i++)
+                    tile[i*bytesPerPixel + plane] = value[0];
+            }
+        }
+    }
+    return true;
+}
+
+static bool DecodeZlibTile( const XcfFile * file,
+                            uint64_t offset,
+                            unsigned char * tile,
+                            size_t size )
+{
+    // The compressed size isn't stored, but the stream knows its end:
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if(inflateInit(&stream) != Z_OK)
+        return false;
+    stream.next_in = (unsigned char *)&file->data[offset];
+    stream.avail_in = (uInt)(file->size - offset);
+    stream.next_out = tile;
+    stream.avail_out = (uInt)size;
+    const int result = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    return result == Z_STREAM_END || (result == Z_BUF_ERROR && stream.avail_out == 0);
+}
+
+/**
+ * Reads the pixels of a layer or mask hierarchy into `components` floats
+ * per pixel.
+ */
+static bool ReadHierarchy( const XcfFile * file,
+                           uint64_t offset,
+                           int width,
+                           int height,
+                           int components,
+                           float * pixels )
+{
+    XcfReader reader;
+    InitReader(&reader, file, offset);
+    ReadU32(&reader); // Width
+    ReadU32(&reader); // Height
+    const int bytesPerPixel = (int)ReadU32(&reader);
+    if(bytesPerPixel != components*file->componentSize)
+        return false;
+
+    // Only the first level is used, the others are unused mipmaps:
+    InitReader(&reader, file, ReadPointer(&reader));
+    if(reader.failed)
+        return false;
+    ReadU32(&reader); // Width
+    ReadU32(&reader); // Height
+
+    const int columns = (width  + XcfTileSize-1) / XcfTileSize;
+    const int rows    = (height + XcfTileSize-1) / XcfTileSize;
+    unsigned char * tile = (unsigned char *)malloc(XcfTileSize*XcfTileSize*bytesPerPixel);
+
+    bool success = tile != NULL;
+    for(int i = 0; i < columns*rows && success; i++)
+    {
+        const uint64_t tileOffset = ReadPointer(&reader);
+        if(reader.failed || tileOffset == 0 || tileOffset >= file->size)
+        {
+            success = false;
+            break;
+        }
+
+        const int tileX = (i % columns) * XcfTileSize;
+        const int tileY = (i / columns) * XcfTileSize;
+        const int tileWidth  = (tileX + XcfTileSize > width)  ? width  - tileX : XcfTileSize;
+        const int tileHeight = (tileY + XcfTileSize > height) ? height - tileY : XcfTileSize;
+        const int tilePixels = tileWidth*tileHeight;
+        const size_t tileSize = (size_t)tilePixels*bytesPerPixel;
+
+        XcfReader tileReader;
+        InitReader(&tileReader, file, tileOffset);
+        switch(file->compression)
+        {
+            case XcfCompressionNone:
+            {
+                const unsigned char * bytes = ReadBytes(&tileReader, tileSize);
+                if(bytes)
+                    memcpy(tile, bytes, tileSize);
+                success = bytes != NULL;
+                break;
+            }
+            case XcfCompressionRle:
+                success = DecodeRleTile(&tileReader, tile, tilePixels, bytesPerPixel);
+                break;
+            default:
+                success = DecodeZlibTile(file, tileOffset, tile, tileSize);
+        }
+
+        for(int y = 0; y < tileHeight && success; y++)
+        for(int x = 0; x < tileWidth; x++)
+        {
+            const unsigned char * source = &tile[(y*tileWidth + x)*bytesPerPixel];
+            float * destination = &pixels[((size_t)(tileY+y)*width + tileX+x)*components];
+            for(int c = 0; c < components; c++)
+                destination[c] = ReadComponent(&source[c*file->componentSize],
+                                               file->componentType);
+        }
+    }
+
+    free(tile);
+    return success;
+}
+
+/**
+ * Converts the components of a layer to RGBA.
+ */
+static void ExpandToRgba( const XcfFile * file,
+                          int type,
+                          const float * source,
+                          float * destination,
+                          size_t pixels )
+{
+    const int components = GetLayerComponents(type);
+    for(size_t i = 0; i < pixels; i++)
+    {
+        const float * s = &source[i*components];
+        float * d = &destination[i*4];
+        switch(type / 2)
+        {
+            case XcfRgb:
+                d[0] = s[0];
+                d[1] = s[1];
+                d[2] = s[2];
+                break;
+            case XcfGray:
+                d[0] = d[1] = d[2] = s[0];
+                break;
+            default:
+            {
+                int index = (int)(s[0]*255.0f + 0.5f);
+                index = (index < 0) ? 0 : (index > 255) ? 255 : index;
+                d[0] = file->colormap[index*3+0] / 255.0f;
+                d[1] = file->colormap[index*3+1] / 255.0f;
+                d[2] = file->colormap[index*3+2] / 255.0f;
+            }
+        }
+        d[3] = HasAlpha(type) ? s[components-1] : 1.0f;
+    }
+}
+
+static bool ReadMask( const XcfFile * file, XcfLayer * layer )
+{
+    XcfReader reader;
+    InitReader(&reader, file, layer->mask);
+    const int width  = (int)ReadU32(&reader);
+    const int height = (int)ReadU32(&reader);
+    SkipString(&reader);
+    for(;;)
+    {
+        const uint32_t type = ReadU32(&reader);
+        const uint32_t length = ReadU32(&reader);
+        if(reader.failed || type == XcfPropEnd)
+            break;
+        ReadBytes(&reader, length);
+    }
+    const uint64_t hierarchy = ReadPointer(&reader);
+    if(reader.failed || width != layer->width || height != layer->height)
+        return false;
+
+    layer->maskPixels = (float *)malloc(sizeof(float)*width*height + 1);
+    if(!layer->maskPixels)
+        return false;
+    return ReadHierarchy(file, hierarchy, width, height, 1, layer->maskPixels);
+}
+
+typedef struct
+{
+    const XcfFile * file;
+    XcfLayer * layer;
+} LayerTask;
+
+static void DecodeLayer( void * data, int workerIndex )
+{
+    LayerTask * task = (LayerTask *)data;
+    const XcfFile * file = task->file;
+    XcfLayer * layer = task->layer;
+
+    // Groups have no pixels of their own, only a mask:
+    if(layer->group)
+    {
+        if(layer->mask && layer->applyMask)
+            layer->failed = !ReadMask(file, layer);
+        return;
+    }
+
+    const size_t pixels = (size_t)layer->width*layer->height;
+    const int components = GetLayerComponents(layer->type);
+    float * raw = (float *)malloc(sizeof(float)*(pixels*components + 1));
+    layer->pixels = (float *)malloc(sizeof(float)*(pixels*4 + 1));
+
+    if(raw && layer->pixels &&
+       ReadHierarchy(file, layer->hierarchy, layer->width, layer->height, components, raw))
+        ExpandToRgba(file, layer->type, raw, layer->pixels, pixels);
+    else
+        layer->failed = true;
+    free(raw);
+
+    if(!layer->failed && layer->mask && layer->applyMask)
+        layer->failed = !ReadMask(file, layer);
+}
+
+
+// --- Compositing ---
+
+static float Clamp( float value )
+{
+    return (value < 0) ? 0 : (value > 1) ? 1 : value;
+}
+
+/**
+ * @param b
+ * Backdrop
+ *
+ * @param s
+ * Layer
+ */
+static float BlendChannel( XcfBlendMode mode, float b, float s )
+{
+    switch(mode)
+    {
+        case XcfMultiply:     return b*s;
+        case XcfScreen:       return 1 - (1-b)*(1-s);
+        case XcfOverlay:      return (b < 0.5f) ? 2*b*s : 1 - 2*(1-b)*(1-s);
+        case XcfDifference:   return fabsf(b-s);
+        case XcfAddition:     return Clamp(b+s);
+        case XcfSubtract:     return Clamp(b-s);
+        case XcfDarkenOnly:   return (b < s) ? b : s;
+        case XcfLightenOnly:  return (b > s) ? b : s;
+        case XcfDivide:       return (s > 0) ? Clamp(b/s) : 1;
+        case XcfDodge:        return (s < 1) ? Clamp(b/(1-s)) : 1;
+        case XcfBurn:         return (s > 0) ? Clamp(1 - (1-b)/s) : 0;
+        case XcfHardLight:    return (s < 0.5f) ? 2*b*s : 1 - 2*(1-b)*(1-s);
+        case XcfSoftLight:    return (1-b)*b*s + b*(1 - (1-b)*(1-s));
+        case XcfGrainExtract: return Clamp(b - s + 0.5f);
+        case XcfGrainMerge:   return Clamp(b + s - 0.5f);
+        default:              return s;
+    }
+}
+
+/**
+ * Composites a layer over the backdrop.  Both are RGBA with straight
+ * alpha.
+ */
+static void BlendPixel( XcfBlendMode mode,
+                        float * backdrop,
+                        const float * layer,
+                        float alpha )
+{
+    if(alpha <= 0)
+        return;
+
+    const float backdropAlpha = backdrop[3];
+    const float resultAlpha = alpha + backdropAlpha*(1-alpha);
+    for(int c = 0; c < 3; c++)
+    {
+        const float b = backdrop[c];
+        const float s = layer[c];
+        const float blended = (backdropAlpha > 0) ? BlendChannel(mode, b, s) : s;
+        backdrop[c] = (alpha*(1-backdropAlpha)*s +
+                       alpha*backdropAlpha*blended +
+                       (1-alpha)*backdropAlpha*b) / resultAlpha;
+    }
+    backdrop[3] = resultAlpha;
+}
+
+/**
+ * Fades from the backdrop to the result of a pass-through group, which
+ * already contains the backdrop.  Interpolates premultiplied colors.
+ */
+static void FadePixel( float * backdrop, const float * result, float amount )
+{
+    const float alpha = backdrop[3] + (result[3] - backdrop[3])*amount;
+    for(int c = 0; c < 3; c++)
+    {
+        const float b = backdrop[c]*backdrop[3];
+        const float r = result[c]*result[3];
+        backdrop[c] = (alpha > 0) ? (b + (r - b)*amount) / alpha : 0;
+    }
+    backdrop[3] = alpha;
+}
+
+/**
+ * Index after the last child of the group at `index`.
+ */
+static int GetGroupEnd( const XcfFile * file, int index )
+{
+    const int depth = file->layers[index].depth;
+    int end = index+1;
+    while(end < file->layerCount && file->layers[end].depth > depth)
+        end++;
+    return end;
+}
+
+/**
+ * Composites the layers `[first, end)` of one nesting level into rows
+ * `[top, bottom)` of an image sized canvas band.
+ *
+ * Groups are composited into a band of their own first.  Pass-through
+ * groups start with a copy of the backdrop, so their children blend with
+ * the layers below; opacity and mask then fade between the backdrop and
+ * that result.
+ *
+ * @return
+ * `false` if memory ran out.
+ */
+static bool CompositeLayers( const XcfFile * file,
+                             int first,
+                             int end,
+                             int top,
+                             int bottom,
+                             float * band )
+{
+    const int width = file->width;
+
+    // Layers are stored from top to bottom, so go backwards:
+    int i = end-1;
+    while(i >= first)
+    {
+        // Find the item on this level, which may be a group with children:
+        int item = i;
+        while(item > first && file->layers[item].depth > file->layers[first].depth)
+            item--;
+        const XcfLayer * layer = &file->layers[item];
+        i = item-1;
+
+        if(!layer->visible)
+            continue;
+
+        const float * pixels;
+        int layerX, layerY, layerWidth, layerHeight;
+        float * groupBand = NULL;
+        const bool passThrough = layer->group && layer->mode == XcfPassThrough;
+        if(layer->group)
+        {
+            const size_t bandSize = sizeof(float)*width*(bottom-top)*4;
+            groupBand = (float *)malloc(bandSize);
+            if(!groupBand)
+                return false;
+            if(passThrough)
+                memcpy(groupBand, band, bandSize);
+            else
+                memset(groupBand, 0, bandSize);
+            if(!CompositeLayers(file, item+1, GetGroupEnd(file, item), top, bottom, groupBand))
+            {
+                free(groupBand);
+                return false;
+            }
+            pixels = groupBand;
+            layerX = 0;
+            layerY = top;
+            layerWidth = width;
+            layerHeight = bottom-top;
+        }
+        else
+        {
+            pixels = layer->pixels;
+            layerX = layer->x;
+            layerY = layer->y;
+            layerWidth = layer->width;
+            layerHeight = layer->height;
+        }
+
+        int x0 = (layerX > 0) ? layerX : 0;
+        int x1 = (layerX+layerWidth < width) ? layerX+layerWidth : width;
+        int y0 = (layerY > top) ? layerY : top;
+        int y1 = (layerY+layerHeight < bottom) ? layerY+layerHeight : bottom;
+
+        // Masks cover the layer's own rectangle, which for groups is the
+        // bounding box of their children.  Nothing shows outside of it:
+        if(layer->maskPixels)
+        {
+            x0 = (layer->x > x0) ? layer->x : x0;
+            x1 = (layer->x+layer->width < x1) ? layer->x+layer->width : x1;
+            y0 = (layer->y > y0) ? layer->y : y0;
+            y1 = (layer->y+layer->height < y1) ? layer->y+layer->height : y1;
+        }
+
+        for(int y = y0; y < y1; y++)
+        for(int x = x0; x < x1; x++)
+        {
+            const size_t index = (size_t)(y-layerY)*layerWidth + (x-layerX);
+            const float * source = &pixels[index*4];
+            float * backdrop = &band[((size_t)(y-top)*width + x)*4];
+            float amount = layer->opacity;
+            if(layer->maskPixels)
+                amount *= layer->maskPixels[(size_t)(y-layer->y)*layer->width +
+                                            (x-layer->x)];
+            if(passThrough)
+                FadePixel(backdrop, source, amount);
+            else
+                BlendPixel(layer->mode, backdrop, source, source[3]*amount);
+        }
+
+        free(groupBand);
+    }
+    return true;
+}
+
+typedef struct
+{
+    const XcfFile * file;
+    float * canvas;
+    int top;
+    int bottom;
+    bool failed;
+} BandTask;
+
+static void CompositeBand( void * data, int workerIndex )
+{
+    BandTask * task = (BandTask *)data;
+    const XcfFile * file = task->file;
+    task->failed = !CompositeLayers(file,
+                                    0,
+                                    file->layerCount,
+                                    task->top,
+                                    task->bottom,
+                                    &task->canvas[(size_t)task->top*file->width*4]);
+}
+
+
+// --- Codec ---
+
+static unsigned char * ReadWholeFile( const char * fileName, size_t * size )
+{
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char * buffer = (unsigned char *)malloc(length > 0 ? length : 1);
+    *size = (length > 0) ? (size_t)length : 0;
+    if(fread(buffer, 1, *size, file) != *size)
+    {
+        free(buffer);
+        buffer = NULL;
+    }
+    fclose(file);
+    return buffer;
+}
+
+static bool OpenXcfFile( const char * fileName, XcfFile * file )
+{
+    memset(file, 0, sizeof(XcfFile));
+    file->fileName = fileName;
+    file->data = ReadWholeFile(fileName, &file->size);
+    if(!file->data)
+    {
+        fprintf(stderr, "Could not open '%s' for reading.\n", fileName);
+        return false;
+    }
+    return ParseHeader(file);
+}
+
+static void CloseXcfFile( XcfFile * file )
+{
+    for(int i = 0; i < file->layerCount; i++)
+    {
+        free(file->layers[i].pixels);
+        free(file->layers[i].maskPixels);
+    }
+    free(file->layers);
+    free((void *)file->data);
+    memset(file, 0, sizeof(XcfFile));
+}
+
+static int GetOutputChannels( const XcfFile * file )
+{
+    const int colorChannels = (file->baseType == XcfGray) ? 1 : 3;
+    return colorChannels + (IsOpaque(file) ? 0 : 1);
+}
+
+static Image * ReadXcfImage( const char * fileName )
+{
+    XcfFile file;
+    if(!OpenXcfFile(fileName, &file))
+    {
+        CloseXcfFile(&file);
+        return NULL;
+    }
+
+    ThreadPool * pool = CreateThreadPool(GetImageThreads());
+
+    // Layers are decoded concurrently:
+    LayerTask * layerTasks = (LayerTask *)malloc(sizeof(LayerTask)*(file.layerCount+1));
+    for(int i = 0; i < file.layerCount; i++)
+    {
+        layerTasks[i].file = &file;
+        layerTasks[i].layer = &file.layers[i];
+        SubmitTask(pool, DecodeLayer, &layerTasks[i]);
+    }
+    WaitForTasks(pool);
+    free(layerTasks);
+
+    bool success = true;
+    for(int i = 0; i < file.layerCount; i++)
+        success = success && !file.layers[i].failed;
+    if(!success)
+    {
+        fprintf(stderr, "'%s' has corrupt pixel data.\n", fileName);
+        FreeThreadPool(pool);
+        CloseXcfFile(&file);
+        return NULL;
+    }
+
+    // ... and composited in bands of rows:
+    const int width = file.width;
+    const int height = file.height;
+    float * canvas = (float *)calloc((size_t)width*height*4, sizeof(float));
+    if(!canvas)
+    {
+        fprintf(stderr, "'%s' is too large.\n", fileName);
+        FreeThreadPool(pool);
+        CloseXcfFile(&file);
+        return NULL;
+    }
+    const int bandCount = (height + XcfBandHeight-1) / XcfBandHeight;
+    BandTask * bandTasks = (BandTask *)malloc(sizeof(BandTask)*bandCount);
+    for(int i = 0; i < bandCount; i++)
+    {
+        bandTasks[i].file = &file;
+        bandTasks[i].canvas = canvas;
+        bandTasks[i].top = i*XcfBandHeight;
+        bandTasks[i].bottom = (i+1)*XcfBandHeight < height ? (i+1)*XcfBandHeight : height;
+        bandTasks[i].failed = false;
+        SubmitTask(pool, CompositeBand, &bandTasks[i]);
+    }
+    WaitForTasks(pool);
+    for(int i = 0; i < bandCount; i++)
+        success = success && !bandTasks[i].failed;
+    free(bandTasks);
+    FreeThreadPool(pool);
+    if(!success)
+    {
+        fprintf(stderr, "'%s' is too large.\n", fileName);
+        free(canvas);
+        CloseXcfFile(&file);
+        return NULL;
+    }
+
+    const int channels = GetOutputChannels(&file);
+    const bool gray = file.baseType == XcfGray;
+    Image * image = CreateImage(width, height, channels);
+    for(size_t i = 0; i < (size_t)width*height; i++)
+    {
+        const float * source = &canvas[i*4];
+        float * destination = &image->data[i*channels];
+        if(gray)
+        {
+            destination[0] = source[0];
+        }
+        else
+        {
+            destination[0] = source[0];
+            destination[1] = source[1];
+            destination[2] = source[2];
+        }
+        if(channels == 2 || channels == 4)
+            destination[channels-1] = source[3];
+    }
+
+    free(canvas);
+    CloseXcfFile(&file);
+    return image;
+}
+
+static bool ReadXcfImageInfo( const char * fileName, ImageInfo * info )
+{
+    XcfFile file;
+    const bool success = OpenXcfFile(fileName, &file);
+    if(success)
+    {
+        info->width    = file.width;
+        info->height   = file.height;
+        info->channels = GetOutputChannels(&file);
+        info->bitDepth = file.componentSize*8;
+    }
+    CloseXcfFile(&file);
+    return success;
+}
+
+static bool ProbeXcfImage( const unsigned char * header, int headerSize )
+{
+    return headerSize >= 9 && memcmp(header, "gimp xcf ", 9) == 0;
+}
+
+static const char * const XcfExtensions[] = { "xcf", NULL };
+
+const ImageCodec XcfCodec =
+{
+    "xcf",
+    XcfExtensions,
+    ProbeXcfImage,
+    ReadXcfImage,
+    NULL, // Read only
+    ReadXcfImageInfo,
+    NULL
+};
@@ -1,23 +1,517 @@
+#define _POSIX_C_SOURCE 200809L // stat.st_mtim
 #include <assert.h>
-#include <string.h> // memset
-#include <stdlib.h> // malloc, free
+#include <stdio.h> // fopen, fread, fprintf, printf
+#include <string.h> // memset, memcpy, strrchr, strcmp, strlen
+#include <stdlib.h> // malloc, free, atoi
+#include <ctype.h> // tolower
+#include <pthread.h>
+#include <sys/stat.h> // stat
 #include "image.h"
+#include "image-codec.h"
+#include "allocator.h"
+#include "pixelformat.h"
+#include "stats.h"
 
 
+// Native codecs come first, so they're preferred over the generic fallback.
+static const ImageCodec * Codecs[] =
+{
+    &PngCodec,
+    &PfmCodec,
+    &QoiCodec,
+    &XcfCodec,
+#if defined(USE_OIIO)
+    &OiioCodec,
+#endif
+    NULL
+};
+
+static int CacheSize = 256; // megabytes
+static int Threads = 0;
+
+enum
+{
+    ChannelBandHeight = 256 // Rows per region read by #ReadImageChannel
+};
+
+/**
+ * Decoded images which #ReadImage keeps around, most recently used first.
+ */
+typedef struct DecodedImage
+{
+    struct DecodedImage * next;
+    char * fileName;
+    struct stat status; // Of the file when it was decoded
+    Image * image;
+} DecodedImage;
+
+static pthread_mutex_t DecodedImageMutex = PTHREAD_MUTEX_INITIALIZER;
+static DecodedImage * DecodedImages = NULL;
+static size_t DecodedImagesSize = 0;
+static int DecodedImageCacheSize = 0; // megabytes
+
+
+static size_t GetImageDataSize( const Image * image )
+{
+    return sizeof(float)*(size_t)image->width*image->height*image->channels;
+}
+
 Image * CreateImage( int width, int height, int channels )
 {
     Image * image = (Image *)malloc(sizeof(Image));
     image->width    = width;
     image->height   = height;
     image->channels = channels;
-    image->data     = (float *)malloc(sizeof(float)*width*height*channels);
+    image->data     = (float *)AcquireBuffer(GetImageDataSize(image));
     return image;
 }
 
 void FreeImage( Image * image )
 {
     assert(image->data != NULL);
-    free(image->data);
+    ReleaseBuffer(image->data, GetImageDataSize(image));
     memset(image, 0, sizeof(Image));
     free(image);
 }
+
+Image * CopyImageChannel( const Image * image, int channel )
+{
+    assert(channel >= 0 && channel < image->channels);
+    Image * copy = CreateImage(image->width, image->height, 1);
+    ExtractChannel(image->data,
+                   image->channels,
+                   channel,
+                   copy->data,
+                   (size_t)image->width*image->height);
+    return copy;
+}
+
+static bool HasExtension( const ImageCodec * codec, const char * fileName )
+{
+    if(!codec->extensions)
+        return false;
+
+    const char * dot = strrchr(fileName, '.');
+    if(!dot)
+        return false;
+    const char * extension = dot+1;
+
+    for(int i = 0; codec->extensions[i]; i++)
+    {
+        const char * a = extension;
+        const char * b = codec->extensions[i];
+        while(*a && tolower((unsigned char)*a) == *b)
+        {
+            a++;
+            b++;
+        }
+        if(*a == '\0' && *b == '\0')
+            return true;
+    }
+    return false;
+}
+
+static bool IsFallback( const ImageCodec * codec )
+{
+    return !codec->probe && !codec->extensions;
+}
+
+static const ImageCodec * FindCodecForReading( const char * fileName )
+{
+    unsigned char header[ImageSignatureSize];
+    int headerSize = 0;
+
+    FILE * file = fopen(fileName, "rb");
+    if(file)
+    {
+        headerSize = (int)fread(header, 1, sizeof(header), file);
+        fclose(file);
+    }
+
+    // Signatures are more reliable than extensions:
+    for(int i = 0; Codecs[i]; i++)
+        if(Codecs[i]->probe && Codecs[i]->probe(header, headerSize))
+            return Codecs[i];
+
+    for(int i = 0; Codecs[i]; i++)
+        if(HasExtension(Codecs[i], fileName))
+            return Codecs[i];
+
+    for(int i = 0; Codecs[i]; i++)
+        if(IsFallback(Codecs[i]))
+            return Codecs[i];
+
+    return NULL;
+}
+
+static const ImageCodec * FindCodecForWriting( const char * fileName )
+{
+    for(int i = 0; Codecs[i]; i++)
+        if(Codecs[i]->write && HasExtension(Codecs[i], fileName))
+            return Codecs[i];
+
+    for(int i = 0; Codecs[i]; i++)
+        if(IsFallback(Codecs[i]))
+            return Codecs[i];
+
+    return NULL;
+}
+
+static Image * DecodeImage( const char * fileName )
+{
+    const ImageCodec * codec = FindCodecForReading(fileName);
+    if(!codec)
+    {
+        fprintf(stderr, "No codec can read '%s'.\n", fileName);
+        return NULL;
+    }
+
+    StatsScope scope;
+    BeginStatsScope(&scope, "decode", fileName);
+    Image * image = codec->read(fileName);
+    EndStatsScope(&scope);
+
+    struct stat status;
+    if(image && stat(fileName, &status) == 0)
+        AddStatsCount("bytes read", (double)status.st_size);
+    return image;
+}
+
+static Image * CopyImage( const Image * image )
+{
+    Image * copy = CreateImage(image->width, image->height, image->channels);
+    memcpy(copy->data, image->data, GetImageDataSize(image));
+    return copy;
+}
+
+static bool IsSameFileVersion( const struct stat * a, const struct stat * b )
+{
+    return a->st_size == b->st_size &&
+           a->st_ino  == b->st_ino  &&
+           a->st_mtim.tv_sec  == b->st_mtim.tv_sec &&
+           a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+static void FreeDecodedImage( DecodedImage * entry )
+{
+    DecodedImagesSize -= GetImageDataSize(entry->image);
+    FreeImage(entry->image);
+    free(entry->fileName);
+    free(entry);
+}
+
+/**
+ * Unlinks the entry for `fileName` and returns it, if there is one.
+ * Must be called with the mutex locked.
+ */
+static DecodedImage * TakeDecodedImage( const char * fileName )
+{
+    for(DecodedImage * * link = &DecodedImages; *link; link = &(*link)->next)
+    {
+        DecodedImage * entry = *link;
+        if(strcmp(entry->fileName, fileName) == 0)
+        {
+            *link = entry->next;
+            entry->next = NULL;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Frees the least recently used entries until `limit` is met.
+ * Must be called with the mutex locked.
+ */
+static void TrimDecodedImages( size_t limit )
+{
+    while(DecodedImagesSize > limit)
+    {
+        DecodedImage * * link = &DecodedImages;
+        while((*link)->next)
+            link = &(*link)->next;
+        FreeDecodedImage(*link);
+        *link = NULL;
+    }
+}
+
+static Image * ReadCachedImage( const char * fileName )
+{
+    struct stat status;
+    if(stat(fileName, &status) != 0)
+        return DecodeImage(fileName); // Reports the error
+
+    const size_t limit = (size_t)DecodedImageCacheSize*1024*1024;
+
+    pthread_mutex_lock(&DecodedImageMutex);
+    DecodedImage * entry = TakeDecodedImage(fileName);
+    if(entry && IsSameFileVersion(&entry->status, &status))
+    {
+        entry->next = DecodedImages;
+        DecodedImages = entry;
+        Image * image = CopyImage(entry->image);
+        pthread_mutex_unlock(&DecodedImageMutex);
+        return image;
+    }
+    else if(entry)
+    {
+        FreeDecodedImage(entry);
+    }
+    pthread_mutex_unlock(&DecodedImageMutex);
+
+    Image * image = DecodeImage(fileName);
+    if(!image || GetImageDataSize(image) > limit)
+        return image;
+
+    entry = (DecodedImage *)malloc(sizeof(DecodedImage));
+    entry->fileName = (char *)malloc(strlen(fileName)+1);
+    memcpy(entry->fileName, fileName, strlen(fileName)+1);
+    entry->status = status;
+    entry->image = CopyImage(image);
+
+    pthread_mutex_lock(&DecodedImageMutex);
+    // Another thread may have decoded the same file in the meantime:
+    DecodedImage * previous = TakeDecodedImage(fileName);
+    if(previous)
+        FreeDecodedImage(previous);
+    entry->next = DecodedImages;
+    DecodedImages = entry;
+    DecodedImagesSize += GetImageDataSize(image);
+    TrimDecodedImages(limit);
+    pthread_mutex_unlock(&DecodedImageMutex);
+    return image;
+}
+
+Image * ReadImage( const char * fileName )
+{
+    if(DecodedImageCacheSize > 0)
+        return ReadCachedImage(fileName);
+    else
+        return DecodeImage(fileName);
+}
+
+bool ReadImageInfo( const char * fileName, ImageInfo * info )
+{
+    const ImageCodec * codec = FindCodecForReading(fileName);
+    if(!codec)
+    {
+        fprintf(stderr, "No codec can read '%s'.\n", fileName);
+        return false;
+    }
+
+    if(codec->readInfo)
+        return codec->readInfo(fileName, info);
+
+    Image * image = codec->read(fileName);
+    if(!image)
+        return false;
+    info->width    = image->width;
+    info->height   = image->height;
+    info->channels = image->channels;
+    info->bitDepth = 32;
+    FreeImage(image);
+    return true;
+}
+
+static Image * CropImage( const Image * source,
+                          int x,
+                          int y,
+                          int width,
+                          int height )
+{
+    const int channels = source->channels;
+    Image * image = CreateImage(width, height, channels);
+    for(int row = 0; row < height; row++)
+        memcpy(&image->data[row*width*channels],
+               &source->data[((y+row)*source->width + x)*channels],
+               sizeof(float)*width*channels);
+    return image;
+}
+
+Image * ReadImageRegion( const char * fileName,
+                         int x,
+                         int y,
+                         int width,
+                         int height )
+{
+    const ImageCodec * codec = FindCodecForReading(fileName);
+    if(!codec)
+    {
+        fprintf(stderr, "No codec can read '%s'.\n", fileName);
+        return NULL;
+    }
+
+    if(codec->readRegion)
+        return codec->readRegion(fileName, x, y, width, height);
+
+    Image * source = codec->read(fileName);
+    if(!source)
+        return NULL;
+
+    if(x < 0 || y < 0 || width <= 0 || height <= 0 ||
+       x+width  > source->width ||
+       y+height > source->height)
+    {
+        fprintf(stderr, "Region is outside of '%s'.\n", fileName);
+        FreeImage(source);
+        return NULL;
+    }
+
+    Image * image = CropImage(source, x, y, width, height);
+    FreeImage(source);
+    return image;
+}
+
+Image * ReadImageChannel( const char * fileName, int channel )
+{
+    const ImageCodec * codec = FindCodecForReading(fileName);
+    if(!codec)
+    {
+        fprintf(stderr, "No codec can read '%s'.\n", fileName);
+        return NULL;
+    }
+
+    // Whole images are decoded or kept by the decoded image cache anyway:
+    if(!codec->readRegion || DecodedImageCacheSize > 0)
+    {
+        Image * image = ReadImage(fileName);
+        if(!image)
+            return NULL;
+        if(channel >= image->channels)
+        {
+            fprintf(stderr, "'%s' has no channel %d.\n", fileName, channel);
+            FreeImage(image);
+            return NULL;
+        }
+        if(image->channels == 1)
+            return image;
+        Image * copy = CopyImageChannel(image, channel);
+        FreeImage(image);
+        return copy;
+    }
+
+    ImageInfo info;
+    if(!ReadImageInfo(fileName, &info))
+        return NULL;
+    if(channel >= info.channels)
+    {
+        fprintf(stderr, "'%s' has no channel %d.\n", fileName, channel);
+        return NULL;
+    }
+
+    StatsScope scope;
+    BeginStatsScope(&scope, "decode", fileName);
+    Image * image = CreateImage(info.width, info.height, 1);
+    for(int y = 0; y < info.height; y += ChannelBandHeight)
+    {
+        const int rows = (info.height-y < ChannelBandHeight) ? info.height-y :
+                                                               ChannelBandHeight;
+        Image * band = codec->readRegion(fileName, 0, y, info.width, rows);
+        if(!band)
+        {
+            FreeImage(image);
+            image = NULL;
+            break;
+        }
+        ExtractChannel(band->data,
+                       band->channels,
+                       channel,
+                       &image->data[(size_t)y*info.width],
+                       (size_t)info.width*rows);
+        FreeImage(band);
+    }
+    EndStatsScope(&scope);
+    return image;
+}
+
+bool WriteImage( const Image * image, const char * fileName )
+{
+    const ImageCodec * codec = FindCodecForWriting(fileName);
+    if(!codec)
+    {
+        fprintf(stderr, "No codec can write '%s'.\n", fileName);
+        return false;
+    }
+
+    StatsScope scope;
+    BeginStatsScope(&scope, "encode", fileName);
+    const bool success = codec->write(image, fileName);
+    EndStatsScope(&scope);
+
+    struct stat status;
+    if(success && stat(fileName, &status) == 0)
+        AddStatsCount("bytes written", (double)status.st_size);
+    return success;
+}
+
+void SetImageCacheSize( int megabytes )
+{
+    CacheSize = megabytes;
+}
+
+int GetImageCacheSize()
+{
+    return CacheSize;
+}
+
+void SetDecodedImageCacheSize( int megabytes )
+{
+    pthread_mutex_lock(&DecodedImageMutex);
+    DecodedImageCacheSize = (megabytes > 0) ? megabytes : 0;
+    TrimDecodedImages((size_t)DecodedImageCacheSize*1024*1024);
+    pthread_mutex_unlock(&DecodedImageMutex);
+}
+
+int GetDecodedImageCacheSize()
+{
+    return DecodedImageCacheSize;
+}
+
+void SetImageThreads( int threads )
+{
+    Threads = threads;
+}
+
+int GetImageThreads()
+{
+    return Threads;
+}
+
+void InitImageOptions( ImageOptions * options )
+{
+    options->cacheSize = GetImageCacheSize();
+    options->threads = GetImageThreads();
+}
+
+int ParseImageOption( int argc, char * * argv, int * i, ImageOptions * options )
+{
+    if(strcmp(argv[*i], "-M") != 0 &&
+       strcmp(argv[*i], "-D") != 0)
+        return 0;
+
+    if(*i+1 >= argc)
+    {
+        printf("Option needs a value.\n");
+        return -1;
+    }
+    const char option = argv[*i][1];
+    (*i)++;
+    if(option == 'M')
+        options->cacheSize = atoi(argv[*i]);
+    else
+        options->threads = atoi(argv[*i]);
+    return 1;
+}
+
+void PrintImageHelp()
+{
+    printf("\t-M <megabytes> (tile cache for codecs with random access, defaults to %d)\n",
+           CacheSize);
+    printf("\t-D <threads> (codec threads, defaults to the codec's choice)\n");
+}
+
+void ApplyImageOptions( const ImageOptions * options )
+{
+    SetImageCacheSize(options->cacheSize);
+    SetImageThreads(options->threads);
+}
@@ -15,11 +15,103 @@ typedef struct
     float * data;
 } Image;
 
+typedef struct
+{
+    int width;
+    int height;
+    int channels;
+    int bitDepth; // Bits per channel as stored in the file.
+} ImageInfo;
+
 Image * CreateImage( int width, int height, int channels );
 void FreeImage( Image * image );
+
+/**
+ * Creates a single channel image from one channel of `image`.
+ */
+Image * CopyImageChannel( const Image * image, int channel );
+
 Image * ReadImage( const char * fileName );
 bool WriteImage( const Image * image, const char * fileName );
 
+/**
+ * Reads only the image header, without decoding any pixels.
+ *
+ * The channel count is the one #ReadImage would produce.
+ */
+bool ReadImageInfo( const char * fileName, ImageInfo * info );
+
+/**
+ * Reads a rectangular part of an image.
+ *
+ * Codecs which support random access (like tiled EXR or TIFF files through
+ * OpenImageIO) only decode the tiles which overlap the region.  Others decode
+ * the complete image and crop it.
+ */
+Image * ReadImageRegion( const char * fileName,
+                         int x,
+                         int y,
+                         int width,
+                         int height );
+
+/**
+ * Reads one channel into a single channel image.
+ *
+ * Codecs which support random access are read in bands of rows, so the
+ * other channels of a large image are never decoded all at once.
+ */
+Image * ReadImageChannel( const char * fileName, int channel );
+
+/**
+ * Upper bound for memory which codecs may use to cache decoded tiles.
+ */
+void SetImageCacheSize( int megabytes );
+int GetImageCacheSize();
+
+/**
+ * Upper bound for memory which #ReadImage may use to keep decoded images.
+ *
+ * Reading a file again then only copies its pixels, as long as its size
+ * and modification time didn't change.  Useful for long running processes
+ * which see the same inputs repeatedly.  Zero, the default, disables it.
+ */
+void SetDecodedImageCacheSize( int megabytes );
+int GetDecodedImageCacheSize();
+
+/**
+ * Number of threads codecs may use for decoding and encoding.
+ * Zero lets the codec decide.
+ */
+void SetImageThreads( int threads );
+int GetImageThreads();
+
+/**
+ * Codec settings given on the command line.
+ */
+typedef struct
+{
+    int cacheSize; // See #SetImageCacheSize
+    int threads; // See #SetImageThreads
+} ImageOptions;
+
+void InitImageOptions( ImageOptions * options );
+
+/**
+ * Parses the image option at `argv[*i]`, if it is one.
+ *
+ * @return
+ * 1 if the option was consumed (`*i` then points to its last argument),
+ * 0 if it isn't an image option and -1 if it is malformed.
+ */
+int ParseImageOption( int argc, char * * argv, int * i, ImageOptions * options );
+
+void PrintImageHelp();
+
+/**
+ * Applies the options with #SetImageCacheSize and #SetImageThreads.
+ */
+void ApplyImageOptions( const ImageOptions * options );
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,565 @@
+#include <stdio.h> // printf
+#include <string.h> // strcmp, memset, memcpy
+#include <stdlib.h> // malloc, free
+#include "imagetool.h"
+#include "batch.h"
+#include "server.h"
+#include "watch.h"
+#include "stats.h"
+#include "tiles.h"
+
+
+typedef struct
+{
+    const char * inputFileName;
+    const char * outputFileName;
+
+    /**
+     * Copy of the input which the current output was generated from.
+     * Enables incremental updates and is refreshed after each run.
+     */
+    const char * previousInputFileName;
+
+    void * options; // ImageTool.optionsSize bytes
+} ImageJob;
+
+typedef struct
+{
+    const ImageTool * tool;
+    ImageJob defaults; // Given on the command line
+    CacheOptions cache;
+    Arena * * scratchArenas; // One per compute worker
+} ImageToolContext;
+
+typedef struct
+{
+    ImageJob job;
+    char cacheKey[CacheKeyLength+1];
+    bool cached; // Output has been restored from the cache
+    bool unchanged; // Input didn't change since the previous run
+    Image * input;
+    Image * previousInput; // Only for incremental updates
+    Image * output; // Or the previous output for incremental updates
+} Item;
+
+static void InitImageToolContext( ImageToolContext * context,
+                                  const ImageTool * tool,
+                                  void * defaultOptions )
+{
+    context->tool = tool;
+    context->defaults.inputFileName = NULL;
+    context->defaults.outputFileName = NULL;
+    context->defaults.previousInputFileName = NULL;
+    context->defaults.options = defaultOptions;
+    InitCacheOptions(&context->cache);
+    context->scratchArenas = NULL;
+}
+
+static void PrintImageToolHelp( const ImageTool * tool, const char * programName )
+{
+    printf("%s [options] <input> <output>\n", programName);
+    printf("%s [options] -b <manifest>\n", programName);
+    printf("%s [options] -s <socket>\n", programName);
+
+    tool->printHelp();
+    printf("\t-p <previous input> (only update tiles which changed since the previous run)\n");
+    PrintCacheHelp();
+    PrintImageHelp();
+    PrintStatsHelp();
+    PrintBatchHelp();
+}
+
+/**
+ * @param batchOptions, cacheOptions, statsOptions, imageOptions
+ * May be `NULL`, in which case these options are not accepted
+ * (i.e. within a manifest).
+ */
+static bool ParseImageToolArguments( int argc,
+                                     char * * argv,
+                                     const ImageTool * tool,
+                                     ImageJob * job,
+                                     BatchOptions * batchOptions,
+                                     CacheOptions * cacheOptions,
+                                     StatsOptions * statsOptions,
+                                     ImageOptions * imageOptions )
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(argv[i][0] == '-')
+        {
+            const int batchOption =
+                batchOptions ? ParseBatchOption(argc, argv, &i, batchOptions) : 0;
+            if(batchOption < 0)
+                return false;
+            else if(batchOption > 0)
+                continue;
+
+            const int cacheOption =
+                cacheOptions ? ParseCacheOption(argc, argv, &i, cacheOptions) : 0;
+            if(cacheOption < 0)
+                return false;
+            else if(cacheOption > 0)
+                continue;
+
+            const int statsOption =
+                statsOptions ? ParseStatsOption(argc, argv, &i, statsOptions) : 0;
+            if(statsOption < 0)
+                return false;
+            else if(statsOption > 0)
+                continue;
+
+            const int imageOption =
+                imageOptions ? ParseImageOption(argc, argv, &i, imageOptions) : 0;
+            if(imageOption < 0)
+                return false;
+            else if(imageOption > 0)
+                continue;
+
+            const int toolOption = tool->parseOption(argc, argv, &i, job->options);
+            if(toolOption < 0)
+                return false;
+            else if(toolOption > 0)
+                continue;
+
+            if(strcmp(argv[i], "-p") == 0)
+            {
+                if(i+1 < argc)
+                {
+                    i++;
+                    job->previousInputFileName = argv[i];
+                }
+                else
+                {
+                    printf("Option needs a value.\n");
+                    return false;
+                }
+            }
+            else
+            {
+                printf("Unknown option %s\n", argv[i]);
+                return false;
+            }
+        }
+        else if(job->inputFileName == NULL)
+        {
+            job->inputFileName = argv[i];
+        }
+        else if(job->outputFileName == NULL)
+        {
+            job->outputFileName = argv[i];
+        }
+        else
+        {
+            printf("Too many arguments.\n");
+            return false;
+        }
+    }
+
+    if(batchOptions && batchOptions->watch && !batchOptions->manifestFileName)
+    {
+        printf("Watch mode needs a manifest.\n");
+        return false;
+    }
+
+    if(batchOptions && (batchOptions->manifestFileName ||
+                        batchOptions->serverSocketName))
+    {
+        if(job->inputFileName != NULL)
+        {
+            printf("Batch and server mode take no file parameters.\n");
+            return false;
+        }
+        return true;
+    }
+
+    if(job->inputFileName  == NULL ||
+       job->outputFileName == NULL)
+    {
+        printf("File parameter(s) are missing.\n");
+        return false;
+    }
+
+    return true;
+}
+
+
+// --- Cache keys ---
+
+static void HashOptions( CacheHasher * hasher,
+                         const ImageTool * tool,
+                         const ImageJob * job )
+{
+    HashString(hasher, tool->version);
+    tool->hashOptions(hasher, job->options);
+    HashFileExtension(hasher, job->outputFileName);
+}
+
+static bool GetCacheKey( const ImageTool * tool, const ImageJob * job, char * key )
+{
+    CacheHasher hasher;
+    InitCacheHasher(&hasher);
+    HashOptions(&hasher, tool, job);
+    if(!HashFile(&hasher, job->inputFileName))
+        return false;
+    FinishCacheKey(&hasher, key);
+    return true;
+}
+
+/**
+ * Like the cache key, but without the input.
+ */
+static void GetOptionsKey( const ImageTool * tool, const ImageJob * job, char * key )
+{
+    CacheHasher hasher;
+    InitCacheHasher(&hasher);
+    HashOptions(&hasher, tool, job);
+    FinishCacheKey(&hasher, key);
+}
+
+
+// --- Incremental updates ---
+
+/**
+ * Reads the previous input and output, if they exist and still match.
+ * Both are only used if they were generated with the same options.
+ */
+static void ReadPreviousRun( const ImageTool * tool, Item * item )
+{
+    const ImageJob * job = &item->job;
+    char optionsKey[CacheKeyLength+1];
+    GetOptionsKey(tool, job, optionsKey);
+    if(!FileExists(job->previousInputFileName) ||
+       !FileExists(job->outputFileName) ||
+       !MatchPreviousOptions(job->previousInputFileName, optionsKey))
+        return;
+
+    Image * previousInput = tool->readInput(job->previousInputFileName, job->options);
+    Image * previousOutput = ReadImage(job->outputFileName);
+    const Image * input = item->input;
+    if(previousInput && previousOutput &&
+       previousInput->width  == input->width &&
+       previousInput->height == input->height &&
+       previousOutput->width  == input->width &&
+       previousOutput->height == input->height &&
+       previousOutput->channels == tool->outputChannels)
+    {
+        item->previousInput = previousInput;
+        item->output = previousOutput;
+        return;
+    }
+
+    if(previousInput)
+        FreeImage(previousInput);
+    if(previousOutput)
+        FreeImage(previousOutput);
+}
+
+/**
+ * Stores a copy of the input and the options, which the next run compares
+ * against.
+ */
+static bool UpdatePreviousInput( const ImageTool * tool, const ImageJob * job )
+{
+    if(!job->previousInputFileName)
+        return true;
+    char optionsKey[CacheKeyLength+1];
+    GetOptionsKey(tool, job, optionsKey);
+    return DuplicateFile(job->inputFileName, job->previousInputFileName) &&
+           WritePreviousOptions(job->previousInputFileName, optionsKey);
+}
+
+/**
+ * Regenerates the output around changed tiles of the previous input.
+ */
+static void UpdateOutput( const ImageTool * tool, Item * item, Arena * scratchArena )
+{
+    const Image * input = item->input;
+    const void * options = item->job.options;
+
+    TileGrid grid;
+    InitTileGrid(&grid, input->width, input->height, DefaultTileSize);
+    if(MarkChangedTiles(&grid, input->data, item->previousInput->data) == 0)
+    {
+        item->unchanged = true;
+    }
+    else
+    {
+        bool wrap;
+        const int reach = tool->getReach(options, &wrap);
+        DilateDirtyTiles(&grid, reach, wrap);
+
+        void * scratch = NULL;
+        if(tool->getRegionScratchSize)
+            scratch = ArenaAllocate(scratchArena,
+                tool->getRegionScratchSize(input, DefaultTileSize, options));
+
+        for(int row = 0; row < grid.rows; row++)
+        for(int column = 0; column < grid.columns; column++)
+        {
+            if(!grid.dirty[row*grid.columns + column])
+                continue;
+
+            int x, y, width, height;
+            GetTileRect(&grid, column, row, &x, &y, &width, &height);
+            tool->generateRegion(input, item->output, options,
+                                 x, y, width, height,
+                                 scratch);
+        }
+        ResetArena(scratchArena);
+    }
+    FreeTileGrid(&grid);
+
+    FreeImage(item->previousInput);
+    item->previousInput = NULL;
+}
+
+
+// --- Pipeline stages ---
+
+static bool DecodeItem( void * data, void * context, int workerIndex )
+{
+    Item * item = (Item *)data;
+    const ImageJob * job = &item->job;
+    const ImageToolContext * toolContext = (const ImageToolContext *)context;
+    const ImageTool * tool = toolContext->tool;
+    const CacheOptions * cache = &toolContext->cache;
+
+    if(cache->directory)
+    {
+        if(!GetCacheKey(tool, job, item->cacheKey))
+            return false;
+        item->cached = RestoreCachedFile(cache,
+                                         item->cacheKey,
+                                         job->outputFileName);
+        if(item->cached)
+            return UpdatePreviousInput(tool, job);
+    }
+
+    item->input = tool->readInput(job->inputFileName, job->options);
+    if(!item->input)
+        return false;
+
+    if(job->previousInputFileName)
+        ReadPreviousRun(tool, item);
+    return true;
+}
+
+static bool ComputeItem( void * data, void * context, int workerIndex )
+{
+    Item * item = (Item *)data;
+    if(item->cached)
+        return true;
+
+    const ImageToolContext * toolContext = (const ImageToolContext *)context;
+    const ImageTool * tool = toolContext->tool;
+    Arena * scratchArena = toolContext->scratchArenas[workerIndex];
+    Image * input = item->input;
+
+    if(item->previousInput)
+    {
+        UpdateOutput(tool, item, scratchArena);
+    }
+    else
+    {
+        item->output = CreateImage(input->width, input->height, tool->outputChannels);
+        tool->generate(input, item->output, item->job.options, scratchArena);
+        ResetArena(scratchArena);
+    }
+
+    // Free it early, so it doesn't count against the memory limit:
+    FreeImage(input);
+    item->input = NULL;
+    return true;
+}
+
+static bool EncodeItem( void * data, void * context, int workerIndex )
+{
+    Item * item = (Item *)data;
+    if(item->cached)
+        return true;
+
+    const ImageToolContext * toolContext = (const ImageToolContext *)context;
+
+    // The output is still up to date, if nothing changed:
+    bool success = item->unchanged ||
+                   WriteImage(item->output, item->job.outputFileName);
+    FreeImage(item->output);
+    item->output = NULL;
+
+    if(success)
+    {
+        StoreCachedFile(&toolContext->cache,
+                        item->cacheKey,
+                        item->job.outputFileName);
+        if(!item->unchanged)
+            success = UpdatePreviousInput(toolContext->tool, &item->job);
+    }
+    return success;
+}
+
+static size_t EstimateItemMemory( void * data, void * context )
+{
+    const Item * item = (const Item *)data;
+    const ImageTool * tool = ((const ImageToolContext *)context)->tool;
+    ImageInfo info;
+    if(!ReadImageInfo(item->job.inputFileName, &info))
+        return 0;
+
+    // Decoded input, extracted channel and output.  The scratch arenas are
+    // allocated per worker and thus not accounted here.
+    const size_t pixels = (size_t)info.width*info.height;
+    size_t planes = info.channels + 1 + tool->outputChannels;
+    if(item->job.previousInputFileName)
+        planes += 1; // Previous input channel
+    return pixels*sizeof(float)*planes;
+}
+
+/**
+ * The options of an item are stored right behind it.
+ */
+static Item * CreateDefaultItem( const ImageToolContext * context )
+{
+    const size_t optionsSize = context->tool->optionsSize;
+    Item * item = (Item *)malloc(sizeof(Item) + optionsSize);
+    memset(item, 0, sizeof(Item));
+    item->job = context->defaults;
+    item->job.options = &item[1];
+    memcpy(item->job.options, context->defaults.options, optionsSize);
+    return item;
+}
+
+static void * CreateItem( int argc, char * * argv, void * context )
+{
+    const ImageToolContext * toolContext = (const ImageToolContext *)context;
+
+    // Options given on the command line serve as defaults:
+    Item * item = CreateDefaultItem(toolContext);
+    if(!ParseImageToolArguments(argc, argv, toolContext->tool, &item->job,
+                                 NULL, NULL, NULL, NULL))
+    {
+        free(item);
+        return NULL;
+    }
+    return item;
+}
+
+static void FreeItem( void * data, void * context )
+{
+    Item * item = (Item *)data;
+    if(item->input)
+        FreeImage(item->input);
+    if(item->previousInput)
+        FreeImage(item->previousInput);
+    if(item->output)
+        FreeImage(item->output);
+    free(item);
+}
+
+static const char * GetInputFileName( const void * data )
+{
+    return ((const Item *)data)->job.inputFileName;
+}
+
+
+// --- Runs ---
+
+/**
+ * Runs the job given on the command line.
+ */
+static bool RunImageToolJob( ImageToolContext * context )
+{
+    Arena * scratchArena = CreateArena(0);
+    context->scratchArenas = &scratchArena;
+
+    Item * item = CreateDefaultItem(context);
+    const bool success = DecodeItem(item, context, 0) &&
+                         ComputeItem(item, context, 0) &&
+                         EncodeItem(item, context, 0);
+    FreeItem(item, context);
+
+    FreeArena(scratchArena);
+    context->scratchArenas = NULL;
+    return success;
+}
+
+/**
+ * Runs the jobs of a manifest or server.
+ */
+static bool RunImageToolJobs( ImageToolContext * context,
+                              const BatchOptions * options,
+                              const char * programName )
+{
+    PipelineOptions pipelineOptions = options->pipeline;
+    ResolvePipelineOptions(&pipelineOptions);
+    const int threads = pipelineOptions.threads[ComputeStage];
+
+    context->scratchArenas = (Arena * *)malloc(sizeof(Arena *)*threads);
+    for(int i = 0; i < threads; i++)
+        context->scratchArenas[i] = CreateArena(0);
+
+    BatchStages stages;
+    stages.createItem = CreateItem;
+    stages.freeItem = FreeItem;
+    stages.getInputFileName = GetInputFileName;
+    stages.stages.estimateMemory = EstimateItemMemory;
+    stages.stages.functions[DecodeStage]  = DecodeItem;
+    stages.stages.functions[ComputeStage] = ComputeItem;
+    stages.stages.functions[EncodeStage]  = EncodeItem;
+
+    BatchOptions resolvedOptions = *options;
+    resolvedOptions.pipeline = pipelineOptions;
+    bool success;
+    if(options->serverSocketName)
+        success = RunServer(&resolvedOptions, programName, &stages, context);
+    else if(options->watch)
+        success = RunWatch(&resolvedOptions, programName, &stages, context);
+    else
+        success = RunBatch(&resolvedOptions, programName, &stages, context);
+
+    for(int i = 0; i < threads; i++)
+        FreeArena(context->scratchArenas[i]);
+    free(context->scratchArenas);
+    context->scratchArenas = NULL;
+    return success;
+}
+
+int RunImageTool( const ImageTool * tool,
+                  void * defaultOptions,
+                  int argc,
+                  char * * argv )
+{
+    if(argc == 1)
+    {
+        PrintImageToolHelp(tool, argv[0]);
+        return 0;
+    }
+
+    ImageToolContext context;
+    InitImageToolContext(&context, tool, defaultOptions);
+
+    BatchOptions batchOptions;
+    InitBatchOptions(&batchOptions);
+
+    StatsOptions statsOptions;
+    InitStatsOptions(&statsOptions);
+
+    ImageOptions imageOptions;
+    InitImageOptions(&imageOptions);
+
+    if(!ParseImageToolArguments(argc, argv, tool, &context.defaults,
+                                &batchOptions, &context.cache,
+                                &statsOptions, &imageOptions))
+        return 1;
+    ApplyImageOptions(&imageOptions);
+    StartStats(&statsOptions);
+
+    bool success;
+    if(batchOptions.manifestFileName || batchOptions.serverSocketName)
+        success = RunImageToolJobs(&context, &batchOptions, argv[0]);
+    else
+        success = RunImageToolJob(&context);
+    TrimCache(&context.cache);
+    success = FinishStats() && success;
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#ifndef __IMAGETOOL_H__
+#define __IMAGETOOL_H__
+
+#include <stdbool.h>
+#include <stddef.h> // size_t
+#include "image.h"
+#include "allocator.h"
+#include "cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Plumbing of the tools which generate one image from a single channel of
+ * another, like gen-normalmap and gen-distancefield: job arguments, the
+ * output cache, incremental updates with `-p` and the pipeline stages of
+ * batch, watch and server mode.
+ *
+ * Tools describe their own options and how an output is generated in an
+ * #ImageTool.  Their options are opaque here; every job carries a copy.
+ */
+typedef struct
+{
+    /**
+     * Must change whenever the output for the same input and options
+     * changes.  Part of the cache key.
+     */
+    const char * version;
+
+    size_t optionsSize;
+
+    /**
+     * Channels of the output.  Previous outputs with a different count
+     * aren't updated incrementally.
+     */
+    int outputChannels;
+
+    /**
+     * Prints the tool specific options.
+     */
+    void (*printHelp)();
+
+    /**
+     * Parses the tool specific option at `argv[*i]`, if it is one.
+     *
+     * @return
+     * Like #ParseCacheOption.
+     */
+    int (*parseOption)( int argc, char * * argv, int * i, void * options );
+
+    /**
+     * Hashes everything in the options which affects the output.
+     */
+    void (*hashOptions)( CacheHasher * hasher, const void * options );
+
+    /**
+     * Reads the channel which the output is generated from.
+     */
+    Image * (*readInput)( const char * fileName, const void * options );
+
+    /**
+     * @param output
+     * Has the size of the input and #outputChannels.
+     *
+     * @param scratchArena
+     * Is reset afterwards.
+     */
+    void (*generate)( const Image * input,
+                      Image * output,
+                      const void * options,
+                      Arena * scratchArena );
+
+    /**
+     * Pixels around a changed input pixel whose output may change.
+     *
+     * @param wrap
+     * Receives whether changes reach across the edges.
+     */
+    int (*getReach)( const void * options, bool * wrap );
+
+    /**
+     * Regenerates a rectangle of an existing output.
+     *
+     * @param scratch
+     * #getRegionScratchSize bytes.
+     */
+    void (*generateRegion)( const Image * input,
+                            Image * output,
+                            const void * options,
+                            int x,
+                            int y,
+                            int width,
+                            int height,
+                            void * scratch );
+
+    /**
+     * Scratch memory which #generateRegion needs for a tile.  May be `NULL`
+     * if it needs none.
+     */
+    size_t (*getRegionScratchSize)( const Image * input,
+                                    int tileSize,
+                                    const void * options );
+} ImageTool;
+
+/**
+ * Runs the tool with the arguments of `main`: a single job, or the jobs of
+ * a manifest or server.
+ *
+ * @param defaultOptions
+ * Options of jobs which don't override them.
+ *
+ * @return
+ * Exit code of the process.
+ */
+int RunImageTool( const ImageTool * tool,
+                  void * defaultOptions,
+                  int argc,
+                  char * * argv );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+#include <stdio.h> // printf, putchar
+#include <string.h> // strcmp
+#include "image.h"
+
+static const char * DefaultFormat = "%n: %wx%h, %c channels, %b bit";
+
+static void PrintHelp( const char * programName )
+{
+    printf("%s [options] <input>...\n", programName);
+
+    printf("\t-f <format> (defaults to '%s')\n", DefaultFormat);
+    printf("\t\t%%w width\n");
+    printf("\t\t%%h height\n");
+    printf("\t\t%%c channels\n");
+    printf("\t\t%%b bits per channel\n");
+    printf("\t\t%%n file name\n");
+}
+
+static void PrintInfo( const char * format,
+                       const char * fileName,
+                       const ImageInfo * info )
+{
+    for(const char * c = format; *c; c++)
+    {
+        if(*c != '%')
+        {
+            putchar(*c);
+            continue;
+        }
+
+        c++;
+        switch(*c)
+        {
+            case 'w': printf("%d", info->width);    break;
+            case 'h': printf("%d", info->height);   break;
+            case 'c': printf("%d", info->channels); break;
+            case 'b': printf("%d", info->bitDepth); break;
+            case 'n': printf("%s", fileName);       break;
+            case '%': putchar('%');                 break;
+            case '\0': // Trailing '%'
+                putchar('%');
+                c--;
+                break;
+            default:
+                putchar('%');
+                putchar(*c);
+        }
+    }
+    putchar('\n');
+}
+
+int main( int argc, char * * argv )
+{
+    if(argc == 1)
+    {
+        PrintHelp(argv[0]);
+        return 0;
+    }
+
+    const char * format = DefaultFormat;
+    int fileCount = 0;
+    bool success = true;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-f") == 0)
+        {
+            if(i+1 < argc)
+            {
+                i++;
+                format = argv[i];
+            }
+            else
+            {
+                printf("Option needs a value.\n");
+                return 1;
+            }
+        }
+        else if(argv[i][0] == '-')
+        {
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+        else
+        {
+            ImageInfo info;
+            if(ReadImageInfo(argv[i], &info))
+                PrintInfo(format, argv[i], &info);
+            else
+                success = false;
+            fileCount++;
+        }
+    }
+
+    if(fileCount == 0)
+    {
+        printf("File parameter(s) are missing.\n");
+        return 1;
+    }
+
+    return success ? 0 : 1;
+}
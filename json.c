@@ -0,0 +1,385 @@
+#include <stdio.h> // fopen, fread, fprintf
+#include <stdlib.h> // strtod, malloc, realloc, free
+#include <string.h> // memset
+#include "json.h"
+
+
+enum
+{
+    BufferSize = 64*1024,
+    MaxDepth = 512,
+    EndOfFile = -1
+};
+
+typedef struct
+{
+    FILE * file;
+    const char * fileName;
+    unsigned char buffer[BufferSize];
+    int position;
+    int size;
+    int line;
+
+    const JsonHandler * handler;
+    void * context;
+    bool failed; // Already reported
+
+    // Reused by strings, keys and numbers:
+    char * text;
+    int textLength;
+    int textCapacity;
+} Parser;
+
+
+static int Peek( Parser * parser )
+{
+    if(parser->position == parser->size)
+    {
+        parser->size = (int)fread(parser->buffer, 1, BufferSize, parser->file);
+        parser->position = 0;
+        if(parser->size == 0)
+            return EndOfFile;
+    }
+    return parser->buffer[parser->position];
+}
+
+static int Next( Parser * parser )
+{
+    const int c = Peek(parser);
+    if(c != EndOfFile)
+    {
+        parser->position++;
+        if(c == '\n')
+            parser->line++;
+    }
+    return c;
+}
+
+static bool Fail( Parser * parser, const char * message )
+{
+    if(!parser->failed)
+        fprintf(stderr, "%s:%d: %s\n", parser->fileName, parser->line, message);
+    parser->failed = true;
+    return false;
+}
+
+static bool Stopped( Parser * parser )
+{
+    // Callbacks report their own errors:
+    parser->failed = true;
+    return false;
+}
+
+static void SkipWhitespace( Parser * parser )
+{
+    for(;;)
+    {
+        const int c = Peek(parser);
+        if(c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            return;
+        Next(parser);
+    }
+}
+
+static void AppendText( Parser * parser, char c )
+{
+    if(parser->textLength+1 >= parser->textCapacity)
+    {
+        parser->textCapacity = parser->textCapacity ? parser->textCapacity*2 : 256;
+        parser->text = (char *)realloc(parser->text, parser->textCapacity);
+    }
+    parser->text[parser->textLength++] = c;
+    parser->text[parser->textLength] = '\0';
+}
+
+static void ClearText( Parser * parser )
+{
+    parser->textLength = 0;
+    AppendText(parser, '\0');
+    parser->textLength = 0;
+}
+
+static void AppendUtf8( Parser * parser, unsigned long codePoint )
+{
+    if(codePoint < 0x80)
+    {
+        AppendText(parser, (char)codePoint);
+    }
+    else if(codePoint < 0x800)
+    {
+        AppendText(parser, (char)(0xc0 | (codePoint >> 6)));
+        AppendText(parser, (char)(0x80 | (codePoint & 0x3f)));
+    }
+    else if(codePoint < 0x10000)
+    {
+        AppendText(parser, (char)(0xe0 | (codePoint >> 12)));
+        AppendText(parser, (char)(0x80 | ((codePoint >> 6) & 0x3f)));
+        AppendText(parser, (char)(0x80 | (codePoint & 0x3f)));
+    }
+    else
+    {
+        AppendText(parser, (char)(0xf0 | (codePoint >> 18)));
+        AppendText(parser, (char)(0x80 | ((codePoint >> 12) & 0x3f)));
+        AppendText(parser, (char)(0x80 | ((codePoint >> 6) & 0x3f)));
+        AppendText(parser, (char)(0x80 | (codePoint & 0x3f)));
+    }
+}
+
+static bool ReadHexDigits( Parser * parser, unsigned long * value )
+{
+    *value = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        const int c = Next(parser);
+        int digit;
+        if(c >= '0' && c <= '9')
+            digit = c - '0';
+        else if(c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return Fail(parser, "Invalid unicode escape.");
+        *value = (*value << 4) | (unsigned long)digit;
+    }
+    return true;
+}
+
+/**
+ * Reads a string into the text buffer.  The opening quote has already
+ * been consumed.
+ */
+static bool ReadString( Parser * parser )
+{
+    ClearText(parser);
+    for(;;)
+    {
+        const int c = Next(parser);
+        if(c == EndOfFile || c == '\n')
+            return Fail(parser, "Unterminated string.");
+        if(c == '"')
+            return true;
+        if(c != '\\')
+        {
+            AppendText(parser, (char)c);
+            continue;
+        }
+
+        const int escape = Next(parser);
+        switch(escape)
+        {
+            case '"':  AppendText(parser, '"');  break;
+            case '\\': AppendText(parser, '\\'); break;
+            case '/':  AppendText(parser, '/');  break;
+            case 'b':  AppendText(parser, '\b'); break;
+            case 'f':  AppendText(parser, '\f'); break;
+            case 'n':  AppendText(parser, '\n'); break;
+            case 'r':  AppendText(parser, '\r'); break;
+            case 't':  AppendText(parser, '\t'); break;
+            case 'u':
+            {
+                unsigned long codePoint;
+                if(!ReadHexDigits(parser, &codePoint))
+                    return false;
+                // Characters outside the BMP are written as surrogate pair:
+                if(codePoint >= 0xd800 && codePoint < 0xdc00)
+                {
+                    unsigned long low;
+                    if(Next(parser) != '\\' || Next(parser) != 'u' ||
+                       !ReadHexDigits(parser, &low) ||
+                       low < 0xdc00 || low >= 0xe000)
+                        return Fail(parser, "Invalid surrogate pair.");
+                    codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                }
+                AppendUtf8(parser, codePoint);
+                break;
+            }
+            default:
+                return Fail(parser, "Invalid escape sequence.");
+        }
+    }
+}
+
+static bool ReadNumber( Parser * parser )
+{
+    ClearText(parser);
+    bool integer = true;
+    for(;;)
+    {
+        const int c = Peek(parser);
+        if(c == '.' || c == 'e' || c == 'E')
+            integer = false;
+        else if(!(c >= '0' && c <= '9') && c != '-' && c != '+')
+            break;
+        AppendText(parser, (char)Next(parser));
+    }
+
+    char * end;
+    const double value = strtod(parser->text, &end);
+    if(parser->textLength == 0 || *end != '\0')
+        return Fail(parser, "Invalid number.");
+
+    const JsonHandler * handler = parser->handler;
+    if(handler->number && !handler->number(parser->context, value, integer))
+        return Stopped(parser);
+    return true;
+}
+
+static bool ReadLiteral( Parser * parser, const char * literal )
+{
+    for(const char * c = literal; *c; c++)
+        if(Next(parser) != *c)
+            return Fail(parser, "Unexpected character.");
+    return true;
+}
+
+static bool ReadValue( Parser * parser, int depth );
+
+static bool ReadObject( Parser * parser, int depth )
+{
+    const JsonHandler * handler = parser->handler;
+    if(handler->beginObject && !handler->beginObject(parser->context))
+        return Stopped(parser);
+
+    SkipWhitespace(parser);
+    if(Peek(parser) == '}')
+        Next(parser);
+    else for(;;)
+    {
+        SkipWhitespace(parser);
+        if(Next(parser) != '"')
+            return Fail(parser, "Expected a key.");
+        if(!ReadString(parser))
+            return false;
+        if(handler->key && !handler->key(parser->context, parser->text))
+            return Stopped(parser);
+
+        SkipWhitespace(parser);
+        if(Next(parser) != ':')
+            return Fail(parser, "Expected ':'.");
+        if(!ReadValue(parser, depth+1))
+            return false;
+
+        SkipWhitespace(parser);
+        const int c = Next(parser);
+        if(c == '}')
+            break;
+        if(c != ',')
+            return Fail(parser, "Expected ',' or '}'.");
+    }
+
+    if(handler->endObject && !handler->endObject(parser->context))
+        return Stopped(parser);
+    return true;
+}
+
+static bool ReadArray( Parser * parser, int depth )
+{
+    const JsonHandler * handler = parser->handler;
+    if(handler->beginArray && !handler->beginArray(parser->context))
+        return Stopped(parser);
+
+    SkipWhitespace(parser);
+    if(Peek(parser) == ']')
+        Next(parser);
+    else for(;;)
+    {
+        if(!ReadValue(parser, depth+1))
+            return false;
+
+        SkipWhitespace(parser);
+        const int c = Next(parser);
+        if(c == ']')
+            break;
+        if(c != ',')
+            return Fail(parser, "Expected ',' or ']'.");
+    }
+
+    if(handler->endArray && !handler->endArray(parser->context))
+        return Stopped(parser);
+    return true;
+}
+
+static bool ReadValue( Parser * parser, int depth )
+{
+    if(depth > MaxDepth)
+        return Fail(parser, "Nested too deeply.");
+
+    const JsonHandler * handler = parser->handler;
+    SkipWhitespace(parser);
+    const int c = Peek(parser);
+    switch(c)
+    {
+        case '{':
+            Next(parser);
+            return ReadObject(parser, depth);
+
+        case '[':
+            Next(parser);
+            return ReadArray(parser, depth);
+
+        case '"':
+            Next(parser);
+            if(!ReadString(parser))
+                return false;
+            if(handler->string && !handler->string(parser->context, parser->text))
+                return Stopped(parser);
+            return true;
+
+        case 't':
+        case 'f':
+            if(!ReadLiteral(parser, (c == 't') ? "true" : "false"))
+                return false;
+            if(handler->boolean && !handler->boolean(parser->context, c == 't'))
+                return Stopped(parser);
+            return true;
+
+        case 'n':
+            if(!ReadLiteral(parser, "null"))
+                return false;
+            if(handler->null && !handler->null(parser->context))
+                return Stopped(parser);
+            return true;
+
+        case EndOfFile:
+            return Fail(parser, "Unexpected end of file.");
+
+        default:
+            if(c == '-' || (c >= '0' && c <= '9'))
+                return ReadNumber(parser);
+            return Fail(parser, "Unexpected character.");
+    }
+}
+
+bool ParseJsonFile( const char * fileName,
+                    const JsonHandler * handler,
+                    void * context )
+{
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for reading.\n", fileName);
+        return false;
+    }
+
+    Parser * parser = (Parser *)malloc(sizeof(Parser));
+    memset(parser, 0, sizeof(Parser));
+    parser->file = file;
+    parser->fileName = fileName;
+    parser->line = 1;
+    parser->handler = handler;
+    parser->context = context;
+
+    bool success = ReadValue(parser, 0);
+    if(success)
+    {
+        SkipWhitespace(parser);
+        if(Peek(parser) != EndOfFile)
+            success = Fail(parser, "Unexpected data after the document.");
+    }
+
+    fclose(file);
+    free(parser->text);
+    free(parser);
+    return success;
+}
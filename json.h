@@ -0,0 +1,57 @@
+#ifndef __JSON_H__
+#define __JSON_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Streaming (SAX style) JSON parser.  Values are passed to the callbacks as
+ * soon as they've been read, so documents of any size can be processed
+ * without building a tree.
+ *
+ * Strings passed to callbacks are only valid during the call.  Any callback
+ * may be `NULL`.  Returning `false` from a callback stops the parser.
+ */
+typedef struct
+{
+    bool (*beginObject)( void * context );
+    bool (*endObject)( void * context );
+    bool (*beginArray)( void * context );
+    bool (*endArray)( void * context );
+
+    /**
+     * Called for each member of an object, before its value.
+     */
+    bool (*key)( void * context, const char * key );
+
+    bool (*string)( void * context, const char * value );
+
+    /**
+     * @param integer
+     * Whether the number was written without fraction and exponent.
+     */
+    bool (*number)( void * context, double value, bool integer );
+
+    bool (*boolean)( void * context, bool value );
+    bool (*null)( void * context );
+} JsonHandler;
+
+/**
+ * Parses a complete JSON document.
+ *
+ * @return
+ * `false` if the file couldn't be read, was malformed or a callback
+ * stopped the parser.  Syntax errors are reported with their line.
+ */
+bool ParseJsonFile( const char * fileName,
+                    const JsonHandler * handler,
+                    void * context );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
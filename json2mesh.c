@@ -0,0 +1,480 @@
+#include <stdio.h> // printf, fprintf
+#include <string.h> // strcmp, strlen, memcpy, memset
+#include <stdlib.h> // malloc, realloc, free, atoi
+#include "json.h"
+#include "mesh.h"
+#include "meshoptimize.h"
+#include "meshsimplify.h"
+#include "threadpool.h"
+
+/**
+ * Converts the scene tree written by blend2json (io_scene_json) into the
+ * binary format of meshfile.h.
+ *
+ * Every JSON object is a map of child names to objects.  Objects may have
+ * `vertices` (objects with x/y/z, nx/ny/nz, tx/ty and r/g/b), `faces`
+ * (arrays of vertex indices), scalar custom properties and more children.
+ */
+
+typedef enum
+{
+    SceneFrame,
+    ObjectFrame,
+    VerticesFrame,
+    VertexFrame,
+    FacesFrame,
+    FaceFrame,
+    SkipFrame // Values which don't matter, like arrays in properties
+} FrameType;
+
+typedef struct
+{
+    FrameType type;
+    int object; // Index of the enclosing object, -1 in the scene frame
+} Frame;
+
+typedef struct
+{
+    const char * fileName;
+    Mesh * mesh;
+
+    Frame * frames;
+    int frameCount;
+    int frameCapacity;
+
+    char * key; // Of the current member
+    int keyCapacity;
+
+    MeshVertex * vertex; // Being read
+    uint32_t face[256]; // Indices of the polygon being read
+    int faceSize;
+    bool failed;
+} Converter;
+
+
+static Frame * GetFrame( Converter * converter )
+{
+    return converter->frameCount ? &converter->frames[converter->frameCount-1] : NULL;
+}
+
+static void PushFrame( Converter * converter, FrameType type, int object )
+{
+    if(converter->frameCount == converter->frameCapacity)
+    {
+        converter->frameCapacity = converter->frameCapacity ? converter->frameCapacity*2 : 16;
+        converter->frames = (Frame *)realloc(converter->frames,
+                                             sizeof(Frame)*converter->frameCapacity);
+    }
+    Frame * frame = &converter->frames[converter->frameCount++];
+    frame->type = type;
+    frame->object = object;
+}
+
+static bool PopFrame( void * context )
+{
+    Converter * converter = (Converter *)context;
+    converter->frameCount--;
+    return true;
+}
+
+static bool Fail( Converter * converter, const char * message )
+{
+    fprintf(stderr, "%s: %s\n", converter->fileName, message);
+    converter->failed = true;
+    return false;
+}
+
+static bool BeginObject( void * context )
+{
+    Converter * converter = (Converter *)context;
+    Frame * frame = GetFrame(converter);
+    if(!frame)
+    {
+        PushFrame(converter, SceneFrame, -1);
+        return true;
+    }
+
+    switch(frame->type)
+    {
+        case SceneFrame:
+        case ObjectFrame:
+        {
+            const int object = AddMeshObject(converter->mesh,
+                                             converter->key,
+                                             frame->object);
+            PushFrame(converter, ObjectFrame, object);
+            return true;
+        }
+
+        case VerticesFrame:
+        {
+            MeshObject * object = &converter->mesh->objects[frame->object];
+            converter->vertex = AddMeshVertex(object);
+            PushFrame(converter, VertexFrame, frame->object);
+            return true;
+        }
+
+        default:
+            PushFrame(converter, SkipFrame, frame->object);
+            return true;
+    }
+}
+
+static bool BeginArray( void * context )
+{
+    Converter * converter = (Converter *)context;
+    Frame * frame = GetFrame(converter);
+    if(!frame)
+        return Fail(converter, "Expected an object at the top.");
+
+    if(frame->type == ObjectFrame && strcmp(converter->key, "vertices") == 0)
+    {
+        PushFrame(converter, VerticesFrame, frame->object);
+    }
+    else if(frame->type == ObjectFrame && strcmp(converter->key, "faces") == 0)
+    {
+        PushFrame(converter, FacesFrame, frame->object);
+    }
+    else if(frame->type == FacesFrame)
+    {
+        converter->faceSize = 0;
+        PushFrame(converter, FaceFrame, frame->object);
+    }
+    else
+    {
+        PushFrame(converter, SkipFrame, frame->object);
+    }
+    return true;
+}
+
+/**
+ * Splits the polygon into a triangle fan.  Exports are usually
+ * triangulated already.
+ */
+static bool EndArray( void * context )
+{
+    Converter * converter = (Converter *)context;
+    const Frame * frame = GetFrame(converter);
+    if(frame->type == FaceFrame)
+    {
+        MeshObject * object = &converter->mesh->objects[frame->object];
+        for(int i = 2; i < converter->faceSize; i++)
+        {
+            AddMeshIndex(object, converter->face[0]);
+            AddMeshIndex(object, converter->face[i-1]);
+            AddMeshIndex(object, converter->face[i]);
+        }
+    }
+    return PopFrame(context);
+}
+
+static bool EndObject( void * context )
+{
+    Converter * converter = (Converter *)context;
+    const Frame * frame = GetFrame(converter);
+    if(frame->type == ObjectFrame)
+    {
+        // Faces may come before the vertices, so they're checked at the end:
+        const MeshObject * object = &converter->mesh->objects[frame->object];
+        for(int i = 0; i < object->indexCount; i++)
+        {
+            if(object->indices[i] >= (uint32_t)object->vertexCount)
+            {
+                fprintf(stderr, "%s: Face of '%s' references a missing vertex.\n",
+                        converter->fileName, object->name);
+                converter->failed = true;
+                return false;
+            }
+        }
+    }
+    return PopFrame(context);
+}
+
+static bool Key( void * context, const char * key )
+{
+    Converter * converter = (Converter *)context;
+    const int length = (int)strlen(key);
+    if(length+1 > converter->keyCapacity)
+    {
+        converter->keyCapacity = (length+1)*2;
+        converter->key = (char *)realloc(converter->key, converter->keyCapacity);
+    }
+    memcpy(converter->key, key, length+1);
+    return true;
+}
+
+static bool SetVertexComponent( Converter * converter, double value )
+{
+    static const char * const Names[] =
+        {"x", "y", "z", "nx", "ny", "nz", "tx", "ty", "r", "g", "b", NULL};
+
+    MeshVertex * vertex = converter->vertex;
+    float * const Components[] =
+    {
+        &vertex->position[0], &vertex->position[1], &vertex->position[2],
+        &vertex->normal[0],   &vertex->normal[1],   &vertex->normal[2],
+        &vertex->texCoord[0], &vertex->texCoord[1],
+        &vertex->color[0],    &vertex->color[1],    &vertex->color[2]
+    };
+
+    for(int i = 0; Names[i]; i++)
+    {
+        if(strcmp(converter->key, Names[i]) != 0)
+            continue;
+        *Components[i] = (float)value;
+        if(i == 6)
+            converter->mesh->hasTexCoords = true;
+        else if(i == 8)
+            converter->mesh->hasColors = true;
+        return true;
+    }
+    return true; // Unknown components are ignored
+}
+
+static MeshProperty * AddProperty( Converter * converter )
+{
+    const Frame * frame = GetFrame(converter);
+    if(frame->type != ObjectFrame)
+        return NULL;
+    MeshObject * object = &converter->mesh->objects[frame->object];
+    return AddMeshProperty(object, converter->key);
+}
+
+static bool Number( void * context, double value, bool integer )
+{
+    Converter * converter = (Converter *)context;
+    const Frame * frame = GetFrame(converter);
+    if(!frame)
+        return Fail(converter, "Expected an object at the top.");
+
+    if(frame->type == VertexFrame)
+        return SetVertexComponent(converter, value);
+
+    if(frame->type == FaceFrame)
+    {
+        if(value < 0 || value > 4294967295.0 || value != (double)(uint32_t)value)
+            return Fail(converter, "Invalid vertex index.");
+        if(converter->faceSize == (int)(sizeof(converter->face)/sizeof(converter->face[0])))
+            return Fail(converter, "Face has too many vertices.");
+        converter->face[converter->faceSize++] = (uint32_t)value;
+        return true;
+    }
+
+    MeshProperty * property = AddProperty(converter);
+    if(property)
+    {
+        property->type = integer ? MeshIntegerProperty : MeshFloatProperty;
+        property->number = value;
+    }
+    return true;
+}
+
+static bool Boolean( void * context, bool value )
+{
+    Converter * converter = (Converter *)context;
+    MeshProperty * property = GetFrame(converter) ? AddProperty(converter) : NULL;
+    if(property)
+    {
+        property->type = MeshBooleanProperty;
+        property->number = value ? 1 : 0;
+    }
+    return true;
+}
+
+static bool String( void * context, const char * value )
+{
+    Converter * converter = (Converter *)context;
+    MeshProperty * property = GetFrame(converter) ? AddProperty(converter) : NULL;
+    if(property)
+    {
+        const size_t length = strlen(value);
+        property->type = MeshStringProperty;
+        property->string = (char *)malloc(length+1);
+        memcpy(property->string, value, length+1);
+    }
+    return true;
+}
+
+static bool ReadSceneJson( const char * fileName, Mesh * mesh )
+{
+    static const JsonHandler Handler =
+    {
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Key,
+        String,
+        Number,
+        Boolean,
+        NULL
+    };
+
+    Converter converter;
+    memset(&converter, 0, sizeof(converter));
+    converter.fileName = fileName;
+    converter.mesh = mesh;
+
+    const bool success = ParseJsonFile(fileName, &Handler, &converter) &&
+                         !converter.failed;
+    free(converter.frames);
+    free(converter.key);
+    return success;
+}
+
+static void PrintHelp( const char * programName )
+{
+    printf("%s [options] <input.json> <output>\n", programName);
+    printf("\t-q (store positions and texture coordinates as 16 bit and normals\n"
+           "\t    in octahedral encoding)\n");
+    printf("\t-o (reorder triangles and vertices for the vertex cache and less\n"
+           "\t    overdraw, prints the ACMR and ATVR of each object)\n");
+    printf("\t-l <levels> (add simplified levels of detail, each with half the\n"
+           "\t    triangles of the previous one)\n");
+    printf("\t-j <threads> (defaults to one per processor)\n");
+}
+
+typedef struct
+{
+    MeshObject * object;
+    int levelCount;
+    bool optimize;
+    VertexCacheStats before;
+    VertexCacheStats after;
+} ObjectTask;
+
+static void ProcessObject( void * data, int workerIndex )
+{
+    ObjectTask * task = (ObjectTask *)data;
+    MeshObject * object = task->object;
+
+    GenerateMeshLevels(object, task->levelCount, 0.5f);
+
+    if(!task->optimize)
+        return;
+    AnalyzeVertexCache(object->indices,
+                       object->indexCount,
+                       object->vertexCount,
+                       DefaultVertexCacheSize,
+                       &task->before);
+    OptimizeMeshObject(object, DefaultVertexCacheSize, 1.05f);
+    AnalyzeVertexCache(object->indices,
+                       object->indexCount,
+                       object->vertexCount,
+                       DefaultVertexCacheSize,
+                       &task->after);
+}
+
+/**
+ * Objects are independent, so they're processed concurrently.
+ */
+static void ProcessObjects( Mesh * mesh, int levelCount, bool optimize, int threadCount )
+{
+    ObjectTask * tasks = (ObjectTask *)malloc(sizeof(ObjectTask)*(mesh->objectCount+1));
+    ThreadPool * pool = CreateThreadPool(threadCount);
+    for(int i = 0; i < mesh->objectCount; i++)
+    {
+        ObjectTask * task = &tasks[i];
+        memset(task, 0, sizeof(ObjectTask));
+        task->object = &mesh->objects[i];
+        task->levelCount = levelCount;
+        task->optimize = optimize;
+        if(task->object->indexCount > 0)
+            SubmitTask(pool, ProcessObject, task);
+    }
+    WaitForTasks(pool);
+    FreeThreadPool(pool);
+
+    for(int i = 0; i < mesh->objectCount; i++)
+    {
+        const ObjectTask * task = &tasks[i];
+        const MeshObject * object = task->object;
+        if(object->indexCount == 0)
+            continue;
+        if(optimize)
+            printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+                   object->name,
+                   task->before.acmr, task->after.acmr,
+                   task->before.atvr, task->after.atvr);
+        for(int j = 0; j < object->levelCount; j++)
+            printf("%s: level %d has %d triangles, error %.5f\n",
+                   object->name,
+                   j+1,
+                   object->levels[j].indexCount/3,
+                   object->levels[j].error);
+    }
+    free(tasks);
+}
+
+int main( int argc, char * * argv )
+{
+    if(argc == 1)
+    {
+        PrintHelp(argv[0]);
+        return 0;
+    }
+
+    bool quantize = false;
+    bool optimize = false;
+    int levelCount = 0;
+    int threadCount = 0;
+    const char * inputFileName = NULL;
+    const char * outputFileName = NULL;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-q") == 0)
+        {
+            quantize = true;
+        }
+        else if(strcmp(argv[i], "-o") == 0)
+        {
+            optimize = true;
+        }
+        else if(strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "-j") == 0)
+        {
+            if(i+1 >= argc)
+            {
+                printf("Option needs a value.\n");
+                return 1;
+            }
+            if(argv[i][1] == 'l')
+                levelCount = atoi(argv[i+1]);
+            else
+                threadCount = atoi(argv[i+1]);
+            i++;
+        }
+        else if(argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+        else if(!inputFileName)
+        {
+            inputFileName = argv[i];
+        }
+        else if(!outputFileName)
+        {
+            outputFileName = argv[i];
+        }
+        else
+        {
+            printf("Too many parameters.\n");
+            return 1;
+        }
+    }
+
+    if(!inputFileName || !outputFileName)
+    {
+        printf("File parameter(s) are missing.\n");
+        return 1;
+    }
+
+    Mesh mesh;
+    InitMesh(&mesh);
+    bool success = ReadSceneJson(inputFileName, &mesh);
+    if(success && (optimize || levelCount > 0))
+        ProcessObjects(&mesh, levelCount, optimize, threadCount);
+    success = success && WriteMeshFile(&mesh, outputFileName, quantize);
+    FreeMesh(&mesh);
+    return success ? 0 : 1;
+}
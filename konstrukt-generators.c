@@ -0,0 +1,472 @@
+#include <stdio.h> // fprintf
+#include <stdlib.h> // malloc, free
+#include <string.h> // memset, memcpy
+#include <stdint.h> // uint8_t, uint16_t
+#include "konstrukt-generators.h"
+#include "allocator.h"
+#include "pixelformat.h"
+#include "threadpool.h"
+#include "normalmap.h"
+#include "distancefield.h"
+
+enum
+{
+    TileSize = 128
+};
+
+struct KonstruktContext
+{
+    ThreadPool * pool;
+    Arena * * scratchArenas; // One per worker
+};
+
+typedef struct
+{
+    const KonstruktImageView * input;
+    const KonstruktImageView * output;
+    const KonstruktNormalMapOptions * normalMapOptions; // Or `NULL`
+    float maxDistance;
+    int margin; // Input pixels needed around a tile
+} Operation;
+
+typedef struct
+{
+    const Operation * operation;
+    KonstruktContext * context;
+    KonstruktRect rect;
+} Tile;
+
+
+void KonstruktGetVersion( int * major, int * minor )
+{
+    *major = KONSTRUKT_GENERATORS_VERSION_MAJOR;
+    *minor = KONSTRUKT_GENERATORS_VERSION_MINOR;
+}
+
+KonstruktContext * KonstruktCreateContext( int threadCount )
+{
+    KonstruktContext * context = (KonstruktContext *)malloc(sizeof(KonstruktContext));
+    context->pool = CreateThreadPool(threadCount);
+
+    const int workers = GetThreadPoolSize(context->pool);
+    context->scratchArenas = (Arena * *)malloc(sizeof(Arena *)*workers);
+    for(int i = 0; i < workers; i++)
+        context->scratchArenas[i] = CreateArena(0);
+    return context;
+}
+
+void KonstruktFreeContext( KonstruktContext * context )
+{
+    const int workers = GetThreadPoolSize(context->pool);
+    FreeThreadPool(context->pool);
+    for(int i = 0; i < workers; i++)
+        FreeArena(context->scratchArenas[i]);
+    free(context->scratchArenas);
+    memset(context, 0, sizeof(KonstruktContext));
+    free(context);
+}
+
+
+// --- Pixel access ---
+
+static size_t GetComponentSize( KonstruktPixelType type )
+{
+    switch(type)
+    {
+        case KonstruktU8:  return sizeof(uint8_t);
+        case KonstruktU16: return sizeof(uint16_t);
+        default:           return sizeof(float);
+    }
+}
+
+static unsigned char * GetPixel( const KonstruktImageView * view, int x, int y )
+{
+    return (unsigned char *)view->data + y*view->rowStride + x*view->pixelStride;
+}
+
+/**
+ * Converts the first component of `count` pixels to floats.
+ */
+static void ReadRow( const KonstruktImageView * view,
+                     int x,
+                     int y,
+                     int count,
+                     float * destination )
+{
+    const unsigned char * pixel = GetPixel(view, x, y);
+    const size_t componentSize = GetComponentSize(view->type);
+
+    // Single channel rows can be converted in one go:
+    if(view->pixelStride == (ptrdiff_t)componentSize)
+    {
+        switch(view->type)
+        {
+            case KonstruktU8:
+                ConvertU8ToFloat((const uint8_t *)pixel, destination, count);
+                break;
+            case KonstruktU16:
+                ConvertU16ToFloat((const uint16_t *)pixel, destination, count);
+                break;
+            default:
+                memcpy(destination, pixel, sizeof(float)*count);
+        }
+        return;
+    }
+
+    for(int i = 0; i < count; i++, pixel += view->pixelStride)
+    {
+        switch(view->type)
+        {
+            case KonstruktU8:
+                ConvertU8ToFloat((const uint8_t *)pixel, &destination[i], 1);
+                break;
+            case KonstruktU16:
+                ConvertU16ToFloat((const uint16_t *)pixel, &destination[i], 1);
+                break;
+            default:
+                memcpy(&destination[i], pixel, sizeof(float));
+        }
+    }
+}
+
+/**
+ * Like #ReadRow, but wraps around the image edges.
+ */
+static void ReadWrappedRow( const KonstruktImageView * view,
+                            int x,
+                            int y,
+                            int count,
+                            float * destination )
+{
+    y = ((y % view->height) + view->height) % view->height;
+    for(int i = 0; i < count;)
+    {
+        const int sourceX = (((x+i) % view->width) + view->width) % view->width;
+        int n = view->width - sourceX;
+        if(n > count-i)
+            n = count-i;
+        ReadRow(view, sourceX, y, n, &destination[i]);
+        i += n;
+    }
+}
+
+/**
+ * Converts `count` pixels with `components` floats each.
+ */
+static void WriteRow( const KonstruktImageView * view,
+                      int x,
+                      int y,
+                      int count,
+                      int components,
+                      const float * source )
+{
+    unsigned char * pixel = GetPixel(view, x, y);
+    const size_t componentSize = GetComponentSize(view->type);
+
+    // Consecutive pixels can be converted in one go:
+    size_t runLength = 1;
+    if(view->pixelStride == (ptrdiff_t)(componentSize*components))
+    {
+        runLength = count;
+        count = 1;
+    }
+
+    for(int i = 0; i < count; i++, pixel += view->pixelStride)
+    {
+        const float * values = &source[i*components];
+        const size_t n = runLength*components;
+        switch(view->type)
+        {
+            case KonstruktU8:
+                ConvertFloatToU8(values, (uint8_t *)pixel, n);
+                break;
+            case KonstruktU16:
+                ConvertFloatToU16(values, (uint16_t *)pixel, n);
+                break;
+            default:
+                memcpy(pixel, values, sizeof(float)*n);
+        }
+    }
+}
+
+
+// --- Tiles ---
+
+/**
+ * Reads the input around a tile, so it can be processed on its own.
+ * Outside of tiled images the window is cropped to the image.
+ */
+static float * ReadWindow( const Operation * operation,
+                           const KonstruktRect * rect,
+                           bool wrap,
+                           Arena * arena,
+                           KonstruktRect * window )
+{
+    const KonstruktImageView * input = operation->input;
+    const int margin = operation->margin;
+
+    window->x = rect->x - margin;
+    window->y = rect->y - margin;
+    int right  = rect->x + rect->width  + margin;
+    int bottom = rect->y + rect->height + margin;
+    if(!wrap)
+    {
+        if(window->x < 0)
+            window->x = 0;
+        if(window->y < 0)
+            window->y = 0;
+        if(right > input->width)
+            right = input->width;
+        if(bottom > input->height)
+            bottom = input->height;
+    }
+    window->width  = right  - window->x;
+    window->height = bottom - window->y;
+
+    float * pixels = (float *)ArenaAllocate(arena,
+        sizeof(float)*window->width*window->height);
+    for(int y = 0; y < window->height; y++)
+    {
+        float * row = &pixels[y*window->width];
+        if(wrap)
+            ReadWrappedRow(input, window->x, window->y+y, window->width, row);
+        else
+            ReadRow(input, window->x, window->y+y, window->width, row);
+    }
+    return pixels;
+}
+
+static void ProcessNormalMapTile( const Tile * tile, Arena * arena )
+{
+    const Operation * operation = tile->operation;
+    const KonstruktNormalMapOptions * options = operation->normalMapOptions;
+    const KonstruktRect * rect = &tile->rect;
+
+    KonstruktRect window;
+    float * heightMap = ReadWindow(operation, rect, options->wrap, arena, &window);
+    float * normalMap = (float *)ArenaAllocate(arena,
+        sizeof(float)*window.width*window.height*3);
+
+    // The window already contains the wrapped heights, and cropped windows
+    // end at the image edges, so the kernel doesn't need to wrap:
+    GenerateNormalMapRegion(window.width,
+                            window.height,
+                            heightMap,
+                            normalMap,
+                            (NormalMapFilter)options->filter,
+                            false,
+                            options->invertY,
+                            rect->x - window.x,
+                            rect->y - window.y,
+                            rect->width,
+                            rect->height);
+
+    for(int y = 0; y < rect->height; y++)
+    {
+        const int windowY = rect->y - window.y + y;
+        const int windowX = rect->x - window.x;
+        WriteRow(operation->output,
+                 rect->x,
+                 rect->y + y,
+                 rect->width,
+                 3,
+                 &normalMap[(windowY*window.width + windowX)*3]);
+    }
+}
+
+static void ProcessDistanceFieldTile( const Tile * tile, Arena * arena )
+{
+    const Operation * operation = tile->operation;
+    const KonstruktRect * rect = &tile->rect;
+
+    KonstruktRect window;
+    float * mask = ReadWindow(operation, rect, false, arena, &window);
+    float * distanceField = (float *)ArenaAllocate(arena,
+        sizeof(float)*window.width*window.height);
+    void * scratch = ArenaAllocate(arena,
+        GetDistanceFieldScratchSize(window.width, window.height));
+
+    GenerateDistanceField(window.width,
+                          window.height,
+                          mask,
+                          distanceField,
+                          operation->maxDistance,
+                          scratch);
+
+    for(int y = 0; y < rect->height; y++)
+    {
+        const int windowY = rect->y - window.y + y;
+        const int windowX = rect->x - window.x;
+        WriteRow(operation->output,
+                 rect->x,
+                 rect->y + y,
+                 rect->width,
+                 1,
+                 &distanceField[windowY*window.width + windowX]);
+    }
+}
+
+static void ProcessTile( void * data, int workerIndex )
+{
+    const Tile * tile = (const Tile *)data;
+    Arena * arena = tile->context->scratchArenas[workerIndex];
+    if(tile->operation->normalMapOptions)
+        ProcessNormalMapTile(tile, arena);
+    else
+        ProcessDistanceFieldTile(tile, arena);
+    ResetArena(arena);
+}
+
+/**
+ * Splits the region into tiles and processes them on the worker threads.
+ */
+static void RunTiles( KonstruktContext * context,
+                      const Operation * operation,
+                      const KonstruktRect * region,
+                      int tileSize )
+{
+    const int columns = (region->width  + tileSize-1) / tileSize;
+    const int rows    = (region->height + tileSize-1) / tileSize;
+    const int tileCount = columns*rows;
+
+    Tile * tiles = (Tile *)malloc(sizeof(Tile)*tileCount);
+    for(int i = 0; i < tileCount; i++)
+    {
+        Tile * tile = &tiles[i];
+        tile->operation = operation;
+        tile->context = context;
+        tile->rect.x = region->x + (i % columns)*tileSize;
+        tile->rect.y = region->y + (i / columns)*tileSize;
+        tile->rect.width  = tileSize;
+        tile->rect.height = tileSize;
+        if(tile->rect.x + tile->rect.width > region->x + region->width)
+            tile->rect.width = region->x + region->width - tile->rect.x;
+        if(tile->rect.y + tile->rect.height > region->y + region->height)
+            tile->rect.height = region->y + region->height - tile->rect.y;
+        SubmitTask(context->pool, ProcessTile, tile);
+    }
+    WaitForTasks(context->pool);
+    free(tiles);
+}
+
+
+// --- Validation ---
+
+static bool CheckView( const KonstruktImageView * view, int components, const char * name )
+{
+    if(!view->data || view->width <= 0 || view->height <= 0)
+    {
+        fprintf(stderr, "The %s view is empty.\n", name);
+        return false;
+    }
+    if(view->type != KonstruktU8 &&
+       view->type != KonstruktU16 &&
+       view->type != KonstruktF32)
+    {
+        fprintf(stderr, "The %s view has an unknown pixel type.\n", name);
+        return false;
+    }
+    const ptrdiff_t pixelSize = (ptrdiff_t)(GetComponentSize(view->type)*components);
+    if(view->pixelStride < pixelSize ||
+       view->rowStride < view->pixelStride*view->width)
+    {
+        fprintf(stderr, "The strides of the %s view are too small.\n", name);
+        return false;
+    }
+    return true;
+}
+
+static bool CheckViews( const KonstruktImageView * input,
+                        const KonstruktImageView * output,
+                        int outputComponents,
+                        const KonstruktRect * region )
+{
+    if(!CheckView(input, 1, "input") ||
+       !CheckView(output, outputComponents, "output"))
+        return false;
+
+    if(input->width  != output->width ||
+       input->height != output->height)
+    {
+        fprintf(stderr, "Input and output sizes differ.\n");
+        return false;
+    }
+
+    if(region->x < 0 || region->y < 0 ||
+       region->width < 0 || region->height < 0 ||
+       region->x + region->width  > input->width ||
+       region->y + region->height > input->height)
+    {
+        fprintf(stderr, "The region exceeds the image.\n");
+        return false;
+    }
+    return true;
+}
+
+static KonstruktRect GetRegion( const KonstruktImageView * view,
+                                const KonstruktRect * region )
+{
+    if(region)
+        return *region;
+    KonstruktRect all = {0, 0, view->width, view->height};
+    return all;
+}
+
+
+bool KonstruktGenerateNormalMap( KonstruktContext * context,
+                                 const KonstruktImageView * heightMap,
+                                 const KonstruktImageView * normalMap,
+                                 const KonstruktNormalMapOptions * options,
+                                 const KonstruktRect * region )
+{
+    const KonstruktRect rect = GetRegion(heightMap, region);
+    if(!CheckViews(heightMap, normalMap, 3, &rect))
+        return false;
+    if(options->filter < KonstruktPrewitt3x3 ||
+       options->filter > KonstruktScharr5x5)
+    {
+        fprintf(stderr, "Unknown normal map filter.\n");
+        return false;
+    }
+
+    Operation operation;
+    operation.input = heightMap;
+    operation.output = normalMap;
+    operation.normalMapOptions = options;
+    operation.maxDistance = 0;
+    operation.margin = GetNormalMapFilterRadius((NormalMapFilter)options->filter);
+
+    RunTiles(context, &operation, &rect, TileSize);
+    return true;
+}
+
+bool KonstruktGenerateDistanceField( KonstruktContext * context,
+                                     const KonstruktImageView * mask,
+                                     const KonstruktImageView * distanceField,
+                                     float maxDistance,
+                                     const KonstruktRect * region )
+{
+    const KonstruktRect rect = GetRegion(mask, region);
+    if(!CheckViews(mask, distanceField, 1, &rect))
+        return false;
+    if(!(maxDistance > 0))
+    {
+        fprintf(stderr, "The maximum distance must be positive.\n");
+        return false;
+    }
+
+    Operation operation;
+    operation.input = mask;
+    operation.output = distanceField;
+    operation.normalMapOptions = NULL;
+    operation.maxDistance = maxDistance;
+    operation.margin = GetDistanceFieldRegionMargin(maxDistance);
+
+    // Each tile reads its margin again, so it should be small in comparison:
+    int tileSize = TileSize;
+    if(tileSize < operation.margin*4)
+        tileSize = operation.margin*4;
+
+    RunTiles(context, &operation, &rect, tileSize);
+    return true;
+}
@@ -0,0 +1,147 @@
+#ifndef __KONSTRUKT_GENERATORS_H__
+#define __KONSTRUKT_GENERATORS_H__
+
+#include <stdbool.h>
+#include <stddef.h> // ptrdiff_t
+
+#if defined(_WIN32)
+    #if defined(KONSTRUKT_GENERATORS_BUILD)
+        #define KONSTRUKT_API __declspec(dllexport)
+    #else
+        #define KONSTRUKT_API __declspec(dllimport)
+    #endif
+#else
+    #define KONSTRUKT_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Shared library which generates normal maps and signed distance fields
+ * directly in memory owned by the caller.
+ *
+ * The major version changes whenever the API or ABI breaks, which is also
+ * the soname of the library.
+ */
+enum
+{
+    KONSTRUKT_GENERATORS_VERSION_MAJOR = 1,
+    KONSTRUKT_GENERATORS_VERSION_MINOR = 0
+};
+
+/**
+ * Version of the loaded library, which may differ from the header.
+ */
+KONSTRUKT_API void KonstruktGetVersion( int * major, int * minor );
+
+
+typedef enum
+{
+    KonstruktU8,  // Normalized to 0-1
+    KonstruktU16, // Normalized to 0-1
+    KonstruktF32
+} KonstruktPixelType;
+
+/**
+ * Describes pixels in caller owned memory.  They are read and written in
+ * place, so a view may point into a larger image, a single channel of an
+ * interleaved image or a staging buffer.
+ *
+ * The components of a pixel are consecutive.  Inputs only use the first
+ * component, so pointing `data` at the second component of an RGBA image
+ * selects its green channel.
+ */
+typedef struct
+{
+    void * data;
+    KonstruktPixelType type;
+    int width;
+    int height;
+    ptrdiff_t pixelStride; // Bytes from one pixel to the next
+    ptrdiff_t rowStride;   // Bytes from one row to the next
+} KonstruktImageView;
+
+typedef struct
+{
+    int x;
+    int y;
+    int width;
+    int height;
+} KonstruktRect;
+
+/**
+ * Holds the worker threads and their scratch memory.
+ *
+ * A context may only be used by one thread at a time.  Create one per
+ * caller thread which needs to generate concurrently.
+ */
+typedef struct KonstruktContext KonstruktContext;
+
+/**
+ * @param threadCount
+ * Zero or less uses one thread per processor.
+ */
+KONSTRUKT_API KonstruktContext * KonstruktCreateContext( int threadCount );
+KONSTRUKT_API void KonstruktFreeContext( KonstruktContext * context );
+
+
+typedef enum
+{
+    KonstruktPrewitt3x3,
+    KonstruktPrewitt5x5,
+    KonstruktSobel3x3,
+    KonstruktSobel5x5,
+    KonstruktScharr3x3,
+    KonstruktScharr5x5
+} KonstruktNormalMapFilter;
+
+typedef struct
+{
+    KonstruktNormalMapFilter filter;
+    bool wrap; // Whether the height map is tiled.
+    bool invertY;
+} KonstruktNormalMapOptions;
+
+/**
+ * Writes an RGB normal map (3 components per pixel) for the first component
+ * of the height map.
+ *
+ * @param region
+ * Only the normals of this rectangle are written, e.g. after a brush stroke
+ * changed the heights.  Heights around it are still read.  `NULL` updates
+ * the whole image.
+ *
+ * @return
+ * `false` if the views or the region don't fit together.
+ */
+KONSTRUKT_API bool KonstruktGenerateNormalMap( KonstruktContext * context,
+                                               const KonstruktImageView * heightMap,
+                                               const KonstruktImageView * normalMap,
+                                               const KonstruktNormalMapOptions * options,
+                                               const KonstruktRect * region );
+
+/**
+ * Writes a signed distance field (1 component per pixel) for the first
+ * component of the mask, where values above 0.5 are inside.  Distances are
+ * mapped from [-maxDistance, maxDistance] to [0, 1].
+ *
+ * @param region
+ * Only the distances of this rectangle are written.  The mask is read up to
+ * `maxDistance` pixels around it.  `NULL` updates the whole image.
+ *
+ * @return
+ * `false` if the views or the region don't fit together.
+ */
+KONSTRUKT_API bool KonstruktGenerateDistanceField( KonstruktContext * context,
+                                                   const KonstruktImageView * mask,
+                                                   const KonstruktImageView * distanceField,
+                                                   float maxDistance,
+                                                   const KonstruktRect * region );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
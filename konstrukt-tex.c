@@ -0,0 +1,835 @@
+#include <assert.h>
+#include <stdio.h> // printf, fprintf
+#include <string.h> // strcmp, strchr, strlen, strncmp, memset
+#include <stdlib.h> // atof, atoi, strtol, malloc, free
+#include <pthread.h>
+#include "image.h"
+#include "allocator.h"
+#include "batch.h" // ReadManifest
+#include "threadpool.h"
+#include "stats.h"
+#include "normalmap.h"
+#include "distancefield.h"
+#include "resize.h"
+
+enum
+{
+    MaxInputs = 4,
+    AllChannels = -1
+};
+
+typedef enum
+{
+    LoadNode,
+    NormalMapNode,
+    DistanceFieldNode,
+    MergeNode,
+    ResizeNode,
+    SaveNode
+} NodeType;
+
+typedef struct
+{
+    int node;
+    int channel; // Or AllChannels
+} Reference;
+
+struct Graph;
+
+typedef struct
+{
+    struct Graph * graph;
+    NodeType type;
+    const char * name; // NULL for save nodes
+    int line;
+
+    Reference inputs[MaxInputs];
+    int inputCount;
+
+    const char * fileName;
+    NormalMapFilter filter;
+    bool wrap;
+    bool invertY;
+    float maxDistance;
+    int x; // Of the region to load
+    int y;
+    int width; // Zero loads the whole image
+    int height;
+
+    // One entry per edge, so a node may appear multiple times:
+    int * consumers;
+    int consumerCount;
+
+    // Guarded by the graph mutex:
+    int pendingInputs;
+    int pendingConsumers;
+    Image * output;
+    bool failed;
+} Node;
+
+typedef struct Graph
+{
+    const char * fileName;
+    Manifest * manifest; // Owns the strings used by the nodes
+    Node * nodes;
+    int nodeCount;
+
+    ThreadPool * pool;
+    Arena * * scratchArenas; // One per worker
+    pthread_mutex_t mutex;
+} Graph;
+
+static void PrintHelp( const char * programName )
+{
+    printf("%s [options] <graph>\n", programName);
+
+    printf("\t-j <threads> (defaults to processor count)\n");
+    PrintImageHelp();
+    PrintStatsHelp();
+    printf("\n");
+    printf("Each line of the graph defines a node:\n");
+    printf("\t<name> = load <file> [-r <x> <y> <width> <height>]\n");
+    printf("\t<name> = normalmap <ref> [-f <filter>] [-w] [-y]\n");
+    printf("\t<name> = distancefield <ref> [-d <max distance>]\n");
+    printf("\t<name> = merge <ref>...\n");
+    printf("\t<name> = resize <ref> <width> <height>\n");
+    printf("\tsave <ref> <file>\n");
+    printf("A <ref> is '<name>' or '<name>:<channel>'.\n");
+}
+
+// --- Parsing ---
+
+static void PrintNodeError( const Graph * graph, int line, const char * message )
+{
+    fprintf(stderr, "%s:%d: %s\n", graph->fileName, line, message);
+}
+
+static int FindNode( const Graph * graph, const char * name, size_t length )
+{
+    for(int i = 0; i < graph->nodeCount; i++)
+    {
+        const char * nodeName = graph->nodes[i].name;
+        if(nodeName &&
+           strlen(nodeName) == length &&
+           strncmp(nodeName, name, length) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static bool ParseReference( const Graph * graph,
+                            Node * node,
+                            const char * argument )
+{
+    if(node->inputCount == MaxInputs)
+    {
+        PrintNodeError(graph, node->line, "Too many inputs.");
+        return false;
+    }
+    Reference * reference = &node->inputs[node->inputCount];
+
+    const char * colon = strchr(argument, ':');
+    const size_t nameLength = colon ? (size_t)(colon-argument) : strlen(argument);
+
+    reference->node = FindNode(graph, argument, nameLength);
+    if(reference->node < 0)
+    {
+        fprintf(stderr, "%s:%d: Unknown node '%.*s'.\n",
+                graph->fileName, node->line, (int)nameLength, argument);
+        return false;
+    }
+
+    reference->channel = AllChannels;
+    if(colon)
+    {
+        char * end;
+        reference->channel = (int)strtol(colon+1, &end, 10);
+        if(end == colon+1 || *end != '\0' || reference->channel < 0)
+        {
+            fprintf(stderr, "%s:%d: Invalid channel in '%s'.\n",
+                    graph->fileName, node->line, argument);
+            return false;
+        }
+    }
+
+    node->inputCount++;
+    return true;
+}
+
+static NodeType GetNodeTypeByName( const char * name, bool * found )
+{
+    static const char * names[] =
+    {
+        "load", "normalmap", "distancefield", "merge", "resize", NULL
+    };
+    for(int i = 0; names[i]; i++)
+    {
+        if(strcmp(name, names[i]) == 0)
+        {
+            *found = true;
+            return (NodeType)i;
+        }
+    }
+    *found = false;
+    return LoadNode;
+}
+
+static bool GetFilterByName( const char * name, NormalMapFilter * filter )
+{
+    for(int i = 0; i < NormalMapFilterCount; i++)
+    {
+        if(strcmp(name, NormalMapFilterToString((NormalMapFilter)i)) == 0)
+        {
+            *filter = (NormalMapFilter)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool PrintUnknownOption( const Graph * graph,
+                                const Node * node,
+                                const char * option )
+{
+    fprintf(stderr, "%s:%d: Unknown option %s\n",
+            graph->fileName, node->line, option);
+    return false;
+}
+
+/**
+ * @param argv
+ * Arguments following the node type.
+ */
+static bool ParseNodeArguments( const Graph * graph,
+                                Node * node,
+                                int argc,
+                                char * * argv )
+{
+    int positional = 0;
+    for(int i = 0; i < argc; i++)
+    {
+        const char * argument = argv[i];
+        if(argument[0] == '-' && node->type == NormalMapNode)
+        {
+            if(strcmp(argument, "-f") == 0 && i+1 < argc)
+            {
+                i++;
+                if(!GetFilterByName(argv[i], &node->filter))
+                {
+                    fprintf(stderr, "%s:%d: Unknown filter '%s'.\n",
+                            graph->fileName, node->line, argv[i]);
+                    return false;
+                }
+            }
+            else if(strcmp(argument, "-w") == 0)
+                node->wrap = true;
+            else if(strcmp(argument, "-y") == 0)
+                node->invertY = true;
+            else
+                return PrintUnknownOption(graph, node, argument);
+        }
+        else if(argument[0] == '-' && node->type == LoadNode)
+        {
+            if(strcmp(argument, "-r") == 0 && i+4 < argc)
+            {
+                node->x = atoi(argv[i+1]);
+                node->y = atoi(argv[i+2]);
+                node->width = atoi(argv[i+3]);
+                node->height = atoi(argv[i+4]);
+                i += 4;
+            }
+            else
+                return PrintUnknownOption(graph, node, argument);
+        }
+        else if(argument[0] == '-' && node->type == DistanceFieldNode)
+        {
+            if(strcmp(argument, "-d") == 0 && i+1 < argc)
+            {
+                i++;
+                node->maxDistance = atof(argv[i]);
+            }
+            else
+                return PrintUnknownOption(graph, node, argument);
+        }
+        else if(argument[0] == '-')
+        {
+            return PrintUnknownOption(graph, node, argument);
+        }
+        else
+        {
+            // Positional arguments are references, except for file names
+            // and sizes:
+            const bool isReference =
+                (node->type != LoadNode) &&
+                (node->type == MergeNode || positional == 0);
+            if(isReference && !ParseReference(graph, node, argument))
+                return false;
+
+            bool valid = true;
+            switch(node->type)
+            {
+                case LoadNode:
+                    node->fileName = argument;
+                    valid = (positional == 0);
+                    break;
+
+                case SaveNode:
+                    if(positional == 1)
+                        node->fileName = argument;
+                    valid = (positional < 2);
+                    break;
+
+                case NormalMapNode:
+                case DistanceFieldNode:
+                    valid = (positional == 0);
+                    break;
+
+                case MergeNode:
+                    break;
+
+                case ResizeNode:
+                    if(positional == 1)
+                        node->width = atoi(argument);
+                    else if(positional == 2)
+                        node->height = atoi(argument);
+                    valid = (positional < 3);
+                    break;
+            }
+            if(!valid)
+            {
+                PrintNodeError(graph, node->line, "Invalid arguments.");
+                return false;
+            }
+            positional++;
+        }
+    }
+
+    bool complete = true;
+    switch(node->type)
+    {
+        case LoadNode:
+            complete = (positional == 1) &&
+                       (node->width != 0) == (node->height != 0);
+            break;
+        case SaveNode:          complete = (positional == 2); break;
+        case NormalMapNode:     complete = (positional == 1); break;
+        case DistanceFieldNode: complete = (positional == 1); break;
+        case MergeNode:         complete = (positional >= 1); break;
+        case ResizeNode:
+            complete = (positional == 3) && node->width > 0 && node->height > 0;
+            break;
+    }
+    if(!complete)
+    {
+        PrintNodeError(graph, node->line, "Invalid arguments.");
+        return false;
+    }
+    return true;
+}
+
+static bool ParseNode( Graph * graph, const ManifestEntry * entry )
+{
+    Node * node = &graph->nodes[graph->nodeCount];
+    memset(node, 0, sizeof(Node));
+    node->graph = graph;
+    node->line = entry->line;
+    node->filter = Sobel3x3;
+    node->maxDistance = 16;
+
+    // argv[0] is the program name:
+    int argc = entry->argc-1;
+    char * * argv = entry->argv+1;
+
+    if(strcmp(argv[0], "save") == 0)
+    {
+        node->type = SaveNode;
+        argc -= 1;
+        argv += 1;
+    }
+    else
+    {
+        if(argc < 3 || strcmp(argv[1], "=") != 0)
+        {
+            PrintNodeError(graph, node->line, "Expected '<name> = <type> ...'.");
+            return false;
+        }
+
+        node->name = argv[0];
+        if(strchr(node->name, ':') || strcmp(node->name, "save") == 0)
+        {
+            PrintNodeError(graph, node->line, "Invalid node name.");
+            return false;
+        }
+        if(FindNode(graph, node->name, strlen(node->name)) >= 0)
+        {
+            PrintNodeError(graph, node->line, "Node name is already used.");
+            return false;
+        }
+
+        bool found;
+        node->type = GetNodeTypeByName(argv[2], &found);
+        if(!found)
+        {
+            fprintf(stderr, "%s:%d: Unknown node type '%s'.\n",
+                    graph->fileName, node->line, argv[2]);
+            return false;
+        }
+        argc -= 3;
+        argv += 3;
+    }
+
+    if(!ParseNodeArguments(graph, node, argc, argv))
+        return false;
+
+    // References only point to previous nodes, so the graph can't have cycles.
+    graph->nodeCount++;
+    return true;
+}
+
+static void LinkNodes( Graph * graph )
+{
+    for(int i = 0; i < graph->nodeCount; i++)
+    {
+        const Node * node = &graph->nodes[i];
+        for(int j = 0; j < node->inputCount; j++)
+            graph->nodes[node->inputs[j].node].consumerCount++;
+    }
+
+    for(int i = 0; i < graph->nodeCount; i++)
+    {
+        Node * node = &graph->nodes[i];
+        node->consumers = (int *)malloc(sizeof(int)*(node->consumerCount+1));
+        node->pendingConsumers = node->consumerCount;
+        node->pendingInputs = node->inputCount;
+        node->consumerCount = 0;
+    }
+
+    for(int i = 0; i < graph->nodeCount; i++)
+    {
+        const Node * node = &graph->nodes[i];
+        for(int j = 0; j < node->inputCount; j++)
+        {
+            Node * input = &graph->nodes[node->inputs[j].node];
+            input->consumers[input->consumerCount++] = i;
+        }
+    }
+}
+
+static Graph * ReadGraph( const char * fileName )
+{
+    Manifest * manifest = ReadManifest(fileName, "konstrukt-tex");
+    if(!manifest)
+        return NULL;
+
+    Graph * graph = (Graph *)malloc(sizeof(Graph));
+    memset(graph, 0, sizeof(Graph));
+    graph->fileName = fileName;
+    graph->manifest = manifest;
+    graph->nodes = (Node *)malloc(sizeof(Node)*(manifest->entryCount+1));
+
+    for(int i = 0; i < manifest->entryCount; i++)
+    {
+        if(!ParseNode(graph, &manifest->entries[i]))
+        {
+            free(graph->nodes);
+            free(graph);
+            FreeManifest(manifest);
+            return NULL;
+        }
+    }
+
+    LinkNodes(graph);
+    return graph;
+}
+
+static void FreeGraph( Graph * graph )
+{
+    for(int i = 0; i < graph->nodeCount; i++)
+    {
+        Node * node = &graph->nodes[i];
+        if(node->output)
+            FreeImage(node->output);
+        free(node->consumers);
+    }
+    free(graph->nodes);
+    FreeManifest(graph->manifest);
+    memset(graph, 0, sizeof(Graph));
+    free(graph);
+}
+
+// --- Execution ---
+
+/**
+ * Returns the referenced image.  A single channel is copied, unless it's
+ * the only one.  Whole images are shared between all consumers, so they
+ * must not be modified.
+ *
+ * @param defaultChannel
+ * Channel used if the reference selects all channels.  May be #AllChannels.
+ */
+static const Image * GetInput( const Node * node,
+                               int index,
+                               int defaultChannel,
+                               Image * * copy )
+{
+    const Reference * reference = &node->inputs[index];
+    const Image * image = node->graph->nodes[reference->node].output;
+    *copy = NULL;
+
+    int channel = reference->channel;
+    if(channel == AllChannels)
+        channel = defaultChannel;
+    if(channel == AllChannels || (channel == 0 && image->channels == 1))
+        return image;
+
+    if(channel >= image->channels)
+    {
+        fprintf(stderr, "%s:%d: Input has no channel %d.\n",
+                node->graph->fileName, node->line, channel);
+        return NULL;
+    }
+
+    *copy = CopyImageChannel(image, channel);
+    return *copy;
+}
+
+static Image * MergeInputs( const Node * node )
+{
+    const Image * inputs[MaxInputs];
+    Image * copies[MaxInputs];
+    int channels = 0;
+    int inputCount = 0; // Which have been fetched
+    bool valid = true;
+    for(int i = 0; i < node->inputCount; i++)
+    {
+        inputs[i] = GetInput(node, i, AllChannels, &copies[i]);
+        inputCount++;
+        if(!inputs[i])
+        {
+            valid = false;
+            break;
+        }
+        channels += inputs[i]->channels;
+        if(inputs[i]->width  != inputs[0]->width ||
+           inputs[i]->height != inputs[0]->height)
+        {
+            PrintNodeError(node->graph, node->line, "Input sizes differ.");
+            valid = false;
+        }
+    }
+    if(valid && channels > 4)
+    {
+        PrintNodeError(node->graph, node->line, "Too many channels.");
+        valid = false;
+    }
+
+    Image * output = NULL;
+    if(valid)
+    {
+        const int width = inputs[0]->width;
+        const int height = inputs[0]->height;
+        const size_t pixels = (size_t)width*height;
+        output = CreateImage(width, height, channels);
+
+        int offset = 0;
+        for(int i = 0; i < node->inputCount; i++)
+        {
+            const Image * input = inputs[i];
+            for(size_t p = 0; p < pixels; p++)
+                for(int c = 0; c < input->channels; c++)
+                    output->data[p*channels + offset + c] =
+                        input->data[p*input->channels + c];
+            offset += input->channels;
+        }
+    }
+
+    for(int i = 0; i < inputCount; i++)
+        if(copies[i])
+            FreeImage(copies[i]);
+    return output;
+}
+
+static Image * ExecuteNode( const Node * node, Arena * scratchArena, bool * success )
+{
+    *success = true;
+    if(node->type == LoadNode)
+    {
+        // Regions only decode what they cover, if the codec allows it:
+        Image * output;
+        if(node->width != 0)
+            output = ReadImageRegion(node->fileName,
+                                     node->x,
+                                     node->y,
+                                     node->width,
+                                     node->height);
+        else
+            output = ReadImage(node->fileName);
+        *success = (output != NULL);
+        return output;
+    }
+    else if(node->type == MergeNode)
+    {
+        Image * output = MergeInputs(node);
+        *success = (output != NULL);
+        return output;
+    }
+
+    const Image * input;
+    Image * copy;
+    switch(node->type)
+    {
+        case NormalMapNode:
+            input = GetInput(node, 0, 0, &copy);
+            break;
+
+        case DistanceFieldNode:
+        {
+            const Image * image = node->graph->nodes[node->inputs[0].node].output;
+            const int alpha = (image->channels == 2 || image->channels == 4) ?
+                              image->channels-1 : 0;
+            input = GetInput(node, 0, alpha, &copy);
+            break;
+        }
+
+        default:
+            input = GetInput(node, 0, AllChannels, &copy);
+    }
+    if(!input)
+    {
+        *success = false;
+        return NULL;
+    }
+
+    Image * output = NULL;
+    switch(node->type)
+    {
+        case NormalMapNode:
+            output = CreateImage(input->width, input->height, 3);
+            GenerateNormalMap(input->width,
+                              input->height,
+                              input->data,
+                              output->data,
+                              node->filter,
+                              node->wrap,
+                              node->invertY);
+            break;
+
+        case DistanceFieldNode:
+        {
+            output = CreateImage(input->width, input->height, 1);
+            void * scratch = ArenaAllocate(scratchArena,
+                GetDistanceFieldScratchSize(input->width, input->height));
+            GenerateDistanceField(input->width,
+                                  input->height,
+                                  input->data,
+                                  output->data,
+                                  node->maxDistance,
+                                  scratch);
+            ResetArena(scratchArena);
+            break;
+        }
+
+        case ResizeNode:
+            output = CreateImage(node->width, node->height, input->channels);
+            ResizePixels(input->width,
+                         input->height,
+                         input->channels,
+                         input->data,
+                         node->width,
+                         node->height,
+                         output->data);
+            break;
+
+        case SaveNode:
+            *success = WriteImage(input, node->fileName);
+            break;
+
+        default:
+            assert(!"Unexpected node type.");
+    }
+
+    if(copy)
+        FreeImage(copy);
+    return output;
+}
+
+static void RunNode( void * data, int workerIndex );
+
+/**
+ * Stores the result, frees inputs which have no pending consumers left and
+ * starts consumers whose inputs are complete.
+ */
+static void FinishNode( Graph * graph, Node * node, Image * output, bool failed )
+{
+    Image * unused[MaxInputs+1];
+    int unusedCount = 0;
+
+    pthread_mutex_lock(&graph->mutex);
+    node->output = output;
+    node->failed = failed;
+    if(output && node->consumerCount == 0)
+    {
+        unused[unusedCount++] = output;
+        node->output = NULL;
+    }
+
+    for(int i = 0; i < node->inputCount; i++)
+    {
+        Node * input = &graph->nodes[node->inputs[i].node];
+        input->pendingConsumers--;
+        if(input->pendingConsumers == 0 && input->output)
+        {
+            unused[unusedCount++] = input->output;
+            input->output = NULL;
+        }
+    }
+
+    for(int i = 0; i < node->consumerCount; i++)
+    {
+        Node * consumer = &graph->nodes[node->consumers[i]];
+        consumer->pendingInputs--;
+        if(consumer->pendingInputs == 0)
+            SubmitTask(graph->pool, RunNode, consumer);
+    }
+    pthread_mutex_unlock(&graph->mutex);
+
+    for(int i = 0; i < unusedCount; i++)
+        FreeImage(unused[i]);
+}
+
+static void RunNode( void * data, int workerIndex )
+{
+    Node * node = (Node *)data;
+    Graph * graph = node->graph;
+
+    // Inputs are complete, so their state doesn't change anymore:
+    bool inputsFailed = false;
+    for(int i = 0; i < node->inputCount; i++)
+        if(graph->nodes[node->inputs[i].node].failed)
+            inputsFailed = true;
+
+    Image * output = NULL;
+    bool success = false;
+    if(!inputsFailed)
+    {
+        output = ExecuteNode(node, graph->scratchArenas[workerIndex], &success);
+        if(!success)
+            PrintNodeError(graph, node->line, "Node failed.");
+    }
+
+    FinishNode(graph, node, output, !success);
+}
+
+static bool RunGraph( Graph * graph, int threads )
+{
+    graph->pool = CreateThreadPool(threads);
+    threads = GetThreadPoolSize(graph->pool);
+    graph->scratchArenas = (Arena * *)malloc(sizeof(Arena *)*threads);
+    for(int i = 0; i < threads; i++)
+        graph->scratchArenas[i] = CreateArena(0);
+    pthread_mutex_init(&graph->mutex, NULL);
+
+    pthread_mutex_lock(&graph->mutex);
+    for(int i = 0; i < graph->nodeCount; i++)
+        if(graph->nodes[i].inputCount == 0)
+            SubmitTask(graph->pool, RunNode, &graph->nodes[i]);
+    pthread_mutex_unlock(&graph->mutex);
+
+    WaitForTasks(graph->pool);
+
+    bool success = true;
+    for(int i = 0; i < graph->nodeCount; i++)
+        if(graph->nodes[i].failed)
+            success = false;
+
+    FreeThreadPool(graph->pool);
+    graph->pool = NULL;
+    for(int i = 0; i < threads; i++)
+        FreeArena(graph->scratchArenas[i]);
+    free(graph->scratchArenas);
+    graph->scratchArenas = NULL;
+    pthread_mutex_destroy(&graph->mutex);
+    return success;
+}
+
+int main( int argc, char * * argv )
+{
+    if(argc == 1)
+    {
+        PrintHelp(argv[0]);
+        return 0;
+    }
+
+    const char * graphFileName = NULL;
+    int threads = 0;
+    StatsOptions statsOptions;
+    InitStatsOptions(&statsOptions);
+    ImageOptions imageOptions;
+    InitImageOptions(&imageOptions);
+    for(int i = 1; i < argc; i++)
+    {
+        if(argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            const int statsOption = ParseStatsOption(argc, argv, &i, &statsOptions);
+            if(statsOption < 0)
+                return 1;
+            else if(statsOption > 0)
+                continue;
+
+            const int imageOption = ParseImageOption(argc, argv, &i, &imageOptions);
+            if(imageOption < 0)
+                return 1;
+            else if(imageOption > 0)
+                continue;
+
+            if(strcmp(argv[i], "-j") == 0)
+            {
+                if(i+1 < argc)
+                {
+                    i++;
+                    threads = atoi(argv[i]);
+                }
+                else
+                {
+                    printf("Option needs a value.\n");
+                    return 1;
+                }
+            }
+            else
+            {
+                printf("Unknown option %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(graphFileName == NULL)
+        {
+            graphFileName = argv[i];
+        }
+        else
+        {
+            printf("Too many arguments.\n");
+            return 1;
+        }
+    }
+
+    if(graphFileName == NULL)
+    {
+        printf("File parameter(s) are missing.\n");
+        return 1;
+    }
+
+    // '-' reads the graph from stdin, so scripts can use here documents:
+    if(strcmp(graphFileName, "-") == 0)
+        graphFileName = "/dev/stdin";
+
+    Graph * graph = ReadGraph(graphFileName);
+    if(!graph)
+        return 1;
+
+    ApplyImageOptions(&imageOptions);
+    StartStats(&statsOptions);
+    bool success = RunGraph(graph, threads);
+    FreeGraph(graph);
+    success = FinishStats() && success;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+#include <stdint.h> // uint32_t
+#include <stdlib.h> // calloc, free
+#include <string.h> // memcpy
+#include "lz4block.h"
+
+enum
+{
+    HashBits = 16,
+    MinMatch = 4,
+    LastLiterals = 5, // The format requires the block to end with literals
+    MatchSearchLimit = 12, // Matches must start this far before the end
+    MaxOffset = 65535,
+    SkipTrigger = 6 // Probe less often in incompressible data
+};
+
+static uint32_t Read32( const unsigned char * data )
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint32_t HashSequence( uint32_t sequence )
+{
+    return (sequence * 2654435761u) >> (32 - HashBits);
+}
+
+static unsigned char * WriteLength( unsigned char * out, size_t length )
+{
+    while(length >= 255)
+    {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (unsigned char)length;
+    return out;
+}
+
+/**
+ * @return
+ * New output position or `NULL` if the sequence doesn't fit.
+ */
+static unsigned char * WriteSequence( unsigned char * out,
+                                      const unsigned char * outEnd,
+                                      const unsigned char * literals,
+                                      size_t literalLength,
+                                      size_t offset,
+                                      size_t matchLength )
+{
+    const size_t needed = 1 + literalLength/255+1 + literalLength + 2 + matchLength/255+1;
+    if((size_t)(outEnd - out) < needed)
+        return NULL;
+
+    unsigned char * token = out++;
+    if(literalLength >= 15)
+    {
+        *token = 15 << 4;
+        out = WriteLength(out, literalLength - 15);
+    }
+    else
+    {
+        *token = (unsigned char)(literalLength << 4);
+    }
+    memcpy(out, literals, literalLength);
+    out += literalLength;
+
+    if(offset == 0) // Last sequence
+        return out;
+
+    *out++ = (unsigned char)(offset & 0xff);
+    *out++ = (unsigned char)(offset >> 8);
+    matchLength -= MinMatch;
+    if(matchLength >= 15)
+    {
+        *token |= 15;
+        out = WriteLength(out, matchLength - 15);
+    }
+    else
+    {
+        *token |= (unsigned char)matchLength;
+    }
+    return out;
+}
+
+size_t CompressLz4Block( const void * input,
+                         size_t size,
+                         void * output,
+                         size_t capacity )
+{
+    if(size > LZ4_BLOCK_MAX_INPUT_SIZE)
+        return 0;
+
+    const unsigned char * in = (const unsigned char *)input;
+    const unsigned char * inEnd = in + size;
+    unsigned char * out = (unsigned char *)output;
+    const unsigned char * outEnd = out + capacity;
+    const unsigned char * anchor = in;
+
+    if(size > MatchSearchLimit)
+    {
+        uint32_t * table = (uint32_t *)calloc((size_t)1 << HashBits, sizeof(uint32_t));
+        const unsigned char * matchStartLimit = inEnd - MatchSearchLimit;
+        const unsigned char * matchEndLimit = inEnd - LastLiterals;
+        const unsigned char * position = in;
+        while(position < matchStartLimit)
+        {
+            const uint32_t sequence = Read32(position);
+            const uint32_t hash = HashSequence(sequence);
+            const unsigned char * candidate = in + table[hash];
+            table[hash] = (uint32_t)(position - in);
+
+            if(candidate >= position ||
+               position - candidate > MaxOffset ||
+               Read32(candidate) != sequence)
+            {
+                position += 1 + ((position - anchor) >> SkipTrigger);
+                continue;
+            }
+
+            while(position > anchor && candidate > in && position[-1] == candidate[-1])
+            {
+                position--;
+                candidate--;
+            }
+            const unsigned char * matchEnd = position + MinMatch;
+            const unsigned char * source = candidate + MinMatch;
+            while(matchEnd < matchEndLimit && *matchEnd == *source)
+            {
+                matchEnd++;
+                source++;
+            }
+
+            out = WriteSequence(out, outEnd,
+                                anchor, (size_t)(position - anchor),
+                                (size_t)(position - candidate),
+                                (size_t)(matchEnd - position));
+            if(!out)
+            {
+                free(table);
+                return 0;
+            }
+            position = matchEnd;
+            anchor = position;
+
+            // Remember a position inside the match, which often repeats:
+            if(position - 2 >= in && position < matchStartLimit)
+                table[HashSequence(Read32(position - 2))] = (uint32_t)(position - 2 - in);
+        }
+        free(table);
+    }
+
+    out = WriteSequence(out, outEnd, anchor, (size_t)(inEnd - anchor), 0, 0);
+    if(!out)
+        return 0;
+    return (size_t)(out - (unsigned char *)output);
+}
+
+static bool ReadLength( const unsigned char * * in, const unsigned char * inEnd, size_t * length )
+{
+    unsigned char byte;
+    do
+    {
+        if(*in >= inEnd)
+            return false;
+        byte = *(*in)++;
+        *length += byte;
+    } while(byte == 255);
+    return true;
+}
+
+bool DecompressLz4Block( const void * input,
+                         size_t size,
+                         void * output,
+                         size_t outputSize )
+{
+    const unsigned char * in = (const unsigned char *)input;
+    const unsigned char * inEnd = in + size;
+    unsigned char * out = (unsigned char *)output;
+    unsigned char * outEnd = out + outputSize;
+
+    for(;;)
+    {
+        if(in >= inEnd)
+            return false;
+        const unsigned token = *in++;
+
+        size_t literalLength = token >> 4;
+        if(literalLength == 15 && !ReadLength(&in, inEnd, &literalLength))
+            return false;
+        if(literalLength > (size_t)(inEnd - in) ||
+           literalLength > (size_t)(outEnd - out))
+            return false;
+        memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        if(in == inEnd) // Last sequence has no match
+            return out == outEnd;
+
+        if(inEnd - in < 2)
+            return false;
+        const size_t offset = in[0] | (size_t)in[1] << 8;
+        in += 2;
+        if(offset == 0 || offset > (size_t)(out - (unsigned char *)output))
+            return false;
+
+        size_t matchLength = token & 15;
+        if(matchLength == 15 && !ReadLength(&in, inEnd, &matchLength))
+            return false;
+        matchLength += MinMatch;
+        if(matchLength > (size_t)(outEnd - out))
+            return false;
+
+        const unsigned char * match = out - offset;
+        if(offset >= matchLength)
+        {
+            memcpy(out, match, matchLength);
+            out += matchLength;
+        }
+        else
+        {
+            // Overlapping copies repeat the last `offset` bytes:
+            for(size_t i = 0; i < matchLength; i++)
+                *out++ = *match++;
+        }
+    }
+}
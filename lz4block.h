@@ -0,0 +1,47 @@
+#ifndef __LZ4BLOCK_H__
+#define __LZ4BLOCK_H__
+
+#include <stdbool.h>
+#include <stddef.h> // size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Largest input #CompressLz4Block accepts, as in the reference implementation.
+ */
+#define LZ4_BLOCK_MAX_INPUT_SIZE ((size_t)0x7E000000)
+
+/**
+ * Compresses into the LZ4 block format, which `LZ4_decompress_safe` of
+ * liblz4 can decode.  Uses a single hash table probe per position, which
+ * gives the usual LZ4 speed and ratio.
+ *
+ * @return
+ * Compressed size, or 0 if it would exceed `capacity`.  Passing less than
+ * the input size as capacity thus stops early on incompressible data.
+ */
+size_t CompressLz4Block( const void * input,
+                         size_t size,
+                         void * output,
+                         size_t capacity );
+
+/**
+ * @param outputSize
+ * Exact size of the decompressed data.
+ *
+ * @return
+ * `false` if the input is malformed or doesn't decompress to `outputSize`
+ * bytes.  Never reads or writes outside the buffers.
+ */
+bool DecompressLz4Block( const void * input,
+                         size_t size,
+                         void * output,
+                         size_t outputSize );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
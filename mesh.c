@@ -0,0 +1,608 @@
+#include <math.h> // fabsf, floorf
+#include <stdio.h> // fopen, fwrite, fprintf
+#include <stdlib.h> // malloc, realloc, free
+#include <string.h> // memset, memcpy, strlen
+#include "mesh.h"
+
+
+static char * CopyString( const char * string )
+{
+    const size_t length = strlen(string);
+    char * copy = (char *)malloc(length+1);
+    memcpy(copy, string, length+1);
+    return copy;
+}
+
+void InitMesh( Mesh * mesh )
+{
+    memset(mesh, 0, sizeof(Mesh));
+}
+
+void FreeMesh( Mesh * mesh )
+{
+    for(int i = 0; i < mesh->objectCount; i++)
+    {
+        MeshObject * object = &mesh->objects[i];
+        for(int j = 0; j < object->propertyCount; j++)
+        {
+            free(object->properties[j].name);
+            free(object->properties[j].string);
+        }
+        free(object->properties);
+        free(object->vertices);
+        free(object->indices);
+        for(int j = 0; j < object->levelCount; j++)
+            free(object->levels[j].indices);
+        free(object->levels);
+        free(object->name);
+    }
+    free(mesh->objects);
+    memset(mesh, 0, sizeof(Mesh));
+}
+
+int AddMeshObject( Mesh * mesh, const char * name, int parent )
+{
+    mesh->objects = (MeshObject *)realloc(mesh->objects,
+                                          sizeof(MeshObject)*(mesh->objectCount+1));
+    MeshObject * object = &mesh->objects[mesh->objectCount];
+    memset(object, 0, sizeof(MeshObject));
+    object->name = CopyString(name);
+    object->parent = parent;
+    return mesh->objectCount++;
+}
+
+MeshProperty * AddMeshProperty( MeshObject * object, const char * name )
+{
+    object->properties = (MeshProperty *)realloc(object->properties,
+                                                 sizeof(MeshProperty)*(object->propertyCount+1));
+    MeshProperty * property = &object->properties[object->propertyCount++];
+    memset(property, 0, sizeof(MeshProperty));
+    property->name = CopyString(name);
+    return property;
+}
+
+MeshVertex * AddMeshVertex( MeshObject * object )
+{
+    if(object->vertexCount == object->vertexCapacity)
+    {
+        object->vertexCapacity = object->vertexCapacity ? object->vertexCapacity*2 : 64;
+        object->vertices = (MeshVertex *)realloc(object->vertices,
+                                                 sizeof(MeshVertex)*object->vertexCapacity);
+    }
+    MeshVertex * vertex = &object->vertices[object->vertexCount++];
+    memset(vertex, 0, sizeof(MeshVertex));
+    return vertex;
+}
+
+void AddMeshIndex( MeshObject * object, uint32_t index )
+{
+    if(object->indexCount == object->indexCapacity)
+    {
+        object->indexCapacity = object->indexCapacity ? object->indexCapacity*2 : 64;
+        object->indices = (uint32_t *)realloc(object->indices,
+                                              sizeof(uint32_t)*object->indexCapacity);
+    }
+    object->indices[object->indexCount++] = index;
+}
+
+
+// --- Writing ---
+
+typedef struct
+{
+    char * data;
+    size_t size;
+    size_t capacity;
+} StringTable;
+
+/**
+ * Names are stored once per distinct string.  A linear search is fine for
+ * the few hundred names of a scene.
+ */
+static uint32_t AddString( StringTable * table, const char * string )
+{
+    const size_t length = strlen(string);
+    for(size_t offset = 0; offset < table->size; offset += strlen(&table->data[offset])+1)
+        if(strcmp(&table->data[offset], string) == 0)
+            return (uint32_t)offset;
+
+    if(table->size + length+1 > table->capacity)
+    {
+        table->capacity = (table->size + length+1)*2;
+        table->data = (char *)realloc(table->data, table->capacity);
+    }
+    const size_t offset = table->size;
+    memcpy(&table->data[offset], string, length+1);
+    table->size += length+1;
+    return (uint32_t)offset;
+}
+
+static uint64_t Align( uint64_t offset )
+{
+    return (offset + MeshFileAlignment-1) / MeshFileAlignment * MeshFileAlignment;
+}
+
+static void PutU16( unsigned char * out, unsigned value )
+{
+    out[0] = (unsigned char)(value & 0xff);
+    out[1] = (unsigned char)((value >> 8) & 0xff);
+}
+
+static void PutU32( unsigned char * out, uint32_t value )
+{
+    out[0] = (unsigned char)(value & 0xff);
+    out[1] = (unsigned char)((value >> 8) & 0xff);
+    out[2] = (unsigned char)((value >> 16) & 0xff);
+    out[3] = (unsigned char)((value >> 24) & 0xff);
+}
+
+static void PutF32( unsigned char * out, float value )
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutU32(out, bits);
+}
+
+static void PutF64( unsigned char * out, double value )
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutU32(out, (uint32_t)bits);
+    PutU32(out+4, (uint32_t)(bits >> 32));
+}
+
+static void WritePadding( FILE * file, uint64_t * position, uint64_t target )
+{
+    static const unsigned char Zeros[MeshFileAlignment] = {0};
+    fwrite(Zeros, 1, (size_t)(target - *position), file);
+    *position = target;
+}
+
+static float Saturate( float value )
+{
+    return (value < 0) ? 0 : (value > 1) ? 1 : value;
+}
+
+static unsigned ToUNorm16( float value, float min, float max )
+{
+    if(max <= min)
+        return 0;
+    return (unsigned)floorf(Saturate((value-min) / (max-min))*65535.0f + 0.5f);
+}
+
+static unsigned ToSNorm16( float value )
+{
+    const float clamped = (value < -1) ? -1 : (value > 1) ? 1 : value;
+    const int scaled = (int)floorf(clamped*32767.0f + 0.5f);
+    return (unsigned)(scaled & 0xffff);
+}
+
+/**
+ * Maps the unit sphere onto the [-1, 1] square.
+ */
+static void EncodeOctahedral( const float * normal, float * encoded )
+{
+    const float sum = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    float x = (sum > 0) ? normal[0]/sum : 0;
+    float y = (sum > 0) ? normal[1]/sum : 0;
+    if(normal[2] < 0)
+    {
+        const float foldedX = (1 - fabsf(y)) * (x >= 0 ? 1 : -1);
+        const float foldedY = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = x;
+    encoded[1] = y;
+}
+
+typedef struct
+{
+    bool quantize;
+    bool hasTexCoords;
+    bool hasColors;
+    int stride;
+    int normalOffset;
+    int texCoordOffset;
+    int colorOffset;
+    MeshFileAttribute attributes[4];
+    int attributeCount;
+} VertexLayout;
+
+static void AddAttribute( VertexLayout * layout,
+                          MeshAttributeSemantic semantic,
+                          MeshAttributeFormat format,
+                          int components,
+                          int size )
+{
+    MeshFileAttribute * attribute = &layout->attributes[layout->attributeCount++];
+    attribute->semantic = semantic;
+    attribute->format = format;
+    attribute->components = components;
+    attribute->offset = layout->stride;
+    layout->stride += size;
+}
+
+static void InitVertexLayout( VertexLayout * layout, const Mesh * mesh, bool quantize )
+{
+    memset(layout, 0, sizeof(VertexLayout));
+    layout->quantize = quantize;
+    layout->hasTexCoords = mesh->hasTexCoords;
+    layout->hasColors = mesh->hasColors;
+
+    if(quantize)
+    {
+        // The fourth component keeps the normal 4 byte aligned:
+        AddAttribute(layout, MeshPosition, MeshUNorm16, 4, 8);
+        layout->normalOffset = layout->stride;
+        AddAttribute(layout, MeshNormal, MeshSNorm16, 2, 4);
+        layout->texCoordOffset = layout->stride;
+        if(layout->hasTexCoords)
+            AddAttribute(layout, MeshTexCoord, MeshUNorm16, 2, 4);
+    }
+    else
+    {
+        AddAttribute(layout, MeshPosition, MeshFloat32, 3, 12);
+        layout->normalOffset = layout->stride;
+        AddAttribute(layout, MeshNormal, MeshFloat32, 3, 12);
+        layout->texCoordOffset = layout->stride;
+        if(layout->hasTexCoords)
+            AddAttribute(layout, MeshTexCoord, MeshFloat32, 2, 8);
+    }
+
+    // Vertex colors are 8 bit in Blender anyway:
+    layout->colorOffset = layout->stride;
+    if(layout->hasColors)
+        AddAttribute(layout, MeshColor, MeshUNorm8, 4, 4);
+}
+
+typedef struct
+{
+    float boundsMin[3];
+    float boundsMax[3];
+    float texCoordMin[2];
+    float texCoordMax[2];
+} ObjectBounds;
+
+static void GetObjectBounds( const MeshObject * object, ObjectBounds * bounds )
+{
+    memset(bounds, 0, sizeof(ObjectBounds));
+    for(int i = 0; i < object->vertexCount; i++)
+    {
+        const MeshVertex * vertex = &object->vertices[i];
+        for(int c = 0; c < 3; c++)
+        {
+            const float value = vertex->position[c];
+            if(i == 0 || value < bounds->boundsMin[c]) bounds->boundsMin[c] = value;
+            if(i == 0 || value > bounds->boundsMax[c]) bounds->boundsMax[c] = value;
+        }
+        for(int c = 0; c < 2; c++)
+        {
+            const float value = vertex->texCoord[c];
+            if(i == 0 || value < bounds->texCoordMin[c]) bounds->texCoordMin[c] = value;
+            if(i == 0 || value > bounds->texCoordMax[c]) bounds->texCoordMax[c] = value;
+        }
+    }
+}
+
+static void PackVertex( const VertexLayout * layout,
+                        const ObjectBounds * bounds,
+                        const MeshVertex * vertex,
+                        unsigned char * out )
+{
+    memset(out, 0, layout->stride);
+    if(layout->quantize)
+    {
+        for(int c = 0; c < 3; c++)
+            PutU16(&out[c*2], ToUNorm16(vertex->position[c],
+                                        bounds->boundsMin[c],
+                                        bounds->boundsMax[c]));
+        float octahedral[2];
+        EncodeOctahedral(vertex->normal, octahedral);
+        for(int c = 0; c < 2; c++)
+            PutU16(&out[layout->normalOffset + c*2], ToSNorm16(octahedral[c]));
+        if(layout->hasTexCoords)
+            for(int c = 0; c < 2; c++)
+                PutU16(&out[layout->texCoordOffset + c*2],
+                       ToUNorm16(vertex->texCoord[c],
+                                 bounds->texCoordMin[c],
+                                 bounds->texCoordMax[c]));
+    }
+    else
+    {
+        for(int c = 0; c < 3; c++)
+        {
+            PutF32(&out[c*4], vertex->position[c]);
+            PutF32(&out[layout->normalOffset + c*4], vertex->normal[c]);
+        }
+        if(layout->hasTexCoords)
+            for(int c = 0; c < 2; c++)
+                PutF32(&out[layout->texCoordOffset + c*4], vertex->texCoord[c]);
+    }
+
+    if(layout->hasColors)
+    {
+        for(int c = 0; c < 3; c++)
+            out[layout->colorOffset + c] =
+                (unsigned char)floorf(Saturate(vertex->color[c])*255.0f + 0.5f);
+        out[layout->colorOffset + 3] = 255;
+    }
+}
+
+static int GetIndexSize( const MeshObject * object )
+{
+    if(object->indexCount == 0)
+        return 0;
+    return (object->vertexCount <= 65536) ? 2 : 4;
+}
+
+/**
+ * Bytes taken by the index buffers of all levels, each starting aligned.
+ */
+static uint64_t GetObjectIndexBytes( const MeshObject * object )
+{
+    const int size = GetIndexSize(object);
+    uint64_t bytes = Align((uint64_t)object->indexCount*size);
+    for(int i = 0; i < object->levelCount; i++)
+        bytes += Align((uint64_t)object->levels[i].indexCount*size);
+    return bytes;
+}
+
+static void WriteIndices( FILE * file,
+                          uint64_t * position,
+                          const uint32_t * indices,
+                          int indexCount,
+                          int size )
+{
+    unsigned char buffer[4];
+    for(int i = 0; i < indexCount; i++)
+    {
+        if(size == 2)
+            PutU16(buffer, indices[i]);
+        else
+            PutU32(buffer, indices[i]);
+        fwrite(buffer, 1, size, file);
+    }
+    *position += (uint64_t)indexCount*size;
+    WritePadding(file, position, Align(*position));
+}
+
+bool WriteMeshFile( const Mesh * mesh, const char * fileName, bool quantize )
+{
+    VertexLayout layout;
+    InitVertexLayout(&layout, mesh, quantize);
+
+    StringTable strings;
+    memset(&strings, 0, sizeof(strings));
+    AddString(&strings, ""); // Offset 0 is the empty string
+
+    // Lay out all sections before writing anything:
+    int propertyCount = 0;
+    int levelCount = 0;
+    uint64_t vertexCount = 0;
+    uint64_t indexSize = 0;
+    for(int i = 0; i < mesh->objectCount; i++)
+    {
+        const MeshObject * object = &mesh->objects[i];
+        propertyCount += object->propertyCount;
+        levelCount += object->levelCount;
+        vertexCount += object->vertexCount;
+        indexSize += GetObjectIndexBytes(object);
+    }
+
+    const uint64_t attributeOffset = Align(sizeof(MeshFileHeader));
+    const uint64_t objectOffset = Align(attributeOffset +
+                                        sizeof(MeshFileAttribute)*layout.attributeCount);
+    const uint64_t propertyOffset = Align(objectOffset +
+                                          sizeof(MeshFileObject)*(uint64_t)mesh->objectCount);
+    const uint64_t levelOffset = Align(propertyOffset +
+                                       sizeof(MeshFileProperty)*(uint64_t)propertyCount);
+    const uint64_t vertexOffset = Align(levelOffset +
+                                        sizeof(MeshFileLevel)*(uint64_t)levelCount);
+    const uint64_t indexOffset = Align(vertexOffset + vertexCount*layout.stride);
+    const uint64_t stringOffset = indexOffset + indexSize;
+
+    // Names and string properties need to be known for the file size:
+    for(int i = 0; i < mesh->objectCount; i++)
+    {
+        const MeshObject * object = &mesh->objects[i];
+        AddString(&strings, object->name);
+        for(int j = 0; j < object->propertyCount; j++)
+        {
+            AddString(&strings, object->properties[j].name);
+            if(object->properties[j].type == MeshStringProperty)
+                AddString(&strings, object->properties[j].string);
+        }
+    }
+
+    const uint64_t fileSize = stringOffset + strings.size;
+    if(fileSize > UINT32_MAX)
+    {
+        fprintf(stderr, "'%s' would exceed 4 GiB.\n", fileName);
+        free(strings.data);
+        return false;
+    }
+
+    FILE * file = fopen(fileName, "wb");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for writing.\n", fileName);
+        free(strings.data);
+        return false;
+    }
+
+    unsigned char buffer[sizeof(MeshFileObject)];
+    uint64_t position = 0;
+
+    // Header:
+    {
+        unsigned char out[sizeof(MeshFileHeader)];
+        const uint32_t fields[] =
+        {
+            MeshFileVersion,
+            quantize ? MeshFileQuantized : 0,
+            (uint32_t)fileSize,
+            (uint32_t)layout.attributeCount,
+            (uint32_t)attributeOffset,
+            (uint32_t)mesh->objectCount,
+            (uint32_t)objectOffset,
+            (uint32_t)propertyCount,
+            (uint32_t)propertyOffset,
+            (uint32_t)levelCount,
+            (uint32_t)levelOffset,
+            (uint32_t)vertexCount,
+            (uint32_t)layout.stride,
+            (uint32_t)vertexOffset,
+            (uint32_t)indexOffset,
+            (uint32_t)strings.size,
+            (uint32_t)stringOffset
+        };
+        memcpy(out, MESH_FILE_MAGIC, 4);
+        for(size_t i = 0; i < sizeof(fields)/sizeof(fields[0]); i++)
+            PutU32(&out[4 + i*4], fields[i]);
+        fwrite(out, 1, sizeof(out), file);
+        position += sizeof(out);
+    }
+
+    // Attributes:
+    WritePadding(file, &position, attributeOffset);
+    for(int i = 0; i < layout.attributeCount; i++)
+    {
+        const MeshFileAttribute * attribute = &layout.attributes[i];
+        PutU32(&buffer[0],  attribute->semantic);
+        PutU32(&buffer[4],  attribute->format);
+        PutU32(&buffer[8],  attribute->components);
+        PutU32(&buffer[12], attribute->offset);
+        fwrite(buffer, 1, sizeof(MeshFileAttribute), file);
+        position += sizeof(MeshFileAttribute);
+    }
+
+    // Objects:
+    WritePadding(file, &position, objectOffset);
+    uint32_t firstProperty = 0;
+    uint32_t firstVertex = 0;
+    uint32_t firstLevel = 0;
+    uint64_t objectIndexOffset = indexOffset;
+    for(int i = 0; i < mesh->objectCount; i++)
+    {
+        const MeshObject * object = &mesh->objects[i];
+        ObjectBounds bounds;
+        GetObjectBounds(object, &bounds);
+
+        memset(buffer, 0, sizeof(buffer));
+        PutU32(&buffer[0],  AddString(&strings, object->name));
+        PutU32(&buffer[4],  (uint32_t)object->parent);
+        PutU32(&buffer[8],  firstProperty);
+        PutU32(&buffer[12], (uint32_t)object->propertyCount);
+        PutU32(&buffer[16], firstVertex);
+        PutU32(&buffer[20], (uint32_t)object->vertexCount);
+        PutU32(&buffer[24], (uint32_t)GetIndexSize(object));
+        PutU32(&buffer[28], (uint32_t)object->indexCount);
+        PutU32(&buffer[32], object->indexCount ? (uint32_t)objectIndexOffset : 0);
+        for(int c = 0; c < 3; c++)
+        {
+            PutF32(&buffer[36 + c*4], bounds.boundsMin[c]);
+            PutF32(&buffer[48 + c*4], bounds.boundsMax[c]);
+        }
+        for(int c = 0; c < 2; c++)
+        {
+            PutF32(&buffer[60 + c*4], bounds.texCoordMin[c]);
+            PutF32(&buffer[68 + c*4], bounds.texCoordMax[c]);
+        }
+        PutU32(&buffer[76], object->levelCount ? firstLevel : 0);
+        PutU32(&buffer[80], (uint32_t)object->levelCount);
+        fwrite(buffer, 1, sizeof(MeshFileObject), file);
+        position += sizeof(MeshFileObject);
+
+        firstProperty += object->propertyCount;
+        firstVertex += object->vertexCount;
+        firstLevel += object->levelCount;
+        objectIndexOffset += GetObjectIndexBytes(object);
+    }
+
+    // Properties:
+    WritePadding(file, &position, propertyOffset);
+    for(int i = 0; i < mesh->objectCount; i++)
+    {
+        const MeshObject * object = &mesh->objects[i];
+        for(int j = 0; j < object->propertyCount; j++)
+        {
+            const MeshProperty * property = &object->properties[j];
+            const bool isString = property->type == MeshStringProperty;
+            const bool isInteger = property->type == MeshIntegerProperty ||
+                                   property->type == MeshBooleanProperty;
+            memset(buffer, 0, sizeof(buffer));
+            PutU32(&buffer[0], AddString(&strings, property->name));
+            PutU32(&buffer[4], property->type);
+            PutU32(&buffer[8], isString ? AddString(&strings, property->string) : 0);
+            PutU32(&buffer[12], isInteger ? (uint32_t)(int32_t)property->number : 0);
+            PutF64(&buffer[16], isString ? 0 : property->number);
+            fwrite(buffer, 1, sizeof(MeshFileProperty), file);
+            position += sizeof(MeshFileProperty);
+        }
+    }
+
+    // Levels:
+    WritePadding(file, &position, levelOffset);
+    objectIndexOffset = indexOffset;
+    for(int i = 0; i < mesh->objectCount; i++)
+    {
+        const MeshObject * object = &mesh->objects[i];
+        const int size = GetIndexSize(object);
+        uint64_t levelIndexOffset = objectIndexOffset +
+                                    Align((uint64_t)object->indexCount*size);
+        for(int j = 0; j < object->levelCount; j++)
+        {
+            const MeshLevel * level = &object->levels[j];
+            memset(buffer, 0, sizeof(buffer));
+            PutU32(&buffer[0], (uint32_t)level->indexCount);
+            PutU32(&buffer[4], level->indexCount ? (uint32_t)levelIndexOffset : 0);
+            PutF32(&buffer[8], level->error);
+            fwrite(buffer, 1, sizeof(MeshFileLevel), file);
+            position += sizeof(MeshFileLevel);
+            levelIndexOffset += Align((uint64_t)level->indexCount*size);
+        }
+        objectIndexOffset += GetObjectIndexBytes(object);
+    }
+
+    // Vertices:
+    WritePadding(file, &position, vertexOffset);
+    for(int i = 0; i < mesh->objectCount; i++)
+    {
+        const MeshObject * object = &mesh->objects[i];
+        ObjectBounds bounds;
+        GetObjectBounds(object, &bounds);
+        for(int j = 0; j < object->vertexCount; j++)
+        {
+            PackVertex(&layout, &bounds, &object->vertices[j], buffer);
+            fwrite(buffer, 1, layout.stride, file);
+        }
+        position += (uint64_t)object->vertexCount*layout.stride;
+    }
+
+    // Indices:
+    WritePadding(file, &position, indexOffset);
+    for(int i = 0; i < mesh->objectCount; i++)
+    {
+        const MeshObject * object = &mesh->objects[i];
+        const int size = GetIndexSize(object);
+        WriteIndices(file, &position, object->indices, object->indexCount, size);
+        for(int j = 0; j < object->levelCount; j++)
+            WriteIndices(file,
+                         &position,
+                         object->levels[j].indices,
+                         object->levels[j].indexCount,
+                         size);
+    }
+
+    // Strings:
+    fwrite(strings.data, 1, strings.size, file);
+    free(strings.data);
+
+    if(ferror(file) | fclose(file))
+    {
+        fprintf(stderr, "Could not write '%s'.\n", fileName);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef __MESH_H__
+#define __MESH_H__
+
+#include <stdbool.h>
+#include <stdint.h> // uint32_t
+#include "meshfile.h" // MeshPropertyType
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    float position[3];
+    float normal[3];
+    float texCoord[2];
+    float color[3];
+} MeshVertex;
+
+typedef struct
+{
+    char * name;
+    MeshPropertyType type;
+    char * string;
+    double number;
+} MeshProperty;
+
+typedef struct
+{
+    uint32_t * indices; // Triangle list over the vertices of the object
+    int indexCount;
+    float error; // Relative to the diagonal of the object bounds
+} MeshLevel;
+
+typedef struct
+{
+    char * name;
+    int parent; // -1 for root objects
+
+    MeshProperty * properties;
+    int propertyCount;
+
+    MeshVertex * vertices;
+    int vertexCount;
+    int vertexCapacity;
+
+    uint32_t * indices; // Triangle list
+    int indexCount;
+    int indexCapacity;
+
+    MeshLevel * levels; // Simplified versions, from fine to coarse
+    int levelCount;
+} MeshObject;
+
+/**
+ * Scene tree of objects, each with an optional triangle mesh.
+ */
+typedef struct
+{
+    MeshObject * objects; // Parents before their children
+    int objectCount;
+    bool hasTexCoords;
+    bool hasColors;
+} Mesh;
+
+void InitMesh( Mesh * mesh );
+void FreeMesh( Mesh * mesh );
+
+/**
+ * @return
+ * Index of the new object.
+ */
+int AddMeshObject( Mesh * mesh, const char * name, int parent );
+
+MeshProperty * AddMeshProperty( MeshObject * object, const char * name );
+
+MeshVertex * AddMeshVertex( MeshObject * object );
+
+void AddMeshIndex( MeshObject * object, uint32_t index );
+
+/**
+ * Writes the format described in meshfile.h.
+ *
+ * @param quantize
+ * Stores positions and texture coordinates as 16 bit values within the
+ * object bounds and normals in octahedral encoding.
+ */
+bool WriteMeshFile( const Mesh * mesh, const char * fileName, bool quantize );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
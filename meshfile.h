@@ -0,0 +1,158 @@
+#ifndef __MESHFILE_H__
+#define __MESHFILE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Binary mesh files, as written by `json2mesh`.
+ *
+ * Everything is little endian and every section starts at a multiple of
+ * #MeshFileAlignment, so a mapped file can be used in place:
+ *
+ * - #MeshFileHeader
+ * - #MeshFileAttribute array, describing the interleaved vertex format
+ * - #MeshFileObject array, parents before their children
+ * - #MeshFileProperty array
+ * - #MeshFileLevel array
+ * - vertex data, `vertexCount*vertexStride` bytes
+ * - index data, one triangle list per object and level of detail
+ * - strings, zero terminated UTF-8
+ *
+ * Offsets are counted from the start of the file.
+ */
+
+enum
+{
+    MeshFileVersion = 2,
+    MeshFileAlignment = 16
+};
+
+#define MESH_FILE_MAGIC "KMSH"
+
+typedef enum
+{
+    MeshFileQuantized = 1 << 0 // Positions and texture coordinates are normalized
+} MeshFileFlags;
+
+typedef enum
+{
+    MeshPosition,
+    MeshNormal,   // Two octahedral components if quantized
+    MeshTexCoord,
+    MeshColor     // RGBA
+} MeshAttributeSemantic;
+
+typedef enum
+{
+    MeshFloat32,
+    MeshUNorm16,
+    MeshSNorm16,
+    MeshUNorm8
+} MeshAttributeFormat;
+
+typedef struct
+{
+    char magic[4]; // MESH_FILE_MAGIC
+    uint32_t version;
+    uint32_t flags; // MeshFileFlags
+    uint32_t fileSize;
+
+    uint32_t attributeCount;
+    uint32_t attributeOffset;
+    uint32_t objectCount;
+    uint32_t objectOffset;
+    uint32_t propertyCount;
+    uint32_t propertyOffset;
+    uint32_t levelCount;
+    uint32_t levelOffset;
+
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    uint32_t vertexOffset;
+    uint32_t indexOffset;
+    uint32_t stringSize;
+    uint32_t stringOffset;
+} MeshFileHeader;
+
+typedef struct
+{
+    uint32_t semantic; // MeshAttributeSemantic
+    uint32_t format; // MeshAttributeFormat
+    uint32_t components;
+    uint32_t offset; // Within a vertex
+} MeshFileAttribute;
+
+/**
+ * Normalized positions and texture coordinates are mapped to the bounds of
+ * their object: `position = boundsMin + value*(boundsMax - boundsMin)`
+ */
+typedef struct
+{
+    uint32_t name; // Offset into the strings
+    int32_t parent; // -1 for root objects
+
+    uint32_t firstProperty;
+    uint32_t propertyCount;
+
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+
+    /**
+     * Indices are relative to `firstVertex`.  They are 16 bit if the object
+     * has at most 65536 vertices, 32 bit otherwise and 0 if it has no mesh.
+     */
+    uint32_t indexSize;
+    uint32_t indexCount;
+    uint32_t indexOffset;
+
+    float boundsMin[3];
+    float boundsMax[3];
+    float texCoordMin[2];
+    float texCoordMax[2];
+
+    /**
+     * Simplified versions of the mesh, from fine to coarse, which don't
+     * include the full detail one above.
+     */
+    uint32_t firstLevel;
+    uint32_t levelCount;
+} MeshFileObject;
+
+/**
+ * Level of detail of an object.  It uses the vertices and the index size of
+ * its object.
+ */
+typedef struct
+{
+    uint32_t indexCount;
+    uint32_t indexOffset;
+    float error; // Deviation from the full mesh, relative to the bounds' diagonal
+    uint32_t reserved;
+} MeshFileLevel;
+
+typedef enum
+{
+    MeshFloatProperty,
+    MeshIntegerProperty,
+    MeshBooleanProperty,
+    MeshStringProperty
+} MeshPropertyType;
+
+typedef struct
+{
+    uint32_t name; // Offset into the strings
+    uint32_t type; // MeshPropertyType
+    uint32_t string; // Offset into the strings, for string properties
+    int32_t integer; // Also set for booleans
+    double number; // Set for all but strings
+} MeshFileProperty;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
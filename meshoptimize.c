@@ -0,0 +1,486 @@
+#include <math.h> // sqrtf
+#include <stdlib.h> // malloc, calloc, free, qsort
+#include <string.h> // memcpy
+#include "meshoptimize.h"
+
+// Sander, Nehab, Barczak: Fast Triangle Reordering for Vertex Locality and
+// Reduced Overdraw (2007)
+
+
+/**
+ * FIFO cache which only stores the time at which a vertex was inserted.
+ * Vertices older than `size` insertions have been evicted.
+ */
+typedef struct
+{
+    uint32_t * stamps;
+    uint32_t time;
+    int size;
+} FifoCache;
+
+static void InitFifoCache( FifoCache * cache, int vertexCount, int size )
+{
+    cache->stamps = (uint32_t *)calloc(vertexCount+1, sizeof(uint32_t));
+    cache->size = size;
+    cache->time = (uint32_t)size+1;
+}
+
+static void FreeFifoCache( FifoCache * cache )
+{
+    free(cache->stamps);
+}
+
+static void ClearFifoCache( FifoCache * cache )
+{
+    cache->time += (uint32_t)cache->size+1;
+}
+
+static int GetCacheMisses( FifoCache * cache, const uint32_t * triangle )
+{
+    int misses = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        const uint32_t vertex = triangle[i];
+        if(cache->time - cache->stamps[vertex] > (uint32_t)cache->size)
+        {
+            cache->stamps[vertex] = cache->time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+void AnalyzeVertexCache( const uint32_t * indices,
+                         int indexCount,
+                         int vertexCount,
+                         int cacheSize,
+                         VertexCacheStats * stats )
+{
+    stats->acmr = 0;
+    stats->atvr = 0;
+    if(indexCount < 3)
+        return;
+
+    FifoCache cache;
+    InitFifoCache(&cache, vertexCount, cacheSize);
+    bool * used = (bool *)calloc(vertexCount+1, sizeof(bool));
+    int misses = 0;
+    int usedVertices = 0;
+    for(int i = 0; i+2 < indexCount; i += 3)
+    {
+        misses += GetCacheMisses(&cache, &indices[i]);
+        for(int j = 0; j < 3; j++)
+        {
+            usedVertices += !used[indices[i+j]];
+            used[indices[i+j]] = true;
+        }
+    }
+    free(used);
+    FreeFifoCache(&cache);
+
+    stats->acmr = (float)misses / (float)(indexCount/3);
+    stats->atvr = (float)misses / (float)usedVertices;
+}
+
+
+// --- Vertex cache ---
+
+typedef struct
+{
+    int * offsets; // Into triangles, vertexCount+1 entries
+    int * triangles;
+} Adjacency;
+
+static void BuildAdjacency( Adjacency * adjacency,
+                            const uint32_t * indices,
+                            int indexCount,
+                            int vertexCount )
+{
+    adjacency->offsets = (int *)calloc(vertexCount+1, sizeof(int));
+    adjacency->triangles = (int *)malloc(sizeof(int)*(indexCount+1));
+    for(int i = 0; i < indexCount; i++)
+        adjacency->offsets[indices[i]+1]++;
+    for(int v = 0; v < vertexCount; v++)
+        adjacency->offsets[v+1] += adjacency->offsets[v];
+
+    int * fill = (int *)malloc(sizeof(int)*(vertexCount+1));
+    memcpy(fill, adjacency->offsets, sizeof(int)*vertexCount);
+    for(int i = 0; i < indexCount; i++)
+        adjacency->triangles[fill[indices[i]]++] = i/3;
+    free(fill);
+}
+
+static void FreeAdjacency( Adjacency * adjacency )
+{
+    free(adjacency->offsets);
+    free(adjacency->triangles);
+}
+
+typedef struct
+{
+    int * liveTriangles; // Per vertex
+    int * deadEnds; // Stack of recently used vertices
+    int deadEndCount;
+    int cursor; // Of the linear scan over all vertices
+    int vertexCount;
+} DeadEndState;
+
+/**
+ * Continues with a recently used vertex or, if there is none, the next one
+ * with unemitted triangles.  The latter starts a new cluster.
+ */
+static int SkipDeadEnd( DeadEndState * state, bool * hardBoundary )
+{
+    while(state->deadEndCount > 0)
+    {
+        const int vertex = state->deadEnds[--state->deadEndCount];
+        if(state->liveTriangles[vertex] > 0)
+            return vertex;
+    }
+
+    *hardBoundary = true;
+    for(; state->cursor < state->vertexCount; state->cursor++)
+        if(state->liveTriangles[state->cursor] > 0)
+            return state->cursor;
+    return -1;
+}
+
+/**
+ * Tipsify: fans around one vertex at a time and picks the next vertex among
+ * the ones just used, preferring those which stay in the cache while their
+ * remaining triangles are emitted.
+ *
+ * @param order
+ * Receives the triangles in their new order.
+ *
+ * @param clusterStarts
+ * Receives the positions in `order` where the traversal had to jump, which
+ * separate independent clusters.
+ */
+static int OrderTriangles( const uint32_t * indices,
+                           int indexCount,
+                           int vertexCount,
+                           int cacheSize,
+                           int * order,
+                           int * clusterStarts )
+{
+    const int triangleCount = indexCount/3;
+
+    Adjacency adjacency;
+    BuildAdjacency(&adjacency, indices, indexCount, vertexCount);
+
+    DeadEndState state;
+    state.liveTriangles = (int *)malloc(sizeof(int)*(vertexCount+1));
+    state.deadEnds = (int *)malloc(sizeof(int)*(indexCount+1));
+    state.deadEndCount = 0;
+    state.cursor = 0;
+    state.vertexCount = vertexCount;
+    for(int v = 0; v < vertexCount; v++)
+        state.liveTriangles[v] = adjacency.offsets[v+1] - adjacency.offsets[v];
+
+    int * cacheTimes = (int *)calloc(vertexCount+1, sizeof(int));
+    bool * emitted = (bool *)calloc(triangleCount+1, sizeof(bool));
+    int * candidates = (int *)malloc(sizeof(int)*(indexCount+1));
+    int time = cacheSize+1;
+    int emittedCount = 0;
+    int clusterCount = 0;
+
+    bool hardBoundary = false;
+    int fanVertex = SkipDeadEnd(&state, &hardBoundary);
+    while(fanVertex >= 0)
+    {
+        if(hardBoundary)
+        {
+            clusterStarts[clusterCount++] = emittedCount;
+            hardBoundary = false;
+        }
+
+        int candidateCount = 0;
+        for(int i = adjacency.offsets[fanVertex]; i < adjacency.offsets[fanVertex+1]; i++)
+        {
+            const int triangle = adjacency.triangles[i];
+            if(emitted[triangle])
+                continue;
+
+            for(int j = 0; j < 3; j++)
+            {
+                const int vertex = (int)indices[triangle*3+j];
+                state.deadEnds[state.deadEndCount++] = vertex;
+                candidates[candidateCount++] = vertex;
+                state.liveTriangles[vertex]--;
+                if(time - cacheTimes[vertex] > cacheSize)
+                    cacheTimes[vertex] = time++;
+            }
+            emitted[triangle] = true;
+            order[emittedCount++] = triangle;
+        }
+
+        // Candidates which would still be cached after their triangles have
+        // been emitted are best, among those the ones which entered first:
+        int next = -1;
+        int bestPriority = -1;
+        for(int i = 0; i < candidateCount; i++)
+        {
+            const int vertex = candidates[i];
+            if(state.liveTriangles[vertex] <= 0)
+                continue;
+            int priority = 0;
+            if(time - cacheTimes[vertex] + 2*state.liveTriangles[vertex] <= cacheSize)
+                priority = time - cacheTimes[vertex];
+            if(priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+        fanVertex = (next >= 0) ? next : SkipDeadEnd(&state, &hardBoundary);
+    }
+
+    free(candidates);
+    free(emitted);
+    free(cacheTimes);
+    free(state.deadEnds);
+    free(state.liveTriangles);
+    FreeAdjacency(&adjacency);
+    return clusterCount;
+}
+
+
+// --- Overdraw ---
+
+/**
+ * Splits clusters further where the ACMR of the part so far is close to the
+ * one of the whole cluster, since restarting the cache there costs little.
+ */
+static int SplitClusters( const uint32_t * indices,
+                          int vertexCount,
+                          int cacheSize,
+                          float threshold,
+                          const int * order,
+                          int triangleCount,
+                          const int * hardStarts,
+                          int hardCount,
+                          int * starts )
+{
+    FifoCache cache;
+    InitFifoCache(&cache, vertexCount, cacheSize);
+
+    int count = 0;
+    for(int c = 0; c < hardCount; c++)
+    {
+        const int first = hardStarts[c];
+        const int end = (c+1 < hardCount) ? hardStarts[c+1] : triangleCount;
+
+        ClearFifoCache(&cache);
+        int misses = 0;
+        for(int t = first; t < end; t++)
+            misses += GetCacheMisses(&cache, &indices[order[t]*3]);
+        const float clusterAcmr = (float)misses / (float)(end-first);
+
+        starts[count++] = first;
+        ClearFifoCache(&cache);
+        int start = first;
+        misses = 0;
+        for(int t = first; t < end; t++)
+        {
+            misses += GetCacheMisses(&cache, &indices[order[t]*3]);
+            const float acmr = (float)misses / (float)(t+1 - start);
+            if(t+1 < end && acmr <= clusterAcmr*threshold)
+            {
+                starts[count++] = t+1;
+                start = t+1;
+                misses = 0;
+                ClearFifoCache(&cache);
+            }
+        }
+    }
+
+    FreeFifoCache(&cache);
+    return count;
+}
+
+typedef struct
+{
+    int start;
+    int end;
+    float sortKey;
+} Cluster;
+
+static int CompareClusters( const void * a, const void * b )
+{
+    const Cluster * ca = (const Cluster *)a;
+    const Cluster * cb = (const Cluster *)b;
+    if(ca->sortKey != cb->sortKey)
+        return (ca->sortKey > cb->sortKey) ? -1 : 1;
+    return ca->start - cb->start; // Keeps the order stable
+}
+
+/**
+ * Clusters which face away from the center of the mesh are likely to occlude
+ * the others, so they're drawn first.
+ */
+static void SortClusters( const MeshObject * object,
+                          const uint32_t * indices,
+                          const int * order,
+                          Cluster * clusters,
+                          int clusterCount )
+{
+    float meshCenter[3] = {0, 0, 0};
+    for(int v = 0; v < object->vertexCount; v++)
+        for(int c = 0; c < 3; c++)
+            meshCenter[c] += object->vertices[v].position[c] / (float)object->vertexCount;
+
+    for(int i = 0; i < clusterCount; i++)
+    {
+        Cluster * cluster = &clusters[i];
+        float center[3] = {0, 0, 0};
+        float normal[3] = {0, 0, 0};
+        float area = 0;
+        for(int t = cluster->start; t < cluster->end; t++)
+        {
+            const uint32_t * triangle = &indices[order[t]*3];
+            const float * p0 = object->vertices[triangle[0]].position;
+            const float * p1 = object->vertices[triangle[1]].position;
+            const float * p2 = object->vertices[triangle[2]].position;
+            const float e1[3] = {p1[0]-p0[0], p1[1]-p0[1], p1[2]-p0[2]};
+            const float e2[3] = {p2[0]-p0[0], p2[1]-p0[1], p2[2]-p0[2]};
+            const float n[3] =
+            {
+                e1[1]*e2[2] - e1[2]*e2[1],
+                e1[2]*e2[0] - e1[0]*e2[2],
+                e1[0]*e2[1] - e1[1]*e2[0]
+            };
+            // The length of the cross product is twice the area:
+            const float a = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+            for(int c = 0; c < 3; c++)
+            {
+                center[c] += (p0[c] + p1[c] + p2[c]) / 3.0f * a;
+                normal[c] += n[c];
+            }
+            area += a;
+        }
+
+        const float length = sqrtf(normal[0]*normal[0] +
+                                   normal[1]*normal[1] +
+                                   normal[2]*normal[2]);
+        cluster->sortKey = 0;
+        if(area > 0 && length > 0)
+            for(int c = 0; c < 3; c++)
+                cluster->sortKey += (center[c]/area - meshCenter[c]) * normal[c]/length;
+    }
+
+    qsort(clusters, clusterCount, sizeof(Cluster), CompareClusters);
+}
+
+
+// --- Vertex fetch ---
+
+static void RemapIndices( uint32_t * indices, int indexCount, int * remap, int * next )
+{
+    for(int i = 0; i < indexCount; i++)
+    {
+        const uint32_t vertex = indices[i];
+        if(remap[vertex] < 0)
+            remap[vertex] = (*next)++;
+        indices[i] = (uint32_t)remap[vertex];
+    }
+}
+
+/**
+ * Vertices used by the full detail mesh come first, followed by the ones
+ * only used by simplified levels.
+ */
+static void ReorderVertices( MeshObject * object )
+{
+    const int vertexCount = object->vertexCount;
+    int * remap = (int *)malloc(sizeof(int)*(vertexCount+1));
+    for(int v = 0; v < vertexCount; v++)
+        remap[v] = -1;
+
+    int next = 0;
+    RemapIndices(object->indices, object->indexCount, remap, &next);
+    for(int i = 0; i < object->levelCount; i++)
+        RemapIndices(object->levels[i].indices, object->levels[i].indexCount, remap, &next);
+    // Unused vertices go to the end:
+    for(int v = 0; v < vertexCount; v++)
+        if(remap[v] < 0)
+            remap[v] = next++;
+
+    MeshVertex * vertices = (MeshVertex *)malloc(sizeof(MeshVertex)*(vertexCount+1));
+    for(int v = 0; v < vertexCount; v++)
+        vertices[remap[v]] = object->vertices[v];
+    free(object->vertices);
+    object->vertices = vertices;
+    object->vertexCapacity = vertexCount;
+    free(remap);
+}
+
+static void OptimizeTriangleOrder( const MeshObject * object,
+                                   uint32_t * indices,
+                                   int indexCount,
+                                   int cacheSize,
+                                   float overdrawThreshold )
+{
+    const int triangleCount = indexCount/3;
+    if(triangleCount == 0)
+        return;
+
+    int * order = (int *)malloc(sizeof(int)*triangleCount);
+    int * hardStarts = (int *)malloc(sizeof(int)*triangleCount);
+    int * starts = (int *)malloc(sizeof(int)*triangleCount);
+    const int hardCount = OrderTriangles(indices,
+                                         triangleCount*3,
+                                         object->vertexCount,
+                                         cacheSize,
+                                         order,
+                                         hardStarts);
+    const int clusterCount = SplitClusters(indices,
+                                           object->vertexCount,
+                                           cacheSize,
+                                           overdrawThreshold,
+                                           order,
+                                           triangleCount,
+                                           hardStarts,
+                                           hardCount,
+                                           starts);
+
+    Cluster * clusters = (Cluster *)malloc(sizeof(Cluster)*clusterCount);
+    for(int i = 0; i < clusterCount; i++)
+    {
+        clusters[i].start = starts[i];
+        clusters[i].end = (i+1 < clusterCount) ? starts[i+1] : triangleCount;
+    }
+    SortClusters(object, indices, order, clusters, clusterCount);
+
+    uint32_t * sorted = (uint32_t *)malloc(sizeof(uint32_t)*triangleCount*3);
+    int position = 0;
+    for(int i = 0; i < clusterCount; i++)
+        for(int t = clusters[i].start; t < clusters[i].end; t++, position += 3)
+            memcpy(&sorted[position], &indices[order[t]*3], sizeof(uint32_t)*3);
+    memcpy(indices, sorted, sizeof(uint32_t)*triangleCount*3);
+    free(sorted);
+
+    free(clusters);
+    free(starts);
+    free(hardStarts);
+    free(order);
+}
+
+void OptimizeMeshObject( MeshObject * object, int cacheSize, float overdrawThreshold )
+{
+    if(object->indexCount == 0)
+        return;
+
+    OptimizeTriangleOrder(object,
+                          object->indices,
+                          object->indexCount,
+                          cacheSize,
+                          overdrawThreshold);
+    for(int i = 0; i < object->levelCount; i++)
+        OptimizeTriangleOrder(object,
+                              object->levels[i].indices,
+                              object->levels[i].indexCount,
+                              cacheSize,
+                              overdrawThreshold);
+    ReorderVertices(object);
+}
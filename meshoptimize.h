@@ -0,0 +1,52 @@
+#ifndef __MESHOPTIMIZE_H__
+#define __MESHOPTIMIZE_H__
+
+#include <stdint.h> // uint32_t
+#include "mesh.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum
+{
+    /**
+     * Entries of the simulated post-transform cache.  Hardware uses
+     * anything from 16 to 32, more than 16 yields little.
+     */
+    DefaultVertexCacheSize = 16
+};
+
+typedef struct
+{
+    float acmr; // Transformed vertices per triangle, 0.5 is ideal
+    float atvr; // Transformed vertices per vertex, 1 is ideal
+} VertexCacheStats;
+
+/**
+ * Simulates a FIFO post-transform cache on a triangle list.
+ */
+void AnalyzeVertexCache( const uint32_t * indices,
+                         int indexCount,
+                         int vertexCount,
+                         int cacheSize,
+                         VertexCacheStats * stats );
+
+/**
+ * Reorders the triangles of an object for the post-transform cache
+ * (Tipsify), sorts the resulting clusters so triangles facing outwards are
+ * drawn first to reduce overdraw and finally orders the vertices by first
+ * use, so they're fetched sequentially.  Levels of detail are reordered the
+ * same way.
+ *
+ * @param overdrawThreshold
+ * How much worse the ACMR may get for smaller clusters, which are sorted
+ * more precisely.  1.05 is a good trade off, 1 keeps the cache order.
+ */
+void OptimizeMeshObject( MeshObject * object, int cacheSize, float overdrawThreshold );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
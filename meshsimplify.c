@@ -0,0 +1,756 @@
+#include <math.h> // sqrt
+#include <stdlib.h> // malloc, calloc, realloc, free, qsort
+#include <string.h> // memcmp, memcpy, memset
+#include "meshsimplify.h"
+
+
+enum
+{
+    EmptySlot = -1
+};
+
+/**
+ * How vertices may move.  Derived from the current mesh in every pass.
+ */
+typedef enum
+{
+    ManifoldVertex, // Anywhere
+    BorderVertex,   // Along the open border
+    SeamVertex,     // Along the seam, together with its twin
+    LockedVertex    // Corners, non-manifold and complex seams
+} VertexKind;
+
+typedef struct
+{
+    // Plane equation coefficients, summed over all planes:
+    double aa, ab, ac, ad;
+    double bb, bc, bd;
+    double cc, cd;
+    double dd;
+    double weight;
+} Quadric;
+
+typedef struct
+{
+    uint32_t from;
+    uint32_t to;
+    double error;
+} Collapse;
+
+/**
+ * Counts directed edges in an open addressing hash table.
+ */
+typedef struct
+{
+    uint64_t * keys;
+    int * counts;
+    int capacity; // Power of two
+} EdgeTable;
+
+
+// --- Helpers ---
+
+static uint32_t HashU64( uint64_t key )
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+static void InitEdgeTable( EdgeTable * table, int edgeCount )
+{
+    table->capacity = 16;
+    while(table->capacity < edgeCount*2)
+        table->capacity *= 2;
+    table->keys = (uint64_t *)malloc(sizeof(uint64_t)*table->capacity);
+    table->counts = (int *)malloc(sizeof(int)*table->capacity);
+    for(int i = 0; i < table->capacity; i++)
+        table->counts[i] = EmptySlot;
+}
+
+static void FreeEdgeTable( EdgeTable * table )
+{
+    free(table->keys);
+    free(table->counts);
+}
+
+static int * FindEdge( const EdgeTable * table, uint32_t a, uint32_t b, bool insert )
+{
+    const uint64_t key = ((uint64_t)a << 32) | b;
+    const int mask = table->capacity-1;
+    for(int slot = (int)(HashU64(key) & mask);; slot = (slot+1) & mask)
+    {
+        if(table->counts[slot] == EmptySlot)
+        {
+            if(!insert)
+                return NULL;
+            table->keys[slot] = key;
+            table->counts[slot] = 0;
+            return &table->counts[slot];
+        }
+        if(table->keys[slot] == key)
+            return &table->counts[slot];
+    }
+}
+
+static int GetEdgeCount( const EdgeTable * table, uint32_t a, uint32_t b )
+{
+    const int * count = FindEdge(table, a, b, false);
+    return count ? *count : 0;
+}
+
+static void Subtract( const float * a, const float * b, double * result )
+{
+    for(int c = 0; c < 3; c++)
+        result[c] = (double)a[c] - (double)b[c];
+}
+
+static void Cross( const double * a, const double * b, double * result )
+{
+    result[0] = a[1]*b[2] - a[2]*b[1];
+    result[1] = a[2]*b[0] - a[0]*b[2];
+    result[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+static double Dot( const double * a, const double * b )
+{
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static void AddPlane( Quadric * q, const double * normal, double d, double weight )
+{
+    const double a = normal[0];
+    const double b = normal[1];
+    const double c = normal[2];
+    q->aa += weight*a*a; q->ab += weight*a*b; q->ac += weight*a*c; q->ad += weight*a*d;
+    q->bb += weight*b*b; q->bc += weight*b*c; q->bd += weight*b*d;
+    q->cc += weight*c*c; q->cd += weight*c*d;
+    q->dd += weight*d*d;
+    q->weight += weight;
+}
+
+static void AddQuadric( Quadric * q, const Quadric * other )
+{
+    q->aa += other->aa; q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+    q->bb += other->bb; q->bc += other->bc; q->bd += other->bd;
+    q->cc += other->cc; q->cd += other->cd;
+    q->dd += other->dd;
+    q->weight += other->weight;
+}
+
+/**
+ * Mean squared distance of `p` to the planes of the quadric.
+ */
+static double EvaluateQuadric( const Quadric * q, const float * p )
+{
+    const double x = p[0];
+    const double y = p[1];
+    const double z = p[2];
+    const double error = q->aa*x*x + 2*q->ab*x*y + 2*q->ac*x*z + 2*q->ad*x +
+                         q->bb*y*y + 2*q->bc*y*z + 2*q->bd*y +
+                         q->cc*z*z + 2*q->cd*z +
+                         q->dd;
+    return (q->weight > 0 && error > 0) ? error / q->weight : 0;
+}
+
+
+// --- Mesh state ---
+
+typedef struct
+{
+    const MeshVertex * vertices;
+    int vertexCount;
+
+    uint32_t * indices;
+    int indexCount;
+
+    uint32_t * positionIds; // First vertex with the same position
+    uint32_t * twins; // Next vertex with the same position, circular
+    Quadric * quadrics; // Per position id
+
+    // Rebuilt every pass:
+    int * adjacencyOffsets;
+    int * adjacency; // Triangles per vertex
+    EdgeTable edges; // Between vertices
+    EdgeTable positionEdges; // Between position ids
+    VertexKind * kinds;
+} Simplifier;
+
+/**
+ * Groups vertices with equal positions.
+ */
+static void FindTwins( Simplifier * simplifier )
+{
+    const int vertexCount = simplifier->vertexCount;
+    int capacity = 16;
+    while(capacity < vertexCount*2)
+        capacity *= 2;
+    int * table = (int *)malloc(sizeof(int)*capacity);
+    for(int i = 0; i < capacity; i++)
+        table[i] = EmptySlot;
+
+    for(int v = 0; v < vertexCount; v++)
+    {
+        const float * position = simplifier->vertices[v].position;
+        uint32_t bits[3];
+        memcpy(bits, position, sizeof(bits));
+        const uint64_t key = ((uint64_t)bits[0] << 32) ^ ((uint64_t)bits[1] << 16) ^ bits[2];
+
+        int slot = (int)(HashU64(key) & (capacity-1));
+        while(table[slot] != EmptySlot &&
+              memcmp(simplifier->vertices[table[slot]].position, position, sizeof(float)*3) != 0)
+            slot = (slot+1) & (capacity-1);
+
+        if(table[slot] == EmptySlot)
+        {
+            table[slot] = v;
+            simplifier->positionIds[v] = v;
+            simplifier->twins[v] = v;
+        }
+        else
+        {
+            const uint32_t first = (uint32_t)table[slot];
+            simplifier->positionIds[v] = first;
+            simplifier->twins[v] = simplifier->twins[first];
+            simplifier->twins[first] = v;
+        }
+    }
+    free(table);
+}
+
+static int GetTwinCount( const Simplifier * simplifier, uint32_t vertex )
+{
+    int count = 1;
+    for(uint32_t v = simplifier->twins[vertex]; v != vertex; v = simplifier->twins[v])
+        count++;
+    return count;
+}
+
+static bool IsOpenEdge( const Simplifier * simplifier, uint32_t a, uint32_t b )
+{
+    return GetEdgeCount(&simplifier->edges, a, b) +
+           GetEdgeCount(&simplifier->edges, b, a) == 1;
+}
+
+static bool IsOpenPositionEdge( const Simplifier * simplifier, uint32_t a, uint32_t b )
+{
+    const uint32_t pa = simplifier->positionIds[a];
+    const uint32_t pb = simplifier->positionIds[b];
+    return GetEdgeCount(&simplifier->positionEdges, pa, pb) +
+           GetEdgeCount(&simplifier->positionEdges, pb, pa) == 1;
+}
+
+static void BuildQuadrics( Simplifier * simplifier )
+{
+    const uint32_t * indices = simplifier->indices;
+    for(int i = 0; i < simplifier->indexCount; i += 3)
+    {
+        const float * p0 = simplifier->vertices[indices[i+0]].position;
+        const float * p1 = simplifier->vertices[indices[i+1]].position;
+        const float * p2 = simplifier->vertices[indices[i+2]].position;
+        double e1[3], e2[3], normal[3];
+        Subtract(p1, p0, e1);
+        Subtract(p2, p0, e2);
+        Cross(e1, e2, normal);
+        const double length = sqrt(Dot(normal, normal));
+        if(length == 0)
+            continue;
+        for(int c = 0; c < 3; c++)
+            normal[c] /= length;
+        const double origin[3] = {p0[0], p0[1], p0[2]};
+        const double d = -Dot(normal, origin);
+        for(int j = 0; j < 3; j++)
+            AddPlane(&simplifier->quadrics[simplifier->positionIds[indices[i+j]]],
+                     normal,
+                     d,
+                     length*0.5);
+    }
+}
+
+/**
+ * Vertices on borders and seams get planes perpendicular to their
+ * triangles, which keep them from moving sideways.
+ */
+static void AddEdgeQuadrics( Simplifier * simplifier )
+{
+    const double BorderWeight = 10;
+    const uint32_t * indices = simplifier->indices;
+    for(int i = 0; i < simplifier->indexCount; i += 3)
+    for(int j = 0; j < 3; j++)
+    {
+        const uint32_t a = indices[i+j];
+        const uint32_t b = indices[i+(j+1)%3];
+        const uint32_t c = indices[i+(j+2)%3];
+        if(!IsOpenEdge(simplifier, a, b))
+            continue;
+
+        const float * pa = simplifier->vertices[a].position;
+        const float * pb = simplifier->vertices[b].position;
+        const float * pc = simplifier->vertices[c].position;
+        double edge[3], other[3], normal[3], plane[3];
+        Subtract(pb, pa, edge);
+        Subtract(pc, pa, other);
+        Cross(edge, other, normal);
+        Cross(edge, normal, plane);
+        const double length = sqrt(Dot(plane, plane));
+        if(length == 0)
+            continue;
+        for(int k = 0; k < 3; k++)
+            plane[k] /= length;
+        const double origin[3] = {pa[0], pa[1], pa[2]};
+        const double d = -Dot(plane, origin);
+        const double weight = Dot(edge, edge)*BorderWeight;
+        AddPlane(&simplifier->quadrics[simplifier->positionIds[a]], plane, d, weight);
+        AddPlane(&simplifier->quadrics[simplifier->positionIds[b]], plane, d, weight);
+    }
+}
+
+static void FreeTopology( Simplifier * simplifier )
+{
+    free(simplifier->adjacencyOffsets);
+    free(simplifier->adjacency);
+    free(simplifier->kinds);
+    FreeEdgeTable(&simplifier->edges);
+    FreeEdgeTable(&simplifier->positionEdges);
+}
+
+static void BuildTopology( Simplifier * simplifier )
+{
+    const int vertexCount = simplifier->vertexCount;
+    const int indexCount = simplifier->indexCount;
+    const uint32_t * indices = simplifier->indices;
+
+    simplifier->adjacencyOffsets = (int *)calloc(vertexCount+1, sizeof(int));
+    simplifier->adjacency = (int *)malloc(sizeof(int)*(indexCount+1));
+    for(int i = 0; i < indexCount; i++)
+        simplifier->adjacencyOffsets[indices[i]+1]++;
+    for(int v = 0; v < vertexCount; v++)
+        simplifier->adjacencyOffsets[v+1] += simplifier->adjacencyOffsets[v];
+    int * fill = (int *)malloc(sizeof(int)*(vertexCount+1));
+    memcpy(fill, simplifier->adjacencyOffsets, sizeof(int)*vertexCount);
+    for(int i = 0; i < indexCount; i++)
+        simplifier->adjacency[fill[indices[i]]++] = i/3;
+    free(fill);
+
+    InitEdgeTable(&simplifier->edges, indexCount);
+    InitEdgeTable(&simplifier->positionEdges, indexCount);
+    for(int i = 0; i < indexCount; i += 3)
+    for(int j = 0; j < 3; j++)
+    {
+        const uint32_t a = indices[i+j];
+        const uint32_t b = indices[i+(j+1)%3];
+        (*FindEdge(&simplifier->edges, a, b, true))++;
+        (*FindEdge(&simplifier->positionEdges,
+                   simplifier->positionIds[a],
+                   simplifier->positionIds[b],
+                   true))++;
+    }
+
+    // Count open edges per vertex and position:
+    int * openEdges = (int *)calloc(vertexCount+1, sizeof(int));
+    int * openPositionEdges = (int *)calloc(vertexCount+1, sizeof(int));
+    bool * complex = (bool *)calloc(vertexCount+1, sizeof(bool));
+    for(int i = 0; i < indexCount; i += 3)
+    for(int j = 0; j < 3; j++)
+    {
+        const uint32_t a = indices[i+j];
+        const uint32_t b = indices[i+(j+1)%3];
+        const uint32_t pa = simplifier->positionIds[a];
+        const uint32_t pb = simplifier->positionIds[b];
+        if(IsOpenEdge(simplifier, a, b))
+        {
+            openEdges[a]++;
+            openEdges[b]++;
+        }
+        if(IsOpenPositionEdge(simplifier, a, b))
+        {
+            openPositionEdges[pa]++;
+            openPositionEdges[pb]++;
+        }
+        // Edges used more than once per direction aren't manifold:
+        if(GetEdgeCount(&simplifier->positionEdges, pa, pb) > 1)
+        {
+            complex[pa] = true;
+            complex[pb] = true;
+        }
+    }
+
+    simplifier->kinds = (VertexKind *)malloc(sizeof(VertexKind)*(vertexCount+1));
+    for(int v = 0; v < vertexCount; v++)
+    {
+        const uint32_t position = simplifier->positionIds[v];
+        const int twinCount = GetTwinCount(simplifier, v);
+        VertexKind kind = LockedVertex;
+        if(complex[position])
+            kind = LockedVertex;
+        else if(twinCount == 1 && openEdges[v] == 0)
+            kind = ManifoldVertex;
+        else if(twinCount == 1 && openEdges[v] == 2 && openPositionEdges[position] == 2)
+            kind = BorderVertex;
+        else if(twinCount == 2 && openPositionEdges[position] == 0 &&
+                openEdges[v] == 2 && openEdges[simplifier->twins[v]] == 2)
+            kind = SeamVertex;
+        simplifier->kinds[v] = kind;
+    }
+
+    free(complex);
+    free(openPositionEdges);
+    free(openEdges);
+}
+
+
+// --- Collapsing ---
+
+static bool HasEdge( const Simplifier * simplifier, uint32_t a, uint32_t b )
+{
+    return GetEdgeCount(&simplifier->edges, a, b) + GetEdgeCount(&simplifier->edges, b, a) > 0;
+}
+
+/**
+ * Finds where the twins of `from` have to go when it collapses onto `to`.
+ *
+ * @return
+ * Number of vertices which move, 0 if the collapse isn't allowed.
+ */
+static int GetCollapseTargets( const Simplifier * simplifier,
+                               uint32_t from,
+                               uint32_t to,
+                               uint32_t * sources,
+                               uint32_t * targets )
+{
+    switch(simplifier->kinds[from])
+    {
+        case ManifoldVertex:
+            sources[0] = from;
+            targets[0] = to;
+            return 1;
+
+        case BorderVertex:
+            if(!IsOpenEdge(simplifier, from, to) || !IsOpenPositionEdge(simplifier, from, to))
+                return 0;
+            sources[0] = from;
+            targets[0] = to;
+            return 1;
+
+        case SeamVertex:
+        {
+            if(!IsOpenEdge(simplifier, from, to) || IsOpenPositionEdge(simplifier, from, to))
+                return 0;
+            // The twin has to follow along the other side of the seam:
+            const uint32_t twin = simplifier->twins[from];
+            uint32_t twinTarget = to;
+            bool found = false;
+            do
+            {
+                if(HasEdge(simplifier, twin, twinTarget) &&
+                   IsOpenEdge(simplifier, twin, twinTarget))
+                {
+                    found = true;
+                    break;
+                }
+                twinTarget = simplifier->twins[twinTarget];
+            } while(twinTarget != to);
+            if(!found)
+                return 0;
+            sources[0] = from;
+            targets[0] = to;
+            sources[1] = twin;
+            targets[1] = twinTarget;
+            return 2;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Whether moving `source` onto `target` keeps the orientation of the
+ * triangles around it.
+ */
+static bool IsFlipFree( const Simplifier * simplifier, uint32_t source, uint32_t target )
+{
+    const float * newPosition = simplifier->vertices[target].position;
+    for(int i = simplifier->adjacencyOffsets[source];
+        i < simplifier->adjacencyOffsets[source+1];
+        i++)
+    {
+        const uint32_t * triangle = &simplifier->indices[simplifier->adjacency[i]*3];
+        if(triangle[0] == target || triangle[1] == target || triangle[2] == target)
+            continue; // Vanishes
+
+        int corner = 0;
+        while(triangle[corner] != source)
+            corner++;
+        const float * p1 = simplifier->vertices[triangle[(corner+1)%3]].position;
+        const float * p2 = simplifier->vertices[triangle[(corner+2)%3]].position;
+        const float * p0 = simplifier->vertices[source].position;
+
+        double e1[3], e2[3], oldNormal[3], newNormal[3];
+        Subtract(p1, p0, e1);
+        Subtract(p2, p0, e2);
+        Cross(e1, e2, oldNormal);
+        Subtract(p1, newPosition, e1);
+        Subtract(p2, newPosition, e2);
+        Cross(e1, e2, newNormal);
+
+        // Rejects flips, slivers and triangles tilted by more than ~75°:
+        const double oldLength = sqrt(Dot(oldNormal, oldNormal));
+        const double newLength = sqrt(Dot(newNormal, newNormal));
+        if(Dot(oldNormal, newNormal) <= 0.25*oldLength*newLength || newLength == 0)
+            return false;
+    }
+    return true;
+}
+
+static int CompareCollapses( const void * a, const void * b )
+{
+    const Collapse * ca = (const Collapse *)a;
+    const Collapse * cb = (const Collapse *)b;
+    if(ca->error != cb->error)
+        return (ca->error < cb->error) ? -1 : 1;
+    if(ca->from != cb->from)
+        return (ca->from < cb->from) ? -1 : 1;
+    return (ca->to < cb->to) ? -1 : (ca->to > cb->to) ? 1 : 0;
+}
+
+static int CountSharedTriangles( const Simplifier * simplifier, uint32_t a, uint32_t b )
+{
+    int count = 0;
+    for(int i = simplifier->adjacencyOffsets[a]; i < simplifier->adjacencyOffsets[a+1]; i++)
+    {
+        const uint32_t * triangle = &simplifier->indices[simplifier->adjacency[i]*3];
+        count += triangle[0] == b || triangle[1] == b || triangle[2] == b;
+    }
+    return count;
+}
+
+static void LockNeighbourhood( const Simplifier * simplifier, uint32_t vertex, bool * locked )
+{
+    locked[vertex] = true;
+    for(int i = simplifier->adjacencyOffsets[vertex];
+        i < simplifier->adjacencyOffsets[vertex+1];
+        i++)
+    {
+        const uint32_t * triangle = &simplifier->indices[simplifier->adjacency[i]*3];
+        for(int j = 0; j < 3; j++)
+            locked[triangle[j]] = true;
+    }
+}
+
+/**
+ * Performs a batch of non-overlapping collapses with the smallest errors.
+ *
+ * @return
+ * Number of collapses done.
+ */
+static int RunPass( Simplifier * simplifier, int targetIndexCount, double * maxError )
+{
+    const uint32_t * indices = simplifier->indices;
+    const int indexCount = simplifier->indexCount;
+
+    // Each vertex only moves once per pass, so only its cheapest allowed
+    // collapse is a candidate:
+    const int vertexCount = simplifier->vertexCount;
+    Collapse * best = (Collapse *)malloc(sizeof(Collapse)*(vertexCount+1));
+    for(int v = 0; v < vertexCount; v++)
+        best[v].error = -1;
+    for(int i = 0; i < indexCount; i += 3)
+    for(int j = 0; j < 3; j++)
+    {
+        const uint32_t a = indices[i+j];
+        const uint32_t b = indices[i+(j+1)%3];
+        for(int k = 0; k < 2; k++)
+        {
+            const uint32_t from = k ? b : a;
+            const uint32_t to = k ? a : b;
+            if(simplifier->kinds[from] == LockedVertex)
+                continue;
+            const double error =
+                EvaluateQuadric(&simplifier->quadrics[simplifier->positionIds[from]],
+                                simplifier->vertices[to].position);
+            if(best[from].error >= 0 && error >= best[from].error)
+                continue;
+            uint32_t sources[2];
+            uint32_t targets[2];
+            if(GetCollapseTargets(simplifier, from, to, sources, targets) == 0)
+                continue;
+            best[from].from = from;
+            best[from].to = to;
+            best[from].error = error;
+        }
+    }
+
+    Collapse * collapses = best;
+    int collapseCount = 0;
+    for(int v = 0; v < vertexCount; v++)
+        if(best[v].error >= 0)
+            collapses[collapseCount++] = best[v];
+    qsort(collapses, collapseCount, sizeof(Collapse), CompareCollapses);
+
+    // Collapses late in the list get worse as earlier ones change the mesh,
+    // so each pass only takes about as many as are still needed:
+    const int neededTriangles = (indexCount - targetIndexCount)/3;
+    const int limitIndex = (neededTriangles < collapseCount) ? neededTriangles : collapseCount-1;
+    const double errorLimit = (collapseCount > 0) ? collapses[limitIndex].error : 0;
+
+    bool * locked = (bool *)calloc(simplifier->vertexCount+1, sizeof(bool));
+    uint32_t * remap = (uint32_t *)malloc(sizeof(uint32_t)*(simplifier->vertexCount+1));
+    for(int v = 0; v < simplifier->vertexCount; v++)
+        remap[v] = (uint32_t)v;
+
+    int removedTriangles = 0;
+    int done = 0;
+    for(int i = 0; i < collapseCount && removedTriangles < neededTriangles; i++)
+    {
+        const Collapse * collapse = &collapses[i];
+        if(collapse->error > errorLimit && done > 0)
+            break;
+
+        uint32_t sources[2];
+        uint32_t targets[2];
+        const int count = GetCollapseTargets(simplifier,
+                                             collapse->from,
+                                             collapse->to,
+                                             sources,
+                                             targets);
+        bool valid = count > 0;
+        for(int j = 0; j < count && valid; j++)
+            valid = !locked[sources[j]] && !locked[targets[j]] &&
+                    IsFlipFree(simplifier, sources[j], targets[j]);
+        if(!valid)
+            continue;
+
+        for(int j = 0; j < count; j++)
+        {
+            removedTriangles += CountSharedTriangles(simplifier, sources[j], targets[j]);
+            remap[sources[j]] = targets[j];
+            LockNeighbourhood(simplifier, sources[j], locked);
+            LockNeighbourhood(simplifier, targets[j], locked);
+        }
+        AddQuadric(&simplifier->quadrics[simplifier->positionIds[collapse->to]],
+                   &simplifier->quadrics[simplifier->positionIds[collapse->from]]);
+        if(collapse->error > *maxError)
+            *maxError = collapse->error;
+        done++;
+    }
+
+    // Apply the collapses and drop the triangles which vanished:
+    int newIndexCount = 0;
+    for(int i = 0; i < indexCount; i += 3)
+    {
+        const uint32_t a = remap[indices[i+0]];
+        const uint32_t b = remap[indices[i+1]];
+        const uint32_t c = remap[indices[i+2]];
+        if(a == b || b == c || c == a)
+            continue;
+        simplifier->indices[newIndexCount++] = a;
+        simplifier->indices[newIndexCount++] = b;
+        simplifier->indices[newIndexCount++] = c;
+    }
+    simplifier->indexCount = newIndexCount;
+
+    free(remap);
+    free(locked);
+    free(collapses);
+    return done;
+}
+
+int SimplifyMesh( const uint32_t * indices,
+                  int indexCount,
+                  const MeshVertex * vertices,
+                  int vertexCount,
+                  int targetIndexCount,
+                  uint32_t * destination,
+                  float * error )
+{
+    Simplifier simplifier;
+    memset(&simplifier, 0, sizeof(simplifier));
+    simplifier.vertices = vertices;
+    simplifier.vertexCount = vertexCount;
+    simplifier.indices = destination;
+    simplifier.indexCount = indexCount - indexCount%3;
+    memcpy(destination, indices, sizeof(uint32_t)*simplifier.indexCount);
+
+    simplifier.positionIds = (uint32_t *)malloc(sizeof(uint32_t)*(vertexCount+1));
+    simplifier.twins = (uint32_t *)malloc(sizeof(uint32_t)*(vertexCount+1));
+    simplifier.quadrics = (Quadric *)calloc(vertexCount+1, sizeof(Quadric));
+    FindTwins(&simplifier);
+
+    BuildTopology(&simplifier);
+    BuildQuadrics(&simplifier);
+    AddEdgeQuadrics(&simplifier);
+
+    double maxError = 0;
+    while(simplifier.indexCount > targetIndexCount)
+    {
+        const int done = RunPass(&simplifier, targetIndexCount, &maxError);
+        FreeTopology(&simplifier);
+        BuildTopology(&simplifier);
+        if(done == 0)
+            break;
+    }
+    FreeTopology(&simplifier);
+
+    // Relative to the bounding box diagonal:
+    float boundsMin[3] = {0, 0, 0};
+    float boundsMax[3] = {0, 0, 0};
+    for(int v = 0; v < vertexCount; v++)
+    for(int c = 0; c < 3; c++)
+    {
+        const float value = vertices[v].position[c];
+        if(v == 0 || value < boundsMin[c]) boundsMin[c] = value;
+        if(v == 0 || value > boundsMax[c]) boundsMax[c] = value;
+    }
+    double extent[3];
+    Subtract(boundsMax, boundsMin, extent);
+    const double diagonal = sqrt(Dot(extent, extent));
+    *error = (diagonal > 0) ? (float)(sqrt(maxError) / diagonal) : 0;
+
+    free(simplifier.quadrics);
+    free(simplifier.twins);
+    free(simplifier.positionIds);
+    return simplifier.indexCount;
+}
+
+void GenerateMeshLevels( MeshObject * object, int levelCount, float ratio )
+{
+    const uint32_t * indices = object->indices;
+    int indexCount = object->indexCount;
+    float error = 0;
+    for(int i = 0; i < levelCount; i++)
+    {
+        int target = (int)((float)indexCount*ratio);
+        target -= target%3;
+
+        uint32_t * result = (uint32_t *)malloc(sizeof(uint32_t)*(indexCount+1));
+        float levelError;
+        const int resultCount = SimplifyMesh(indices,
+                                             indexCount,
+                                             object->vertices,
+                                             object->vertexCount,
+                                             target,
+                                             result,
+                                             &levelError);
+
+        // Levels which hardly differ aren't worth it:
+        if(resultCount == 0 || resultCount > indexCount - indexCount/10)
+        {
+            free(result);
+            break;
+        }
+
+        // Each level builds on the previous one, so the errors add up:
+        error += levelError;
+        object->levels = (MeshLevel *)realloc(object->levels,
+                                              sizeof(MeshLevel)*(object->levelCount+1));
+        MeshLevel * level = &object->levels[object->levelCount++];
+        level->indices = result;
+        level->indexCount = resultCount;
+        level->error = error;
+
+        indices = result;
+        indexCount = resultCount;
+    }
+}
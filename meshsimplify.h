@@ -0,0 +1,50 @@
+#ifndef __MESHSIMPLIFY_H__
+#define __MESHSIMPLIFY_H__
+
+#include <stdint.h> // uint32_t
+#include "mesh.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Removes triangles by collapsing edges in the order of their quadric error
+ * (Garland and Heckbert).  Vertices are moved onto one of their neighbours,
+ * so the attributes of the remaining vertices don't change.
+ *
+ * Vertices with equal positions but different normals, texture coordinates
+ * or colors form seams.  Those, as well as open borders, are only collapsed
+ * along themselves, so the seam stays closed and the outline intact.
+ *
+ * @param destination
+ * Receives at most `indexCount` indices.
+ *
+ * @param error
+ * Receives the largest deviation caused, relative to the extent of the
+ * mesh.
+ *
+ * @return
+ * Index count of the result.  It is larger than `targetIndexCount` if the
+ * mesh can't be simplified further.
+ */
+int SimplifyMesh( const uint32_t * indices,
+                  int indexCount,
+                  const MeshVertex * vertices,
+                  int vertexCount,
+                  int targetIndexCount,
+                  uint32_t * destination,
+                  float * error );
+
+/**
+ * Adds up to `levelCount` levels of detail, each having `ratio` times the
+ * triangles of the previous one.  Stops early once the mesh can't be
+ * simplified any more.
+ */
+void GenerateMeshLevels( MeshObject * object, int levelCount, float ratio );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,587 @@
+#include <assert.h>
+#include <math.h> // powf, sqrtf, sinf, ceilf, floorf, fabsf
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcpy, memset
+#include "mipmap.h"
+#include "stats.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || \
+    (defined(__i386__) && defined(__SSE2__))
+#define MIPMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+enum
+{
+    BandHeight = 32 // Rows filtered by one task
+};
+
+static const float KaiserRadius = 3.0f;
+static const float KaiserAlpha = 4.0f;
+static const float LanczosRadius = 3.0f;
+static const float Pi = 3.14159265358979f;
+
+
+const char * MipFilterToString( MipFilter filter )
+{
+    switch(filter)
+    {
+        case MipKaiser:  return "Kaiser";
+        case MipLanczos: return "Lanczos";
+        case MipBox:     return "Box";
+        case MipFilterCount: ; // fallthrough
+    }
+    assert(!"Unknown mip filter.");
+    return NULL;
+}
+
+const char * MipContentToString( MipContent content )
+{
+    switch(content)
+    {
+        case MipColor:         return "Color";
+        case MipData:          return "Data";
+        case MipNormalMap:     return "NormalMap";
+        case MipDistanceField: return "DistanceField";
+        case MipContentCount: ; // fallthrough
+    }
+    assert(!"Unknown mip content.");
+    return NULL;
+}
+
+int GetMipLevelCount( int width, int height )
+{
+    int count = 1;
+    while(width > 1 || height > 1)
+    {
+        width = (width > 1) ? width/2 : 1;
+        height = (height > 1) ? height/2 : 1;
+        count++;
+    }
+    return count;
+}
+
+
+// --- Kernels ---
+
+static float Sinc( float x )
+{
+    if(fabsf(x) < 1e-6f)
+        return 1.0f;
+    return sinf(Pi*x) / (Pi*x);
+}
+
+/**
+ * Modified Bessel function of the first kind, as needed by the Kaiser window.
+ */
+static float BesselI0( float x )
+{
+    const float xx = x*x*0.25f;
+    float sum = 1.0f;
+    float term = 1.0f;
+    for(int k = 1; k < 32 && term > sum*1e-8f; k++)
+    {
+        term *= xx / (float)(k*k);
+        sum += term;
+    }
+    return sum;
+}
+
+static float GetFilterRadius( MipFilter filter )
+{
+    switch(filter)
+    {
+        case MipKaiser:  return KaiserRadius;
+        case MipLanczos: return LanczosRadius;
+        default:         return 0.5f;
+    }
+}
+
+/**
+ * @param x
+ * Distance in destination pixels.
+ */
+static float EvaluateFilter( MipFilter filter, float x )
+{
+    const float radius = GetFilterRadius(filter);
+    x = fabsf(x);
+    if(x >= radius)
+        return 0.0f;
+    switch(filter)
+    {
+        case MipKaiser:
+        {
+            const float t = x / radius;
+            return Sinc(x) * BesselI0(KaiserAlpha*sqrtf(1.0f - t*t)) / BesselI0(KaiserAlpha);
+        }
+        case MipLanczos:
+            return Sinc(x) * Sinc(x/radius);
+        default:
+            return 1.0f;
+    }
+}
+
+
+// --- Axis filtering ---
+
+/**
+ * Filter taps of one axis.  Each destination coordinate has `tapCount` taps,
+ * unused ones have zero weight.
+ */
+typedef struct
+{
+    int tapCount;
+    int * indices;
+    float * weights;
+} AxisFilter;
+
+static int WrapIndex( int index, int size, bool wrap )
+{
+    if(wrap)
+    {
+        index %= size;
+        return (index < 0) ? index + size : index;
+    }
+    if(index < 0)
+        return 0;
+    if(index >= size)
+        return size-1;
+    return index;
+}
+
+static void CreateAxisFilter( AxisFilter * axis,
+                              MipFilter filter,
+                              bool wrap,
+                              int size,
+                              int newSize )
+{
+    const float scale = (float)newSize / (float)size;
+    const float support = GetFilterRadius(filter) / scale;
+    const int tapCount = (int)ceilf(support*2.0f) + 1;
+
+    axis->tapCount = tapCount;
+    axis->indices = (int *)malloc(sizeof(int)*tapCount*newSize);
+    axis->weights = (float *)malloc(sizeof(float)*tapCount*newSize);
+
+    for(int i = 0; i < newSize; i++)
+    {
+        int * indices = &axis->indices[i*tapCount];
+        float * weights = &axis->weights[i*tapCount];
+
+        const float center = ((float)i + 0.5f) / scale - 0.5f;
+        const int first = (int)floorf(center - support) + 1;
+
+        float weightSum = 0;
+        for(int t = 0; t < tapCount; t++)
+        {
+            const int source = first + t;
+            const float weight = EvaluateFilter(filter, ((float)source - center) * scale);
+            indices[t] = WrapIndex(source, size, wrap);
+            weights[t] = weight;
+            weightSum += weight;
+        }
+
+        for(int t = 0; t < tapCount; t++)
+            weights[t] /= weightSum;
+    }
+}
+
+static void FreeAxisFilter( AxisFilter * axis )
+{
+    free(axis->indices);
+    free(axis->weights);
+}
+
+typedef struct
+{
+    const AxisFilter * axis;
+    int channels;
+    const float * source;
+    int sourceWidth;
+    float * destination;
+    int destinationWidth;
+} AxisPass;
+
+typedef struct
+{
+    const AxisPass * pass;
+    int firstRow;
+    int endRow;
+} Band;
+
+/**
+ * Filters rows of `sourceWidth` pixels to `destinationWidth`.
+ */
+static void FilterRows( void * data, int workerIndex )
+{
+    const Band * band = (const Band *)data;
+    const AxisPass * pass = band->pass;
+    const AxisFilter * axis = pass->axis;
+    const int channels = pass->channels;
+    const int tapCount = axis->tapCount;
+
+    for(int y = band->firstRow; y < band->endRow; y++)
+    {
+        const float * sourceRow = &pass->source[(size_t)y*pass->sourceWidth*channels];
+        float * destinationRow = &pass->destination[(size_t)y*pass->destinationWidth*channels];
+        for(int x = 0; x < pass->destinationWidth; x++)
+        {
+            const int * indices = &axis->indices[x*tapCount];
+            const float * weights = &axis->weights[x*tapCount];
+            float * pixel = &destinationRow[x*channels];
+#if defined(MIPMAP_SSE2)
+            if(channels == 4)
+            {
+                __m128 sum = _mm_setzero_ps();
+                for(int t = 0; t < tapCount; t++)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&sourceRow[indices[t]*4]),
+                                                     _mm_set1_ps(weights[t])));
+                _mm_storeu_ps(pixel, sum);
+                continue;
+            }
+#endif
+            for(int c = 0; c < channels; c++)
+            {
+                float sum = 0;
+                for(int t = 0; t < tapCount; t++)
+                    sum += sourceRow[indices[t]*channels + c] * weights[t];
+                pixel[c] = sum;
+            }
+        }
+    }
+}
+
+/**
+ * Filters columns: each destination row is a weighted sum of whole source
+ * rows, which are contiguous and vectorize regardless of the channel count.
+ * The source and destination width are equal here.
+ */
+static void FilterColumns( void * data, int workerIndex )
+{
+    const Band * band = (const Band *)data;
+    const AxisPass * pass = band->pass;
+    const AxisFilter * axis = pass->axis;
+    const int tapCount = axis->tapCount;
+    const int count = pass->destinationWidth * pass->channels;
+
+    for(int y = band->firstRow; y < band->endRow; y++)
+    {
+        const int * indices = &axis->indices[y*tapCount];
+        const float * weights = &axis->weights[y*tapCount];
+        float * destinationRow = &pass->destination[(size_t)y*count];
+        memset(destinationRow, 0, sizeof(float)*count);
+        for(int t = 0; t < tapCount; t++)
+        {
+            const float weight = weights[t];
+            if(weight == 0)
+                continue;
+            const float * sourceRow = &pass->source[(size_t)indices[t]*count];
+            int i = 0;
+#if defined(MIPMAP_SSE2)
+            const __m128 w = _mm_set1_ps(weight);
+            for(; i+4 <= count; i += 4)
+                _mm_storeu_ps(&destinationRow[i],
+                              _mm_add_ps(_mm_loadu_ps(&destinationRow[i]),
+                                         _mm_mul_ps(_mm_loadu_ps(&sourceRow[i]), w)));
+#endif
+            for(; i < count; i++)
+                destinationRow[i] += sourceRow[i] * weight;
+        }
+    }
+}
+
+/**
+ * Splits `rowCount` rows into bands and runs them on the pool, or directly
+ * without one.
+ */
+static void RunBands( ThreadPool * pool, TaskFunction function, const AxisPass * pass, int rowCount )
+{
+    const int bandCount = (rowCount + BandHeight - 1) / BandHeight;
+    Band * bands = (Band *)malloc(sizeof(Band)*bandCount);
+    for(int i = 0; i < bandCount; i++)
+    {
+        bands[i].pass = pass;
+        bands[i].firstRow = i*BandHeight;
+        bands[i].endRow = (i+1)*BandHeight < rowCount ? (i+1)*BandHeight : rowCount;
+        if(pool)
+            SubmitTask(pool, function, &bands[i]);
+        else
+            function(&bands[i], 0);
+    }
+    if(pool)
+        WaitForTasks(pool);
+    free(bands);
+}
+
+static void DownsampleLevel( const MipLevel * source,
+                             MipLevel * destination,
+                             int channels,
+                             MipFilter filter,
+                             bool wrap,
+                             ThreadPool * pool )
+{
+    AxisFilter xFilter;
+    AxisFilter yFilter;
+    CreateAxisFilter(&xFilter, filter, wrap, source->width, destination->width);
+    CreateAxisFilter(&yFilter, filter, wrap, source->height, destination->height);
+
+    // Horizontal pass into newWidth*height, then vertical pass:
+    float * temp = (float *)malloc(sizeof(float)*destination->width*source->height*channels);
+
+    const AxisPass horizontal = { &xFilter, channels,
+                                  source->data, source->width,
+                                  temp, destination->width };
+    RunBands(pool, FilterRows, &horizontal, source->height);
+
+    const AxisPass vertical = { &yFilter, channels,
+                                temp, destination->width,
+                                destination->data, destination->width };
+    RunBands(pool, FilterColumns, &vertical, destination->height);
+
+    free(temp);
+    FreeAxisFilter(&yFilter);
+    FreeAxisFilter(&xFilter);
+}
+
+
+// --- Working space ---
+
+static float SrgbToLinear( float value )
+{
+    if(value <= 0.04045f)
+        return value / 12.92f;
+    return powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb( float value )
+{
+    if(value <= 0.0031308f)
+        return value * 12.92f;
+    return 1.055f*powf(value, 1.0f/2.4f) - 0.055f;
+}
+
+static float Saturate( float value )
+{
+    if(!(value > 0)) // Also catches NaN.
+        return 0;
+    if(value > 1)
+        return 1;
+    return value;
+}
+
+static bool HasAlpha( int channels, MipContent content )
+{
+    return content == MipColor && (channels == 2 || channels == 4);
+}
+
+/**
+ * Colors are filtered in linear light and premultiplied, so transparent
+ * pixels don't bleed their color into visible ones.
+ */
+static void ToWorkingSpace( float * pixels, size_t pixelCount, int channels, MipContent content )
+{
+    if(content != MipColor)
+        return;
+    const bool alpha = HasAlpha(channels, content);
+    const int colorChannels = alpha ? channels-1 : channels;
+    for(size_t i = 0; i < pixelCount; i++)
+    {
+        float * pixel = &pixels[i*channels];
+        const float a = alpha ? pixel[colorChannels] : 1.0f;
+        for(int c = 0; c < colorChannels; c++)
+            pixel[c] = SrgbToLinear(pixel[c]) * a;
+    }
+}
+
+static void FromWorkingSpace( float * pixels,
+                              size_t pixelCount,
+                              int channels,
+                              MipContent content,
+                              bool linearColor )
+{
+    switch(content)
+    {
+        case MipColor:
+        {
+            const bool alpha = HasAlpha(channels, content);
+            const int colorChannels = alpha ? channels-1 : channels;
+            for(size_t i = 0; i < pixelCount; i++)
+            {
+                float * pixel = &pixels[i*channels];
+                const float a = alpha ? Saturate(pixel[colorChannels]) : 1.0f;
+                for(int c = 0; c < colorChannels; c++)
+                {
+                    const float value = (a > 0) ? Saturate(pixel[c] / a) : 0.0f;
+                    pixel[c] = linearColor ? value : LinearToSrgb(value);
+                }
+                if(alpha)
+                    pixel[colorChannels] = a;
+            }
+            break;
+        }
+
+        case MipNormalMap:
+            if(channels < 3)
+                break;
+            for(size_t i = 0; i < pixelCount; i++)
+            {
+                float * pixel = &pixels[i*channels];
+                const float x = pixel[0]*2.0f - 1.0f;
+                const float y = pixel[1]*2.0f - 1.0f;
+                const float z = pixel[2]*2.0f - 1.0f;
+                const float length = sqrtf(x*x + y*y + z*z);
+                if(length > 0)
+                {
+                    pixel[0] = Saturate(x / length * 0.5f + 0.5f);
+                    pixel[1] = Saturate(y / length * 0.5f + 0.5f);
+                    pixel[2] = Saturate(z / length * 0.5f + 0.5f);
+                }
+                else
+                {
+                    pixel[0] = 0.5f;
+                    pixel[1] = 0.5f;
+                    pixel[2] = 1.0f;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+// --- Alpha coverage ---
+
+static float GetAlphaCoverage( const float * pixels,
+                               size_t pixelCount,
+                               int channels,
+                               float reference,
+                               float scale )
+{
+    size_t passed = 0;
+    for(size_t i = 0; i < pixelCount; i++)
+        if(pixels[i*channels + channels-1] * scale > reference)
+            passed++;
+    return (float)passed / (float)pixelCount;
+}
+
+/**
+ * Scales the alpha channel so `coverage` of the pixels pass the alpha test.
+ */
+static void PreserveAlphaCoverage( float * pixels,
+                                   size_t pixelCount,
+                                   int channels,
+                                   float reference,
+                                   float coverage )
+{
+    // Small levels can't match exactly, so the closest scale tried is used:
+    float low = 0.0f;
+    float high = 4.0f;
+    float scale = 1.0f;
+    float bestScale = 1.0f;
+    float bestError = 2.0f;
+    for(int i = 0; i < 16; i++)
+    {
+        const float current = GetAlphaCoverage(pixels, pixelCount, channels, reference, scale);
+        const float error = fabsf(current - coverage);
+        if(error < bestError)
+        {
+            bestScale = scale;
+            bestError = error;
+        }
+        if(current < coverage)
+            low = scale;
+        else if(current > coverage)
+            high = scale;
+        else
+            break;
+        scale = (low + high) * 0.5f;
+    }
+
+    for(size_t i = 0; i < pixelCount; i++)
+    {
+        float * alpha = &pixels[i*channels + channels-1];
+        *alpha = Saturate(*alpha * bestScale);
+    }
+}
+
+
+// --- Chain ---
+
+MipLevel * GenerateMipChain( int width,
+                             int height,
+                             int channels,
+                             const float * pixels,
+                             const MipOptions * options,
+                             bool linearColor,
+                             ThreadPool * pool )
+{
+    StatsScope scope;
+    BeginStatsScope(&scope, "mipmap", MipFilterToString(options->filter));
+
+    const MipFilter filter = (options->content == MipDistanceField) ? MipBox : options->filter;
+    const bool alphaTest = HasAlpha(channels, options->content) &&
+                           options->alphaReference >= 0;
+    const int levelCount = GetMipLevelCount(width, height);
+
+    MipLevel * levels = (MipLevel *)malloc(sizeof(MipLevel)*levelCount);
+    levels[0].width = width;
+    levels[0].height = height;
+    levels[0].data = (float *)malloc(sizeof(float)*width*height*channels);
+    memcpy(levels[0].data, pixels, sizeof(float)*width*height*channels);
+
+    const float coverage = alphaTest ?
+        GetAlphaCoverage(pixels, (size_t)width*height, channels, options->alphaReference, 1.0f) :
+        0.0f;
+
+    // Every level is filtered from the previous one in working space, before
+    // that is converted back:
+    MipLevel work[2];
+    work[0] = levels[0];
+    work[0].data = (float *)malloc(sizeof(float)*width*height*channels);
+    memcpy(work[0].data, pixels, sizeof(float)*width*height*channels);
+    ToWorkingSpace(work[0].data, (size_t)width*height, channels, options->content);
+    work[1].data = (float *)malloc(sizeof(float)*(width/2 > 0 ? width/2 : 1)*
+                                                 (height/2 > 0 ? height/2 : 1)*channels);
+
+    for(int i = 1; i < levelCount; i++)
+    {
+        MipLevel * source = &work[(i-1) & 1];
+        MipLevel * destination = &work[i & 1];
+        destination->width = (source->width > 1) ? source->width/2 : 1;
+        destination->height = (source->height > 1) ? source->height/2 : 1;
+        DownsampleLevel(source, destination, channels, filter, options->wrap, pool);
+
+        const size_t pixelCount = (size_t)destination->width*destination->height;
+        MipLevel * level = &levels[i];
+        level->width = destination->width;
+        level->height = destination->height;
+        level->data = (float *)malloc(sizeof(float)*pixelCount*channels);
+        memcpy(level->data, destination->data, sizeof(float)*pixelCount*channels);
+        FromWorkingSpace(level->data, pixelCount, channels, options->content, linearColor);
+        if(alphaTest)
+            PreserveAlphaCoverage(level->data, pixelCount, channels,
+                                  options->alphaReference, coverage);
+    }
+
+    free(work[0].data);
+    free(work[1].data);
+
+    if(linearColor && options->content == MipColor)
+    {
+        ToWorkingSpace(levels[0].data, (size_t)width*height, channels, MipColor);
+        FromWorkingSpace(levels[0].data, (size_t)width*height, channels, MipColor, true);
+    }
+
+    AddStatsCount("mip levels", levelCount);
+    EndStatsScope(&scope);
+    return levels;
+}
+
+void FreeMipChain( MipLevel * levels, int levelCount )
+{
+    for(int i = 0; i < levelCount; i++)
+        free(levels[i].data);
+    free(levels);
+}
@@ -0,0 +1,112 @@
+#ifndef __MIPMAP_H__
+#define __MIPMAP_H__
+
+#include <stdbool.h>
+#include "threadpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    MipKaiser,
+    MipLanczos,
+    MipBox,
+    MipFilterCount
+} MipFilter;
+
+const char * MipFilterToString( MipFilter filter );
+
+/**
+ * What the channels contain, which decides how they're filtered.
+ */
+typedef enum
+{
+    /**
+     * sRGB encoded colors, optionally with alpha in the last channel of
+     * two or four.  Filtered in linear light with premultiplied alpha.
+     */
+    MipColor,
+
+    /**
+     * Linear values, filtered as they are.
+     */
+    MipData,
+
+    /**
+     * Normals mapped from [-1, 1] to [0, 1] in the first three channels.
+     * Every level is renormalized.
+     */
+    MipNormalMap,
+
+    /**
+     * Distance fields as written by #GenerateDistanceField.  Windowed sinc
+     * kernels ring around edges, which would move the outline, so levels
+     * are averaged with a box filter instead, which keeps the zero crossing
+     * of a linear field in place.
+     */
+    MipDistanceField,
+
+    MipContentCount
+} MipContent;
+
+const char * MipContentToString( MipContent content );
+
+typedef struct
+{
+    MipContent content;
+    MipFilter filter; // Ignored for distance fields
+    bool wrap; // Filter across the edges, for tiling textures
+
+    /**
+     * Alpha test reference value.  If not negative, the alpha of every
+     * level is scaled so the same fraction of pixels passes the test as in
+     * the full resolution image, so alpha tested foliage doesn't thin out.
+     */
+    float alphaReference;
+} MipOptions;
+
+typedef struct
+{
+    int width;
+    int height;
+    float * data; // width*height*channels elements, interleaved
+} MipLevel;
+
+/**
+ * Levels down to 1x1, including the full resolution one.
+ */
+int GetMipLevelCount( int width, int height );
+
+/**
+ * Generates the complete chain.  Each level halves the size of the previous
+ * one, rounded down, and is filtered from it with a separable kernel.  Rows
+ * are processed in bands on the pool's threads.
+ *
+ * @param pixels
+ * Is expected being an array with width*height*channels elements.  The
+ * first level is a copy.
+ *
+ * @param linearColor
+ * Color levels are converted back to sRGB, unless this is set; e.g. for
+ * formats with enough precision for linear values.
+ *
+ * @return
+ * #GetMipLevelCount levels, to be freed with #FreeMipChain.
+ */
+MipLevel * GenerateMipChain( int width,
+                             int height,
+                             int channels,
+                             const float * pixels,
+                             const MipOptions * options,
+                             bool linearColor,
+                             ThreadPool * pool );
+
+void FreeMipChain( MipLevel * levels, int levelCount );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,8 +1,9 @@
 #include <assert.h>
 #include <math.h> // sqrtf
 #include <stdlib.h> // malloc, free
-#include <string.h> // memset
+#include <pthread.h> // pthread_once
 #include "normalmap.h"
+#include "stats.h"
 #include <stdio.h> // DEBUG
 
 
@@ -81,14 +82,6 @@ static Kernel * CreateKernel( int size, const float * weights )
     return kernel;
 }
 
-static void FreeKernel( Kernel * kernel )
-{
-    assert(kernel->elements != NULL);
-    free(kernel->elements);
-    memset(kernel, 0, sizeof(Kernel));
-    free(kernel);
-}
-
 static const float Prewitt3x3XWeights[] =
 {
     -1, 0, +1,
@@ -184,6 +177,28 @@ static void CreateFilterKernels( NormalMapFilter filter,
     assert(!"Unknown normal map filter.");
 }
 
+// Kernels are created once and shared by all calls, which matters when many
+// small images are processed in one process.
+static Kernel * XKernels[NormalMapFilterCount];
+static Kernel * YKernels[NormalMapFilterCount];
+static pthread_once_t KernelsCreated = PTHREAD_ONCE_INIT;
+
+static void CreateAllFilterKernels()
+{
+    for(int i = 0; i < NormalMapFilterCount; i++)
+        CreateFilterKernels((NormalMapFilter)i, &XKernels[i], &YKernels[i]);
+}
+
+static void GetFilterKernels( NormalMapFilter filter,
+                              const Kernel * * xKernel,
+                              const Kernel * * yKernel )
+{
+    assert(filter >= 0 && filter < NormalMapFilterCount);
+    pthread_once(&KernelsCreated, CreateAllFilterKernels);
+    *xKernel = XKernels[filter];
+    *yKernel = YKernels[filter];
+}
+
 static int GetCroppedMapIndex( int width,
                                int height,
                                int x,
@@ -279,24 +294,54 @@ static void NormalToRGB( float * v )
            v[2] >= 0 && v[2] <= 1);
 }
 
-void GenerateNormalMap( int width,
-                        int height,
-                        const float * heightMap,
-                        float * normalMap,
-                        NormalMapFilter filter,
-                        bool wrap,
-                        bool invertY )
+int GetNormalMapFilterRadius( NormalMapFilter filter )
 {
-    Kernel * xKernel;
-    Kernel * yKernel;
-    CreateFilterKernels(filter, &xKernel, &yKernel);
+    switch(filter)
+    {
+        case Prewitt3x3:
+        case Sobel3x3:
+        case Scharr3x3:
+            return 1;
+
+        case Prewitt5x5:
+        case Sobel5x5:
+        case Scharr5x5:
+            return 2;
+
+        case NormalMapFilterCount: ; // fallthrough
+    }
+    assert(!"Unknown normal map filter.");
+    return 0;
+}
+
+void GenerateNormalMapRegion( int width,
+                              int height,
+                              const float * heightMap,
+                              float * normalMap,
+                              NormalMapFilter filter,
+                              bool wrap,
+                              bool invertY,
+                              int regionX,
+                              int regionY,
+                              int regionWidth,
+                              int regionHeight )
+{
+    assert(regionX >= 0 && regionX+regionWidth  <= width);
+    assert(regionY >= 0 && regionY+regionHeight <= height);
+
+    StatsScope scope;
+    BeginStatsScope(&scope, "normal map", NULL);
+
+    const Kernel * xKernel;
+    const Kernel * yKernel;
+    GetFilterKernels(filter, &xKernel, &yKernel);
 
     const float yModifier = invertY ?  1 : -1;
     // Flip Y by default, to be compatible with normal maps generated by Blender.
 
     #pragma omp parallel for collapse(2)
-    for(int y = 0; y < height; y++)
-    for(int x = 0; x < width;  x++)
+    for(int y = regionY; y < regionY+regionHeight; y++)
+    for(int x = regionX; x < regionX+regionWidth;  x++)
     {
         float * normal = &normalMap[(y*width + x)*3];
         normal[0] = ApplyKernel(xKernel, heightMap, width, height, wrap, x, y);
@@ -307,6 +352,26 @@ void GenerateNormalMap( int width,
         NormalToRGB(normal);
     }
 
-    FreeKernel(xKernel);
-    FreeKernel(yKernel);
+    EndStatsScope(&scope);
+}
+
+void GenerateNormalMap( int width,
+                        int height,
+                        const float * heightMap,
+                        float * normalMap,
+                        NormalMapFilter filter,
+                        bool wrap,
+                        bool invertY )
+{
+    GenerateNormalMapRegion(width,
+                            height,
+                            heightMap,
+                            normalMap,
+                            filter,
+                            wrap,
+                            invertY,
+                            0,
+                            0,
+                            width,
+                            height);
 }
@@ -43,6 +43,27 @@ void GenerateNormalMap( int width,
                         bool wrap,
                         bool invertY );
 
+/**
+ * Distance in pixels up to which a height change affects the normals.
+ */
+int GetNormalMapFilterRadius( NormalMapFilter filter );
+
+/**
+ * Like #GenerateNormalMap, but only writes the normals of a region.
+ * The kernel still reads the height map outside of the region.
+ */
+void GenerateNormalMapRegion( int width,
+                              int height,
+                              const float * heightMap,
+                              float * normalMap,
+                              NormalMapFilter filter,
+                              bool wrap,
+                              bool invertY,
+                              int regionX,
+                              int regionY,
+                              int regionWidth,
+                              int regionHeight );
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,223 @@
+#include <stdio.h> // fprintf, fopen, fread
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcmp, memcpy, strcmp
+#if !defined(_WIN32)
+#include <fcntl.h> // open
+#include <unistd.h> // close
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#endif
+#include "packfile.h"
+#include "lz4block.h"
+#include "pack.h"
+
+struct Pack
+{
+    const unsigned char * data;
+    size_t size;
+    const PackFileHeader * header;
+    const PackFileEntry * entries;
+    const uint32_t * slots;
+    const char * strings;
+};
+
+uint64_t HashPackName( const char * name )
+{
+    uint64_t hash = UINT64_C(14695981039346656037);
+    for(const unsigned char * c = (const unsigned char *)name; *c; c++)
+    {
+        hash ^= *c;
+        hash *= UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+/**
+ * Maps the whole file read only.  Falls back to reading it where mapping
+ * isn't available.
+ */
+static const unsigned char * MapFile( const char * fileName, size_t * size )
+{
+#if defined(_WIN32)
+    FILE * file = fopen(fileName, "rb");
+    if(!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    *size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char * data = (unsigned char *)malloc(*size ? *size : 1);
+    const bool success = fread(data, 1, *size, file) == *size;
+    fclose(file);
+    if(!success)
+    {
+        free(data);
+        return NULL;
+    }
+    return data;
+#else
+    const int file = open(fileName, O_RDONLY);
+    if(file < 0)
+        return NULL;
+    struct stat status;
+    if(fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        close(file);
+        return NULL;
+    }
+    *size = (size_t)status.st_size;
+    void * data = mmap(NULL, *size, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    return data == MAP_FAILED ? NULL : (const unsigned char *)data;
+#endif
+}
+
+static void UnmapFile( const unsigned char * data, size_t size )
+{
+#if defined(_WIN32)
+    free((void *)data);
+#else
+    munmap((void *)data, size);
+#endif
+}
+
+static bool IsInside( uint64_t offset, uint64_t size, uint64_t fileSize )
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+static bool ValidatePack( const Pack * pack )
+{
+    const PackFileHeader * header = pack->header;
+    if(pack->size < sizeof(PackFileHeader) ||
+       memcmp(header->magic, PACK_FILE_MAGIC, 4) != 0 ||
+       header->version != PackFileVersion ||
+       header->fileSize != pack->size)
+        return false;
+
+    const uint32_t slotCount = header->slotCount;
+    if(slotCount == 0 ||
+       (slotCount & (slotCount-1)) != 0 ||
+       slotCount <= header->entryCount ||
+       header->entryOffset % PackFileIndexAlignment != 0 ||
+       header->slotOffset % PackFileIndexAlignment != 0 ||
+       !IsInside(header->entryOffset,
+                 (uint64_t)header->entryCount*sizeof(PackFileEntry),
+                 pack->size) ||
+       !IsInside(header->slotOffset, (uint64_t)slotCount*sizeof(uint32_t), pack->size) ||
+       !IsInside(header->stringOffset, header->stringSize, pack->size) ||
+       header->stringSize == 0 ||
+       pack->strings[header->stringSize-1] != '\0')
+        return false;
+
+    for(uint32_t i = 0; i < header->entryCount; i++)
+    {
+        const PackFileEntry * entry = &pack->entries[i];
+        if(entry->name >= header->stringSize ||
+           !IsInside(entry->offset, entry->size, pack->size) ||
+           entry->compression > PackLz4 ||
+           (entry->compression == PackRaw && entry->size != entry->originalSize))
+            return false;
+    }
+    // Lookups probe until they reach an empty slot, which must exist even
+    // if slots reference the same entry more than once:
+    uint32_t usedSlots = 0;
+    for(uint32_t i = 0; i < slotCount; i++)
+    {
+        if(pack->slots[i] > header->entryCount)
+            return false;
+        if(pack->slots[i])
+            usedSlots++;
+    }
+    return usedSlots <= header->entryCount;
+}
+
+Pack * OpenPack( const char * fileName )
+{
+    size_t size = 0;
+    const unsigned char * data = MapFile(fileName, &size);
+    if(!data)
+    {
+        fprintf(stderr, "Can't open '%s'.\n", fileName);
+        return NULL;
+    }
+
+    Pack * pack = (Pack *)malloc(sizeof(Pack));
+    pack->data = data;
+    pack->size = size;
+    pack->header = (const PackFileHeader *)data;
+    if(size >= sizeof(PackFileHeader))
+    {
+        pack->entries = (const PackFileEntry *)(data + pack->header->entryOffset);
+        pack->slots = (const uint32_t *)(data + pack->header->slotOffset);
+        pack->strings = (const char *)(data + pack->header->stringOffset);
+    }
+    if(!ValidatePack(pack))
+    {
+        fprintf(stderr, "'%s' is no valid pack.\n", fileName);
+        ClosePack(pack);
+        return NULL;
+    }
+    return pack;
+}
+
+void ClosePack( Pack * pack )
+{
+    UnmapFile(pack->data, pack->size);
+    free(pack);
+}
+
+int GetPackEntryCount( const Pack * pack )
+{
+    return (int)pack->header->entryCount;
+}
+
+const char * GetPackEntryName( const Pack * pack, int entry )
+{
+    return &pack->strings[pack->entries[entry].name];
+}
+
+int FindPackEntry( const Pack * pack, const char * name )
+{
+    const uint64_t hash = HashPackName(name);
+    const uint32_t mask = pack->header->slotCount - 1;
+    // ValidatePack ensures that there's an empty slot:
+    for(uint32_t slot = (uint32_t)hash & mask; pack->slots[slot]; slot = (slot+1) & mask)
+    {
+        const int entry = (int)pack->slots[slot] - 1;
+        if(pack->entries[entry].hash == hash &&
+           strcmp(GetPackEntryName(pack, entry), name) == 0)
+            return entry;
+    }
+    return -1;
+}
+
+size_t GetPackEntrySize( const Pack * pack, int entry )
+{
+    return (size_t)pack->entries[entry].originalSize;
+}
+
+const void * MapPackEntry( const Pack * pack, int entry )
+{
+    const PackFileEntry * e = &pack->entries[entry];
+    if(e->compression != PackRaw)
+        return NULL;
+    return pack->data + e->offset;
+}
+
+bool ReadPackEntry( const Pack * pack, int entry, void * destination )
+{
+    const PackFileEntry * e = &pack->entries[entry];
+    const unsigned char * data = pack->data + e->offset;
+    if(e->compression == PackRaw)
+    {
+        memcpy(destination, data, (size_t)e->size);
+        return true;
+    }
+
+    if(!DecompressLz4Block(data, (size_t)e->size, destination, (size_t)e->originalSize))
+    {
+        fprintf(stderr, "Entry '%s' is corrupt.\n", GetPackEntryName(pack, entry));
+        return false;
+    }
+    return true;
+}
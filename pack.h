@@ -0,0 +1,62 @@
+#ifndef __PACK_H__
+#define __PACK_H__
+
+#include <stdbool.h>
+#include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Read access to the asset packs described in packfile.h.
+ *
+ * The file is memory mapped, so opening a pack only validates its index.
+ * Entries are found by a hash table lookup and uncompressed ones are used
+ * in place.
+ */
+typedef struct Pack Pack;
+
+/**
+ * Hash of an entry name, as stored in the pack.
+ */
+uint64_t HashPackName( const char * name );
+
+Pack * OpenPack( const char * fileName );
+void ClosePack( Pack * pack );
+
+int GetPackEntryCount( const Pack * pack );
+const char * GetPackEntryName( const Pack * pack, int entry );
+
+/**
+ * @return
+ * Index of the entry or -1 if the pack has none of that name.
+ */
+int FindPackEntry( const Pack * pack, const char * name );
+
+/**
+ * Size of the entry once decompressed.
+ */
+size_t GetPackEntrySize( const Pack * pack, int entry );
+
+/**
+ * @return
+ * Data of an uncompressed entry inside the mapped file, or `NULL` if the
+ * entry is compressed and needs #ReadPackEntry.
+ */
+const void * MapPackEntry( const Pack * pack, int entry );
+
+/**
+ * Copies or decompresses an entry.
+ *
+ * @param destination
+ * Receives #GetPackEntrySize bytes.
+ */
+bool ReadPackEntry( const Pack * pack, int entry, void * destination );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __PACKFILE_H__
+#define __PACKFILE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Asset packs, as written by `gen-pack`.
+ *
+ * Everything is little endian.  The index sections start at multiples of
+ * #PackFileIndexAlignment and the data of uncompressed entries at multiples
+ * of the header's alignment, usually the page size, so a mapped file can be
+ * used in place:
+ *
+ * - #PackFileHeader
+ * - #PackFileEntry array, sorted by name
+ * - hash table with `slotCount` `uint32_t` slots.  Each holds an entry
+ *   index + 1 or 0 if it's empty.  Names are looked up at slot
+ *   `hash & (slotCount-1)` and the ones after it until an empty slot.
+ * - names, zero terminated UTF-8
+ * - entry data
+ *
+ * Offsets are counted from the start of the file.
+ */
+
+enum
+{
+    PackFileVersion = 1,
+    PackFileIndexAlignment = 16
+};
+
+#define PACK_FILE_MAGIC "KPAK"
+
+typedef enum
+{
+    PackRaw = 0,
+    PackLz4 = 1 // LZ4 block format, without frame
+} PackCompression;
+
+typedef struct
+{
+    char magic[4]; // PACK_FILE_MAGIC
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t slotCount; // Power of two, at least twice the entry count
+    uint32_t alignment; // Of uncompressed entry data
+    uint32_t reserved;
+
+    uint64_t fileSize;
+    uint64_t entryOffset;
+    uint64_t slotOffset;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+} PackFileHeader;
+
+typedef struct
+{
+    uint64_t hash; // 64 bit FNV-1a of the name
+    uint64_t offset;
+    uint64_t size; // Stored bytes
+    uint64_t originalSize;
+    uint32_t name; // Offset into the names
+    uint32_t compression; // PackCompression
+} PackFileEntry;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+#include <stdio.h> // printf, fprintf
+#include <stdlib.h> // malloc, free
+#include <string.h> // strcmp
+#include "pack.h"
+
+static void PrintHelp( const char * programName )
+{
+    printf("%s [options] <pack>...\n", programName);
+
+    printf("\t-c (decompress every entry to check it)\n");
+    printf("\tLists name, size and compression ('-' or 'lz4') of every entry.\n");
+}
+
+static bool PrintPack( const char * fileName, bool check )
+{
+    Pack * pack = OpenPack(fileName);
+    if(!pack)
+        return false;
+
+    bool success = true;
+    for(int i = 0; i < GetPackEntryCount(pack); i++)
+    {
+        const char * name = GetPackEntryName(pack, i);
+        const size_t size = GetPackEntrySize(pack, i);
+        if(MapPackEntry(pack, i))
+        {
+            printf("%s %zu -\n", name, size);
+        }
+        else
+        {
+            printf("%s %zu lz4\n", name, size);
+            if(check)
+            {
+                void * data = malloc(size ? size : 1);
+                success = ReadPackEntry(pack, i, data) && success;
+                free(data);
+            }
+        }
+        if(check && FindPackEntry(pack, name) != i)
+        {
+            fprintf(stderr, "'%s' can't be found in '%s'.\n", name, fileName);
+            success = false;
+        }
+    }
+    ClosePack(pack);
+    return success;
+}
+
+int main( int argc, char * * argv )
+{
+    if(argc == 1)
+    {
+        PrintHelp(argv[0]);
+        return 0;
+    }
+
+    bool check = false;
+    int fileCount = 0;
+    bool success = true;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-c") == 0)
+        {
+            check = true;
+        }
+        else if(argv[i][0] == '-')
+        {
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+        else
+        {
+            fileCount++;
+        }
+    }
+
+    if(fileCount == 0)
+    {
+        printf("File parameter(s) are missing.\n");
+        return 1;
+    }
+
+    for(int i = 1; i < argc; i++)
+        if(argv[i][0] != '-')
+            success = PrintPack(argv[i], check) && success;
+
+    return success ? 0 : 1;
+}
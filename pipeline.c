@@ -0,0 +1,303 @@
+#include <assert.h>
+#include <stdlib.h> // malloc, free
+#include <string.h> // memset
+#include <pthread.h>
+#include "pipeline.h"
+#include "threadpool.h" // GetProcessorCount
+#include "stats.h"
+
+
+// --- Bounded queue of item indices ---
+
+typedef struct
+{
+    int * slots;
+    int capacity;
+    int first;
+    int count;
+    bool closed;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} Queue;
+
+static void InitQueue( Queue * queue, int capacity )
+{
+    memset(queue, 0, sizeof(Queue));
+    queue->slots = (int *)malloc(sizeof(int)*capacity);
+    queue->capacity = capacity;
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->notEmpty, NULL);
+    pthread_cond_init(&queue->notFull, NULL);
+}
+
+static void DestroyQueue( Queue * queue )
+{
+    assert(queue->count == 0);
+    pthread_cond_destroy(&queue->notFull);
+    pthread_cond_destroy(&queue->notEmpty);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->slots);
+    memset(queue, 0, sizeof(Queue));
+}
+
+static void PushQueue( Queue * queue, int item )
+{
+    pthread_mutex_lock(&queue->mutex);
+    while(queue->count == queue->capacity)
+        pthread_cond_wait(&queue->notFull, &queue->mutex);
+    assert(!queue->closed);
+    queue->slots[(queue->first + queue->count) % queue->capacity] = item;
+    queue->count++;
+    pthread_cond_signal(&queue->notEmpty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+/**
+ * @return
+ * `false` if the queue has been closed and is empty.
+ */
+static bool PopQueue( Queue * queue, int * item )
+{
+    pthread_mutex_lock(&queue->mutex);
+    while(queue->count == 0 && !queue->closed)
+        pthread_cond_wait(&queue->notEmpty, &queue->mutex);
+
+    if(queue->count == 0)
+    {
+        pthread_mutex_unlock(&queue->mutex);
+        return false;
+    }
+
+    *item = queue->slots[queue->first];
+    queue->first = (queue->first + 1) % queue->capacity;
+    queue->count--;
+    pthread_cond_signal(&queue->notFull);
+    pthread_mutex_unlock(&queue->mutex);
+    return true;
+}
+
+static void CloseQueue( Queue * queue )
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->notEmpty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+
+// --- Pipeline ---
+
+static const size_t NoMemoryLimit = (size_t)-1;
+
+typedef struct
+{
+    void * * items;
+    int itemCount;
+    const PipelineStages * stages;
+    void * context;
+    bool * results;
+
+    // Connect decode with compute and compute with encode:
+    Queue queues[PipelineStageCount-1];
+
+    pthread_mutex_t mutex;
+    pthread_cond_t memoryReleased;
+    int nextItem;
+    size_t memoryLimit;
+    size_t memoryInFlight;
+    size_t * itemMemory;
+    int activeWorkers[PipelineStageCount];
+} Pipeline;
+
+typedef struct
+{
+    Pipeline * pipeline;
+    PipelineStage stage;
+    int index;
+} StageWorker;
+
+void InitPipelineOptions( PipelineOptions * options )
+{
+    memset(options, 0, sizeof(PipelineOptions));
+}
+
+void ResolvePipelineOptions( PipelineOptions * options )
+{
+    const int processors = GetProcessorCount();
+    int * threads = options->threads;
+
+    // Decoding is usually faster than compression, so fewer decoders are
+    // needed to keep the computation busy.
+    if(threads[ComputeStage] <= 0)
+        threads[ComputeStage] = processors;
+    if(threads[DecodeStage] <= 0)
+        threads[DecodeStage] = (processors+3) / 4;
+    if(threads[EncodeStage] <= 0)
+        threads[EncodeStage] = (processors+1) / 2;
+
+    if(options->queueSize <= 0)
+        options->queueSize = threads[ComputeStage]*2;
+}
+
+static void AcquireMemory( Pipeline * pipeline, int item )
+{
+    size_t memory = 0;
+    if(pipeline->memoryLimit != NoMemoryLimit && pipeline->stages->estimateMemory)
+        memory = pipeline->stages->estimateMemory(pipeline->items[item],
+                                                  pipeline->context);
+
+    pthread_mutex_lock(&pipeline->mutex);
+    while(pipeline->memoryInFlight > 0 &&
+          pipeline->memoryInFlight + memory > pipeline->memoryLimit)
+        pthread_cond_wait(&pipeline->memoryReleased, &pipeline->mutex);
+    pipeline->memoryInFlight += memory;
+    pipeline->itemMemory[item] = memory;
+    pthread_mutex_unlock(&pipeline->mutex);
+}
+
+static void ReleaseMemory( Pipeline * pipeline, int item, bool success )
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->memoryInFlight -= pipeline->itemMemory[item];
+    pipeline->itemMemory[item] = 0;
+    pipeline->results[item] = success;
+    pthread_cond_broadcast(&pipeline->memoryReleased);
+    pthread_mutex_unlock(&pipeline->mutex);
+}
+
+static bool NextItem( StageWorker * worker, int * item )
+{
+    Pipeline * pipeline = worker->pipeline;
+    if(worker->stage == DecodeStage)
+    {
+        pthread_mutex_lock(&pipeline->mutex);
+        const bool available = pipeline->nextItem < pipeline->itemCount;
+        if(available)
+            *item = pipeline->nextItem++;
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        if(available)
+            AcquireMemory(pipeline, *item);
+        return available;
+    }
+    else
+    {
+        return PopQueue(&pipeline->queues[worker->stage-1], item);
+    }
+}
+
+static void * StageWorkerMain( void * argument )
+{
+    StageWorker * worker = (StageWorker *)argument;
+    Pipeline * pipeline = worker->pipeline;
+    const PipelineStage stage = worker->stage;
+    const PipelineFunction function = pipeline->stages->functions[stage];
+    static const char * ScopeNames[PipelineStageCount] =
+    {
+        "decode stage",
+        "compute stage",
+        "encode stage"
+    };
+
+    int item;
+    while(NextItem(worker, &item))
+    {
+        StatsScope scope;
+        BeginStatsScope(&scope, ScopeNames[stage], NULL);
+        const bool success = function(pipeline->items[item],
+                                      pipeline->context,
+                                      worker->index);
+        EndStatsScope(&scope);
+
+        if(success && stage != EncodeStage)
+            PushQueue(&pipeline->queues[stage], item);
+        else
+            ReleaseMemory(pipeline, item, success);
+    }
+
+    // The last worker of a stage tells the next stage that no more items
+    // will arrive:
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->activeWorkers[stage]--;
+    const bool lastWorker = pipeline->activeWorkers[stage] == 0;
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    if(lastWorker && stage != EncodeStage)
+        CloseQueue(&pipeline->queues[stage]);
+
+    return NULL;
+}
+
+bool RunPipeline( void * * items,
+                  int itemCount,
+                  const PipelineStages * stages,
+                  void * context,
+                  const PipelineOptions * options,
+                  bool * results )
+{
+    PipelineOptions resolvedOptions = *options;
+    ResolvePipelineOptions(&resolvedOptions);
+
+    Pipeline pipeline;
+    memset(&pipeline, 0, sizeof(Pipeline));
+    pipeline.items       = items;
+    pipeline.itemCount   = itemCount;
+    pipeline.stages      = stages;
+    pipeline.context     = context;
+    pipeline.results     = (bool *)malloc(sizeof(bool)*(itemCount+1));
+    pipeline.memoryLimit = resolvedOptions.memoryLimit;
+    pipeline.itemMemory  = (size_t *)malloc(sizeof(size_t)*(itemCount+1));
+    if(pipeline.memoryLimit == 0)
+        pipeline.memoryLimit = NoMemoryLimit;
+    pthread_mutex_init(&pipeline.mutex, NULL);
+    pthread_cond_init(&pipeline.memoryReleased, NULL);
+    for(int i = 0; i < PipelineStageCount-1; i++)
+        InitQueue(&pipeline.queues[i], resolvedOptions.queueSize);
+    for(int i = 0; i < itemCount; i++)
+        pipeline.results[i] = false;
+
+    int threadCount = 0;
+    for(int stage = 0; stage < PipelineStageCount; stage++)
+    {
+        pipeline.activeWorkers[stage] = resolvedOptions.threads[stage];
+        threadCount += resolvedOptions.threads[stage];
+    }
+
+    pthread_t * threads = (pthread_t *)malloc(sizeof(pthread_t)*threadCount);
+    StageWorker * workers = (StageWorker *)malloc(sizeof(StageWorker)*threadCount);
+    int t = 0;
+    for(int stage = 0; stage < PipelineStageCount; stage++)
+    {
+        for(int i = 0; i < resolvedOptions.threads[stage]; i++, t++)
+        {
+            workers[t].pipeline = &pipeline;
+            workers[t].stage    = (PipelineStage)stage;
+            workers[t].index    = i;
+            pthread_create(&threads[t], NULL, StageWorkerMain, &workers[t]);
+        }
+    }
+
+    for(int i = 0; i < threadCount; i++)
+        pthread_join(threads[i], NULL);
+    assert(pipeline.memoryInFlight == 0);
+
+    bool success = true;
+    for(int i = 0; i < itemCount; i++)
+    {
+        if(results)
+            results[i] = pipeline.results[i];
+        success = success && pipeline.results[i];
+    }
+
+    free(workers);
+    free(threads);
+    for(int i = 0; i < PipelineStageCount-1; i++)
+        DestroyQueue(&pipeline.queues[i]);
+    pthread_cond_destroy(&pipeline.memoryReleased);
+    pthread_mutex_destroy(&pipeline.mutex);
+    free(pipeline.itemMemory);
+    free(pipeline.results);
+    return success;
+}
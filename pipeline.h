@@ -0,0 +1,88 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <stdbool.h>
+#include <stddef.h> // size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    DecodeStage,
+    ComputeStage,
+    EncodeStage,
+    PipelineStageCount
+} PipelineStage;
+
+typedef struct
+{
+    /**
+     * Worker threads per stage.  Zero picks a default based on the
+     * processor count.
+     */
+    int threads[PipelineStageCount];
+
+    /**
+     * Items which may wait between two stages.  Zero picks a default.
+     */
+    int queueSize;
+
+    /**
+     * Upper bound for the memory used by items which have been decoded but
+     * not yet encoded.  Zero means unlimited.  A single item is always
+     * admitted, even if it exceeds the limit on its own.
+     */
+    size_t memoryLimit;
+} PipelineOptions;
+
+void InitPipelineOptions( PipelineOptions * options );
+
+/**
+ * Replaces zero values with their defaults.
+ */
+void ResolvePipelineOptions( PipelineOptions * options );
+
+/**
+ * Items pass decode, compute and encode in this order.  Different items
+ * are processed concurrently: While one is computed, the next one is being
+ * decoded and the previous one encoded.
+ *
+ * A failing stage skips the remaining stages of its item.
+ *
+ * @param workerIndex
+ * Index of the worker within its stage, see #TaskFunction.
+ */
+typedef bool (*PipelineFunction)( void * item, void * context, int workerIndex );
+
+typedef struct
+{
+    /**
+     * Returns the memory an item will occupy while it's in flight.
+     * May be `NULL` if no memory limit is used.
+     */
+    size_t (*estimateMemory)( void * item, void * context );
+
+    PipelineFunction functions[PipelineStageCount];
+} PipelineStages;
+
+/**
+ * @param results
+ * Receives whether each item passed all stages.  May be `NULL`.
+ *
+ * @return
+ * Whether all items passed all stages.
+ */
+bool RunPipeline( void * * items,
+                  int itemCount,
+                  const PipelineStages * stages,
+                  void * context,
+                  const PipelineOptions * options,
+                  bool * results );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
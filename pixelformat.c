@@ -0,0 +1,404 @@
+#include <assert.h>
+#include "pixelformat.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || \
+    (defined(__i386__) && defined(__SSE2__))
+#define PIXELFORMAT_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(PIXELFORMAT_SSE2) && defined(__GNUC__)
+#define PIXELFORMAT_AVX2
+#include <immintrin.h>
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+// Divisions instead of multiplications with the reciprocal, so the results
+// are bit-identical in every code path.
+
+
+// --- Scalar ---
+
+static void ConvertU8ToFloatScalar( const uint8_t * source, float * destination, size_t count )
+{
+    for(size_t i = 0; i < count; i++)
+        destination[i] = (float)source[i] / 255.f;
+}
+
+static void ConvertU16ToFloatScalar( const uint16_t * source, float * destination, size_t count )
+{
+    for(size_t i = 0; i < count; i++)
+        destination[i] = (float)source[i] / 65535.f;
+}
+
+static void ConvertFloatToU8Scalar( const float * source, uint8_t * destination, size_t count )
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        float value = source[i] * 255.f;
+        if(!(value > 0))       value = 0; // Also catches NaN.
+        else if(value > 255.f) value = 255.f;
+        destination[i] = (uint8_t)value;
+    }
+}
+
+static void ConvertFloatToU16Scalar( const float * source, uint16_t * destination, size_t count )
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        float value = source[i] * 65535.f;
+        if(!(value > 0))         value = 0;
+        else if(value > 65535.f) value = 65535.f;
+        destination[i] = (uint16_t)value;
+    }
+}
+
+
+// --- SSE2 ---
+
+#if defined(PIXELFORMAT_SSE2)
+static void ConvertU8ToFloatSSE2( const uint8_t * source, float * destination, size_t count )
+{
+    const __m128 scale = _mm_set1_ps(255.f);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128((const __m128i *)&source[i]);
+        const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        const __m128i words[4] =
+        {
+            _mm_unpacklo_epi16(lo, zero),
+            _mm_unpackhi_epi16(lo, zero),
+            _mm_unpacklo_epi16(hi, zero),
+            _mm_unpackhi_epi16(hi, zero)
+        };
+        for(int j = 0; j < 4; j++)
+            _mm_storeu_ps(&destination[i+j*4],
+                          _mm_div_ps(_mm_cvtepi32_ps(words[j]), scale));
+    }
+    ConvertU8ToFloatScalar(&source[i], &destination[i], count-i);
+}
+
+static void ConvertU16ToFloatSSE2( const uint16_t * source, float * destination, size_t count )
+{
+    const __m128 scale = _mm_set1_ps(65535.f);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i+8 <= count; i += 8)
+    {
+        const __m128i words = _mm_loadu_si128((const __m128i *)&source[i]);
+        const __m128i lo = _mm_unpacklo_epi16(words, zero);
+        const __m128i hi = _mm_unpackhi_epi16(words, zero);
+        _mm_storeu_ps(&destination[i],   _mm_div_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(&destination[i+4], _mm_div_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    ConvertU16ToFloatScalar(&source[i], &destination[i], count-i);
+}
+
+static __m128i ScaleAndTruncateSSE2( const float * source, __m128 scale )
+{
+    __m128 value = _mm_mul_ps(_mm_loadu_ps(source), scale);
+    value = _mm_max_ps(value, _mm_setzero_ps()); // Returns 0 for NaN.
+    value = _mm_min_ps(value, scale);
+    return _mm_cvttps_epi32(value);
+}
+
+static void ConvertFloatToU8SSE2( const float * source, uint8_t * destination, size_t count )
+{
+    const __m128 scale = _mm_set1_ps(255.f);
+    size_t i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        const __m128i a = ScaleAndTruncateSSE2(&source[i],    scale);
+        const __m128i b = ScaleAndTruncateSSE2(&source[i+4],  scale);
+        const __m128i c = ScaleAndTruncateSSE2(&source[i+8],  scale);
+        const __m128i d = ScaleAndTruncateSSE2(&source[i+12], scale);
+        const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(a, b),
+                                               _mm_packs_epi32(c, d));
+        _mm_storeu_si128((__m128i *)&destination[i], bytes);
+    }
+    ConvertFloatToU8Scalar(&source[i], &destination[i], count-i);
+}
+
+static void ConvertFloatToU16SSE2( const float * source, uint16_t * destination, size_t count )
+{
+    // SSE2 has no unsigned 32 to 16 bit pack, so the values are biased into
+    // the signed range and back.
+    const __m128 scale = _mm_set1_ps(65535.f);
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    size_t i = 0;
+    for(; i+8 <= count; i += 8)
+    {
+        const __m128i a = _mm_sub_epi32(ScaleAndTruncateSSE2(&source[i],   scale), bias32);
+        const __m128i b = _mm_sub_epi32(ScaleAndTruncateSSE2(&source[i+4], scale), bias32);
+        const __m128i words = _mm_xor_si128(_mm_packs_epi32(a, b), bias16);
+        _mm_storeu_si128((__m128i *)&destination[i], words);
+    }
+    ConvertFloatToU16Scalar(&source[i], &destination[i], count-i);
+}
+#endif
+
+
+// --- AVX2 ---
+
+#if defined(PIXELFORMAT_AVX2)
+AVX2_FUNCTION
+static void ConvertU8ToFloatAVX2( const uint8_t * source, float * destination, size_t count )
+{
+    const __m256 scale = _mm256_set1_ps(255.f);
+    size_t i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128((const __m128i *)&source[i]);
+        const __m256i lo = _mm256_cvtepu8_epi32(bytes);
+        const __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+        _mm256_storeu_ps(&destination[i],   _mm256_div_ps(_mm256_cvtepi32_ps(lo), scale));
+        _mm256_storeu_ps(&destination[i+8], _mm256_div_ps(_mm256_cvtepi32_ps(hi), scale));
+    }
+    ConvertU8ToFloatScalar(&source[i], &destination[i], count-i);
+}
+
+AVX2_FUNCTION
+static void ConvertU16ToFloatAVX2( const uint16_t * source, float * destination, size_t count )
+{
+    const __m256 scale = _mm256_set1_ps(65535.f);
+    size_t i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        const __m256i words = _mm256_loadu_si256((const __m256i *)&source[i]);
+        const __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(words));
+        const __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(words, 1));
+        _mm256_storeu_ps(&destination[i],   _mm256_div_ps(_mm256_cvtepi32_ps(lo), scale));
+        _mm256_storeu_ps(&destination[i+8], _mm256_div_ps(_mm256_cvtepi32_ps(hi), scale));
+    }
+    ConvertU16ToFloatScalar(&source[i], &destination[i], count-i);
+}
+
+AVX2_FUNCTION
+static __m256i ScaleAndTruncateAVX2( const float * source, __m256 scale )
+{
+    __m256 value = _mm256_mul_ps(_mm256_loadu_ps(source), scale);
+    value = _mm256_max_ps(value, _mm256_setzero_ps());
+    value = _mm256_min_ps(value, scale);
+    return _mm256_cvttps_epi32(value);
+}
+
+AVX2_FUNCTION
+static void ConvertFloatToU8AVX2( const float * source, uint8_t * destination, size_t count )
+{
+    const __m256 scale = _mm256_set1_ps(255.f);
+    size_t i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        const __m256i a = ScaleAndTruncateAVX2(&source[i],   scale);
+        const __m256i b = ScaleAndTruncateAVX2(&source[i+8], scale);
+        // Packs operate per 128 bit lane, so the result needs reordering:
+        const __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+        const __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words),
+                                               _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128((__m128i *)&destination[i], bytes);
+    }
+    ConvertFloatToU8Scalar(&source[i], &destination[i], count-i);
+}
+
+AVX2_FUNCTION
+static void ConvertFloatToU16AVX2( const float * source, uint16_t * destination, size_t count )
+{
+    const __m256 scale = _mm256_set1_ps(65535.f);
+    size_t i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        const __m256i a = ScaleAndTruncateAVX2(&source[i],   scale);
+        const __m256i b = ScaleAndTruncateAVX2(&source[i+8], scale);
+        const __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *)&destination[i], words);
+    }
+    ConvertFloatToU16Scalar(&source[i], &destination[i], count-i);
+}
+#endif
+
+
+// --- Dispatch ---
+
+typedef enum
+{
+    KernelUnknown,
+    KernelScalar,
+    KernelSSE2,
+    KernelAVX2
+} KernelType;
+
+static KernelType ActiveKernel = KernelUnknown;
+
+static KernelType GetKernel()
+{
+    // Racing threads would all store the same value.
+    if(ActiveKernel == KernelUnknown)
+    {
+        KernelType kernel = KernelScalar;
+#if defined(PIXELFORMAT_SSE2)
+        kernel = KernelSSE2;
+#endif
+#if defined(PIXELFORMAT_AVX2)
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            kernel = KernelAVX2;
+#endif
+        ActiveKernel = kernel;
+    }
+    return ActiveKernel;
+}
+
+const char * GetPixelFormatKernelName()
+{
+    switch(GetKernel())
+    {
+        case KernelScalar: return "scalar";
+        case KernelSSE2:   return "sse2";
+        case KernelAVX2:   return "avx2";
+        case KernelUnknown: ; // fallthrough
+    }
+    assert(!"Unknown kernel.");
+    return NULL;
+}
+
+#if defined(PIXELFORMAT_AVX2)
+#define DISPATCH(name, ...) \
+    switch(GetKernel()) \
+    { \
+        case KernelAVX2: name##AVX2(__VA_ARGS__); return; \
+        case KernelSSE2: name##SSE2(__VA_ARGS__); return; \
+        default:         name##Scalar(__VA_ARGS__); return; \
+    }
+#elif defined(PIXELFORMAT_SSE2)
+#define DISPATCH(name, ...) \
+    name##SSE2(__VA_ARGS__);
+#else
+#define DISPATCH(name, ...) \
+    name##Scalar(__VA_ARGS__);
+#endif
+
+void ConvertU8ToFloat( const uint8_t * source, float * destination, size_t count )
+{
+    DISPATCH(ConvertU8ToFloat, source, destination, count)
+}
+
+void ConvertU16ToFloat( const uint16_t * source, float * destination, size_t count )
+{
+    DISPATCH(ConvertU16ToFloat, source, destination, count)
+}
+
+void ConvertFloatToU8( const float * source, uint8_t * destination, size_t count )
+{
+    DISPATCH(ConvertFloatToU8, source, destination, count)
+}
+
+void ConvertFloatToU16( const float * source, uint16_t * destination, size_t count )
+{
+    DISPATCH(ConvertFloatToU16, source, destination, count)
+}
+
+
+// --- Channel layout ---
+// The loops use constant strides for the common channel counts, which lets
+// the compiler turn them into shuffles.
+
+void ExtractChannel( const float * source,
+                     int channels,
+                     int channel,
+                     float * destination,
+                     size_t pixels )
+{
+    assert(channel >= 0 && channel < channels);
+    source += channel;
+    switch(channels)
+    {
+        case 1:
+            for(size_t i = 0; i < pixels; i++)
+                destination[i] = source[i];
+            break;
+
+        case 2:
+            for(size_t i = 0; i < pixels; i++)
+                destination[i] = source[i*2];
+            break;
+
+        case 3:
+            for(size_t i = 0; i < pixels; i++)
+                destination[i] = source[i*3];
+            break;
+
+        case 4:
+            for(size_t i = 0; i < pixels; i++)
+                destination[i] = source[i*4];
+            break;
+
+        default:
+            for(size_t i = 0; i < pixels; i++)
+                destination[i] = source[i*channels];
+    }
+}
+
+void InsertChannel( const float * source,
+                    float * destination,
+                    int channels,
+                    int channel,
+                    size_t pixels )
+{
+    assert(channel >= 0 && channel < channels);
+    destination += channel;
+    switch(channels)
+    {
+        case 1:
+            for(size_t i = 0; i < pixels; i++)
+                destination[i] = source[i];
+            break;
+
+        case 2:
+            for(size_t i = 0; i < pixels; i++)
+                destination[i*2] = source[i];
+            break;
+
+        case 3:
+            for(size_t i = 0; i < pixels; i++)
+                destination[i*3] = source[i];
+            break;
+
+        case 4:
+            for(size_t i = 0; i < pixels; i++)
+                destination[i*4] = source[i];
+            break;
+
+        default:
+            for(size_t i = 0; i < pixels; i++)
+                destination[i*channels] = source[i];
+    }
+}
+
+void SwizzleChannels( const float * source,
+                      int sourceChannels,
+                      float * destination,
+                      int destinationChannels,
+                      const int * mapping,
+                      size_t pixels )
+{
+    for(int c = 0; c < destinationChannels; c++)
+    {
+        const int from = mapping[c];
+        if(from >= 0)
+        {
+            assert(from < sourceChannels);
+            for(size_t i = 0; i < pixels; i++)
+                destination[i*destinationChannels + c] = source[i*sourceChannels + from];
+        }
+        else
+        {
+            const float value = (from == SwizzleOne) ? 1.0f : 0.0f;
+            for(size_t i = 0; i < pixels; i++)
+                destination[i*destinationChannels + c] = value;
+        }
+    }
+}
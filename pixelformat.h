@@ -0,0 +1,72 @@
+#ifndef __PIXELFORMAT_H__
+#define __PIXELFORMAT_H__
+
+#include <stddef.h> // size_t
+#include <stdint.h> // uint8_t, uint16_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Name of the instruction set used by the conversion kernels.
+ * Chosen at runtime depending on what the CPU supports.
+ */
+const char * GetPixelFormatKernelName();
+
+/**
+ * Converts normalized integers to floats in the range 0 to 1.
+ */
+void ConvertU8ToFloat( const uint8_t * source, float * destination, size_t count );
+void ConvertU16ToFloat( const uint16_t * source, float * destination, size_t count );
+
+/**
+ * Converts floats in the range 0 to 1 to normalized integers.
+ * Values are truncated and clamped to the integer range.
+ */
+void ConvertFloatToU8( const float * source, uint8_t * destination, size_t count );
+void ConvertFloatToU16( const float * source, uint16_t * destination, size_t count );
+
+/**
+ * Copies a single channel of an interleaved image into a planar buffer.
+ */
+void ExtractChannel( const float * source,
+                     int channels,
+                     int channel,
+                     float * destination,
+                     size_t pixels );
+
+/**
+ * Copies a planar buffer into a single channel of an interleaved image.
+ */
+void InsertChannel( const float * source,
+                    float * destination,
+                    int channels,
+                    int channel,
+                    size_t pixels );
+
+enum
+{
+    SwizzleZero = -1,
+    SwizzleOne  = -2
+};
+
+/**
+ * Rearranges the channels of an interleaved image.
+ *
+ * @param mapping
+ * Has `destinationChannels` elements, each is the source channel index for
+ * the corresponding destination channel or #SwizzleZero / #SwizzleOne.
+ */
+void SwizzleChannels( const float * source,
+                      int sourceChannels,
+                      float * destination,
+                      int destinationChannels,
+                      const int * mapping,
+                      size_t pixels );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
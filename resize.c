@@ -0,0 +1,136 @@
+#include <math.h> // floorf, ceilf, fabsf
+#include <stdlib.h> // malloc, free
+#include "resize.h"
+#include "stats.h"
+
+
+/**
+ * Filter taps of one axis.  Each destination coordinate has `tapCount` taps,
+ * unused ones have zero weight.
+ */
+typedef struct
+{
+    int tapCount;
+    int * indices;
+    float * weights;
+} AxisFilter;
+
+static int Clamp( int value, int min, int max )
+{
+    if(value < min)
+        return min;
+    if(value > max)
+        return max;
+    return value;
+}
+
+static void CreateAxisFilter( AxisFilter * filter, int size, int newSize )
+{
+    const float scale = (float)newSize / (float)size;
+    const float support = (scale < 1.0f) ? 1.0f/scale : 1.0f;
+    const int tapCount = (int)ceilf(support*2.0f) + 1;
+
+    filter->tapCount = tapCount;
+    filter->indices = (int *)malloc(sizeof(int)*tapCount*newSize);
+    filter->weights = (float *)malloc(sizeof(float)*tapCount*newSize);
+
+    for(int i = 0; i < newSize; i++)
+    {
+        int * indices = &filter->indices[i*tapCount];
+        float * weights = &filter->weights[i*tapCount];
+
+        const float center = ((float)i + 0.5f) / scale - 0.5f;
+        const int first = (int)floorf(center - support) + 1;
+
+        float weightSum = 0;
+        for(int t = 0; t < tapCount; t++)
+        {
+            const int source = first + t;
+            float weight = 1.0f - fabsf((float)source - center) / support;
+            if(weight < 0)
+                weight = 0;
+            indices[t] = Clamp(source, 0, size-1);
+            weights[t] = weight;
+            weightSum += weight;
+        }
+
+        for(int t = 0; t < tapCount; t++)
+            weights[t] /= weightSum;
+    }
+}
+
+static void FreeAxisFilter( AxisFilter * filter )
+{
+    free(filter->indices);
+    free(filter->weights);
+}
+
+/**
+ * Resamples `lineCount` lines with `stride` elements between neighbours
+ * within a line and `lineStride` elements between lines.
+ */
+static void ResampleAxis( const AxisFilter * filter,
+                          int newSize,
+                          int lineCount,
+                          int channels,
+                          const float * source,
+                          int sourceStride,
+                          int sourceLineStride,
+                          float * destination,
+                          int destinationStride,
+                          int destinationLineStride )
+{
+    const int tapCount = filter->tapCount;
+    for(int line = 0; line < lineCount; line++)
+    {
+        const float * sourceLine = &source[line*sourceLineStride];
+        float * destinationLine = &destination[line*destinationLineStride];
+        for(int i = 0; i < newSize; i++)
+        {
+            const int * indices = &filter->indices[i*tapCount];
+            const float * weights = &filter->weights[i*tapCount];
+            float * pixel = &destinationLine[i*destinationStride];
+            for(int c = 0; c < channels; c++)
+            {
+                float sum = 0;
+                for(int t = 0; t < tapCount; t++)
+                    sum += sourceLine[indices[t]*sourceStride + c] * weights[t];
+                pixel[c] = sum;
+            }
+        }
+    }
+}
+
+void ResizePixels( int width,
+                   int height,
+                   int channels,
+                   const float * source,
+                   int newWidth,
+                   int newHeight,
+                   float * destination )
+{
+    StatsScope scope;
+    BeginStatsScope(&scope, "resize", NULL);
+
+    AxisFilter xFilter;
+    AxisFilter yFilter;
+    CreateAxisFilter(&xFilter, width, newWidth);
+    CreateAxisFilter(&yFilter, height, newHeight);
+
+    // Horizontal pass into newWidth*height, then vertical pass:
+    float * temp = (float *)malloc(sizeof(float)*newWidth*height*channels);
+
+    ResampleAxis(&xFilter, newWidth, height, channels,
+                 source, channels, width*channels,
+                 temp, channels, newWidth*channels);
+
+    ResampleAxis(&yFilter, newHeight, newWidth, channels,
+                 temp, newWidth*channels, channels,
+                 destination, newWidth*channels, channels);
+
+    free(temp);
+    FreeAxisFilter(&yFilter);
+    FreeAxisFilter(&xFilter);
+
+    EndStatsScope(&scope);
+}
@@ -0,0 +1,32 @@
+#ifndef __RESIZE_H__
+#define __RESIZE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Resample interleaved pixels to a different size.
+ *
+ * Uses a separable tent filter, which is widened when minifying so every
+ * source pixel contributes.  Pixels beyond the edges are clamped.
+ *
+ * @param source
+ * Is expected being an array with width*height*channels elements.
+ *
+ * @param destination
+ * Is expected being an array with newWidth*newHeight*channels elements.
+ */
+void ResizePixels( int width,
+                   int height,
+                   int channels,
+                   const float * source,
+                   int newWidth,
+                   int newHeight,
+                   float * destination );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
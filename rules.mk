@@ -1,5 +1,5 @@
 ARCHIVE_POSTFIX ?=
-ARCHIVE ?= $(NAME)$(ARCHIVE_POSTFIX).zip
+ARCHIVE ?= $(NAME)$(ARCHIVE_POSTFIX).pack
 ARCHIVE_CONTENTS ?=
 
 
@@ -32,10 +32,16 @@ clean:
 	done
 
 $(ARCHIVE): Makefile $(ARCHIVE_CONTENTS)
-	zip --compression-method deflate -9 --suffixes '.png:.ogg' $@ $(ARCHIVE_CONTENTS)
+	$(BUILD_TOOLS)/gen-pack -r '.png:.ogg' $@ $(ARCHIVE_CONTENTS)
 
 %.json: %.blend
 	$(BUILD_TOOLS)/blend2json $< $@
 
+%.mesh: %.json
+	$(BUILD_TOOLS)/json2mesh -q -o -l 3 $< $@
+
+%.dds: %.png
+	$(BUILD_TOOLS)/gen-mips $< $@
+
 %.png: %.xcf
 	$(BUILD_TOOLS)/xcf2png $< $@
@@ -0,0 +1,387 @@
+#define _POSIX_C_SOURCE 200809L // sigaction
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h> // fprintf
+#include <stdlib.h> // malloc, realloc, free
+#include <string.h> // memset, memchr, memmove, strlen, strncpy
+#include <signal.h> // sigaction, signal
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h> // read, write, close, pipe, unlink
+#include <sys/socket.h>
+#include <sys/un.h> // sockaddr_un
+#include "server.h"
+#include "image.h" // SetDecodedImageCacheSize
+#include "threadpool.h"
+
+
+typedef struct Connection
+{
+    struct Connection * next;
+    struct Server * server;
+    int socket;
+} Connection;
+
+typedef struct Server
+{
+    const char * programName;
+    const BatchStages * stages;
+    void * context;
+    ThreadPool * pool;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t connectionClosed;
+    Connection * connections;
+} Server;
+
+typedef struct
+{
+    Server * server;
+    ManifestEntry entry;
+    const char * error; // NULL if the job succeeded
+
+    pthread_mutex_t mutex;
+    pthread_cond_t finishedCondition;
+    bool finished;
+} Request;
+
+// Written by the signal handler to wake up the accept loop:
+static int StopPipe[2] = {-1, -1};
+
+
+static void HandleStopSignal( int signal )
+{
+    const char byte = 0;
+    const ssize_t result = write(StopPipe[1], &byte, 1);
+    (void)result;
+}
+
+static bool WriteAll( int socket, const char * data, size_t size )
+{
+    while(size > 0)
+    {
+        const ssize_t written = write(socket, data, size);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            return false;
+        data += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+static void FinishRequest( Request * request, const char * error )
+{
+    pthread_mutex_lock(&request->mutex);
+    request->error = error;
+    request->finished = true;
+    pthread_cond_signal(&request->finishedCondition);
+    pthread_mutex_unlock(&request->mutex);
+}
+
+static void RunRequest( void * data, int workerIndex )
+{
+    Request * request = (Request *)data;
+    const BatchStages * stages = request->server->stages;
+    void * context = request->server->context;
+
+    void * item = stages->createItem(request->entry.argc,
+                                     request->entry.argv,
+                                     context);
+    if(!item)
+    {
+        FinishRequest(request, "Invalid job.");
+        return;
+    }
+
+    bool success = true;
+    for(int stage = 0; stage < PipelineStageCount && success; stage++)
+        success = stages->stages.functions[stage](item, context, workerIndex);
+    stages->freeItem(item, context);
+
+    FinishRequest(request, success ? NULL : "Job failed.");
+}
+
+static Request * CreateRequest( Server * server )
+{
+    Request * request = (Request *)malloc(sizeof(Request));
+    memset(request, 0, sizeof(Request));
+    request->server = server;
+    pthread_mutex_init(&request->mutex, NULL);
+    pthread_cond_init(&request->finishedCondition, NULL);
+    return request;
+}
+
+static void FreeRequest( Request * request )
+{
+    if(request->entry.argv)
+        FreeManifestEntry(&request->entry);
+    pthread_cond_destroy(&request->finishedCondition);
+    pthread_mutex_destroy(&request->mutex);
+    free(request);
+}
+
+/**
+ * Waits for the request and sends its reply.
+ */
+static bool ReplyToRequest( int socket, Request * request )
+{
+    pthread_mutex_lock(&request->mutex);
+    while(!request->finished)
+        pthread_cond_wait(&request->finishedCondition, &request->mutex);
+    pthread_mutex_unlock(&request->mutex);
+
+    if(!request->error)
+        return WriteAll(socket, "ok\n", 3);
+
+    return WriteAll(socket, "error ", 6) &&
+           WriteAll(socket, request->error, strlen(request->error)) &&
+           WriteAll(socket, "\n", 1);
+}
+
+/**
+ * Starts all jobs which arrived in one read, so they run concurrently, and
+ * replies in their order afterwards.
+ */
+static bool ProcessLines( Connection * connection, char * text, size_t size )
+{
+    Server * server = connection->server;
+    Request * * requests = NULL;
+    int requestCount = 0;
+
+    char * line = text;
+    char * end = text + size;
+    while(line < end)
+    {
+        char * lineEnd = (char *)memchr(line, '\n', end-line);
+        *lineEnd = '\0';
+        if(lineEnd > line && lineEnd[-1] == '\r')
+            lineEnd[-1] = '\0';
+
+        Request * request = CreateRequest(server);
+        if(!ParseManifestEntry(line, server->programName, &request->entry))
+        {
+            request->finished = true;
+            request->error = "Unterminated quote.";
+        }
+        else if(request->entry.argc == 1) // Empty line or comment
+        {
+            FreeRequest(request);
+            request = NULL;
+        }
+        else
+        {
+            SubmitTask(server->pool, RunRequest, request);
+        }
+
+        if(request)
+        {
+            requests = (Request * *)realloc(requests,
+                                            sizeof(Request *)*(requestCount+1));
+            requests[requestCount++] = request;
+        }
+        line = lineEnd+1;
+    }
+
+    bool connected = true;
+    for(int i = 0; i < requestCount; i++)
+    {
+        // Replies may fail if the client is gone, but the jobs must finish:
+        connected = ReplyToRequest(connection->socket, requests[i]) && connected;
+        FreeRequest(requests[i]);
+    }
+    free(requests);
+    return connected;
+}
+
+static void * ConnectionMain( void * argument )
+{
+    Connection * connection = (Connection *)argument;
+    Server * server = connection->server;
+
+    size_t capacity = 4096;
+    size_t size = 0;
+    char * buffer = (char *)malloc(capacity);
+    for(;;)
+    {
+        if(size == capacity)
+        {
+            capacity *= 2;
+            buffer = (char *)realloc(buffer, capacity);
+        }
+
+        const ssize_t received = read(connection->socket,
+                                      &buffer[size],
+                                      capacity-size);
+        if(received < 0 && errno == EINTR)
+            continue;
+        if(received <= 0)
+            break;
+        size += (size_t)received;
+
+        // Only complete lines are processed:
+        size_t complete = size;
+        while(complete > 0 && buffer[complete-1] != '\n')
+            complete--;
+        if(complete == 0)
+            continue;
+
+        if(!ProcessLines(connection, buffer, complete))
+            break;
+        memmove(buffer, &buffer[complete], size-complete);
+        size -= complete;
+    }
+    free(buffer);
+    close(connection->socket);
+
+    pthread_mutex_lock(&server->mutex);
+    for(Connection * * link = &server->connections; *link; link = &(*link)->next)
+    {
+        if(*link == connection)
+        {
+            *link = connection->next;
+            break;
+        }
+    }
+    pthread_cond_broadcast(&server->connectionClosed);
+    pthread_mutex_unlock(&server->mutex);
+
+    free(connection);
+    return NULL;
+}
+
+static int CreateServerSocket( const char * name )
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(name) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Socket name '%s' is too long.\n", name);
+        return -1;
+    }
+    strncpy(address.sun_path, name, sizeof(address.sun_path)-1);
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0)
+    {
+        fprintf(stderr, "Could not create socket '%s'.\n", name);
+        return -1;
+    }
+
+    // Removes the socket of a previous server which didn't shut down:
+    unlink(name);
+
+    if(bind(listener, (const struct sockaddr *)&address, sizeof(address)) != 0 ||
+       listen(listener, 16) != 0)
+    {
+        fprintf(stderr, "Could not listen on socket '%s'.\n", name);
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+static void AcceptConnections( Server * server, int listener )
+{
+    struct pollfd descriptors[2];
+    descriptors[0].fd = listener;
+    descriptors[0].events = POLLIN;
+    descriptors[1].fd = StopPipe[0];
+    descriptors[1].events = POLLIN;
+
+    for(;;)
+    {
+        if(poll(descriptors, 2, -1) < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(descriptors[1].revents)
+            break;
+        if(!descriptors[0].revents)
+            continue;
+
+        const int socket = accept(listener, NULL, NULL);
+        if(socket < 0)
+            continue;
+
+        Connection * connection = (Connection *)malloc(sizeof(Connection));
+        connection->server = server;
+        connection->socket = socket;
+
+        pthread_mutex_lock(&server->mutex);
+        connection->next = server->connections;
+        server->connections = connection;
+        pthread_mutex_unlock(&server->mutex);
+
+        pthread_t thread;
+        pthread_create(&thread, NULL, ConnectionMain, connection);
+        pthread_detach(thread);
+    }
+}
+
+bool RunServer( const BatchOptions * options,
+                const char * programName,
+                const BatchStages * stages,
+                void * context )
+{
+    if(pipe(StopPipe) != 0)
+        return false;
+
+    const int listener = CreateServerSocket(options->serverSocketName);
+    if(listener < 0)
+    {
+        close(StopPipe[0]);
+        close(StopPipe[1]);
+        return false;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = HandleStopSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN); // Clients may disconnect before their reply.
+
+    // The compute threads do all the work here, as jobs don't wait for each
+    // other:
+    PipelineOptions pipelineOptions = options->pipeline;
+    ResolvePipelineOptions(&pipelineOptions);
+    SetDecodedImageCacheSize(options->inputCacheSize);
+
+    Server server;
+    memset(&server, 0, sizeof(Server));
+    server.programName = programName;
+    server.stages = stages;
+    server.context = context;
+    server.pool = CreateThreadPool(pipelineOptions.threads[ComputeStage]);
+    pthread_mutex_init(&server.mutex, NULL);
+    pthread_cond_init(&server.connectionClosed, NULL);
+
+    AcceptConnections(&server, listener);
+    close(listener);
+    unlink(options->serverSocketName);
+
+    // Stop reading, so connections finish their pending jobs and close:
+    pthread_mutex_lock(&server.mutex);
+    for(Connection * connection = server.connections;
+        connection;
+        connection = connection->next)
+        shutdown(connection->socket, SHUT_RD);
+    while(server.connections)
+        pthread_cond_wait(&server.connectionClosed, &server.mutex);
+    pthread_mutex_unlock(&server.mutex);
+
+    FreeThreadPool(server.pool);
+    pthread_cond_destroy(&server.connectionClosed);
+    pthread_mutex_destroy(&server.mutex);
+    SetDecodedImageCacheSize(0);
+    close(StopPipe[0]);
+    close(StopPipe[1]);
+    StopPipe[0] = StopPipe[1] = -1;
+    return true;
+}
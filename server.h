@@ -0,0 +1,34 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <stdbool.h>
+#include "batch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Serves jobs on the Unix socket `options->serverSocketName` until the
+ * process receives SIGINT or SIGTERM.
+ *
+ * Clients send one job per line, written like a manifest entry.  Every job
+ * is answered with a line in the order they were sent: `ok` or
+ * `error <message>`.  Jobs of different connections run concurrently.
+ *
+ * The process keeps its thread pool, per worker state and recently decoded
+ * inputs (see #SetDecodedImageCacheSize) between jobs.
+ *
+ * @return
+ * Whether the server could be started.
+ */
+bool RunServer( const BatchOptions * options,
+                const char * programName,
+                const BatchStages * stages,
+                void * context );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,317 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime, getrusage
+#include <stdio.h> // printf, fprintf, fopen
+#include <stdlib.h> // malloc, realloc, free
+#include <string.h> // memset, strcmp, strlen, memcpy
+#include <time.h> // clock_gettime
+#include <pthread.h>
+#include <sys/resource.h> // getrusage
+#include "stats.h"
+#include "allocator.h" // GetPeakBufferUsage
+
+
+typedef struct
+{
+    const char * name;
+    int count;
+    double wallTime;
+    double cpuTime;
+} ScopeTotal;
+
+typedef struct
+{
+    const char * name;
+    double amount;
+} Counter;
+
+typedef struct
+{
+    const char * name;
+    char * detail;
+    int thread;
+    double start; // Seconds since #StartStats
+    double duration;
+} TraceEvent;
+
+static bool Enabled = false;
+static StatsOptions Options;
+static double StartTime;
+
+static pthread_mutex_t Mutex = PTHREAD_MUTEX_INITIALIZER;
+static ScopeTotal * ScopeTotals = NULL;
+static int ScopeTotalCount = 0;
+static Counter * Counters = NULL;
+static int CounterCount = 0;
+static TraceEvent * TraceEvents = NULL;
+static int TraceEventCount = 0;
+static int TraceEventCapacity = 0;
+
+// Threads are numbered in the order they record their first scope:
+static pthread_once_t ThreadKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t ThreadKey;
+static int ThreadCount = 0;
+
+
+void InitStatsOptions( StatsOptions * options )
+{
+    options->summary = false;
+    options->traceFileName = NULL;
+}
+
+int ParseStatsOption( int argc, char * * argv, int * i, StatsOptions * options )
+{
+    if(strcmp(argv[*i], "-S") == 0)
+    {
+        options->summary = true;
+        return 1;
+    }
+
+    if(strcmp(argv[*i], "-T") != 0)
+        return 0;
+
+    if(*i+1 >= argc)
+    {
+        printf("Option needs a value.\n");
+        return -1;
+    }
+    (*i)++;
+    options->traceFileName = argv[*i];
+    return 1;
+}
+
+void PrintStatsHelp()
+{
+    printf("\t-S (print time, memory and counters per step)\n");
+    printf("\t-T <file> (write a Chrome trace of all steps)\n");
+}
+
+static double GetWallTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec*1e-9;
+}
+
+static double GetThreadCpuTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec*1e-9;
+}
+
+static void CreateThreadKey()
+{
+    pthread_key_create(&ThreadKey, NULL);
+}
+
+/**
+ * Must be called with the mutex being locked.
+ */
+static int GetThreadNumber()
+{
+    pthread_once(&ThreadKeyOnce, CreateThreadKey);
+    // Stores the number plus one, as unset keys are NULL:
+    size_t number = (size_t)pthread_getspecific(ThreadKey);
+    if(number == 0)
+    {
+        number = (size_t)++ThreadCount;
+        pthread_setspecific(ThreadKey, (void *)number);
+    }
+    return (int)number - 1;
+}
+
+void StartStats( const StatsOptions * options )
+{
+    Options = *options;
+    Enabled = options->summary || options->traceFileName;
+    StartTime = GetWallTime();
+}
+
+void BeginStatsScope( StatsScope * scope, const char * name, const char * detail )
+{
+    if(!Enabled)
+    {
+        scope->name = NULL;
+        return;
+    }
+    scope->name = name;
+    scope->detail = detail;
+    scope->wallStart = GetWallTime();
+    scope->cpuStart = GetThreadCpuTime();
+}
+
+static char * CopyString( const char * string )
+{
+    if(!string)
+        return NULL;
+    const size_t length = strlen(string);
+    char * copy = (char *)malloc(length+1);
+    memcpy(copy, string, length+1);
+    return copy;
+}
+
+void EndStatsScope( StatsScope * scope )
+{
+    if(!scope->name)
+        return;
+
+    const double wallTime = GetWallTime() - scope->wallStart;
+    const double cpuTime = GetThreadCpuTime() - scope->cpuStart;
+
+    pthread_mutex_lock(&Mutex);
+
+    ScopeTotal * total = NULL;
+    for(int i = 0; i < ScopeTotalCount && !total; i++)
+        if(strcmp(ScopeTotals[i].name, scope->name) == 0)
+            total = &ScopeTotals[i];
+    if(!total)
+    {
+        ScopeTotals = (ScopeTotal *)realloc(ScopeTotals,
+                                            sizeof(ScopeTotal)*(ScopeTotalCount+1));
+        total = &ScopeTotals[ScopeTotalCount++];
+        memset(total, 0, sizeof(ScopeTotal));
+        total->name = scope->name;
+    }
+    total->count++;
+    total->wallTime += wallTime;
+    total->cpuTime += cpuTime;
+
+    if(Options.traceFileName)
+    {
+        if(TraceEventCount == TraceEventCapacity)
+        {
+            TraceEventCapacity = TraceEventCapacity ? TraceEventCapacity*2 : 256;
+            TraceEvents = (TraceEvent *)realloc(TraceEvents,
+                                                sizeof(TraceEvent)*TraceEventCapacity);
+        }
+        TraceEvent * event = &TraceEvents[TraceEventCount++];
+        event->name = scope->name;
+        event->detail = CopyString(scope->detail);
+        event->thread = GetThreadNumber();
+        event->start = scope->wallStart - StartTime;
+        event->duration = wallTime;
+    }
+
+    pthread_mutex_unlock(&Mutex);
+}
+
+void AddStatsCount( const char * name, double amount )
+{
+    if(!Enabled)
+        return;
+
+    pthread_mutex_lock(&Mutex);
+    Counter * counter = NULL;
+    for(int i = 0; i < CounterCount && !counter; i++)
+        if(strcmp(Counters[i].name, name) == 0)
+            counter = &Counters[i];
+    if(!counter)
+    {
+        Counters = (Counter *)realloc(Counters, sizeof(Counter)*(CounterCount+1));
+        counter = &Counters[CounterCount++];
+        counter->name = name;
+        counter->amount = 0;
+    }
+    counter->amount += amount;
+    pthread_mutex_unlock(&Mutex);
+}
+
+static void PrintSummary()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const double cpuTime =
+        usage.ru_utime.tv_sec + usage.ru_utime.tv_usec*1e-6 +
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec*1e-6;
+
+    fprintf(stderr, "%-24s %8s %12s %12s\n", "Step", "Count", "Wall (s)", "CPU (s)");
+    for(int i = 0; i < ScopeTotalCount; i++)
+    {
+        const ScopeTotal * total = &ScopeTotals[i];
+        fprintf(stderr, "%-24s %8d %12.4f %12.4f\n",
+                total->name, total->count, total->wallTime, total->cpuTime);
+    }
+    fprintf(stderr, "%-24s %8s %12.4f %12.4f\n",
+            "total", "", GetWallTime() - StartTime, cpuTime);
+
+    fprintf(stderr, "\n");
+    for(int i = 0; i < CounterCount; i++)
+        fprintf(stderr, "%-24s %.0f\n", Counters[i].name, Counters[i].amount);
+    fprintf(stderr, "%-24s %.1f MiB\n", "peak image memory",
+            GetPeakBufferUsage() / (1024.0*1024.0));
+    fprintf(stderr, "%-24s %.1f MiB\n", "peak resident memory",
+            usage.ru_maxrss / 1024.0); // Kibibytes on Linux
+}
+
+static void WriteJsonString( FILE * file, const char * string )
+{
+    fputc('"', file);
+    for(const unsigned char * c = (const unsigned char *)string; *c; c++)
+    {
+        if(*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if(*c < 0x20)
+            fprintf(file, "\\u%04x", *c);
+        else
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+static bool WriteTrace( const char * fileName )
+{
+    FILE * file = fopen(fileName, "w");
+    if(!file)
+    {
+        fprintf(stderr, "Could not open '%s' for writing.\n", fileName);
+        return false;
+    }
+
+    fprintf(file, "{\"traceEvents\": [\n");
+    for(int i = 0; i < TraceEventCount; i++)
+    {
+        const TraceEvent * event = &TraceEvents[i];
+        fprintf(file, "{\"name\": ");
+        WriteJsonString(file, event->name);
+        // Timestamps are in microseconds:
+        fprintf(file,
+                ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                event->thread, event->start*1e6, event->duration*1e6);
+        if(event->detail)
+        {
+            fprintf(file, ", \"args\": {\"detail\": ");
+            WriteJsonString(file, event->detail);
+            fprintf(file, "}");
+        }
+        fprintf(file, "}%s\n", (i+1 < TraceEventCount) ? "," : "");
+    }
+    fprintf(file, "],\n\"displayTimeUnit\": \"ms\"}\n");
+
+    return fclose(file) == 0;
+}
+
+bool FinishStats()
+{
+    if(!Enabled)
+        return true;
+    Enabled = false;
+
+    if(Options.summary)
+        PrintSummary();
+
+    bool success = true;
+    if(Options.traceFileName)
+        success = WriteTrace(Options.traceFileName);
+
+    for(int i = 0; i < TraceEventCount; i++)
+        free(TraceEvents[i].detail);
+    free(TraceEvents);
+    free(Counters);
+    free(ScopeTotals);
+    TraceEvents = NULL;
+    TraceEventCount = TraceEventCapacity = 0;
+    Counters = NULL;
+    CounterCount = 0;
+    ScopeTotals = NULL;
+    ScopeTotalCount = 0;
+    return success;
+}
@@ -0,0 +1,77 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Collects where the time of a run goes.
+ *
+ * Scopes measure wall and CPU time of a named step, like decoding an image
+ * or a distance transform.  Counters add up amounts like bytes read.  The
+ * summary lists the totals per name; the trace lists every single scope on
+ * its thread in the Chrome trace format, which Perfetto and
+ * `chrome://tracing` can display.
+ *
+ * Nothing is recorded unless #StartStats enabled it.
+ */
+
+typedef struct
+{
+    bool summary;
+    const char * traceFileName; // `NULL` disables the trace
+} StatsOptions;
+
+void InitStatsOptions( StatsOptions * options );
+
+/**
+ * Parses the stats option at `argv[*i]`, if it is one.
+ *
+ * @return
+ * 1 if the option was consumed (`*i` then points to its last argument),
+ * 0 if it isn't a stats option and -1 if it is malformed.
+ */
+int ParseStatsOption( int argc, char * * argv, int * i, StatsOptions * options );
+
+void PrintStatsHelp();
+
+void StartStats( const StatsOptions * options );
+
+/**
+ * Prints the summary and writes the trace, if they were requested.
+ */
+bool FinishStats();
+
+typedef struct
+{
+    const char * name; // `NULL` if nothing is recorded
+    const char * detail;
+    double wallStart;
+    double cpuStart;
+} StatsScope;
+
+/**
+ * @param name
+ * Must stay valid until #FinishStats, e.g. a string literal.
+ *
+ * @param detail
+ * Shown in the trace, e.g. the file being processed.  May be `NULL`.
+ * Must stay valid until #EndStatsScope.
+ */
+void BeginStatsScope( StatsScope * scope, const char * name, const char * detail );
+void EndStatsScope( StatsScope * scope );
+
+/**
+ * @param name
+ * Must stay valid until #FinishStats, e.g. a string literal.
+ */
+void AddStatsCount( const char * name, double amount );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+# Runs a manifest with corrupt inputs and checks that the other jobs still
+# finish, with the same outputs as single runs.
+# Run by ctest with TOOL and WORK_DIR set.
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+unset(ENV{KONSTRUKT_CACHE_DIR}) # Outputs must be generated, not restored
+
+# 8x8 PFM files, whose float bytes are printable: '?' is 0.75 and '@' 3.0
+set(header "Pf\n8 8\n-1.0\n")
+set(low "????????????????????????????????")
+set(high "@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@")
+file(WRITE ${WORK_DIR}/a.pfm "${header}${low}${low}${high}${low}${high}${high}${low}${low}")
+file(WRITE ${WORK_DIR}/b.pfm "${header}${high}${low}${low}${high}${low}${high}${high}${low}")
+file(WRITE ${WORK_DIR}/corrupt.pfm "${header}${low}${high}") # Rows are missing
+
+# PNG signature followed by a malformed header chunk, which libpng rejects:
+string(ASCII 137 signatureStart)
+string(ASCII 26 signatureEnd)
+file(WRITE ${WORK_DIR}/corrupt.png "${signatureStart}PNG\r\n${signatureEnd}\nAAAAIHDRgarbage")
+
+file(WRITE ${WORK_DIR}/jobs.txt "a.pfm a-out.pfm\n"
+                                "corrupt.pfm corrupt-pfm-out.pfm\n"
+                                "corrupt.png corrupt-png-out.pfm\n"
+                                "b.pfm b-out.pfm\n")
+
+execute_process(COMMAND ${TOOL} -j 2 -b jobs.txt
+                WORKING_DIRECTORY ${WORK_DIR}
+                RESULT_VARIABLE result
+                ERROR_VARIABLE errors)
+if(result EQUAL 0)
+    message(FATAL_ERROR "The corrupt inputs weren't reported.")
+endif()
+if(NOT errors MATCHES "jobs.txt:2: Job failed." OR
+   NOT errors MATCHES "jobs.txt:3: Job failed.")
+    message(FATAL_ERROR "Unexpected errors:\n${errors}")
+endif()
+if(EXISTS ${WORK_DIR}/corrupt-pfm-out.pfm OR EXISTS ${WORK_DIR}/corrupt-png-out.pfm)
+    message(FATAL_ERROR "A corrupt input has an output.")
+endif()
+
+foreach(name a b)
+    execute_process(COMMAND ${TOOL} ${name}.pfm ${name}-single.pfm
+                    WORKING_DIRECTORY ${WORK_DIR}
+                    RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Single run of ${name}.pfm failed.")
+    endif()
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${name}-out.pfm ${name}-single.pfm
+                    WORKING_DIRECTORY ${WORK_DIR}
+                    RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "The job of ${name}.pfm didn't finish correctly.")
+    endif()
+endforeach()
+
+file(REMOVE_RECURSE ${WORK_DIR})
@@ -0,0 +1,41 @@
+# Packs a few files with gen-pack and checks every entry with 'packinfo -c'.
+# Run by ctest with GEN_PACK, PACKINFO and WORK_DIR set.
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR}/sub)
+
+string(RANDOM LENGTH 3000 SEED 1 random)
+set(text "")
+foreach(i RANGE 499)
+    set(text "${text}konstrukt ")
+endforeach()
+file(WRITE ${WORK_DIR}/random.txt "${random}")
+file(WRITE ${WORK_DIR}/text.txt "${text}")
+file(WRITE ${WORK_DIR}/stored.raw "${text}")
+file(WRITE ${WORK_DIR}/empty.txt "")
+file(WRITE ${WORK_DIR}/sub/nested.txt "nested")
+
+execute_process(COMMAND ${GEN_PACK} -r .raw test.pack
+                        text.txt random.txt stored.raw empty.txt sub/nested.txt
+                WORKING_DIRECTORY ${WORK_DIR}
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "gen-pack failed.")
+endif()
+
+execute_process(COMMAND ${PACKINFO} -c test.pack
+                WORKING_DIRECTORY ${WORK_DIR}
+                RESULT_VARIABLE result
+                OUTPUT_VARIABLE listing)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "packinfo -c failed.")
+endif()
+
+# Random text may or may not compress, so only its size is fixed:
+string(REGEX REPLACE "random.txt 3000 (-|lz4)\n" "random.txt 3000 ?\n" listing "${listing}")
+set(expected "empty.txt 0 -\nrandom.txt 3000 ?\nstored.raw 5000 -\nsub/nested.txt 6 -\ntext.txt 5000 lz4\n")
+if(NOT listing STREQUAL expected)
+    message(FATAL_ERROR "Unexpected entries:\n${listing}")
+endif()
+
+file(REMOVE_RECURSE ${WORK_DIR})
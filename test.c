@@ -0,0 +1,301 @@
+#include <stdio.h> // printf, fprintf, fopen, snprintf
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcmp, memcpy
+#include <stdint.h> // uint8_t, uint16_t, uint32_t
+#include <math.h> // fabsf
+#include <png.h> // 16 bit files, which WriteImage doesn't produce
+#include "image.h"
+#include "lz4block.h"
+
+// Round trips each codec and the LZ4 block compressor in the working
+// directory.  Prints a line per failed check and exits with 1 if any failed.
+
+static const int Width = 37; // Odd sizes catch row padding and stride bugs
+static const int Height = 23;
+
+static int FailureCount = 0;
+
+static void Check( bool condition, const char * test, const char * what )
+{
+    if(!condition)
+    {
+        printf("%s: %s\n", test, what);
+        FailureCount++;
+    }
+}
+
+static uint32_t Hash( uint32_t x )
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+ * Fills an image with gradients and noise, quantized to `levels` so that
+ * codecs with that precision reproduce it exactly.
+ */
+static Image * CreateTestImage( int channels, int levels )
+{
+    Image * image = CreateImage(Width, Height, channels);
+    for(int y = 0; y < Height; y++)
+    for(int x = 0; x < Width; x++)
+    for(int c = 0; c < channels; c++)
+    {
+        uint32_t value;
+        switch(c)
+        {
+            case 0:  value = (uint32_t)(x*(levels-1)/(Width-1)); break;
+            case 1:  value = (uint32_t)(y*(levels-1)/(Height-1)); break;
+            default: value = Hash((uint32_t)((y*Width+x)*channels+c)) % (uint32_t)levels;
+        }
+        image->data[(y*Width+x)*channels+c] = (float)value / (float)(levels-1);
+    }
+    return image;
+}
+
+static bool IsSameImage( const Image * a, const Image * b, float tolerance )
+{
+    if(!a || !b ||
+       a->width != b->width ||
+       a->height != b->height ||
+       a->channels != b->channels)
+        return false;
+    const size_t samples = (size_t)a->width*a->height*a->channels;
+    for(size_t i = 0; i < samples; i++)
+        if(fabsf(a->data[i] - b->data[i]) > tolerance)
+            return false;
+    return true;
+}
+
+static void CheckRoundTrip( const char * fileName, int channels, int levels )
+{
+    char test[64];
+    snprintf(test, sizeof(test), "%s with %d channels", fileName, channels);
+
+    Image * image = CreateTestImage(channels, levels);
+    Check(WriteImage(image, fileName), test, "write failed");
+    Image * copy = ReadImage(fileName);
+    Check(IsSameImage(image, copy, 1e-6f), test, "pixels differ");
+
+    ImageInfo info;
+    Check(ReadImageInfo(fileName, &info) &&
+          info.width == Width &&
+          info.height == Height &&
+          info.channels == channels,
+          test, "header differs");
+
+    if(copy)
+        FreeImage(copy);
+    FreeImage(image);
+    remove(fileName);
+}
+
+
+// --- PNG ---
+
+static bool WritePng16( const Image * image, const char * fileName )
+{
+    FILE * file = fopen(fileName, "wb");
+    if(!file)
+        return false;
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png_create_info_struct(png);
+    const size_t rowSamples = (size_t)image->width*image->channels;
+    png_bytep volatile row = (png_bytep)malloc(rowSamples*2);
+    if(setjmp(png_jmpbuf(png)))
+    {
+        png_destroy_write_struct(&png, &info);
+        free(row);
+        fclose(file);
+        return false;
+    }
+    png_init_io(png, file);
+    png_set_IHDR(png, info, image->width, image->height, 16,
+                 (image->channels == 1) ? PNG_COLOR_TYPE_GRAY : PNG_COLOR_TYPE_RGB_ALPHA,
+                 PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    for(int y = 0; y < image->height; y++)
+    {
+        // Big endian, as PNG stores it:
+        for(size_t i = 0; i < rowSamples; i++)
+        {
+            const uint16_t value =
+                (uint16_t)(image->data[y*rowSamples+i]*65535.0f + 0.5f);
+            row[i*2]   = (png_byte)(value >> 8);
+            row[i*2+1] = (png_byte)(value & 0xff);
+        }
+        png_write_row(png, row);
+    }
+    png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
+    free(row);
+    return fclose(file) == 0;
+}
+
+static void TestPng()
+{
+    for(int channels = 1; channels <= 4; channels++)
+        CheckRoundTrip("test.png", channels, 256);
+
+    for(int channels = 1; channels <= 4; channels += 3)
+    {
+        char test[64];
+        snprintf(test, sizeof(test), "16 bit PNG with %d channels", channels);
+        Image * image = CreateTestImage(channels, 65536);
+        Check(WritePng16(image, "test16.png"), test, "write failed");
+        Image * copy = ReadImage("test16.png");
+        Check(IsSameImage(image, copy, 1e-6f), test, "pixels differ");
+
+        ImageInfo info;
+        Check(ReadImageInfo("test16.png", &info) && info.bitDepth == 16,
+              test, "header differs");
+
+        if(copy)
+            FreeImage(copy);
+        FreeImage(image);
+        remove("test16.png");
+    }
+}
+
+
+// --- PFM ---
+
+static bool IsLittleEndianHost()
+{
+    const uint16_t value = 1;
+    return *(const uint8_t *)&value == 1;
+}
+
+/**
+ * Writes the opposite byte order of what #WriteImage uses on this host.
+ */
+static bool WriteSwappedPfm( const Image * image, const char * fileName )
+{
+    FILE * file = fopen(fileName, "wb");
+    if(!file)
+        return false;
+    fprintf(file,
+            "%s\n%d %d\n%s\n",
+            (image->channels == 3) ? "PF" : "Pf",
+            image->width,
+            image->height,
+            IsLittleEndianHost() ? "1.0" : "-1.0");
+    const size_t rowLength = (size_t)image->width*image->channels;
+    bool success = true;
+    for(int y = image->height-1; y >= 0; y--) // Bottom to top
+    for(size_t i = 0; i < rowLength; i++)
+    {
+        uint8_t bytes[4];
+        memcpy(bytes, &image->data[y*rowLength+i], 4);
+        const uint8_t swapped[4] = { bytes[3], bytes[2], bytes[1], bytes[0] };
+        success = success && fwrite(swapped, 1, 4, file) == 4;
+    }
+    return (fclose(file) == 0) && success;
+}
+
+static void TestPfm()
+{
+    for(int channels = 1; channels <= 3; channels += 2)
+    {
+        // Any float survives, so the levels only keep the values readable:
+        CheckRoundTrip("test.pfm", channels, 1 << 20);
+
+        char test[64];
+        snprintf(test, sizeof(test), "swapped PFM with %d channels", channels);
+        Image * image = CreateTestImage(channels, 1 << 20);
+        Check(WriteSwappedPfm(image, "test-swapped.pfm"), test, "write failed");
+        Image * copy = ReadImage("test-swapped.pfm");
+        Check(IsSameImage(image, copy, 0), test, "pixels differ");
+        if(copy)
+            FreeImage(copy);
+        FreeImage(image);
+        remove("test-swapped.pfm");
+    }
+}
+
+
+// --- QOI ---
+
+static void TestQoi()
+{
+    CheckRoundTrip("test.qoi", 3, 256);
+    CheckRoundTrip("test.qoi", 4, 256);
+
+    // Flat areas exercise the run and index operations:
+    Image * image = CreateImage(Width, Height, 4);
+    const size_t samples = (size_t)Width*Height*4;
+    for(size_t i = 0; i < samples; i++)
+        image->data[i] = (i < samples/2) ? 1.0f : (float)((i/4/7)%3)/255.0f;
+    Check(WriteImage(image, "test.qoi"), "flat QOI", "write failed");
+    Image * copy = ReadImage("test.qoi");
+    Check(IsSameImage(image, copy, 1e-6f), "flat QOI", "pixels differ");
+    if(copy)
+        FreeImage(copy);
+    FreeImage(image);
+    remove("test.qoi");
+}
+
+
+// --- LZ4 ---
+
+static void CheckLz4RoundTrip( const char * test, const uint8_t * data, size_t size )
+{
+    const size_t capacity = size + size/255 + 16; // Worst case of the format
+    uint8_t * compressed = (uint8_t *)malloc(capacity);
+    uint8_t * decompressed = (uint8_t *)malloc(size + 1);
+
+    const size_t compressedSize = CompressLz4Block(data, size, compressed, capacity);
+    Check(compressedSize > 0 || size == 0, test, "compression failed");
+    Check(DecompressLz4Block(compressed, compressedSize, decompressed, size) &&
+          memcmp(data, decompressed, size) == 0,
+          test, "data differs");
+
+    // A wrong size and a truncated block must be rejected:
+    Check(!DecompressLz4Block(compressed, compressedSize, decompressed, size+1),
+          test, "accepted a wrong size");
+    if(compressedSize > 1)
+        Check(!DecompressLz4Block(compressed, compressedSize-1, decompressed, size),
+              test, "accepted a truncated block");
+
+    free(decompressed);
+    free(compressed);
+}
+
+static void TestLz4()
+{
+    const size_t size = 200000; // Exceeds the 64 KiB match window
+    uint8_t * data = (uint8_t *)malloc(size);
+
+    for(size_t i = 0; i < size; i++)
+        data[i] = (uint8_t)(Hash((uint32_t)i) & 0xff);
+    CheckLz4RoundTrip("random LZ4", data, size);
+
+    for(size_t i = 0; i < size; i++)
+        data[i] = (uint8_t)((i % 1000 < 500) ? 'a' : Hash((uint32_t)(i/7)) & 0x0f);
+    CheckLz4RoundTrip("compressible LZ4", data, size);
+
+    CheckLz4RoundTrip("short LZ4", data, 5);
+    CheckLz4RoundTrip("empty LZ4", data, 0);
+    free(data);
+}
+
+int main()
+{
+    TestPng();
+    TestPfm();
+    TestQoi();
+    TestLz4();
+
+    if(FailureCount > 0)
+    {
+        printf("%d checks failed.\n", FailureCount);
+        return 1;
+    }
+    return 0;
+}
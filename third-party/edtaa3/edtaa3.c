@@ -57,6 +57,8 @@
 #include <stdlib.h> // malloc, free
 #include <math.h> // fabsf, sqrtf
 #include <float.h> // FLT_MAX
+#include <string.h> // memset
+#include "edtaa3.h"
 
 /*
  * Compute the local gradient at edge pixels using convolution filters.
@@ -162,7 +164,7 @@ static float distaa3(const float *img, const float *gximg, const float *gyimg, i
 // Shorthand macro: add ubiquitous parameters dist, gx, gy, img and w and call distaa3()
 #define DISTAA(c,xc,yc,xi,yi) (distaa3(img, gx, gy, w, c, xc, yc, xi, yi))
 
-static void edtaa3_transform(const float *img, const float *gx, const float *gy, int w, int h, short *distx, short *disty, float *dist)
+static int edtaa3_transform(const float *img, const float *gx, const float *gy, int w, int h, short *distx, short *disty, float *dist)
 {
     int x, y, i, c;
     int offset_u, offset_ur, offset_r, offset_rd,
@@ -170,6 +172,7 @@ static void edtaa3_transform(const float *img, const float *gx, const float *gy,
     float olddist, newdist;
     int cdistx, cdisty, newdistx, newdisty;
     int changed;
+    int passes = 0;
     float epsilon = 1e-3f;
 
     /* Initialize index offsets for the current image width */
@@ -202,6 +205,7 @@ static void edtaa3_transform(const float *img, const float *gx, const float *gy,
     do
     {
         changed = 0;
+        passes++;
 
         /* Scan rows, except first row */
         for(y=1; y<h; y++)
@@ -573,29 +577,43 @@ static void edtaa3_transform(const float *img, const float *gx, const float *gy,
     while(changed); // Sweep until no more updates are made
 
     /* The transformation is completed. */
+    return passes;
+}
 
+size_t edtaa3_scratch_size( int width, int height )
+{
+    const size_t pixels = (size_t)width * height;
+    return pixels*(2*sizeof(float) + 2*sizeof(short));
 }
 
-void edtaa3( int width, int height, const float * input, float * output )
+int edtaa3_scratch( int width, int height, const float * input, float * output, void * scratch )
 {
     const int pixels = width * height;
 
-    short * xdist = (short *)malloc(pixels*sizeof(short));
-    short * ydist = (short *)malloc(pixels*sizeof(short));
-    float * gx    = (float *)malloc(pixels*sizeof(float));
-    float * gy    = (float *)malloc(pixels*sizeof(float));
+    // Floats first, so the shorts don't break their alignment:
+    float * gx    = (float *)scratch;
+    float * gy    = gx + pixels;
+    short * xdist = (short *)(gy + pixels);
+    short * ydist = xdist + pixels;
+
+    // computegradient() only writes edge pixels:
+    memset(gx, 0, pixels*sizeof(float));
+    memset(gy, 0, pixels*sizeof(float));
 
     computegradient(input, width, height, gx, gy);
-    edtaa3_transform(input, gx, gy, width, height, xdist, ydist, output);
+    const int passes = edtaa3_transform(input, gx, gy, width, height, xdist, ydist, output);
 
     // Pixels with grayscale>0.5 will have a negative distance.
     // This is correct, but we don't want values <0 returned here.
     for(int i = 0; i < pixels; i++)
         if(output[i] < 0)
             output[i] = 0;
+    return passes;
+}
 
-    free(xdist);
-    free(ydist);
-    free(gx);
-    free(gy);
+void edtaa3( int width, int height, const float * input, float * output )
+{
+    void * scratch = malloc(edtaa3_scratch_size(width, height));
+    edtaa3_scratch(width, height, input, output, scratch);
+    free(scratch);
 }
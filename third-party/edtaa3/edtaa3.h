@@ -1,6 +1,21 @@
 #ifndef __EDTAA3_H__
 #define __EDTAA3_H__
 
+#include <stddef.h> // size_t
+
 void edtaa3( int width, int height, const float * input, float * output );
 
+/*
+ * Size of the scratch memory which edtaa3_scratch() needs.
+ */
+size_t edtaa3_scratch_size( int width, int height );
+
+/*
+ * Like edtaa3(), but uses caller provided scratch memory instead of
+ * allocating it on every call.  The scratch memory must be aligned for
+ * float access and at least edtaa3_scratch_size() bytes large.
+ * Returns the number of sweeps until the distances settled.
+ */
+int edtaa3_scratch( int width, int height, const float * input, float * output, void * scratch );
+
 #endif
@@ -2,6 +2,7 @@
 
 import os
 import json
+import numpy
 
 
 TRIANGULATE = False
@@ -30,6 +31,41 @@ def build_properties(obj):
 
 ##### Mesh {{{1
 
+# Finds the distinct rows of a float64 key array, like a dict lookup per row
+# would.  Returns the first row of each distinct key in the order they appear
+# and the index of its key for every row.  Rows are grouped by a 64 bit hash,
+# which is verified afterwards.
+def weld(keys):
+    bits = numpy.ascontiguousarray(keys).view(numpy.uint64)
+    hashes = numpy.zeros(len(bits), dtype=numpy.uint64)
+    with numpy.errstate(over='ignore'):
+        for column in bits.T:
+            hashes ^= column
+            hashes *= numpy.uint64(0x9E3779B97F4A7C15)
+            hashes ^= hashes >> numpy.uint64(32)
+
+    order = numpy.argsort(hashes, kind='stable')
+    sorted_hashes = hashes[order]
+    group_starts = numpy.empty(len(order), dtype=bool)
+    group_starts[0] = True
+    numpy.not_equal(sorted_hashes[1:], sorted_hashes[:-1], out=group_starts[1:])
+    groups = numpy.empty(len(order), dtype=numpy.int64)
+    groups[order] = numpy.cumsum(group_starts) - 1
+    first_rows = order[group_starts] # Stable sort, so the first of each group
+
+    if not (bits == bits[first_rows[groups]]).all():
+        # Hash collision, compare the whole rows instead
+        rows = bits.view(numpy.dtype((numpy.void, bits.shape[1]*8))).ravel()
+        _, first_rows, groups = numpy.unique(rows,
+                                             return_index=True,
+                                             return_inverse=True)
+        groups = groups.ravel()
+
+    appearance = numpy.argsort(first_rows)
+    ranks = numpy.empty(len(appearance), dtype=numpy.int64)
+    ranks[appearance] = numpy.arange(len(appearance))
+    return first_rows[appearance], ranks[groups]
+
 def build_mesh(obj):
     r = dict()
 
@@ -61,96 +97,88 @@ def build_mesh(obj):
     if not mesh.tessfaces and mesh.polygons:
         mesh.calc_tessface()
 
-    uv_layer = None
+    face_count = len(mesh.tessfaces)
+    if face_count == 0:
+        r['vertices'] = []
+        r['faces'] = []
+        return r
+
+    # Gather all attributes as arrays.  A fourth vertex index of 0 marks a
+    # triangle, Blender never puts vertex 0 last in a quad.
+    vertex_count = len(mesh.vertices)
+    coordinates = numpy.empty(vertex_count*3, dtype=numpy.float32)
+    mesh.vertices.foreach_get('co', coordinates)
+    coordinates = coordinates.reshape(-1, 3)
+    vertex_normals = numpy.empty(vertex_count*3, dtype=numpy.float32)
+    mesh.vertices.foreach_get('normal', vertex_normals)
+    vertex_normals = vertex_normals.reshape(-1, 3)
+
+    face_vertices = numpy.empty(face_count*4, dtype=numpy.int32)
+    mesh.tessfaces.foreach_get('vertices_raw', face_vertices)
+    face_vertices = face_vertices.reshape(-1, 4)
+    face_normals = numpy.empty(face_count*3, dtype=numpy.float32)
+    mesh.tessfaces.foreach_get('normal', face_normals)
+    face_normals = face_normals.reshape(-1, 3)
+    face_smooth = numpy.empty(face_count, dtype=bool)
+    mesh.tessfaces.foreach_get('use_smooth', face_smooth)
+
+    # Face corners in face order
+    face_sizes = numpy.where(face_vertices[:,3] == 0, 3, 4)
+    corner_mask = numpy.arange(4) < face_sizes[:,numpy.newaxis]
+    corner_faces, corner_slots = numpy.nonzero(corner_mask)
+    corner_vertices = face_vertices[corner_mask]
+
+    normals = numpy.where(face_smooth[corner_faces,numpy.newaxis],
+                          vertex_normals[corner_vertices],
+                          face_normals[corner_faces])
+    # Same result as round(), as the float32 values times 1e6 are exact.
+    # Adding 0 turns -0 into 0, which are equal as dict keys.
+    keys = [corner_vertices.astype(numpy.int64),
+            numpy.round(normals.astype(numpy.float64), 6) + 0.0]
+
+    uvs = None
     if mesh.tessface_uv_textures.active:
-        uv_layer = mesh.tessface_uv_textures.active.data
+        uvs = numpy.empty(face_count*8, dtype=numpy.float32)
+        mesh.tessface_uv_textures.active.data.foreach_get('uv_raw', uvs)
+        uvs = uvs.reshape(-1, 4, 2)[corner_faces, corner_slots]
+        keys.append(numpy.round(uvs.astype(numpy.float64), 6) + 0.0)
 
-    color_layer = None
+    colors = None
     if mesh.tessface_vertex_colors.active:
         color_layer = mesh.tessface_vertex_colors.active.data
-
-    def rvec3d(v):
-        return round(v[0], 6), round(v[1], 6), round(v[2], 6)
-
-    def rvec2d(v):
-        return round(v[0], 6), round(v[1], 6)
-
-    vertices_out = []
-    faces_out = [[] for f in range(len(mesh.tessfaces))]
-    vdict = [{} for i in range(len(mesh.vertices))]
-    vertex_count = 0
-
-    color = uv = uv_key = normal = normal_key = None
-
-    for face_index, face in enumerate(mesh.tessfaces):
-        smooth = face.use_smooth
-        if not smooth:
-            normal = face.normal[:]
-            normal_key = rvec3d(normal)
-
-        if uv_layer:
-            uvs = uv_layer[face_index]
-            uvs = (uvs.uv1,
-                   uvs.uv2,
-                   uvs.uv3,
-                   uvs.uv4)
-
-        if color_layer:
-            colors = color_layer[face_index]
-            colors = (colors.color1[:],
-                      colors.color2[:],
-                      colors.color3[:],
-                      colors.color4[:])
-
-        face_out = faces_out[face_index]
-        for face_vertex_index, vertex_index in enumerate(face.vertices):
-            vertex = mesh.vertices[vertex_index]
-
-            if smooth:
-                normal = vertex.normal[:]
-                normal_key = rvec3d(normal)
-
-            if uv_layer:
-                uv = (uvs[face_vertex_index][0],
-                      uvs[face_vertex_index][1])
-                uv_key = rvec2d(uv)
-
-            if color_layer:
-                color = colors[face_vertex_index]
-
-            key = normal_key, uv_key, color
-
-            vdict_local = vdict[vertex_index]
-            face_out_vertex_index = vdict_local.get(key)
-
-            if face_out_vertex_index is None:
-                face_out_vertex_index = vdict_local[key] = vertex_count
-
-                if Y_IS_UP:
-                    vertex_out = dict(x=vertex.co[0],
-                                      y=vertex.co[2],
-                                      z=vertex.co[1],
-                                      nx=normal[0],
-                                      ny=normal[2],
-                                      nz=normal[1])
-                else:
-                    vertex_out = dict(x=vertex.co[0],
-                                      y=vertex.co[1],
-                                      z=vertex.co[2],
-                                      nx=normal[0],
-                                      ny=normal[1],
-                                      nz=normal[2])
-                if uv_layer:
-                    vertex_out.update(dict(tx=uv[0],
-                                           ty=uv[1]))
-                if color_layer:
-                    vertex_out.update(dict(r=color[0],
-                                           g=color[1],
-                                           b=color[2]))
-                vertices_out.append(vertex_out)
-                vertex_count += 1
-
-            face_out.append(face_out_vertex_index)
+        colors = numpy.empty((4, face_count*3), dtype=numpy.float32)
+        for slot in range(4):
+            color_layer.foreach_get('color%d' % (slot+1), colors[slot])
+        colors = colors.reshape(4, -1, 3)[corner_slots, corner_faces]
+        keys.append(colors.astype(numpy.float64) + 0.0)
+
+    first_corners, corner_indices = weld(numpy.column_stack(keys))
+
+    # Vertices take the attributes of the corner which used them first
+    corners = first_corners
+    positions = coordinates[corner_vertices[corners]]
+    normals = normals[corners]
+    if Y_IS_UP:
+        positions = positions[:,[0,2,1]]
+        normals = normals[:,[0,2,1]]
+    names = ['x', 'y', 'z', 'nx', 'ny', 'nz']
+    columns = [positions, normals]
+    if uvs is not None:
+        names += ['tx', 'ty']
+        columns.append(uvs[corners])
+    if colors is not None:
+        names += ['r', 'g', 'b']
+        columns.append(colors[corners])
+    columns = numpy.column_stack(columns).tolist()
+    vertices_out = [dict(zip(names, values)) for values in columns]
+
+    corner_indices = corner_indices.tolist()
+    if (face_sizes == 3).all():
+        faces_out = [corner_indices[i:i+3] for i in range(0, len(corner_indices), 3)]
+    else:
+        ends = numpy.cumsum(face_sizes).tolist()
+        faces_out = [corner_indices[end-size:end]
+                     for end, size in zip(ends, face_sizes.tolist())]
 
     r['vertices'] = vertices_out
     r['faces'] = faces_out
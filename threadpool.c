@@ -0,0 +1,153 @@
+#define _POSIX_C_SOURCE 200112L // sysconf
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h> // malloc, free
+#include <string.h> // memset
+#include <pthread.h>
+#include <unistd.h> // sysconf
+#include "threadpool.h"
+
+
+typedef struct Task
+{
+    struct Task * next;
+    TaskFunction function;
+    void * data;
+} Task;
+
+typedef struct
+{
+    ThreadPool * pool;
+    int index;
+} Worker;
+
+struct ThreadPool
+{
+    pthread_t * threads;
+    Worker * workers;
+    int threadCount;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t taskAvailable;
+    pthread_cond_t tasksFinished;
+
+    Task * firstTask;
+    Task * lastTask;
+    int unfinishedTasks; // Queued or running
+    bool stopping;
+};
+
+
+static void * WorkerMain( void * argument )
+{
+    const Worker * worker = (const Worker *)argument;
+    ThreadPool * pool = worker->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    for(;;)
+    {
+        while(!pool->firstTask && !pool->stopping)
+            pthread_cond_wait(&pool->taskAvailable, &pool->mutex);
+
+        Task * task = pool->firstTask;
+        if(!task)
+            break; // Stopping and nothing left to do.
+
+        pool->firstTask = task->next;
+        if(!pool->firstTask)
+            pool->lastTask = NULL;
+
+        pthread_mutex_unlock(&pool->mutex);
+        task->function(task->data, worker->index);
+        free(task);
+        pthread_mutex_lock(&pool->mutex);
+
+        pool->unfinishedTasks--;
+        if(pool->unfinishedTasks == 0)
+            pthread_cond_broadcast(&pool->tasksFinished);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+int GetProcessorCount()
+{
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+}
+
+ThreadPool * CreateThreadPool( int threadCount )
+{
+    if(threadCount <= 0)
+        threadCount = GetProcessorCount();
+
+    ThreadPool * pool = (ThreadPool *)malloc(sizeof(ThreadPool));
+    memset(pool, 0, sizeof(ThreadPool));
+    pool->threadCount = threadCount;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->taskAvailable, NULL);
+    pthread_cond_init(&pool->tasksFinished, NULL);
+
+    pool->threads = (pthread_t *)malloc(sizeof(pthread_t)*threadCount);
+    pool->workers = (Worker *)malloc(sizeof(Worker)*threadCount);
+    for(int i = 0; i < threadCount; i++)
+    {
+        pool->workers[i].pool  = pool;
+        pool->workers[i].index = i;
+        pthread_create(&pool->threads[i], NULL, WorkerMain, &pool->workers[i]);
+    }
+
+    return pool;
+}
+
+void FreeThreadPool( ThreadPool * pool )
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->taskAvailable);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for(int i = 0; i < pool->threadCount; i++)
+        pthread_join(pool->threads[i], NULL);
+    assert(pool->unfinishedTasks == 0);
+
+    pthread_cond_destroy(&pool->tasksFinished);
+    pthread_cond_destroy(&pool->taskAvailable);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->workers);
+    free(pool->threads);
+    memset(pool, 0, sizeof(ThreadPool));
+    free(pool);
+}
+
+int GetThreadPoolSize( const ThreadPool * pool )
+{
+    return pool->threadCount;
+}
+
+void SubmitTask( ThreadPool * pool, TaskFunction function, void * data )
+{
+    Task * task = (Task *)malloc(sizeof(Task));
+    task->next     = NULL;
+    task->function = function;
+    task->data     = data;
+
+    pthread_mutex_lock(&pool->mutex);
+    assert(!pool->stopping);
+    if(pool->lastTask)
+        pool->lastTask->next = task;
+    else
+        pool->firstTask = task;
+    pool->lastTask = task;
+    pool->unfinishedTasks++;
+    pthread_cond_signal(&pool->taskAvailable);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void WaitForTasks( ThreadPool * pool )
+{
+    pthread_mutex_lock(&pool->mutex);
+    while(pool->unfinishedTasks > 0)
+        pthread_cond_wait(&pool->tasksFinished, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+}
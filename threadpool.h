@@ -0,0 +1,46 @@
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @param workerIndex
+ * Index of the worker thread which runs the task.  Lies between 0 and the
+ * pools thread count, so it can be used to address per-thread resources.
+ */
+typedef void (*TaskFunction)( void * data, int workerIndex );
+
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * @param threadCount
+ * Zero or less uses one thread per processor.
+ */
+ThreadPool * CreateThreadPool( int threadCount );
+
+/**
+ * Waits for all pending tasks and stops the threads.
+ */
+void FreeThreadPool( ThreadPool * pool );
+
+int GetThreadPoolSize( const ThreadPool * pool );
+
+/**
+ * Queues a task.  Tasks are started in the order they were submitted.
+ */
+void SubmitTask( ThreadPool * pool, TaskFunction function, void * data );
+
+/**
+ * Blocks until all submitted tasks have finished.
+ */
+void WaitForTasks( ThreadPool * pool );
+
+int GetProcessorCount();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
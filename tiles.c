@@ -0,0 +1,108 @@
+#include <stdlib.h> // malloc, free
+#include <string.h> // memset, memcmp, memcpy
+#include "tiles.h"
+
+
+void InitTileGrid( TileGrid * grid, int width, int height, int tileSize )
+{
+    grid->width    = width;
+    grid->height   = height;
+    grid->tileSize = tileSize;
+    grid->columns  = (width  + tileSize-1) / tileSize;
+    grid->rows     = (height + tileSize-1) / tileSize;
+    grid->dirty    = (bool *)malloc(sizeof(bool)*grid->columns*grid->rows);
+    memset(grid->dirty, 0, sizeof(bool)*grid->columns*grid->rows);
+}
+
+void FreeTileGrid( TileGrid * grid )
+{
+    free(grid->dirty);
+    memset(grid, 0, sizeof(TileGrid));
+}
+
+void GetTileRect( const TileGrid * grid,
+                  int column,
+                  int row,
+                  int * x,
+                  int * y,
+                  int * width,
+                  int * height )
+{
+    *x = column * grid->tileSize;
+    *y = row    * grid->tileSize;
+    *width  = grid->tileSize;
+    *height = grid->tileSize;
+    if(*x + *width > grid->width)
+        *width = grid->width - *x;
+    if(*y + *height > grid->height)
+        *height = grid->height - *y;
+}
+
+int MarkChangedTiles( TileGrid * grid, const float * a, const float * b )
+{
+    int count = 0;
+    for(int row = 0; row < grid->rows; row++)
+    for(int column = 0; column < grid->columns; column++)
+    {
+        int x, y, width, height;
+        GetTileRect(grid, column, row, &x, &y, &width, &height);
+
+        bool changed = false;
+        for(int i = 0; i < height && !changed; i++)
+        {
+            const int offset = (y+i)*grid->width + x;
+            changed = memcmp(&a[offset], &b[offset], sizeof(float)*width) != 0;
+        }
+
+        grid->dirty[row*grid->columns + column] = changed;
+        if(changed)
+            count++;
+    }
+    return count;
+}
+
+int DilateDirtyTiles( TileGrid * grid, int distance, bool wrap )
+{
+    const int columns = grid->columns;
+    const int rows = grid->rows;
+    int reach = (distance + grid->tileSize-1) / grid->tileSize;
+
+    // Partial tiles at the edge may be narrower than the distance, so
+    // changes which wrap around can reach one tile further:
+    if(wrap && (grid->width  % grid->tileSize != 0 ||
+                grid->height % grid->tileSize != 0))
+        reach++;
+
+    bool * source = (bool *)malloc(sizeof(bool)*columns*rows);
+    memcpy(source, grid->dirty, sizeof(bool)*columns*rows);
+
+    int count = 0;
+    for(int row = 0; row < rows; row++)
+    for(int column = 0; column < columns; column++)
+    {
+        bool dirty = false;
+        for(int dy = -reach; dy <= reach && !dirty; dy++)
+        for(int dx = -reach; dx <= reach && !dirty; dx++)
+        {
+            int r = row + dy;
+            int c = column + dx;
+            if(wrap)
+            {
+                r = ((r % rows) + rows) % rows;
+                c = ((c % columns) + columns) % columns;
+            }
+            else if(r < 0 || r >= rows || c < 0 || c >= columns)
+            {
+                continue;
+            }
+            dirty = source[r*columns + c];
+        }
+
+        grid->dirty[row*columns + column] = dirty;
+        if(dirty)
+            count++;
+    }
+
+    free(source);
+    return count;
+}
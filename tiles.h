@@ -0,0 +1,67 @@
+#ifndef __TILES_H__
+#define __TILES_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum
+{
+    DefaultTileSize = 64
+};
+
+/**
+ * Divides an image into square tiles and tracks which of them changed.
+ * Tiles at the right and bottom edge may be smaller.
+ */
+typedef struct
+{
+    int width;
+    int height;
+    int tileSize;
+    int columns;
+    int rows;
+    bool * dirty; // columns*rows flags
+} TileGrid;
+
+void InitTileGrid( TileGrid * grid, int width, int height, int tileSize );
+void FreeTileGrid( TileGrid * grid );
+
+/**
+ * Marks tiles which have any differing pixel in the two single channel
+ * images.
+ *
+ * @return
+ * Number of dirty tiles.
+ */
+int MarkChangedTiles( TileGrid * grid, const float * a, const float * b );
+
+/**
+ * Marks tiles which lie within `distance` pixels of a dirty one.
+ *
+ * @param wrap
+ * Whether the image is tiled, so changes affect the opposite edge.
+ *
+ * @return
+ * Number of dirty tiles.
+ */
+int DilateDirtyTiles( TileGrid * grid, int distance, bool wrap );
+
+/**
+ * Pixel rectangle of a tile.
+ */
+void GetTileRect( const TileGrid * grid,
+                  int column,
+                  int row,
+                  int * x,
+                  int * y,
+                  int * width,
+                  int * height );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
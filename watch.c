@@ -0,0 +1,382 @@
+#define _POSIX_C_SOURCE 200809L // sigaction, strdup, strndup
+#include <stdio.h> // fprintf
+#include "watch.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#include <stdlib.h> // malloc, realloc, free
+#include <string.h> // memset, memcpy, strcmp, strrchr, strdup, strndup
+#include <signal.h> // sigaction
+#include <poll.h>
+#include <unistd.h> // read, write, close, pipe
+#include <sys/inotify.h>
+
+// Jobs start once no event arrived for this many milliseconds:
+static const int DebounceTime = 200;
+
+typedef struct
+{
+    int watchDescriptor; // Of the directory which contains the input
+    char * baseName;
+    int * jobs; // Manifest entries which read the input
+    int jobCount;
+    bool changed;
+} Input;
+
+typedef struct
+{
+    const BatchOptions * options;
+    const BatchStages * stages;
+    void * context;
+    Manifest * manifest;
+    int inotify;
+    Input * inputs;
+    int inputCount;
+} Watch;
+
+// Written by the signal handler to wake up the event loop:
+static int StopPipe[2] = {-1, -1};
+
+
+static void HandleStopSignal( int signal )
+{
+    const char byte = 0;
+    const ssize_t result = write(StopPipe[1], &byte, 1);
+    (void)result;
+}
+
+static Input * FindInput( Watch * watch, int watchDescriptor, const char * baseName )
+{
+    for(int i = 0; i < watch->inputCount; i++)
+    {
+        Input * input = &watch->inputs[i];
+        if(input->watchDescriptor == watchDescriptor &&
+           strcmp(input->baseName, baseName) == 0)
+            return input;
+    }
+    return NULL;
+}
+
+/**
+ * Watches the directory of an input, so replacing the file is noticed too.
+ */
+static bool AddInput( Watch * watch, const char * fileName, int job )
+{
+    const char * slash = strrchr(fileName, '/');
+    char * directory;
+    if(!slash)
+        directory = strdup(".");
+    else if(slash == fileName)
+        directory = strdup("/");
+    else
+        directory = strndup(fileName, slash-fileName);
+    const char * baseName = slash ? slash+1 : fileName;
+
+    // Returns the same descriptor for directories which are already watched:
+    const int watchDescriptor = inotify_add_watch(watch->inotify,
+                                                  directory,
+                                                  IN_CLOSE_WRITE | IN_MOVED_TO);
+    if(watchDescriptor < 0)
+    {
+        fprintf(stderr, "Could not watch directory '%s'.\n", directory);
+        free(directory);
+        return false;
+    }
+    free(directory);
+
+    Input * input = FindInput(watch, watchDescriptor, baseName);
+    if(!input)
+    {
+        watch->inputs = (Input *)realloc(watch->inputs,
+                                         sizeof(Input)*(watch->inputCount+1));
+        input = &watch->inputs[watch->inputCount];
+        watch->inputCount++;
+
+        memset(input, 0, sizeof(Input));
+        input->watchDescriptor = watchDescriptor;
+        input->baseName = strdup(baseName);
+    }
+
+    input->jobs = (int *)realloc(input->jobs, sizeof(int)*(input->jobCount+1));
+    input->jobs[input->jobCount] = job;
+    input->jobCount++;
+    return true;
+}
+
+static void FreeInputs( Watch * watch )
+{
+    for(int i = 0; i < watch->inputCount; i++)
+    {
+        free(watch->inputs[i].baseName);
+        free(watch->inputs[i].jobs);
+    }
+    free(watch->inputs);
+    watch->inputs = NULL;
+    watch->inputCount = 0;
+}
+
+/**
+ * Builds the map from inputs to the jobs which read them.
+ * Invalid entries are reported before anything is processed.
+ */
+static bool AddInputs( Watch * watch )
+{
+    const Manifest * manifest = watch->manifest;
+    const BatchStages * stages = watch->stages;
+
+    bool success = true;
+    for(int i = 0; i < manifest->entryCount; i++)
+    {
+        const ManifestEntry * entry = &manifest->entries[i];
+        void * item = stages->createItem(entry->argc, entry->argv, watch->context);
+        if(!item)
+        {
+            fprintf(stderr,
+                    "%s:%d: Invalid job.\n",
+                    watch->options->manifestFileName,
+                    entry->line);
+            success = false;
+            continue;
+        }
+
+        success = AddInput(watch, stages->getInputFileName(item), i) && success;
+        stages->freeItem(item, watch->context);
+    }
+    return success;
+}
+
+/**
+ * Runs the given manifest entries through a pipeline.
+ * Items are created anew, so no state is left from a previous round.
+ */
+static void RunJobs( Watch * watch, const int * jobs, int jobCount )
+{
+    const Manifest * manifest = watch->manifest;
+    const BatchStages * stages = watch->stages;
+
+    void * * items = (void * *)malloc(sizeof(void *)*(jobCount+1));
+    bool * results = (bool *)malloc(sizeof(bool)*(jobCount+1));
+    int * itemJobs = (int *)malloc(sizeof(int)*(jobCount+1));
+    int itemCount = 0;
+
+    for(int i = 0; i < jobCount; i++)
+    {
+        const ManifestEntry * entry = &manifest->entries[jobs[i]];
+        void * item = stages->createItem(entry->argc, entry->argv, watch->context);
+        if(!item)
+        {
+            fprintf(stderr,
+                    "%s:%d: Invalid job.\n",
+                    watch->options->manifestFileName,
+                    entry->line);
+            continue;
+        }
+        items[itemCount] = item;
+        itemJobs[itemCount] = jobs[i];
+        itemCount++;
+    }
+
+    RunPipeline(items,
+                itemCount,
+                &stages->stages,
+                watch->context,
+                &watch->options->pipeline,
+                results);
+
+    for(int i = 0; i < itemCount; i++)
+    {
+        if(!results[i])
+            fprintf(stderr,
+                    "%s:%d: Job failed.\n",
+                    watch->options->manifestFileName,
+                    manifest->entries[itemJobs[i]].line);
+        stages->freeItem(items[i], watch->context);
+    }
+
+    free(itemJobs);
+    free(results);
+    free(items);
+}
+
+static void RunAllJobs( Watch * watch )
+{
+    const int jobCount = watch->manifest->entryCount;
+    int * jobs = (int *)malloc(sizeof(int)*(jobCount+1));
+    for(int i = 0; i < jobCount; i++)
+        jobs[i] = i;
+    RunJobs(watch, jobs, jobCount);
+    free(jobs);
+}
+
+/**
+ * Runs the jobs of all changed inputs, each once and in manifest order.
+ */
+static void RunChangedJobs( Watch * watch )
+{
+    const int entryCount = watch->manifest->entryCount;
+    bool * affected = (bool *)malloc(sizeof(bool)*(entryCount+1));
+    memset(affected, 0, sizeof(bool)*(entryCount+1));
+
+    for(int i = 0; i < watch->inputCount; i++)
+    {
+        Input * input = &watch->inputs[i];
+        if(!input->changed)
+            continue;
+        for(int j = 0; j < input->jobCount; j++)
+            affected[input->jobs[j]] = true;
+        input->changed = false;
+    }
+
+    int * jobs = (int *)malloc(sizeof(int)*(entryCount+1));
+    int jobCount = 0;
+    for(int i = 0; i < entryCount; i++)
+        if(affected[i])
+            jobs[jobCount++] = i;
+
+    if(jobCount > 0)
+        RunJobs(watch, jobs, jobCount);
+
+    free(jobs);
+    free(affected);
+}
+
+/**
+ * Marks the inputs of pending events as changed.
+ *
+ * @return
+ * Whether any input changed.
+ */
+static bool ReadEvents( Watch * watch )
+{
+    // Events are copied out, as names make them unaligned:
+    char buffer[16*1024];
+    const ssize_t size = read(watch->inotify, buffer, sizeof(buffer));
+    if(size <= 0)
+        return false;
+
+    bool changed = false;
+    for(ssize_t offset = 0; offset < size;)
+    {
+        struct inotify_event event;
+        memcpy(&event, &buffer[offset], sizeof(event));
+        const char * name = &buffer[offset + sizeof(event)];
+        offset += sizeof(event) + event.len;
+
+        if(event.mask & IN_Q_OVERFLOW)
+        {
+            // Events were lost, so anything may have changed:
+            for(int i = 0; i < watch->inputCount; i++)
+                watch->inputs[i].changed = true;
+            changed = true;
+            continue;
+        }
+        if(event.len == 0)
+            continue;
+
+        Input * input = FindInput(watch, event.wd, name);
+        if(input)
+        {
+            input->changed = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static void WatchInputs( Watch * watch )
+{
+    struct pollfd descriptors[2];
+    descriptors[0].fd = watch->inotify;
+    descriptors[0].events = POLLIN;
+    descriptors[1].fd = StopPipe[0];
+    descriptors[1].events = POLLIN;
+
+    int timeout = -1;
+    for(;;)
+    {
+        const int ready = poll(descriptors, 2, timeout);
+        if(ready < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(ready > 0 && descriptors[1].revents)
+            break;
+
+        if(ready == 0)
+        {
+            // It's quiet again:
+            RunChangedJobs(watch);
+            timeout = -1;
+        }
+        else if(ReadEvents(watch))
+        {
+            timeout = DebounceTime;
+        }
+    }
+}
+
+bool RunWatch( const BatchOptions * options,
+               const char * programName,
+               const BatchStages * stages,
+               void * context )
+{
+    Watch watch;
+    memset(&watch, 0, sizeof(Watch));
+    watch.options = options;
+    watch.stages = stages;
+    watch.context = context;
+
+    watch.manifest = ReadManifest(options->manifestFileName, programName);
+    if(!watch.manifest)
+        return false;
+
+    watch.inotify = inotify_init();
+    if(watch.inotify < 0)
+    {
+        fprintf(stderr, "Could not initialize inotify.\n");
+        FreeManifest(watch.manifest);
+        return false;
+    }
+
+    if(!AddInputs(&watch) || pipe(StopPipe) != 0)
+    {
+        FreeInputs(&watch);
+        close(watch.inotify);
+        FreeManifest(watch.manifest);
+        return false;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = HandleStopSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    // Changes made while the jobs run are picked up afterwards:
+    RunAllJobs(&watch);
+    WatchInputs(&watch);
+
+    close(StopPipe[0]);
+    close(StopPipe[1]);
+    StopPipe[0] = StopPipe[1] = -1;
+    FreeInputs(&watch);
+    close(watch.inotify);
+    FreeManifest(watch.manifest);
+    return true;
+}
+
+#else
+
+bool RunWatch( const BatchOptions * options,
+               const char * programName,
+               const BatchStages * stages,
+               void * context )
+{
+    fprintf(stderr, "Watch mode is only available on Linux.\n");
+    return false;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef __WATCH_H__
+#define __WATCH_H__
+
+#include <stdbool.h>
+#include "batch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Runs all jobs of the manifest `options->manifestFileName` and then keeps
+ * watching the directories of their inputs, until the process receives
+ * SIGINT or SIGTERM.
+ *
+ * Whenever an input is written or replaced, the jobs which read it run again.
+ * Bursts of events, like an editor saving several files, are collected
+ * until the directories stay quiet for a moment and then processed together.
+ * Outputs of one job may be inputs of another, which then runs in the next
+ * round.
+ *
+ * @return
+ * Whether the watch could be started.
+ */
+bool RunWatch( const BatchOptions * options,
+               const char * programName,
+               const BatchStages * stages,
+               void * context );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif